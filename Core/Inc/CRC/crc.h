@@ -0,0 +1,50 @@
+/**
+ * @file crc.h
+ * @brief Cálculo de CRC-16/CCITT y CRC-32C por tablas.
+ *
+ * Ambos CRC se calculan por software con tablas constantes en flash procesando varios bytes
+ * por iteración: de a 4 bytes (slice-by-4) el CRC-16 y de a 8 bytes (slice-by-8) el CRC-32C.
+ *
+ * - CRC-16/CCITT-FALSE: polinomio 0x1021, valor inicial 0xFFFF, sin reflejar, sin XOR final.
+ *   Valor de verificación para "123456789": 0x29B1.
+ * - CRC-32C (Castagnoli): polinomio 0x1EDC6F41 reflejado, valor inicial y XOR final 0xFFFFFFFF.
+ *   Valor de verificación para "123456789": 0xE3069283.
+ *
+ * Los dos admiten cálculo por partes: el resultado de una llamada se pasa como crc de la
+ * siguiente para continuar sobre el bloque contiguo.
+ *
+ * @date 17 de octubre de 2026
+ */
+
+#ifndef INC_CRC_CRC_H_
+#define INC_CRC_CRC_H_
+
+#include <stdint.h>
+
+/** @brief Valor inicial del CRC-16/CCITT. */
+#define CRC16_INIT					0xFFFF
+
+/** @brief Valor inicial del CRC-32C, ya con el XOR final aplicado. */
+#define CRC32C_INIT					0x00000000UL
+
+/**
+ * @brief Continúa el cálculo de CRC-16/CCITT sobre un bloque.
+ *
+ * @param crc CRC16_INIT o el resultado de la llamada anterior.
+ * @param data Bloque de datos.
+ * @param len Cantidad de bytes del bloque.
+ * @return CRC acumulado.
+ */
+uint16_t CRC16_Update(uint16_t crc, const uint8_t *data, uint32_t len);
+
+/**
+ * @brief Continúa el cálculo de CRC-32C sobre un bloque.
+ *
+ * @param crc CRC32C_INIT o el resultado de la llamada anterior.
+ * @param data Bloque de datos.
+ * @param len Cantidad de bytes del bloque.
+ * @return CRC acumulado, con el XOR final ya aplicado.
+ */
+uint32_t CRC32C_Update(uint32_t crc, const uint8_t *data, uint32_t len);
+
+#endif /* INC_CRC_CRC_H_ */
@@ -0,0 +1,139 @@
+/**
+ * @file pid.h
+ * @brief Controlador PID en punto fijo Q16 para lazos en cascada.
+ *
+ * Referencia, medición y salida van en Q16 de la unidad de cada lazo (grados, pulsos por
+ * segundo, porcentaje de PWM), así la salida de un lazo se pasa tal cual como referencia
+ * del siguiente. Cada actualización usa sólo productos de 64 bits y desplazamientos, sin
+ * divisiones ni FPU; las ganancias se cargan en float y se convierten una vez al cambiarlas.
+ *
+ * - Derivada sobre la medición: un escalón en la referencia no patea la salida. Pasa por un
+ *   pasabajos de primer orden para no amplificar el ruido del sensor.
+ * - Anti-windup: el término integral no crece mientras la salida está saturada en el mismo
+ *   sentido del error, y además queda acotado a los límites de salida.
+ * - Prealimentación: kff por la referencia más un término externo opcional.
+ *
+ * salida = kp * e + ki * Σe * dt + kd * d(-medición)/dt + kff * referencia + feedforward
+ *
+ * @par Ejemplo de uso:
+ * @code
+ * s_pidLoop tilt;
+ * s_pidGains gains = {.kp = 8.0f, .ki = 40.0f, .kd = 0.3f, .kff = 0.0f};
+ * PID_Init(&tilt, 1000, PID_Q16(-100), PID_Q16(100));		// 1kHz, salida ±100%
+ * PID_Set_Gains(&tilt, &gains);
+ * PID_Set_Derivative_Filter(&tilt, 50.0f);
+ * // En cada muestra nueva
+ * pwm = PID_Update(&tilt, 0, pitch, 0);
+ * @endcode
+ *
+ * @date 17 de octubre de 2026
+ */
+
+#ifndef INC_CONTROL_PID_H_
+#define INC_CONTROL_PID_H_
+
+#include "utilities.h"
+
+/** @brief Conversión de un valor real a Q16. */
+#define PID_Q16(x)					((int32_t)((x) * 65536.0f))
+
+/**
+ * @brief Ganancias de un lazo en unidades reales, tal como se configuran y se guardan.
+ */
+typedef struct{
+	float kp;			///< Proporcional, salida por unidad de error
+	float ki;			///< Integral, salida por unidad de error y segundo
+	float kd;			///< Derivativa, salida por unidad de medición por segundo
+	float kff;			///< Prealimentación, salida por unidad de referencia
+}s_pidGains;
+
+/**
+ * @brief Estado de un lazo.
+ *
+ * Las ganancias en punto fijo ya incluyen el período: ki * dt y kd / dt. Con ki * dt debajo de
+ * 2.0 y errores y salidas debajo de 32768 unidades no hay desbordes.
+ */
+typedef struct{
+	s_pidGains gains;	///< Ganancias configuradas
+	int32_t kp;			///< Proporcional, Q16
+	int32_t kiDt;		///< Integral por muestra, ki * dt en Q30
+	int32_t kdFs;		///< Derivativa por muestra, kd / dt en Q16
+	int32_t kff;		///< Prealimentación, Q16
+	int64_t integral;	///< Término integral, Q32 de la salida
+	int32_t dTerm;		///< Término derivativo filtrado, Q16 de la salida
+	int32_t prevMeasure;///< Medición anterior, Q16
+	int32_t outMin;		///< Límite inferior de la salida, Q16
+	int32_t outMax;		///< Límite superior de la salida, Q16
+	int32_t output;		///< Última salida, Q16
+	uint32_t dt_us;		///< Período de actualización, microsegundos
+	float dCutoff;		///< Corte del pasabajos de la derivada, Hz; 0 sin filtro
+	int16_t dAlpha;		///< Peso de la derivada nueva en el pasabajos, Q15
+	uint8_t isInit;		///< La primera medición ya fijó la anterior
+}s_pidLoop;
+
+/**
+ * @brief Inicializa el lazo con ganancias en cero y la derivada sin filtrar.
+ *
+ * @param pid Puntero al lazo.
+ * @param dt_us Período de actualización en microsegundos.
+ * @param outMin Límite inferior de la salida, Q16.
+ * @param outMax Límite superior de la salida, Q16.
+ */
+void PID_Init(s_pidLoop *pid, uint32_t dt_us, int32_t outMin, int32_t outMax);
+
+/**
+ * @brief Cambia las ganancias sin perder el término integral.
+ *
+ * Usa float: llamar al configurar, no en cada actualización.
+ *
+ * @param pid Puntero al lazo.
+ * @param gains Ganancias nuevas.
+ */
+void PID_Set_Gains(s_pidLoop *pid, const s_pidGains *gains);
+
+/**
+ * @brief Cambia el período de actualización y recalcula las ganancias por muestra.
+ *
+ * @param pid Puntero al lazo.
+ * @param dt_us Período de actualización en microsegundos.
+ */
+void PID_Set_Period(s_pidLoop *pid, uint32_t dt_us);
+
+/**
+ * @brief Cambia los límites de la salida.
+ *
+ * @param pid Puntero al lazo.
+ * @param outMin Límite inferior de la salida, Q16.
+ * @param outMax Límite superior de la salida, Q16.
+ */
+void PID_Set_Limits(s_pidLoop *pid, int32_t outMin, int32_t outMax);
+
+/**
+ * @brief Ajusta el pasabajos de primer orden de la derivada.
+ *
+ * @param pid Puntero al lazo.
+ * @param cutoff Frecuencia de corte en Hz; 0 deja la derivada sin filtrar.
+ */
+void PID_Set_Derivative_Filter(s_pidLoop *pid, float cutoff);
+
+/**
+ * @brief Borra la historia: término integral, derivada y salida.
+ *
+ * Llamar antes de cerrar el lazo para que arranque sin el estado de la vez anterior.
+ *
+ * @param pid Puntero al lazo.
+ */
+void PID_Reset(s_pidLoop *pid);
+
+/**
+ * @brief Calcula una actualización del lazo.
+ *
+ * @param pid Puntero al lazo.
+ * @param setpoint Referencia, Q16.
+ * @param measure Medición, Q16.
+ * @param feedforward Término que se suma directo a la salida, Q16.
+ * @return Salida saturada a los límites, Q16.
+ */
+int32_t PID_Update(s_pidLoop *pid, int32_t setpoint, int32_t measure, int32_t feedforward);
+
+#endif /* INC_CONTROL_PID_H_ */
@@ -0,0 +1,126 @@
+/**
+ * @file ahrs.h
+ * @brief Estimador de actitud 3D (AHRS) por cuaterniones, filtro complementario de Mahony.
+ *
+ * Integra el giróscopo sobre un cuaternión y corrige la inclinación con el acelerómetro,
+ * con realimentación proporcional e integral. El término integral es el sesgo del giróscopo
+ * en los ejes que ve el acelerómetro; el sesgo del eje Z (deriva del yaw) no lo ve cuando el
+ * robot está nivelado, así que además se aprende mientras el robot está quieto.
+ *
+ * Trabaja en float simple, que la FPU del Cortex-M4 resuelve en pocos ciclos, y normaliza con
+ * la raíz cuadrada inversa rápida. Los ángulos se obtienen aparte con AHRS_Get_Euler(), que
+ * usa funciones trigonométricas de la biblioteca.
+ *
+ * Convención de ejes, la misma que MPU6050.Angle: pitch es el giro sobre X, roll sobre Y y
+ * yaw sobre Z, positivo en sentido antihorario visto desde arriba.
+ *
+ * @par Ejemplo de uso:
+ * @code
+ * s_ahrs ahrs;
+ * AHRS_Init(&ahrs, 1000);									// Muestras cada 1000us
+ * // En cada muestra nueva, giróscopo y acelerómetro sin offset
+ * AHRS_Update(&ahrs, gyro, acc);
+ * AHRS_Get_Euler(&ahrs);
+ * heading = ahrs.yaw;
+ * @endcode
+ *
+ * @date 17 de octubre de 2026
+ */
+
+#ifndef INC_ESTIMATORS_AHRS_H_
+#define INC_ESTIMATORS_AHRS_H_
+
+#include "utilities.h"
+
+/** @brief Ganancia proporcional por defecto (2 * Kp). */
+#define AHRS_TWO_KP					1.0f
+/** @brief Ganancia integral por defecto (2 * Ki), aprende el sesgo del giróscopo. */
+#define AHRS_TWO_KI					0.02f
+
+/** @brief Sensibilidad del giróscopo en rad/s por LSB, rango +/-250 grados/s (131 LSB por grado/s). */
+#define AHRS_GYRO_250DPS			(3.14159265f / 180.0f / 131.0f)
+/** @brief LSB del acelerómetro para 1g, rango +/-2g. */
+#define AHRS_ACC_2G					16384
+
+/** @brief Desvío admitido del módulo de la aceleración respecto de 1g para corregir con ella. */
+#define AHRS_ACC_TOLERANCE			0.15f
+/** @brief Velocidad angular por debajo de la cual el robot puede estar quieto, rad/s. */
+#define AHRS_STILL_RATE				0.035f
+/** @brief Muestras seguidas quieto antes de aprender el sesgo. */
+#define AHRS_STILL_SAMPLES			200
+/** @brief Ganancia por muestra con la que el sesgo sigue al giróscopo estando quieto; en 0 no lo aprende. */
+#ifndef AHRS_STILL_GAIN
+#define AHRS_STILL_GAIN				0.002f
+#endif
+
+/**
+ * @brief Estado del estimador.
+ */
+typedef struct{
+	float q[4];			///< Cuaternión de actitud, w x y z
+	float bias[3];		///< Sesgo estimado del giróscopo, rad/s
+	float twoKp;		///< Ganancia proporcional (2 * Kp)
+	float twoKi;		///< Ganancia integral (2 * Ki)
+	float dt;			///< Período de muestreo, segundos
+	float gyroScale;	///< Sensibilidad del giróscopo, rad/s por LSB
+	float accOneG;		///< LSB del acelerómetro para 1g
+	float pitch;		///< Giro sobre X, grados. Lo actualiza AHRS_Get_Euler()
+	float roll;			///< Giro sobre Y, grados. Lo actualiza AHRS_Get_Euler()
+	float yaw;			///< Giro sobre Z, grados entre -180 y 180. Lo actualiza AHRS_Get_Euler()
+	float yawDrift;		///< Deriva del yaw que se está compensando, grados/s
+	uint16_t stillCount;///< Muestras seguidas con el robot quieto
+	uint8_t isStill;	///< El robot está quieto y se está aprendiendo el sesgo
+}s_ahrs;
+
+/**
+ * @brief Inicializa el estimador nivelado y con las ganancias y escalas por defecto.
+ *
+ * @param ahrs Puntero al estimador.
+ * @param dt_us Período de muestreo en microsegundos.
+ */
+void AHRS_Init(s_ahrs *ahrs, uint32_t dt_us);
+
+/**
+ * @brief Cambia las escalas de los sensores, por ejemplo al cambiar el rango del MPU6050.
+ *
+ * @param ahrs Puntero al estimador.
+ * @param gyroScale Sensibilidad del giróscopo, rad/s por LSB.
+ * @param accOneG LSB del acelerómetro para 1g.
+ */
+void AHRS_Set_Scale(s_ahrs *ahrs, float gyroScale, float accOneG);
+
+/**
+ * @brief Cambia el período de muestreo sin perder la actitud ni el sesgo estimados.
+ *
+ * @param ahrs Puntero al estimador.
+ * @param dt_us Período de muestreo en microsegundos.
+ */
+void AHRS_Set_Period(s_ahrs *ahrs, uint32_t dt_us);
+
+/**
+ * @brief Procesa una muestra y actualiza el cuaternión y el sesgo.
+ *
+ * Si el módulo de la aceleración se aleja de 1g el robot está acelerando y la muestra
+ * sólo integra el giróscopo.
+ *
+ * @param ahrs Puntero al estimador.
+ * @param gyro Lecturas del giróscopo X, Y, Z sin offset.
+ * @param acc Lecturas del acelerómetro X, Y, Z sin offset.
+ */
+void AHRS_Update(s_ahrs *ahrs, const int16_t gyro[3], const int16_t acc[3]);
+
+/**
+ * @brief Calcula pitch, roll, yaw y la deriva de yaw a partir del cuaternión.
+ *
+ * @param ahrs Puntero al estimador.
+ */
+void AHRS_Get_Euler(s_ahrs *ahrs);
+
+/**
+ * @brief Lleva el yaw a cero sin tocar la inclinación, por ejemplo al fijar el rumbo de partida.
+ *
+ * @param ahrs Puntero al estimador.
+ */
+void AHRS_Reset_Yaw(s_ahrs *ahrs);
+
+#endif /* INC_ESTIMATORS_AHRS_H_ */
@@ -0,0 +1,169 @@
+/**
+ * @file kalman.h
+ * @brief Filtro de Kalman de dos estados (ángulo y sesgo del giróscopo) para estimar el pitch.
+ *
+ * El giróscopo integra el ángulo en cada muestra y el acelerómetro lo corrige; el filtro
+ * estima además el sesgo del giróscopo, que así deja de acumular deriva.
+ *
+ * La versión principal trabaja en punto fijo para correr en cada muestra de 1ms sin usar
+ * la FPU ni divisiones largas más que dos por actualización:
+ * - Ángulo y sesgo en Q16 (grados y grados/s).
+ * - Covarianzas, ruidos y ganancias en Q30 (hasta 2.0).
+ * - Período de muestreo en Q32 de segundo.
+ *
+ * La versión en float (Kalman_Float_*) sigue exactamente las mismas ecuaciones y sirve de
+ * referencia para validar la de punto fijo.
+ *
+ * @par Ejemplo de uso:
+ * @code
+ * s_kalman pitch;
+ * Kalman_Init(&pitch, 1000);								// Muestras cada 1000us
+ * // En cada muestra nueva
+ * angle = Kalman_Update(&pitch, Kalman_Acc_Pitch(ax, ay, az), Kalman_Gyro_Rate(gx, KALMAN_GYRO_250DPS));
+ * @endcode
+ *
+ * @date 17 de octubre de 2026
+ */
+
+#ifndef INC_ESTIMATORS_KALMAN_H_
+#define INC_ESTIMATORS_KALMAN_H_
+
+#include "utilities.h"
+
+/** @brief Conversión de un valor real a Q16. */
+#define KALMAN_Q16(x)				((int32_t)((x) * 65536.0f))
+/** @brief Conversión de un valor real a Q30. */
+#define KALMAN_Q30(x)				((int32_t)((x) * 1073741824.0f))
+
+/** @brief Ruido de proceso del ángulo por defecto, grados²/s. */
+#define KALMAN_Q_ANGLE				0.001f
+/** @brief Ruido de proceso del sesgo por defecto, (grados/s)²/s. */
+#define KALMAN_Q_BIAS				0.003f
+/** @brief Ruido de medición del ángulo del acelerómetro por defecto, grados². */
+#define KALMAN_R_MEASURE			0.03f
+
+/** @brief Sensibilidad del giróscopo en Q24 de grados/s por LSB, rango +/-250 grados/s (131 LSB). */
+#define KALMAN_GYRO_250DPS			128070
+
+/**
+ * @brief Estado del filtro en punto fijo.
+ */
+typedef struct{
+	int32_t angle;		///< Ángulo estimado, Q16 grados
+	int32_t bias;		///< Sesgo estimado del giróscopo, Q16 grados/s
+	int32_t rate;		///< Velocidad angular sin sesgo de la última muestra, Q16 grados/s
+	int32_t P[2][2];	///< Covarianza del error, Q30
+	int32_t qAngle;		///< Ruido de proceso del ángulo, Q30
+	int32_t qBias;		///< Ruido de proceso del sesgo, Q30
+	int32_t rMeasure;	///< Ruido de medición, Q30
+	uint32_t dt;		///< Período de muestreo, Q32 de segundo
+	uint8_t isInit;		///< La primera medición ya fijó el ángulo inicial
+}s_kalman;
+
+/**
+ * @brief Estado del filtro de referencia en float.
+ */
+typedef struct{
+	float angle;		///< Ángulo estimado, grados
+	float bias;			///< Sesgo estimado del giróscopo, grados/s
+	float rate;			///< Velocidad angular sin sesgo de la última muestra, grados/s
+	float P[2][2];		///< Covarianza del error
+	float qAngle;		///< Ruido de proceso del ángulo
+	float qBias;		///< Ruido de proceso del sesgo
+	float rMeasure;		///< Ruido de medición
+	float dt;			///< Período de muestreo, segundos
+	uint8_t isInit;		///< La primera medición ya fijó el ángulo inicial
+}s_kalmanFloat;
+
+/**
+ * @brief Inicializa el filtro con los ruidos por defecto.
+ *
+ * @param k Puntero al filtro.
+ * @param dt_us Período de muestreo en microsegundos, menor a 1s.
+ */
+void Kalman_Init(s_kalman *k, uint32_t dt_us);
+
+/**
+ * @brief Cambia los ruidos del filtro. Con la covarianza en Q30 deben mantenerla por debajo de 2.0.
+ *
+ * @param k Puntero al filtro.
+ * @param qAngle Ruido de proceso del ángulo, Q30.
+ * @param qBias Ruido de proceso del sesgo, Q30.
+ * @param rMeasure Ruido de medición, Q30.
+ */
+void Kalman_Set_Noise(s_kalman *k, int32_t qAngle, int32_t qBias, int32_t rMeasure);
+
+/**
+ * @brief Cambia el período de muestreo sin perder el ángulo ni el sesgo estimados.
+ *
+ * Con períodos cortos los términos dt * P de la covarianza quedan en pocas unidades de Q30 y
+ * el sesgo se aparta de la referencia en float: 0.004 grados/s a 1ms, 0.05 grados/s a 250us.
+ * El MPU6050 no baja de MPU_MIN_PERIOD_US.
+ *
+ * @param k Puntero al filtro.
+ * @param dt_us Período de muestreo en microsegundos, menor a 1s.
+ */
+void Kalman_Set_Period(s_kalman *k, uint32_t dt_us);
+
+/**
+ * @brief Procesa una muestra: predice con el giróscopo y corrige con el acelerómetro.
+ *
+ * @param k Puntero al filtro.
+ * @param newAngle Ángulo medido por el acelerómetro, Q16 grados.
+ * @param newRate Velocidad angular medida por el giróscopo, Q16 grados/s.
+ * @return Ángulo estimado, Q16 grados.
+ */
+int32_t Kalman_Update(s_kalman *k, int32_t newAngle, int32_t newRate);
+
+/**
+ * @brief Arcotangente de y/x en los cuatro cuadrantes.
+ *
+ * Aproximación polinómica de noveno orden con el cociente redondeado a Q15, error menor a
+ * 0.002 grados en todo el rango de int32_t.
+ *
+ * @param y Componente en el eje de las ordenadas, en cualquier unidad.
+ * @param x Componente en el eje de las abscisas, en la misma unidad que y.
+ * @return Ángulo entre -180 y 180, Q16 grados.
+ */
+int32_t Kalman_Atan2(int32_t y, int32_t x);
+
+/**
+ * @brief Pitch medido por el acelerómetro: atan2(ay, sqrt(ax² + az²)).
+ *
+ * Corresponde a un giro sobre el eje X, el mismo que mide el giróscopo en X.
+ *
+ * @param ax Aceleración en X, sin offset.
+ * @param ay Aceleración en Y, sin offset.
+ * @param az Aceleración en Z, sin offset.
+ * @return Pitch, Q16 grados.
+ */
+int32_t Kalman_Acc_Pitch(int16_t ax, int16_t ay, int16_t az);
+
+/**
+ * @brief Convierte una lectura cruda del giróscopo a Q16 grados/s.
+ *
+ * @param raw Lectura del giróscopo, sin offset.
+ * @param scale Sensibilidad en Q24 de grados/s por LSB, por ejemplo KALMAN_GYRO_250DPS.
+ * @return Velocidad angular, Q16 grados/s.
+ */
+int32_t Kalman_Gyro_Rate(int16_t raw, int32_t scale);
+
+/**
+ * @brief Inicializa el filtro de referencia con los ruidos por defecto.
+ *
+ * @param k Puntero al filtro.
+ * @param dt Período de muestreo en segundos.
+ */
+void Kalman_Float_Init(s_kalmanFloat *k, float dt);
+
+/**
+ * @brief Procesa una muestra con el filtro de referencia.
+ *
+ * @param k Puntero al filtro.
+ * @param newAngle Ángulo medido por el acelerómetro, grados.
+ * @param newRate Velocidad angular medida por el giróscopo, grados/s.
+ * @return Ángulo estimado, grados.
+ */
+float Kalman_Float_Update(s_kalmanFloat *k, float newAngle, float newRate);
+
+#endif /* INC_ESTIMATORS_KALMAN_H_ */
@@ -0,0 +1,192 @@
+/**
+ * @file filters.h
+ * @brief Filtros en punto fijo para varios canales: media móvil, IIR de primer orden, biquad y mediana.
+ *
+ * Todos trabajan sobre tramas intercaladas de int16_t, como las deja el DMA del ADC o la
+ * lectura del MPU6050: canal 0, canal 1, ..., canal N-1 de la primera muestra, luego los de
+ * la segunda, y así. Cada llamada procesa un bloque de tramas; la entrada y la salida pueden
+ * ser el mismo vector.
+ *
+ * Los buffers los reserva el usuario, del tamaño que indica cada función de inicio, así no
+ * hay memoria dinámica y el mismo código sirve para 6 ejes o 9 sensores analógicos.
+ *
+ * En el Cortex-M4 el biquad y la mediana procesan dos canales por instrucción con las
+ * instrucciones SIMD de la extensión DSP (SMLALD, SSUB16 y SEL); en otros procesadores, o en
+ * la PC, se usa el mismo algoritmo en C portable y el resultado es idéntico bit a bit.
+ *
+ * @par Ejemplo de uso:
+ * @code
+ * static int16_t history[8][6];
+ * static int32_t sum[6];
+ * s_filterMaf maf;
+ * Filter_Maf_Init(&maf, &history[0][0], sum, 6, 3);		// 6 canales, media de 8 muestras
+ * Filter_Maf_Process(&maf, raw, filtered, 1);
+ * @endcode
+ *
+ * @date 17 de octubre de 2026
+ */
+
+#ifndef INC_FILTERS_FILTERS_H_
+#define INC_FILTERS_FILTERS_H_
+
+#include "utilities.h"
+
+/** @brief Convierte una constante real a Q15, por ejemplo el alfa del IIR. */
+#define FILTER_Q15(x)				((int16_t)((x) * 32768.0f + 0.5f))
+/** @brief Convierte una constante real a Q14, los coeficientes del biquad. */
+#define FILTER_Q14(x)				((int16_t)((x) >= 0 ? (x) * 16384.0f + 0.5f : (x) * 16384.0f - 0.5f))
+
+/** @brief Muestras de la mediana más larga admitida. */
+#define FILTER_MEDIAN_MAX			5
+
+/**
+ * @brief Media móvil de 2^bits muestras.
+ *
+ * La suma es de 32 bits, así no desborda con ninguna cantidad de muestras de 16 bits.
+ */
+typedef struct{
+	int16_t *history;		///< Últimas muestras, [2^bits][channels]
+	int32_t *sum;			///< Suma de la ventana de cada canal, [channels]
+	uint16_t channels;		///< Canales por trama
+	uint8_t bits;			///< Log2 de la ventana
+	uint8_t index;			///< Fila de history que se reemplaza en la próxima trama
+}s_filterMaf;
+
+/**
+ * @brief IIR de primer orden: y += alfa * (x - y).
+ *
+ * La salida se guarda con 15 bits de fracción, así un alfa chico no pierde el escalón final.
+ */
+typedef struct{
+	int32_t *state;			///< Salida de cada canal en Q15, [channels]
+	uint16_t channels;		///< Canales por trama
+	int16_t alpha;			///< Peso de la muestra nueva, Q15
+	uint8_t isInit;			///< El estado arranca en la primera muestra
+}s_filterIir;
+
+/**
+ * @brief Biquad en forma directa I con coeficientes Q14.
+ *
+ * y = b0*x0 + b1*x1 + b2*x2 - a1*y1 - a2*y2, con a0 = 1. Los coeficientes se guardan de a
+ * pares para multiplicar dos por instrucción.
+ */
+typedef struct{
+	int16_t *state;			///< x1, x2, y1, y2 de cada canal, [channels][4]
+	uint32_t b0b1;			///< b0 en la mitad baja y b1 en la alta
+	uint32_t b2a1;			///< b2 en la mitad baja y -a1 en la alta
+	int16_t a2;				///< -a2
+	uint16_t channels;		///< Canales por trama
+}s_filterBiquad;
+
+/**
+ * @brief Mediana de las últimas 3 o 5 muestras; descarta picos aislados.
+ */
+typedef struct{
+	int16_t *history;		///< Últimas muestras, [size][channels]
+	uint16_t channels;		///< Canales por trama
+	uint8_t size;			///< Muestras de la ventana, 3 o 5
+	uint8_t index;			///< Fila de history que se reemplaza en la próxima trama
+}s_filterMedian;
+
+/**
+ * @brief Inicializa una media móvil con el historial en cero.
+ *
+ * @param f Puntero al filtro.
+ * @param history Buffer de (1 << bits) * channels muestras.
+ * @param sum Buffer de channels sumas.
+ * @param channels Canales por trama.
+ * @param bits Log2 de la ventana, hasta 8.
+ */
+void Filter_Maf_Init(s_filterMaf *f, int16_t *history, int32_t *sum, uint16_t channels, uint8_t bits);
+
+/**
+ * @brief Aplica la media móvil a un bloque de tramas.
+ *
+ * @param f Puntero al filtro.
+ * @param in Tramas de entrada, frames * channels muestras.
+ * @param out Tramas filtradas, puede ser in.
+ * @param frames Tramas del bloque.
+ */
+void Filter_Maf_Process(s_filterMaf *f, const int16_t *in, int16_t *out, uint16_t frames);
+
+/**
+ * @brief Inicializa un IIR de primer orden; la primera muestra fija el estado.
+ *
+ * @param f Puntero al filtro.
+ * @param state Buffer de channels estados.
+ * @param channels Canales por trama.
+ * @param alpha Peso de la muestra nueva en Q15, ver FILTER_Q15(). Con 32767 no filtra.
+ */
+void Filter_Iir_Init(s_filterIir *f, int32_t *state, uint16_t channels, int16_t alpha);
+
+/**
+ * @brief Aplica el IIR de primer orden a un bloque de tramas.
+ *
+ * @param f Puntero al filtro.
+ * @param in Tramas de entrada, frames * channels muestras.
+ * @param out Tramas filtradas, puede ser in.
+ * @param frames Tramas del bloque.
+ */
+void Filter_Iir_Process(s_filterIir *f, const int16_t *in, int16_t *out, uint16_t frames);
+
+/**
+ * @brief Inicializa un biquad con el estado en cero.
+ *
+ * @param f Puntero al filtro.
+ * @param state Buffer de 4 * channels muestras.
+ * @param channels Canales por trama.
+ * @param coef b0, b1, b2, a1, a2 en Q14, normalizados con a0 = 1.
+ */
+void Filter_Biquad_Init(s_filterBiquad *f, int16_t *state, uint16_t channels, const int16_t coef[5]);
+
+/**
+ * @brief Calcula los coeficientes de un pasabajos de segundo orden (RBJ).
+ *
+ * Usa float y funciones trigonométricas; llamar al iniciar, no en la interrupción.
+ *
+ * @note Q14 alcanza para cortes no muy bajos. Con fc/fs = 0.02 (20Hz a 1kHz) 1 + a1 + a2 vale
+ * 0.0145: el redondeo de la salida realimentado se amplifica unas 70 veces y el error contra
+ * el filtro ideal ronda los 15 LSB (hasta 20 en el peor caso), casi sin depender de la amplitud.
+ * Además los coeficientes redondeados bajan la ganancia en continua a 0.9974, un 0.26%.
+ * Con cortes más bajos los dos errores crecen como (fs/fc)^2; ahí conviene filtrar a una
+ * frecuencia de muestreo menor o usar el IIR de primer orden.
+ *
+ * @param coef Destino de b0, b1, b2, a1, a2 en Q14.
+ * @param cutoff Frecuencia de corte, Hz.
+ * @param sampleRate Frecuencia de muestreo, Hz.
+ * @param q Factor de calidad, 0.7071 para Butterworth.
+ */
+void Filter_Biquad_Lowpass(int16_t coef[5], float cutoff, float sampleRate, float q);
+
+/**
+ * @brief Aplica el biquad a un bloque de tramas. La salida satura en el rango de int16_t.
+ *
+ * @param f Puntero al filtro.
+ * @param in Tramas de entrada, frames * channels muestras.
+ * @param out Tramas filtradas, puede ser in.
+ * @param frames Tramas del bloque.
+ */
+void Filter_Biquad_Process(s_filterBiquad *f, const int16_t *in, int16_t *out, uint16_t frames);
+
+/**
+ * @brief Inicializa una mediana con el historial en cero.
+ *
+ * @param f Puntero al filtro.
+ * @param history Buffer de size * channels muestras.
+ * @param channels Canales por trama.
+ * @param size Muestras de la ventana, 3 o 5.
+ * @return SYS_OK, o SYS_ERROR si el tamaño no es válido.
+ */
+e_system Filter_Median_Init(s_filterMedian *f, int16_t *history, uint16_t channels, uint8_t size);
+
+/**
+ * @brief Aplica la mediana a un bloque de tramas.
+ *
+ * @param f Puntero al filtro.
+ * @param in Tramas de entrada, frames * channels muestras.
+ * @param out Tramas filtradas, puede ser in.
+ * @param frames Tramas del bloque.
+ */
+void Filter_Median_Process(s_filterMedian *f, const int16_t *in, int16_t *out, uint16_t frames);
+
+#endif /* INC_FILTERS_FILTERS_H_ */
@@ -6,6 +6,31 @@
  * calibrar y obtener datos del acelerómetro y giróscopo del MPU6050 utilizando una
  * interfaz I2C configurable por el usuario.
  *
+ * En modo FIFO el sensor guarda cada muestra (acelerómetro, temperatura y giróscopo, 14
+ * bytes en el mismo orden que los registros desde ACCEL_XOUT) en su FIFO interna y el
+ * firmware la vacía periódicamente con una lectura DMA de FIFO_COUNTH seguida de una única
+ * ráfaga sobre FIFO_R_W. Las muestras pasan a una cola que consume MPU6050_MAF(), así no se
+ * pierde ninguna aunque la lectura se atrase.
+ *
+ * En modo data-ready el pin INT del sensor marca cada muestra nueva y la interrupción
+ * arranca enseguida la lectura por DMA desde ACCEL_XOUT, para tener siempre la muestra más
+ * reciente. Se mide la demora desde la interrupción hasta que la muestra queda publicada.
+ *
+ * La calibración en segundo plano toma las mismas muestras que llegan por DMA, en ventanas
+ * de MPU_CALIB_WINDOW: sólo suma las ventanas con poca varianza (robot quieto) y cuyo
+ * giróscopo coincide con las anteriores, y publica los offsets al juntar NUM_SAMPLES.
+ *
+ * El sesgo del giróscopo cambia con la temperatura del sensor. Con cada ventana quieta se
+ * suma un punto (temperatura media, giróscopo medio) a una regresión lineal con olvido por
+ * eje; cuando los puntos cubren un rango de temperatura suficiente, cada muestra toma el
+ * offset del giróscopo de la recta con una multiplicación y suma en punto fijo.
+ *
+ * El rango, el filtro pasabajos (DLPF) y la tasa de muestreo se cambian en marcha con
+ * MPU6050_Configure(). Los cuatro registros son consecutivos y se escriben en una sola
+ * transferencia DMA, intercalada entre las lecturas. Al aplicarse quedan en Config los
+ * factores de escala en punto fijo y el período, y Config.changes avanza para que los
+ * consumidores (estimadores, pantalla, telemetría) tomen las escalas nuevas una sola vez.
+ *
  * @author Agustín Alejandro Mayer
  * @date 20 de mayo de 2025
  */
@@ -15,6 +40,7 @@
 
 #include <stdint.h>
 #include "utilities.h"
+#include "Filters/filters.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -45,11 +71,83 @@ extern "C" {
 #define FIFO_COUNTH                 0x72
 #define FIFO_R_W                    0x74
 
+// Bits de registros usados en modo FIFO
+#define FIFO_EN_ACCEL_TEMP_GYRO     0xF8    ///< TEMP_FIFO_EN | XG | YG | ZG | ACCEL_FIFO_EN
+#define USER_CTRL_FIFO_EN           0x40
+#define USER_CTRL_FIFO_RESET        0x04
+#define INT_PIN_CFG_PULSE_HIGH      0x00    ///< INT activo en alto, push-pull, pulso de 50us
+#define INT_ENABLE_DATA_RDY         0x01
+
 // Parámetros de configuración
 #define MPU_TIMEOUT                 1000    ///< Timeout para operaciones I2C
 #define NUM_SAMPLES                 4096    ///< Muestras para calibración
 #define NUM_SAMPLES_BITS            12      ///< Bits de desplazamiento equivalente a 4096
 #define SCALE_FACTOR                16384   ///< Factor de escala para ±2g
+#define MPU_GYRO_DPS_Q24            128070  ///< Grados/s por LSB en Q24 para ±250 grados/s (131 LSB)
+#define MPU_ACC_MS2_Q24             10042   ///< m/s² por LSB en Q24 para ±2g
+
+/** @brief Período de muestreo mínimo admitido, us. El bus I2C compartido no lee más rápido. */
+#ifndef MPU_MIN_PERIOD_US
+#define MPU_MIN_PERIOD_US           1000
+#endif
+
+/** @brief Configuración de arranque: DLPF de 44Hz y 1kHz. */
+#define MPU_DEFAULT_DLPF            MPU_DLPF_44HZ
+#define MPU_DEFAULT_SAMPLE_DIV      0
+
+/** @brief Muestras de cada ventana de la calibración en segundo plano. */
+#define MPU_CALIB_WINDOW_BITS       8
+#define MPU_CALIB_WINDOW            (1 << MPU_CALIB_WINDOW_BITS)
+/** @brief Varianza máxima del giróscopo en una ventana quieta, LSB² (20 LSB eficaces, 0.15 grados/s). */
+#ifndef MPU_CALIB_GYRO_VAR
+#define MPU_CALIB_GYRO_VAR          400
+#endif
+/** @brief Varianza máxima del acelerómetro en una ventana quieta, LSB² (50 LSB eficaces, 3mg). */
+#ifndef MPU_CALIB_ACC_VAR
+#define MPU_CALIB_ACC_VAR           2500
+#endif
+/** @brief Diferencia máxima entre la media del giróscopo de una ventana y la acumulada, LSB. */
+#ifndef MPU_CALIB_GYRO_DRIFT
+#define MPU_CALIB_GYRO_DRIFT        20
+#endif
+
+/** @brief Compensación del sesgo del giróscopo por temperatura; en 0 quedan los offsets fijos. */
+#ifndef MPU_THERMAL_COMP
+#define MPU_THERMAL_COMP            1
+#endif
+/** @brief Memoria de la regresión de temperatura en ventanas quietas (256 ventanas, 65s a 1kHz). */
+#ifndef MPU_THERMAL_MEMORY
+#define MPU_THERMAL_MEMORY          256
+#endif
+/** @brief Ventanas quietas antes de usar la recta. */
+#define MPU_THERMAL_MIN_POINTS      16
+/** @brief Varianza mínima de la temperatura de los puntos para estimar la pendiente, LSB² (0.5 grados eficaces). */
+#define MPU_THERMAL_MIN_VAR         28900.0f
+/** @brief Pendiente máxima creíble, LSB de giróscopo por LSB de temperatura en Q16 (unos 40 LSB por grado). */
+#define MPU_THERMAL_MAX_SLOPE       8192
+/** @brief Centésimas de grado por LSB de temperatura en Q16 (1/340 grados). */
+#define MPU_TEMP_CENTI_Q16          19275
+/** @brief Temperatura con lectura cero, centésimas de grado. */
+#define MPU_TEMP_OFFSET_CENTI       3653
+
+#define MPU_FIFO_SIZE               1024    ///< Capacidad de la FIFO interna en bytes
+#define MPU_FIFO_FRAME              14      ///< Bytes de cada muestra en la FIFO
+#define MPU_FRAME_WORDS             7       ///< Palabras de una muestra: Acc x,y,z, temperatura, Gyro x,y,z
+
+/** @brief Muestras máximas que se leen en una ráfaga; el resto queda para la próxima. */
+#ifndef MPU_FIFO_BURST
+#define MPU_FIFO_BURST              16
+#endif
+
+/** @brief Períodos de muestreo sin interrupción de data-ready tras los que se deja ese modo. */
+#ifndef MPU_DRDY_TIMEOUT_PERIODS
+#define MPU_DRDY_TIMEOUT_PERIODS    8
+#endif
+
+/** @brief Muestras que entran en la cola hasta que las consume MPU6050_MAF(). Potencia de 2, hasta 128. */
+#ifndef MPU_QUEUE_SIZE
+#define MPU_QUEUE_SIZE              32
+#endif
 
 #ifndef NUM_MAF_BITS
 #define NUM_MAF_BITS				3
@@ -79,6 +177,52 @@ typedef struct {
     } offset;
 } s_Axis;
 
+/**
+ * @brief Etapas de la lectura de la FIFO, encadenadas desde los callbacks de DMA.
+ */
+typedef enum{
+	MPU_FIFO_IDLE = 0,		///< Sin transferencia en curso
+	MPU_FIFO_COUNT,			///< Leyendo FIFO_COUNTH
+	MPU_FIFO_DATA,			///< Leyendo la ráfaga de muestras
+	MPU_FIFO_RESET			///< Escribiendo USER_CTRL para vaciar la FIFO luego de un desborde
+}e_mpuFifoState;
+
+/**
+ * @brief Rango del acelerómetro, valor de AFS_SEL. Cada paso duplica el rango y la escala.
+ */
+typedef enum{
+	MPU_ACC_2G = 0,
+	MPU_ACC_4G,
+	MPU_ACC_8G,
+	MPU_ACC_16G
+}e_mpuAccRange;
+
+/**
+ * @brief Rango del giróscopo, valor de FS_SEL. Cada paso duplica el rango y la escala.
+ */
+typedef enum{
+	MPU_GYRO_250DPS = 0,
+	MPU_GYRO_500DPS,
+	MPU_GYRO_1000DPS,
+	MPU_GYRO_2000DPS
+}e_mpuGyroRange;
+
+/**
+ * @brief Ancho de banda del filtro pasabajos interno (DLPF_CFG), del giróscopo.
+ *
+ * Menos ancho de banda es menos ruido y más demora. Sin filtro (260Hz) el muestreo base es
+ * de 8kHz; con filtro es de 1kHz.
+ */
+typedef enum{
+	MPU_DLPF_260HZ = 0,		///< Demora de 1ms
+	MPU_DLPF_184HZ,			///< Demora de 2ms
+	MPU_DLPF_94HZ,			///< Demora de 3ms
+	MPU_DLPF_44HZ,			///< Demora de 5ms
+	MPU_DLPF_21HZ,			///< Demora de 8.5ms
+	MPU_DLPF_10HZ,			///< Demora de 13.8ms
+	MPU_DLPF_5HZ			///< Demora de 19ms
+}e_mpuDlpf;
+
 /**
  * @struct s_MPU
  * @brief Representa el estado completo del sensor MPU6050.
@@ -87,18 +231,86 @@ typedef struct {
     s_Axis Acc;    ///< Datos del acelerómetro
     s_Axis Gyro;   ///< Datos del giróscopo
     struct{
-        int16_t pitch; ///< Ángulo de pitch (inclinación)
-        int16_t roll;  ///< Ángulo de roll (balanceo)
-        int16_t yaw;   ///< Ángulo de yaw (giro)
+        int16_t pitch; ///< Ángulo de pitch (inclinación), en centésimas de grado
+        int16_t roll;  ///< Ángulo de roll (balanceo), en centésimas de grado
+        int16_t yaw;   ///< Ángulo de yaw (giro), rumbo en centésimas de grado entre -180 y 180
     }Angle;          ///< Ángulos calculados
     struct{
     	int32_t sumData[NUM_AXIS];
     	int16_t mediaBuffer[NUM_MAF][NUM_AXIS];
     	int16_t rawData[NUM_AXIS];
     	int16_t filtredData[NUM_AXIS];
-    	uint8_t index;
+    	s_filterMaf filter;		///< Media móvil sobre mediaBuffer y sumData
     	uint8_t isOn;
     }MAF;
+    struct{
+    	int16_t queue[MPU_QUEUE_SIZE][MPU_FRAME_WORDS];	///< Muestras leídas pendientes de procesar
+    	uint8_t buffer[MPU_FIFO_BURST * MPU_FIFO_FRAME];	///< Destino de la ráfaga DMA
+    	uint8_t countData[2];	///< FIFO_COUNTH y FIFO_COUNTL leídos por DMA
+    	uint8_t control;		///< Valor de USER_CTRL que se escribe por DMA al vaciar la FIFO
+    	uint8_t head;			///< Próxima posición a escribir de la cola
+    	uint8_t tail;			///< Próxima posición a leer de la cola
+    	uint8_t frames;			///< Muestras de la ráfaga en curso
+    	uint8_t state;			///< Etapa de la lectura, uno de e_mpuFifoState
+    	uint8_t isOn;			///< El sensor funciona en modo FIFO
+    	uint32_t overflows;		///< Desbordes de la FIFO interna, cada uno vacía la FIFO
+    	uint32_t dropped;		///< Muestras descartadas por cola llena
+    }FIFO;
+    struct{
+    	uint32_t irqTime;		///< Instante de la última interrupción de data-ready
+    	uint32_t readTime;		///< Instante de la interrupción de la muestra que se está leyendo
+    	uint32_t latency;		///< Demora de la última muestra, de la interrupción a la publicación
+    	uint32_t maxLatency;	///< Mayor demora medida
+    	uint32_t totalLatency;	///< Suma de las demoras, para obtener el promedio
+    	uint32_t samples;		///< Muestras publicadas
+    	uint32_t missed;		///< Interrupciones llegadas antes de leer la muestra anterior
+    	uint32_t silence;		///< Tiempo desde la última interrupción según MPU6050_DataReady_Watchdog(), us
+    	uint8_t isPending;		///< Hay una muestra nueva esperando que se libere el bus
+    	uint8_t isReading;		///< Hay una lectura por DMA en curso
+    	uint8_t isOn;			///< El sensor funciona en modo data-ready
+    }DRDY;
+    struct{
+    	int64_t sumSq[NUM_AXIS];	///< Suma de cuadrados de la ventana, para la varianza
+    	int32_t windowSum[NUM_AXIS];///< Suma de la ventana en curso
+    	int32_t windowTemp;			///< Suma de la temperatura de la ventana en curso
+    	int32_t sum[NUM_AXIS];		///< Suma de las ventanas aceptadas
+    	uint16_t count;				///< Muestras de la ventana en curso
+    	uint8_t windows;			///< Ventanas aceptadas
+    	uint32_t rejected;			///< Ventanas descartadas por movimiento
+    	uint8_t isRunning;			///< La calibración en segundo plano está en curso
+    	uint8_t isDone;				///< Los offsets ya están publicados
+    }Calib;
+    struct{
+    	float n;					///< Peso acumulado de los puntos, con olvido
+    	float sT;					///< Suma de temperaturas respecto de tRef
+    	float sTT;					///< Suma de cuadrados de temperaturas
+    	float sG[3];				///< Suma del giróscopo medio de cada eje
+    	float sTG[3];				///< Suma de productos temperatura por giróscopo
+    	int32_t slope[3];			///< Pendiente del sesgo, LSB de giróscopo por LSB de temperatura, Q16
+    	int32_t intercept[3];		///< Sesgo en tRef, LSB de giróscopo en Q16
+    	int16_t raw;				///< Última lectura del sensor de temperatura
+    	int16_t celsius;			///< Última temperatura, centésimas de grado
+    	int16_t tRef;				///< Temperatura de referencia de la recta, LSB; la de la primera ventana quieta
+    	uint16_t points;			///< Ventanas quietas sumadas, hasta MPU_THERMAL_MIN_POINTS
+    	uint8_t hasSlope;			///< La pendiente ya se estimó con suficiente rango de temperatura
+    	uint8_t isValid;			///< La recta reemplaza a los offsets fijos del giróscopo
+    	uint8_t isOn;				///< La compensación por temperatura está habilitada
+    }Thermal;
+    struct{
+    	int32_t gyroScale;			///< Grados/s por LSB del giróscopo, Q24
+    	int32_t accScale;			///< m/s² por LSB del acelerómetro, Q24
+    	uint32_t samplePeriod;		///< Período de muestreo, us
+    	uint16_t accOneG;			///< LSB del acelerómetro para 1g
+    	uint8_t regs[4];			///< SMPLRT_DIV, CONFIG, GYRO_CONFIG y ACCEL_CONFIG a escribir
+    	uint8_t accRange;			///< Rango vigente, uno de e_mpuAccRange
+    	uint8_t gyroRange;			///< Rango vigente, uno de e_mpuGyroRange
+    	uint8_t dlpf;				///< Filtro vigente, uno de e_mpuDlpf
+    	uint8_t sampleDiv;			///< Divisor vigente del muestreo base
+    	uint8_t changes;			///< Avanza con cada configuración aplicada
+    	uint8_t isPending;			///< Hay una configuración esperando el bus
+    	uint8_t isWriting;			///< La escritura por DMA está en curso
+    	uint8_t isWritten;			///< Escrita en el sensor, falta aplicarla en MPU6050_MAF()
+    }Config;
     uint8_t bit_data[14]; ///< Buffer de datos crudos leídos por DMA
     uint8_t isInit;   ///< Flag de inicialización
 } s_MPU;
@@ -118,6 +330,25 @@ void MPU6050_Set_I2C_Communication(
     e_system (*Mem_Read_Blocking)(uint16_t Dev_Address, uint8_t Mem_Adress, uint8_t Mem_AddSize,
                                   uint8_t *p_Data, uint16_t _Size, uint32_t _Timeout));
 
+/**
+ * @brief Establece las funciones de lectura y escritura por DMA usadas en modo FIFO.
+ *
+ * Al terminar cada transferencia se debe llamar a MPU6050_I2C_DMA_Cplt().
+ *
+ * @param Mem_Write_DMA Función para escritura en memoria I2C por DMA.
+ * @param Mem_Read_DMA  Función para lectura desde memoria I2C por DMA.
+ */
+void MPU6050_Set_I2C_DMA(
+    e_system (*Mem_Write_DMA)(uint16_t Dev_Address, uint8_t reg, uint8_t *p_Data, uint16_t _Size),
+    e_system (*Mem_Read_DMA)(uint16_t Dev_Address, uint8_t reg, uint8_t *p_Data, uint16_t _Size));
+
+/**
+ * @brief Asigna la base de tiempo con la que se mide la demora del modo data-ready.
+ *
+ * @param getTime Función que devuelve un contador libre ascendente, por ejemplo en microsegundos.
+ */
+void MPU6050_Attach_TimeBase(uint32_t (*getTime)(void));
+
 /**
  * @brief Inicializa el sensor MPU6050.
  *
@@ -132,21 +363,202 @@ e_system MPU6050_Init(s_MPU *mpu);
  * @brief Calibra el sensor MPU6050.
  *
  * Promedia las lecturas cuando el sensor está estático para calcular los offsets.
+ * Es bloqueante: hace NUM_SAMPLES lecturas antes de volver.
  *
  * @param mpu Puntero a la estructura del sensor.
  */
 void MPU6050_Calibrate(s_MPU *mpu);
 
+/**
+ * @brief Arranca, o vuelve a arrancar, la calibración en segundo plano.
+ *
+ * No bloquea: MPU6050_MAF() va sumando las muestras mientras el robot está quieto y publica
+ * los offsets cuando juntó NUM_SAMPLES. Los offsets anteriores se usan hasta entonces.
+ *
+ * @param mpu Puntero a la estructura del sensor.
+ */
+void MPU6050_Calibrate_Start(s_MPU *mpu);
+
+/**
+ * @brief Indica si los offsets ya están publicados.
+ *
+ * @param mpu Puntero a la estructura del sensor.
+ * @return TRUE si hay una calibración terminada.
+ */
+uint8_t MPU6050_Is_Calibrated(s_MPU *mpu);
+
+/**
+ * @brief Carga offsets guardados y da la calibración por terminada.
+ *
+ * @param mpu Puntero a la estructura del sensor.
+ * @param offsets Offsets de Acc x, y, z y Gyro x, y, z, en el formato de MPU6050_Get_Offsets().
+ */
+void MPU6050_Set_Offsets(s_MPU *mpu, const int16_t offsets[NUM_AXIS]);
+
+/**
+ * @brief Copia los offsets actuales, por ejemplo para guardarlos.
+ *
+ * Se expresan en LSB de ±2g y ±250 grados/s sin importar el rango vigente, así los
+ * guardados siguen valiendo después de cambiar la configuración.
+ *
+ * @param mpu Puntero a la estructura del sensor.
+ * @param offsets Destino: Acc x, y, z y Gyro x, y, z.
+ */
+void MPU6050_Get_Offsets(s_MPU *mpu, int16_t offsets[NUM_AXIS]);
+
+/**
+ * @brief Descarta la recta de sesgo por temperatura y vuelve a aprenderla desde cero.
+ *
+ * Hasta tener puntos suficientes se usan los offsets fijos. Se llama sola al cambiar el
+ * rango del giróscopo.
+ *
+ * @param mpu Puntero a la estructura del sensor.
+ * @param isOn TRUE para habilitar la compensación, FALSE para usar sólo los offsets fijos.
+ */
+void MPU6050_Thermal_Reset(s_MPU *mpu, uint8_t isOn);
+
+/**
+ * @brief Cambia rango, filtro pasabajos y tasa de muestreo.
+ *
+ * Sin funciones DMA escribe enseguida con las bloqueantes, por ejemplo al arrancar. Con DMA
+ * la escritura queda pendiente y sale en la próxima lectura del sensor; se aplica en
+ * MPU6050_MAF(), que reescala los offsets, vacía la media móvil y avanza Config.changes.
+ * Al pasar a un rango más grueso los offsets pierden resolución; conviene recalibrar.
+ *
+ * @param mpu Puntero a la estructura del sensor.
+ * @param accRange Rango del acelerómetro, uno de e_mpuAccRange.
+ * @param gyroRange Rango del giróscopo, uno de e_mpuGyroRange.
+ * @param dlpf Filtro pasabajos, uno de e_mpuDlpf.
+ * @param sampleDiv Divisor del muestreo base: la tasa es base / (1 + sampleDiv).
+ * @return SYS_OK si quedó escrita o pendiente, SYS_BUSY si hay otra pendiente, SYS_ERROR si
+ * algún valor no es válido, el período queda por debajo de MPU_MIN_PERIOD_US o falló el bus.
+ */
+e_system MPU6050_Configure(s_MPU *mpu, uint8_t accRange, uint8_t gyroRange, uint8_t dlpf, uint8_t sampleDiv);
+
+/**
+ * @brief Arranca la escritura de la configuración pendiente, si la hay.
+ *
+ * Los modos FIFO y data-ready la llaman solos antes de cada lectura; en lectura directa
+ * hay que llamarla antes de pedir la muestra.
+ *
+ * @param mpu Puntero a la estructura del sensor.
+ * @return TRUE si se tomó el bus I2C, FALSE si no.
+ */
+uint8_t MPU6050_Config_Start(s_MPU *mpu);
+
+/**
+ * @brief Habilita el modo FIFO con acelerómetro, temperatura y giróscopo.
+ *
+ * Usa las funciones bloqueantes, por lo que debe llamarse antes de empezar las lecturas por DMA.
+ *
+ * @param mpu Puntero a la estructura del sensor.
+ * @return SYS_OK si se configuró, SYS_ERROR si falló la comunicación o no hay funciones DMA.
+ */
+e_system MPU6050_FIFO_Enable(s_MPU *mpu);
+
+/**
+ * @brief Habilita la interrupción de data-ready en el pin INT del sensor.
+ *
+ * Usa las funciones bloqueantes; llamar luego de la inicialización. El pin se configura como
+ * pulso activo en alto, por lo que no hace falta leer INT_STATUS para liberarlo.
+ *
+ * @param mpu Puntero a la estructura del sensor.
+ * @return SYS_OK si se configuró, SYS_ERROR si falló la comunicación o no hay funciones DMA.
+ */
+e_system MPU6050_DataReady_Enable(s_MPU *mpu);
+
+/**
+ * @brief Deja el modo data-ready; las lecturas vuelven a ser las periódicas del llamador.
+ *
+ * No toca los registros del sensor, así que se puede llamar desde una interrupción: el pin INT
+ * sigue pulsando y MPU6050_DataReady_IRQ() lo ignora. Una lectura en curso termina normalmente.
+ *
+ * @param mpu Puntero a la estructura del sensor.
+ */
+void MPU6050_DataReady_Disable(s_MPU *mpu);
+
+/**
+ * @brief Vigila que lleguen las interrupciones de data-ready.
+ *
+ * Llamar periódicamente con el tiempo pasado desde el llamado anterior. Si no llega ninguna
+ * interrupción en MPU_DRDY_TIMEOUT_PERIODS períodos de muestreo (pin mal conectado, sensor
+ * reiniciado) llama a MPU6050_DataReady_Disable().
+ *
+ * @param mpu Puntero a la estructura del sensor.
+ * @param elapsed Tiempo desde el llamado anterior, us.
+ * @return TRUE si dejó el modo data-ready en este llamado, FALSE si no.
+ */
+uint8_t MPU6050_DataReady_Watchdog(s_MPU *mpu, uint32_t elapsed);
+
+/**
+ * @brief Atiende el flanco del pin INT: anota el instante y arranca la lectura por DMA.
+ *
+ * Si el bus I2C está ocupado la lectura queda pendiente hasta MPU6050_DataReady_Retry().
+ * La interrupción del pin debe tener la misma prioridad que las del I2C y su DMA.
+ *
+ * @param mpu Puntero a la estructura del sensor.
+ * @return TRUE si se tomó el bus I2C, FALSE si no.
+ */
+uint8_t MPU6050_DataReady_IRQ(s_MPU *mpu);
+
+/**
+ * @brief Arranca la lectura pendiente, si la hay. Llamar cuando otro dispositivo libera el bus.
+ *
+ * @param mpu Puntero a la estructura del sensor.
+ * @return TRUE si se tomó el bus I2C, FALSE si no.
+ */
+uint8_t MPU6050_DataReady_Retry(s_MPU *mpu);
+
+/**
+ * @brief Arranca el vaciado de la FIFO: lectura de FIFO_COUNTH por DMA.
+ *
+ * Llamar periódicamente, con un período menor al que tarda en llenarse la FIFO
+ * (MPU_FIFO_SIZE / MPU_FIFO_FRAME muestras). Si una lectura anterior sigue en curso no hace nada.
+ *
+ * @param mpu Puntero a la estructura del sensor.
+ * @return TRUE si se tomó el bus I2C, FALSE si no.
+ */
+uint8_t MPU6050_FIFO_Start_Read(s_MPU *mpu);
+
 /**
  * @brief Procesa los datos luego de una transferencia por DMA.
  *
- * Interpreta los datos almacenados en el buffer y aplica la calibración.
+ * Sin modo FIFO interpreta la lectura desde ACCEL_XOUT; en modo data-ready además registra
+ * la demora y, si llegó otra muestra durante la lectura, la lee enseguida. En modo FIFO avanza la lectura:
+ * con la cantidad de bytes pide la ráfaga, con la ráfaga encola las muestras, y si la FIFO
+ * desbordó (las muestras quedan desalineadas) la vacía escribiendo USER_CTRL.
+ * Se debe llamar tanto al terminar una lectura como una escritura del MPU6050.
  *
  * @param mpu Puntero a la estructura del sensor.
+ * @return TRUE si el bus I2C quedó libre, FALSE si se encadenó otra transferencia.
  */
-void MPU6050_I2C_DMA_Cplt(s_MPU *mpu);
+uint8_t MPU6050_I2C_DMA_Cplt(s_MPU *mpu);
 
-void MPU6050_MAF(s_MPU *mpu);
+/**
+ * @brief Aplica el filtro de media móvil a la última lectura y actualiza Acc y Gyro.
+ *
+ * Si se terminó de escribir una configuración nueva la aplica antes de la muestra. Con la
+ * compensación por temperatura activa actualiza los offsets del giróscopo antes de restarlos.
+ * En modo FIFO procesa la muestra más vieja de la cola; hay que llamarla hasta que
+ * devuelva FALSE para no acumular atraso. Con la calibración en segundo plano en curso
+ * también le pasa la muestra cruda.
+ *
+ * @param mpu Puntero a la estructura del sensor.
+ * @return TRUE si había una lectura nueva para procesar, FALSE en caso contrario.
+ */
+uint8_t MPU6050_MAF(s_MPU *mpu);
+
+/**
+ * @brief Arma la trama cruda de la última muestra tal como la entrega el sensor.
+ *
+ * Son los 14 bytes desde ACCEL_XOUT: Acc x, y, z, temperatura y Gyro x, y, z, cada uno
+ * big-endian y sin offsets. Pasada por bit_data y MPU6050_I2C_DMA_Cplt() reproduce la misma
+ * muestra, así un registro de tramas se puede volver a procesar fuera del robot.
+ *
+ * @param mpu Puntero a la estructura del sensor.
+ * @param frame Destino de MPU_FIFO_FRAME bytes.
+ */
+void MPU6050_Get_Frame(s_MPU *mpu, uint8_t frame[MPU_FIFO_FRAME]);
 
 #ifdef __cplusplus
 }
@@ -100,6 +100,13 @@ void Display_I2C_DMA_Ready(uint8_t val);
  */
 void Display_I2C_Refresh_Ready(uint8_t val);
 
+/**
+ * @brief Devuelve el framebuffer del display, de OLED_DMA_BUFFER_SIZE bytes.
+ *
+ * Cada byte es una columna de 8 píxeles de una página, en el orden en que se envía al SSD1306.
+ */
+const uint8_t *Display_Get_Buffer(void);
+
 /**
  * @brief Escribe un solo byte en un registro del dispositivo I2C.
  *
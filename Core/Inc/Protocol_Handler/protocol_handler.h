@@ -3,8 +3,32 @@
  * @brief Módulo de manejo de protocolo de comunicación serial con buffer circular.
  *
  * Este archivo define las estructuras, enumeraciones y funciones necesarias para
- * implementar un protocolo de comunicación serie basado en una máquina de estados finitos (MEF),
- * incluyendo decodificación, transmisión y recepción de datos.
+ * implementar el protocolo de comunicación serie UNER, incluyendo decodificación,
+ * transmisión y recepción de datos.
+ *
+ * Formato de trama: 'U' 'N' 'E' 'R' | nBytes | ':' | cmd | payload... | checksum
+ * donde nBytes cuenta los bytes desde cmd hasta checksum inclusive. El checksum depende del
+ * modo negociado con CHECKMODE y se calcula sobre todos los bytes anteriores de la trama:
+ * - CHECK_XOR: un byte, XOR de los bytes (modo por defecto).
+ * - CHECK_CRC16: dos bytes little-endian, CRC-16/CCITT-FALSE.
+ * - CHECK_CRC32C: cuatro bytes little-endian, CRC-32C.
+ *
+ * Trama extendida, para payloads que no entran en nBytes:
+ * 'U' 'N' 'E' 'R' | 0 | ':' | nBytes (u16) | cmd | payload... | checksum
+ * con nBytes little-endian contando lo mismo que en la trama normal.
+ *
+ * Trama etiquetada: el token es ';' en lugar de ':' y entre el token (o el nBytes de 16 bits
+ * de la trama extendida) y cmd va un byte de etiqueta, contado en nBytes. Toda respuesta
+ * generada mientras se atiende una solicitud etiquetada lleva la misma etiqueta, así la PC
+ * puede tener varias solicitudes en curso y emparejar las respuestas.
+ *
+ * Las tramas a transmitir se encolan según la clase de su cmd (ver Comm_Set_TxClass()): la
+ * cola urgente, para respuestas y avisos, se envía antes que la normal, que lleva telemetría,
+ * fragmentos BULKDATA y texto. El orden se mantiene dentro de cada clase.
+ *
+ * Entre dos tramas puede aparecer una trama PADDING, sin etiqueta y con payload en cero, que
+ * cierra el espacio que una trama más corta que lo reservado no pudo devolver. La PC debe
+ * descartarla; el payload de las demás tramas nunca lleva relleno.
  *
  * @date 7 de mayo de 2025
  * @author Agustín Alejandro Mayer
@@ -14,9 +38,35 @@
 #define INC_PROTOCOL_HANDLER_PROTOCOL_HANDLER_H_
 
 #include <stdint.h>
+#include "RingBuffer/ring_buffer.h"
+#include "utilities.h"
+
+/** @brief Capacidad del buffer circular de recepción. Debe ser potencia de 2. */
+#ifndef COMM_RX_BUFFER_SIZE
+#define COMM_RX_BUFFER_SIZE			256
+#endif
+
+/** @brief Capacidad del buffer circular de transmisión. Debe ser potencia de 2. */
+#ifndef COMM_TX_BUFFER_SIZE
+#define COMM_TX_BUFFER_SIZE			1024
+#endif
+
+/** @brief Capacidad del buffer de transmisión urgente. Debe ser potencia de 2. */
+#ifndef COMM_TX_URGENT_SIZE
+#define COMM_TX_URGENT_SIZE			256
+#endif
+
+/**
+ * @brief Bytes de tramas completas que se entregan de una cola antes de volver a elegir.
+ *
+ * Acota la espera de una trama urgente detrás de la cola normal.
+ */
+#ifndef COMM_TX_BURST
+#define COMM_TX_BURST				256
+#endif
 
-/** @brief Longitud del buffer circular. No está preparado para modificarse. */
-#define RINGBUFFLENGTH      		256
+/** @brief Intervalos del histograma de ida y vuelta: el k cuenta de 2^k a 2^(k+1) - 1 us, el último también los mayores. */
+#define COMM_RTT_BINS				20
 
 /** @brief Tamaño máximo del buffer auxiliar para almacenamiento temporal de datos. */
 #define MAXAUXBUFFER				30
@@ -27,6 +77,54 @@
 /** @brief Posición en el paquete donde inician los datos del payload. */
 #define POSDATA             		5
 
+/** @brief Cantidad de entradas de la tabla de comandos, una por cada valor de cmd. */
+#define COMM_NUM_COMMANDS			256
+
+/** @brief Cabecera 'U','N','E','R' leída como palabra de 32 bits little-endian. */
+#define UNER_HEADER					0x52454E55UL
+
+/** @brief Bytes de la trama previos a cmd: cabecera, nBytes y token. */
+#define FRAME_PREFIX				6
+
+/** @brief Payload máximo que entra en una trama con cualquier checksum: nBytes es de un byte. */
+#define COMM_MAX_PAYLOAD			(255 - 1 - 4)
+
+/** @brief Token de una trama sin etiqueta. */
+#define FRAME_TOKEN					':'
+
+/** @brief Token de una trama con byte de etiqueta. */
+#define FRAME_TOKEN_TAGGED			';'
+
+/**
+ * @brief Solicitudes etiquetadas que la PC puede tener en curso a la vez.
+ *
+ * Se informa con PIPELINE junto con el tamaño de Rx, que limita los bytes de esas solicitudes:
+ * PIPELINE: [pedido] se responde PIPELINE: solicitudes | tamaño de Rx (u16), con solicitudes
+ * igual a pedido si es menor que este máximo.
+ */
+#ifndef COMM_MAX_INFLIGHT
+#define COMM_MAX_INFLIGHT			16
+#endif
+
+/** @brief Espacio libre en Tx necesario para atender una solicitud; si no hay, queda en Rx. */
+#ifndef COMM_REPLY_RESERVE
+#define COMM_REPLY_RESERVE			64
+#endif
+
+/** @brief Bytes de una trama extendida previos a cmd: prefijo normal más nBytes de 16 bits. */
+#define FRAME_EXT_PREFIX			(FRAME_PREFIX + 2)
+
+/** @brief Cantidad de regiones de memoria que se pueden leer con BULKREAD. */
+#ifndef COMM_NUM_REGIONS
+#define COMM_NUM_REGIONS			8
+#endif
+
+/** @brief Máximo de fragmentos sin confirmar de una transferencia BULKREAD. */
+#define BULK_MAX_WINDOW				32
+
+/** @brief Tamaño mínimo de una trama válida: prefijo, cmd y checksum de un byte. */
+#define FRAME_MIN_SIZE				(FRAME_PREFIX + 2)
+
 /**
  * @brief Enumeración de comandos soportados por el protocolo.
  *
@@ -42,8 +140,18 @@ typedef enum{
 
     GETALIVE=			0xF0,		/**< Solicitud de verificación de conexión (keep-alive) */
     FIRMWARE=			0xF1,		/**< Solicitud de versión de firmware */
+    CMDSTATS=			0xF2,		/**< Estadísticas de invocación y tiempo de un comando */
+    CHECKMODE=			0xF3,		/**< Selección del tipo de checksum de las tramas */
+    BULKREAD=			0xF4,		/**< Inicio de lectura por fragmentos de una región de memoria */
+    BULKDATA=			0xF5,		/**< Fragmento de una transferencia BULKREAD */
+    BULKACK=			0xF6,		/**< Confirmación de ventana de fragmentos recibidos */
+    PIPELINE=			0xF7,		/**< Consulta de solicitudes en curso admitidas y tamaño de Rx */
+    TXSTATS=			0xF8,		/**< Estadísticas de demora en cola de cada clase de transmisión */
+    TIMESYNC=			0xF9,		/**< Intercambio de marcas de tiempo para sincronizar relojes */
+    LATENCY=			0xFA,		/**< Histograma de ida y vuelta del enlace */
 
-	SETPID=				0xC0,		/**< Seteo de variables de PID */
+	SETPID=				0xC0,		/**< Ganancias de un lazo PID; se aplican enseguida y se guardan en flash al pasar a IDLE */
+	SAVEPID=			0xC1,		/**< Guarda ya las ganancias cambiadas; con el robot en marcha sin compactar la flash */
 
 	USERTEXT=			0xB1,		/**< Mensaje de texto definido por el usuario */
 	USERNUMBER= 		0xB2,		/**< Número definido por el usuario */
@@ -53,9 +161,34 @@ typedef enum{
 	SETMOTOR=			0xA2,		/**< Comando para control de motor */
 	GET_ENCODER=		0xA3,		/**< Solicitud de lectura de encoder */
 	MPUBLOCK=			0xA4,
-	MPUOFFSET=			0xA5
+	MPUOFFSET=			0xA5,		/**< Offsets del MPU6050; con 1 en el payload recalibra y los vuelve a guardar */
+	SUBSCRIBE=			0xA6,		/**< Suscripción a canales de telemetría: máscara y divisor de tasa */
+	TELEMETRY=			0xA7,		/**< Trama de telemetría con muestras agrupadas de un canal */
+	SETWIFI=			0xA8,		/**< Credenciales WiFi "ssid\0password", se guardan en flash y se usan al reiniciar */
+	MPUCONFIG=			0xA9,		/**< Rango, DLPF y divisor del MPU6050; responde la configuración vigente y sus escalas */
+	RECORDER=			0xAA,		/**< Estado, disparo y armado del registrador de vuelo; el contenido se lee con BULKREAD */
+
+	PADDING=			0xFF		/**< Relleno entre tramas, el receptor la descarta */
 }_eID;
 
+/**
+ * @brief Tipos de checksum de trama que se pueden negociar con CHECKMODE.
+ */
+typedef enum{
+	CHECK_XOR=			0,			/**< XOR de un byte */
+	CHECK_CRC16=		1,			/**< CRC-16/CCITT-FALSE de dos bytes */
+	CHECK_CRC32C=		2			/**< CRC-32C de cuatro bytes */
+}e_checkMode;
+
+/**
+ * @brief Clases de transmisión, de mayor a menor prioridad.
+ */
+typedef enum{
+	COMM_TX_URGENT=		0,			/**< Respuestas y avisos, salen en la próxima oportunidad */
+	COMM_TX_NORMAL=		1,			/**< Telemetría, fragmentos BULKDATA y texto */
+	COMM_TX_CLASSES					/**< Cantidad de clases */
+}e_txClass;
+
 /**
  * @brief Lista de PID configurables
  *
@@ -66,29 +199,54 @@ typedef enum PID_Index{
 	MOTORR= 			1,
 	BALANCE= 			2,
 	LINE_FOLLOWER= 		3,
+	SPEED= 				4,			/**< Velocidad de avance, lazo externo del equilibrio */
 }s_pid;
 
 /**
- * @brief Estados de la máquina de estados finitos (MEF) para decodificación de paquetes.
+ * @brief Estado de una transferencia BULKREAD en curso.
+ *
+ * Los fragmentos se numeran desde cero. Todo fragmento menor que base está confirmado;
+ * retransmit marca, relativo a base, los fragmentos ya enviados que hay que volver a enviar.
  */
-typedef enum{
-    START= 		0,		/**< Esperando el inicio de un paquete */
-    HEADER_1=	1,		/**< Lectura del primer byte de cabecera */
-    HEADER_2=	2,		/**< Lectura del segundo byte de cabecera */
-    HEADER_3=	3,		/**< Lectura del tercer byte de cabecera */
-    NBYTES=		4,		/**< Lectura del número de bytes del payload */
-    TOKEN=		5,		/**< Lectura del token separador */
-    PAYLOAD=	6		/**< Lectura de datos del payload */
-}e_protocolo;
+typedef struct{
+	const uint8_t *data;		/**< Primer byte a enviar */
+	uint32_t length;			/**< Bytes a enviar */
+	uint32_t retransmit;		/**< Bit k: reenviar el fragmento base + k */
+	uint16_t fragSize;			/**< Bytes de datos por fragmento */
+	uint16_t total;				/**< Cantidad de fragmentos */
+	uint16_t base;				/**< Primer fragmento sin confirmar */
+	uint16_t next;				/**< Próximo fragmento que todavía no se envió nunca */
+	uint8_t window;				/**< Fragmentos que se pueden enviar por delante de base */
+	uint8_t id;					/**< Región que se está enviando */
+	uint8_t isActive;			/**< Hay una transferencia en curso */
+}s_bulk;
 
 /**
- * @brief Estructura de buffer circular para transmisión o recepción.
+ * @brief Estadísticas de demora en cola de una clase de transmisión.
+ *
+ * La demora va desde el commit de la trama hasta que su primer byte se entrega al puerto,
+ * en unidades de la base de tiempo de Comm_Attach_TimeBase(). Sin base de tiempo sólo se
+ * cuentan las tramas.
  */
 typedef struct{
-	uint8_t read;						/**< Índice de lectura del buffer */
-	uint8_t write;						/**< Índice de escritura del buffer */
-	uint8_t buffer[RINGBUFFLENGTH];		/**< Arreglo de datos */
-}s_bus;
+	uint32_t frames;			/**< Tramas entregadas al puerto */
+	uint32_t maxDelay;			/**< Mayor demora medida */
+	uint32_t totalDelay;		/**< Suma de las demoras, para obtener el promedio */
+}s_txStats;
+
+/**
+ * @brief Cola de transmisión de una clase.
+ *
+ * Varios productores reservan tramas con una operación atómica sobre reserve; el último en
+ * terminar publica ring.write.
+ */
+typedef struct{
+	s_ring ring;				/**< Tramas publicadas pendientes de envío */
+	uint32_t reserve;			/**< Índice hasta donde hay espacio reservado */
+	uint8_t writers;			/**< Tramas reservadas que todavía no se publicaron */
+	uint32_t *stamp;			/**< Instante de commit de cada trama, indexado por su inicio / FRAME_MIN_SIZE */
+	s_txStats stats;			/**< Demora en cola de las tramas enviadas */
+}s_txQueue;
 
 /**
  * @brief Estructura principal de manejo de datos de comunicación serial.
@@ -98,17 +256,83 @@ typedef struct{
  */
 typedef struct Datos_UART{
     uint8_t timeOut;								/**< Temporizador de espera para reinicio del protocolo */
-    uint8_t indexStart;								/**< Índice donde se encontró el ID en el buffer circular */
-    s_bus Tx;										/**< Buffer de transmisión */
-    s_bus Rx;										/**< Buffer de recepción */
-    uint8_t checksumRx;								/**< Valor de checksum del paquete recibido */
+    uint32_t indexStart;							/**< Índice donde se encontró nBytes en el buffer circular */
+    uint32_t indexCmd;								/**< Índice de cmd de la trama que se está decodificando */
+    uint16_t rxLength;								/**< Bytes de payload de la trama que se está decodificando */
+    uint8_t rxTag;									/**< Etiqueta de la trama que se está decodificando */
+    uint8_t isTagged;								/**< La trama que se está decodificando trae etiqueta */
+    uint8_t isReplying;								/**< Se está ejecutando el decodificador de una trama recibida */
+    s_txQueue txQueue[COMM_TX_CLASSES];				/**< Colas de transmisión, una por clase */
+    uint8_t txActive;								/**< Cola de la que sale la ráfaga en curso */
+    uint32_t txEnd;									/**< Fin de la ráfaga en curso en esa cola */
+    uint32_t txFrame;								/**< Inicio de la próxima trama de la ráfaga sin medir */
+    s_ring Rx;										/**< Buffer de recepción */
     void (*dataDecoder)(struct Datos_UART *selfDD);	/**< Puntero a función encargada de decodificar el payload */
     void (*dataWriter)(struct Datos_UART *selfDW);	/**< Puntero a función encargada de enviar datos por el puerto */
+    uint8_t (*dataPending)(void);					/**< El puerto retiene datos ya sacados de Tx que no pudo enviar */
     uint8_t auxBuffer[MAXAUXBUFFER];				/**< Buffer auxiliar para almacenamiento temporal del payload */
-    e_protocolo protocolState;						/**< Estado actual del protocolo */
     uint8_t isESP01;								/**< Flag para indicar si se comunica a través de ESP-01 */
+    uint8_t checkMode;								/**< Checksum de las tramas, uno de e_checkMode */
+    uint16_t maxChunk;								/**< Mayor bloque que el puerto envía de una vez, 0 sin límite */
+    s_bulk bulk;									/**< Transferencia BULKREAD en curso */
+    uint32_t rttHist[COMM_RTT_BINS];				/**< Histograma de ida y vuelta informado por la PC en TIMESYNC */
+    uint8_t txBuffer[COMM_TX_BUFFER_SIZE];			/**< Memoria de la cola normal */
+    uint8_t txUrgentBuffer[COMM_TX_URGENT_SIZE];	/**< Memoria de la cola urgente */
+    uint32_t txStamp[COMM_TX_BUFFER_SIZE / FRAME_MIN_SIZE];		/**< Instantes de commit de la cola normal */
+    uint32_t txUrgentStamp[COMM_TX_URGENT_SIZE / FRAME_MIN_SIZE];	/**< Instantes de commit de la cola urgente */
+    uint8_t rxBuffer[COMM_RX_BUFFER_SIZE];			/**< Memoria del buffer de recepción */
+    uint8_t rxLinear[COMM_RX_BUFFER_SIZE];			/**< Copia lineal del payload cuando la trama da la vuelta a Rx */
 }s_commData;
 
+_Static_assert(RINGBUFFER_IS_POW2(COMM_TX_BUFFER_SIZE), "COMM_TX_BUFFER_SIZE debe ser potencia de 2");
+_Static_assert(RINGBUFFER_IS_POW2(COMM_TX_URGENT_SIZE), "COMM_TX_URGENT_SIZE debe ser potencia de 2");
+_Static_assert(RINGBUFFER_IS_POW2(COMM_RX_BUFFER_SIZE), "COMM_RX_BUFFER_SIZE debe ser potencia de 2");
+
+/**
+ * @brief Trama en construcción escrita directamente sobre el buffer circular de transmisión.
+ *
+ * Se obtiene con comm_reserveFrame(), se completa con las funciones comm_put_*() y se
+ * publica con comm_commitFrame(). Hasta el commit el lector del buffer no ve la trama.
+ */
+typedef struct{
+	s_ring *ring;			/**< Buffer circular donde se escribe la trama */
+	uint32_t start;			/**< Índice del primer byte de la trama ('U') */
+	uint32_t index;			/**< Índice donde se escribirá el próximo byte */
+	uint16_t remaining;		/**< Bytes de payload que todavía entran en la reserva */
+	uint8_t isExtended;		/**< La trama usa el formato extendido */
+	uint8_t txClass;		/**< Cola en la que se reservó la trama */
+	uint8_t checkMode;		/**< Checksum de la trama, tomado de la instancia al reservar */
+	uint8_t checksum;		/**< XOR acumulado de los bytes escritos */
+	uint8_t slack;			/**< Bytes reservados después de la trama para poder cerrar con PADDING */
+}s_frame;
+
+/**
+ * @brief Vista del payload de una trama recibida.
+ *
+ * Apunta directamente al buffer de recepción cuando el payload es contiguo, o a una copia
+ * lineal cuando da la vuelta al buffer. Sólo es válida durante la ejecución del handler.
+ */
+typedef struct{
+	const uint8_t *data;	/**< Primer byte del payload (el siguiente a cmd) */
+	uint16_t length;		/**< Cantidad de bytes del payload, sin cmd ni checksum */
+}s_payload;
+
+/**
+ * @brief Función que atiende un comando recibido.
+ *
+ * @param comm Instancia por la que llegó el comando, usada para responder.
+ * @param payload Payload de la trama recibida.
+ */
+typedef void (*comm_handler)(s_commData *comm, const s_payload *payload);
+
+/**
+ * @brief Estadísticas de ejecución de un comando registrado.
+ */
+typedef struct{
+	uint32_t calls;			/**< Cantidad de veces que se ejecutó el handler */
+	uint32_t maxTime;		/**< Mayor tiempo de ejecución medido, en unidades de la base de tiempo */
+}s_cmdStats;
+
 /**
  * @brief Inicializa la estructura de comunicación y asigna funciones de usuario.
  *
@@ -130,12 +354,192 @@ void Comm_Task(s_commData* comm);
 /**
  * @brief Función de decodificación del protocolo.
  *
- * Se encarga de analizar el buffer y extraer los datos útiles según el estado actual.
+ * Busca la cabecera 'UNER' de a una palabra por vez sobre los segmentos contiguos del
+ * buffer circular y valida la trama completa (longitud, token ':' y checksum según el modo
+ * negociado) en una sola pasada. Ante una trama inválida descarta únicamente el primer byte de la cabecera y
+ * vuelve a buscar desde la posición siguiente. Una trama incompleta queda en el buffer
+ * hasta el próximo llamado.
  *
  * @param datosCom Puntero a la estructura de comunicación.
  */
 void decodeProtocol(s_commData *datosCom);
 
+/**
+ * @brief Registra el handler de un comando en la tabla de despacho.
+ *
+ * La tabla es común a todas las instancias de comunicación, de modo que un comando
+ * registrado se atiende igual por USB y por ESP-01.
+ *
+ * @param cmd ID del comando.
+ * @param handler Función que atiende el comando, NULL para darlo de baja.
+ * @return SYS_OK si se registró, SYS_BUSY si el comando ya tenía otro handler.
+ */
+e_system Comm_Register_Command(uint8_t cmd, comm_handler handler);
+
+/**
+ * @brief Asigna la base de tiempo usada para medir la duración de los handlers.
+ *
+ * @param getTime Función que devuelve un contador libre ascendente (por ejemplo ciclos de CPU).
+ */
+void Comm_Attach_TimeBase(uint32_t (*getTime)(void));
+
+/**
+ * @brief Asigna el reloj en microsegundos con el que se sincroniza la PC.
+ *
+ * TIMESYNC: hostTime (8 bytes) | rtt (u32, opcional)
+ * Se responde TIMESYNC: hostTime | t2 (u32) | t3 (u32), con hostTime copiado tal cual, t2 el
+ * instante en que se atendió la solicitud y t3 el instante en que se armó la respuesta, en
+ * microsegundos del robot. Con t1 y t4, envío y recepción en la PC, al estilo NTP:
+ * offset = ((t2 - t1) + (t3 - t4)) / 2 y rtt = (t4 - t1) - (t3 - t2), con un error de offset
+ * acotado por rtt / 2. La PC puede enviar en cada TIMESYNC el rtt medido en el anterior para
+ * acumularlo en el histograma del enlace, que se lee con
+ * LATENCY: se responde COMM_RTT_BINS contadores u32; con un payload distinto de cero además
+ * se reinicia el histograma.
+ *
+ * @param getMicros Función que devuelve un contador libre en microsegundos.
+ */
+void Comm_Attach_Clock(uint32_t (*getMicros)(void));
+
+/**
+ * @brief Asigna una función que se llama cada vez que se envía un SYSERROR por cualquier instancia.
+ *
+ * Se llama desde el contexto del que envía, que puede ser una interrupción: tiene que ser breve.
+ *
+ * @param onError Función a llamar, NULL para no llamar a ninguna.
+ */
+void Comm_Attach_OnError(void (*onError)(void));
+
+/**
+ * @brief Tiempo en microsegundos del reloj asignado, cero si no hay reloj.
+ */
+uint32_t Comm_Micros(void);
+
+/**
+ * @brief Decodificador de datos que despacha la trama al handler registrado para su cmd.
+ *
+ * Se pasa como dataD en Comm_Init(). Un comando sin handler se responde con SYSWARNING.
+ *
+ * @param comm Instancia que recibió la trama.
+ */
+void Comm_Dispatch(s_commData *comm);
+
+/**
+ * @brief Cambia el checksum de las tramas que se envíen y reciban a partir de ahora.
+ *
+ * La respuesta a CHECKMODE ya sale con el checksum nuevo. Una trama CHECKMODE con checksum
+ * XOR se acepta en cualquier modo, para que la PC pueda recuperar el enlace sin conocer el
+ * modo vigente.
+ *
+ * @param comm Instancia de comunicación.
+ * @param mode Uno de e_checkMode.
+ * @return SYS_OK si se cambió, SYS_ERROR si el modo no existe.
+ */
+e_system Comm_Set_CheckMode(s_commData *comm, uint8_t mode);
+
+/**
+ * @brief Registra una región de memoria que la PC puede leer con BULKREAD.
+ *
+ * BULKREAD: region | offset (u32) | length (u32) | fragSize (u16) | window
+ * Se responde BULKREAD: region | fragmentos (u16) | fragSize (u16), con fragSize reducido
+ * si la trama de un fragmento no entra en la cola Tx o en el bloque máximo del puerto (ver
+ * Comm_Set_MaxChunk()), y luego se envían tramas BULKDATA: region | seq (u16) | datos,
+ * usando tramas extendidas si hace falta.
+ * Nunca hay más de window fragmentos sin confirmar. La PC confirma con
+ * BULKACK: region | base (u16) | bitmap (u32)
+ * donde base es el primer fragmento que todavía le falta y el bit k del bitmap indica que
+ * recibió el fragmento base + k. Los fragmentos ya enviados que no figuran en el bitmap se
+ * reenvían. La transferencia termina cuando base llega a la cantidad de fragmentos; un
+ * BULKREAD con length cero la cancela.
+ *
+ * @param id Número de región, menor que COMM_NUM_REGIONS.
+ * @param base Primer byte de la región.
+ * @param size Tamaño de la región en bytes.
+ * @return SYS_OK si se registró, SYS_ERROR si id no es válido.
+ */
+e_system Comm_Register_Region(uint8_t id, const void *base, uint32_t size);
+
+/**
+ * @brief Limita el tamaño de los bloques que el puerto puede enviar de una vez.
+ *
+ * Para puertos como el ESP-01, donde cada envío tiene que entrar entero en su buffer: los
+ * fragmentos BULKDATA se achican para que cada trama entre en un envío.
+ *
+ * @param comm Instancia de comunicación.
+ * @param size Bytes que el puerto acepta por envío, 0 sin límite.
+ */
+void Comm_Set_MaxChunk(s_commData *comm, uint16_t size);
+
+/**
+ * @brief Asigna la consulta de datos retenidos en el puerto.
+ *
+ * Un puerto que saca los bytes de Tx antes de saber si el envío se acepta (USB CDC) los
+ * guarda para reintentar. Mientras la consulta devuelva distinto de cero Comm_Task() sigue
+ * llamando a dataWriter aunque las colas estén vacías, así la última respuesta de una
+ * ráfaga no espera a que se encole otra trama.
+ *
+ * @param comm Instancia de comunicación.
+ * @param dataP Consulta del puerto, NULL si no retiene datos.
+ */
+void Comm_Set_Tx_Pending(s_commData *comm, uint8_t (*dataP)(void));
+
+/**
+ * @brief Asigna la clase de transmisión de las tramas con el cmd indicado.
+ *
+ * Por defecto TELEMETRY, BULKDATA, USERTEXT y DEBUGER son COMM_TX_NORMAL y el resto
+ * COMM_TX_URGENT. Una trama que no entra en la cola urgente se encola en la normal.
+ * TXSTATS responde una trama class | frames (u32) | maxDelay (u32) | totalDelay (u32) por
+ * cada clase; con un payload distinto de cero además reinicia las estadísticas.
+ *
+ * @param cmd ID del comando.
+ * @param txClass Uno de e_txClass.
+ * @return SYS_OK si se asignó, SYS_ERROR si la clase no existe.
+ */
+e_system Comm_Set_TxClass(uint8_t cmd, uint8_t txClass);
+
+/**
+ * @brief Elige la próxima ráfaga a transmitir y devuelve la cola de la que sale.
+ *
+ * Para usar desde dataWriter. Mientras la ráfaga en curso no se consuma por completo sigue
+ * saliendo de la misma cola, así nunca se intercalan tramas a medio enviar; al terminarla se
+ * toma la cola de mayor prioridad con datos.
+ *
+ * @param comm Instancia de comunicación.
+ * @param length Devuelve los bytes pendientes de la ráfaga a partir de ring->read; pueden dar
+ * la vuelta al buffer.
+ * @return Buffer circular de la cola elegida, NULL si no hay nada para enviar.
+ */
+s_ring *Comm_Tx_Next(s_commData *comm, uint32_t *length);
+
+/**
+ * @brief Libera len bytes de la ráfaga en curso ya entregados al puerto.
+ */
+void Comm_Tx_Consume(s_commData *comm, uint32_t len);
+
+/**
+ * @brief Copia a data hasta len bytes de las ráfagas pendientes y los libera.
+ *
+ * Une varias ráfagas, aunque den la vuelta al buffer, en un único bloque lineal; para
+ * puertos que transmiten desde su propio buffer. Mismas reglas que Comm_Tx_Next().
+ *
+ * @return Cantidad de bytes copiados.
+ */
+uint32_t Comm_Tx_Read(s_commData *comm, uint8_t *data, uint32_t len);
+
+/**
+ * @brief Bytes publicados en todas las colas de transmisión.
+ */
+uint32_t Comm_Tx_Count(s_commData *comm);
+
+/**
+ * @brief Devuelve las estadísticas acumuladas de un comando.
+ */
+const s_cmdStats *Comm_Get_Stats(uint8_t cmd);
+
+/**
+ * @brief Pone en cero las estadísticas de todos los comandos.
+ */
+void Comm_Reset_Stats(void);
+
 /**
  * @brief Envía un comando con datos mediante el protocolo implementado.
  *
@@ -146,4 +550,87 @@ void decodeProtocol(s_commData *datosCom);
  */
 void comm_sendCMD(s_commData *datosCom, _eID cmd, uint8_t *str, uint8_t len);
 
+/**
+ * @brief Reserva espacio en el buffer Tx y escribe la cabecera y el comando de una trama.
+ *
+ * Puede llamarse desde el lazo principal y desde interrupciones sobre la misma instancia:
+ * la reserva se toma con una operación atómica y la trama recién se hace visible al lector
+ * cuando terminó de escribirse la última trama reservada.
+ *
+ * Si se llama mientras se atiende una solicitud etiquetada la trama lleva su etiqueta. Las
+ * tramas que se arman desde interrupciones deben usar comm_reserveUntagged().
+ *
+ * @param datosCom Puntero a la estructura de comunicación.
+ * @param frame Trama a inicializar.
+ * @param cmd ID del comando a enviar.
+ * @param maxLen Cantidad máxima de bytes de payload que se van a escribir. Si no entra en
+ * nBytes la trama se arma en formato extendido.
+ * @return TRUE si hubo espacio, FALSE si la trama no entra en el buffer y debe descartarse.
+ */
+uint8_t comm_reserveFrame(s_commData *datosCom, s_frame *frame, _eID cmd, uint16_t maxLen);
+
+/**
+ * @brief Igual que comm_reserveFrame() pero la trama nunca lleva etiqueta.
+ *
+ * Para tramas que no responden a una solicitud, como la telemetría enviada desde interrupciones.
+ */
+uint8_t comm_reserveUntagged(s_commData *datosCom, s_frame *frame, _eID cmd, uint16_t maxLen);
+
+/**
+ * @brief Completa nBytes y checksum de la trama y la publica en el buffer Tx.
+ *
+ * Si la trama quedó más corta que lo reservado el sobrante se devuelve a la cola. Cuando otro
+ * productor ya reservó a continuación el sobrante no se puede devolver y se cierra con una
+ * trama PADDING: la trama enviada conserva el largo de lo que realmente se escribió.
+ *
+ * @param datosCom Puntero a la estructura de comunicación.
+ * @param frame Trama obtenida con comm_reserveFrame().
+ */
+void comm_commitFrame(s_commData *datosCom, s_frame *frame);
+
+/**
+ * @brief Lee un entero sin signo de 16 bits little-endian de un payload recibido.
+ */
+uint16_t comm_get_u16(const uint8_t *data);
+
+/**
+ * @brief Lee un entero sin signo de 32 bits little-endian de un payload recibido.
+ */
+uint32_t comm_get_u32(const uint8_t *data);
+
+/**
+ * @brief Lee un flotante de 32 bits little-endian de un payload recibido.
+ */
+float comm_get_f32(const uint8_t *data);
+
+/**
+ * @brief Escribe un byte en el payload de la trama.
+ */
+void comm_put_u8(s_frame *frame, uint8_t value);
+
+/**
+ * @brief Escribe un entero sin signo de 16 bits (little-endian) en el payload de la trama.
+ */
+void comm_put_u16(s_frame *frame, uint16_t value);
+
+/**
+ * @brief Escribe un entero con signo de 16 bits (little-endian) en el payload de la trama.
+ */
+void comm_put_i16(s_frame *frame, int16_t value);
+
+/**
+ * @brief Escribe un entero sin signo de 32 bits (little-endian) en el payload de la trama.
+ */
+void comm_put_u32(s_frame *frame, uint32_t value);
+
+/**
+ * @brief Escribe un flotante de 32 bits (little-endian) en el payload de la trama.
+ */
+void comm_put_f32(s_frame *frame, float value);
+
+/**
+ * @brief Copia un bloque de bytes en el payload de la trama.
+ */
+void comm_put_bytes(s_frame *frame, const uint8_t *data, uint16_t len);
+
 #endif /* INC_PROTOCOL_HANDLER_PROTOCOL_HANDLER_H_ */
@@ -0,0 +1,118 @@
+/**
+ * @file recorder.h
+ * @brief Registrador de vuelo: anillo de registros de tamaño fijo en RAM que se congela al dispararse.
+ *
+ * En cada paso de control se pide el lugar del próximo registro con Recorder_Begin(), se
+ * empaqueta ahí el estado de sensores y actuadores y se cierra con Recorder_End(). El anillo
+ * pisa siempre el registro más viejo, así que guarda los últimos capacity pasos.
+ *
+ * Recorder_Trigger() marca el evento (inclinación excesiva, error de sistema, comando de la PC)
+ * y el registrador sigue grabando postTrigger registros más para ver también lo que pasó
+ * después; entonces se congela y Recorder_Begin() devuelve NULL hasta que se vuelva a armar.
+ *
+ * El costo por registro es constante: un índice, una comparación y la copia que haga el
+ * usuario, sin divisiones ni búsquedas. Con una base de tiempo asignada se mide cada grabación,
+ * de Recorder_Begin() a Recorder_End(), y se guarda la última y la peor.
+ *
+ * La estructura y el buffer pueden ir en una sección de RAM que el arranque no inicializa
+ * (.noinit): si el registrador estaba congelado al reiniciarse el micro, Recorder_Init() lo
+ * conserva para poder leerlo después del reset.
+ *
+ * Para leerlo desde la PC basta una copia cruda de la estructura y el buffer: el registro más
+ * viejo es index si total >= capacity, o el 0 si todavía no se completó una vuelta, y el
+ * disparo fue en el registro triggerTotal desde que se armó.
+ *
+ * @date 17 de octubre de 2026
+ */
+
+#ifndef INC_RECORDER_RECORDER_H_
+#define INC_RECORDER_RECORDER_H_
+
+#include <stdint.h>
+#include "utilities.h"
+
+/** @brief Marca de contenido válido, "REC1". */
+#define RECORDER_MAGIC				0x31434552UL
+
+/** @brief Causa de disparo de un registrador que no se disparó. */
+#define RECORDER_CAUSE_NONE			0
+
+/**
+ * @brief Estado del registrador. El orden de los campos es parte del volcado que lee la PC.
+ */
+typedef struct{
+	uint32_t magic;			///< RECORDER_MAGIC si el contenido es válido
+	uint32_t total;			///< Registros grabados desde que se armó
+	uint32_t triggerTotal;	///< Valor de total al dispararse
+	uint32_t lastCost;		///< Costo de la última grabación, unidades de la base de tiempo
+	uint32_t maxCost;		///< Peor costo de grabación desde que se armó
+	uint32_t startTime;		///< Instante de Recorder_Begin() de la grabación en curso
+	uint16_t recordSize;	///< Bytes de cada registro
+	uint16_t capacity;		///< Registros que entran en el buffer
+	uint16_t index;			///< Registro que se graba a continuación
+	uint16_t postTrigger;	///< Registros que se graban después del disparo
+	uint16_t remaining;		///< Registros que faltan para congelarse
+	uint8_t cause;			///< Causa del disparo, RECORDER_CAUSE_NONE si no se disparó
+	uint8_t isTriggered;	///< Se disparó, está grabando los registros posteriores
+	uint8_t isFrozen;		///< Congelado, no graba más hasta Recorder_Arm()
+	uint8_t resets;			///< Reinicios del micro con el contenido congelado conservado
+	uint8_t *buffer;		///< capacity * recordSize bytes
+}s_recorder;
+
+/**
+ * @brief Inicializa el registrador y lo arma, salvo que conserve un contenido congelado.
+ *
+ * Si la estructura ya tenía un contenido congelado válido con el mismo formato, por ejemplo
+ * en RAM sin inicializar después de un reset, se conserva y se incrementa resets.
+ *
+ * @param rec Puntero al registrador.
+ * @param buffer Memoria de los registros.
+ * @param size Tamaño de buffer en bytes.
+ * @param recordSize Bytes de cada registro.
+ * @param postTrigger Registros que se graban después del disparo, menos que la capacidad.
+ * @return SYS_OK, o SYS_ERROR si los tamaños no son válidos.
+ */
+e_system Recorder_Init(s_recorder *rec, uint8_t *buffer, uint32_t size, uint16_t recordSize, uint16_t postTrigger);
+
+/**
+ * @brief Borra el contenido y vuelve a grabar, esperando un nuevo disparo.
+ *
+ * @param rec Puntero al registrador.
+ * @param postTrigger Registros que se graban después del disparo, menos que la capacidad.
+ * @return SYS_OK, o SYS_ERROR si postTrigger no es válido.
+ */
+e_system Recorder_Arm(s_recorder *rec, uint16_t postTrigger);
+
+/**
+ * @brief Devuelve el lugar del próximo registro; cerrar con Recorder_End() después de llenarlo.
+ *
+ * @param rec Puntero al registrador.
+ * @return recordSize bytes a completar, o NULL si está congelado.
+ */
+uint8_t *Recorder_Begin(s_recorder *rec);
+
+/**
+ * @brief Cierra el registro pedido con Recorder_Begin() y mide el costo de la grabación.
+ *
+ * @param rec Puntero al registrador.
+ */
+void Recorder_End(s_recorder *rec);
+
+/**
+ * @brief Marca el evento: se graban postTrigger registros más y se congela.
+ *
+ * Sólo cuenta el primer disparo; se puede llamar desde una interrupción.
+ *
+ * @param rec Puntero al registrador.
+ * @param cause Causa del disparo, distinta de RECORDER_CAUSE_NONE.
+ */
+void Recorder_Trigger(s_recorder *rec, uint8_t cause);
+
+/**
+ * @brief Asigna la base de tiempo usada para medir el costo de cada grabación.
+ *
+ * @param getTime Función que devuelve un contador libre ascendente (por ejemplo ciclos de CPU).
+ */
+void Recorder_Attach_TimeBase(uint32_t (*getTime)(void));
+
+#endif /* INC_RECORDER_RECORDER_H_ */
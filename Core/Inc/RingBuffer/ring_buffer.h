@@ -0,0 +1,163 @@
+/**
+ * @file ring_buffer.h
+ * @brief Buffer circular genérico de un productor y un consumidor (SPSC) sin bloqueos.
+ *
+ * El buffer admite cualquier capacidad potencia de 2. Los índices de lectura y escritura
+ * avanzan libremente y se enmascaran sólo al acceder al arreglo, por lo que el buffer puede
+ * llenarse por completo sin ambigüedad entre lleno y vacío.
+ *
+ * El productor (por ejemplo una ISR) sólo modifica `write` y el consumidor (por ejemplo el
+ * lazo principal) sólo modifica `read`. Los datos se publican con semántica release y se
+ * leen con semántica acquire, de modo que el consumidor nunca ve un índice antes que los
+ * datos que lo acompañan.
+ *
+ * Además de las operaciones de a bloques con copia, se exponen tramos contiguos del buffer
+ * para poder operar con memcpy o DMA directamente sobre la memoria del buffer.
+ *
+ * @date 17 de octubre de 2026
+ */
+
+#ifndef INC_RINGBUFFER_RING_BUFFER_H_
+#define INC_RINGBUFFER_RING_BUFFER_H_
+
+#include <stdint.h>
+
+/**
+ * @brief Verifica en tiempo de compilación que la capacidad sea potencia de 2.
+ */
+#define RINGBUFFER_IS_POW2(size)	((size) != 0 && (((size) & ((size) - 1)) == 0))
+
+/**
+ * @brief Declara un buffer circular con capacidad fija en tiempo de compilación.
+ *
+ * Crea el arreglo de almacenamiento `name##_storage` y la estructura `name` ya
+ * inicializada, sin necesidad de llamar a RingBuffer_Init().
+ *
+ * Ejemplo:
+ * @code
+ * RINGBUFFER_DEFINE(static, logRing, 1024);
+ * @endcode
+ *
+ * @param qualifier Calificador de almacenamiento (static o vacío).
+ * @param name Nombre de la estructura s_ring.
+ * @param size Capacidad en bytes, potencia de 2.
+ */
+#define RINGBUFFER_DEFINE(qualifier, name, size)										\
+	_Static_assert(RINGBUFFER_IS_POW2(size), #name ": la capacidad debe ser potencia de 2");	\
+	static uint8_t name##_storage[(size)];												\
+	qualifier s_ring name = { .write = 0, .read = 0, .mask = (size) - 1, .buffer = name##_storage }
+
+/**
+ * @brief Estructura de buffer circular.
+ */
+typedef struct{
+	uint32_t write;						/**< Índice de escritura, sólo lo modifica el productor */
+	uint32_t read;						/**< Índice de lectura, sólo lo modifica el consumidor */
+	uint32_t mask;						/**< Capacidad - 1 */
+	uint8_t *buffer;					/**< Memoria de almacenamiento */
+}s_ring;
+
+/**
+ * @brief Inicializa un buffer circular sobre la memoria indicada.
+ *
+ * @param ring Puntero al buffer circular.
+ * @param buffer Memoria de almacenamiento.
+ * @param size Capacidad en bytes. Debe ser potencia de 2.
+ */
+void RingBuffer_Init(s_ring *ring, uint8_t *buffer, uint32_t size);
+
+/**
+ * @brief Descarta todo el contenido. Sólo debe llamarse con productor y consumidor detenidos.
+ */
+void RingBuffer_Reset(s_ring *ring);
+
+/**
+ * @brief Copia hasta len bytes al buffer.
+ *
+ * @return Cantidad de bytes escritos. Es menor a len si el buffer se llenó.
+ */
+uint32_t RingBuffer_Push(s_ring *ring, const uint8_t *data, uint32_t len);
+
+/**
+ * @brief Copia y retira hasta len bytes del buffer.
+ *
+ * @return Cantidad de bytes leídos.
+ */
+uint32_t RingBuffer_Pop(s_ring *ring, uint8_t *data, uint32_t len);
+
+/**
+ * @brief Devuelve el tramo contiguo libre a partir del índice de escritura.
+ *
+ * Los datos escritos en el tramo se publican con RingBuffer_CommitWrite().
+ *
+ * @param ring Puntero al buffer circular.
+ * @param span Devuelve el puntero al inicio del tramo.
+ * @return Largo del tramo en bytes.
+ */
+uint32_t RingBuffer_WriteSpan(s_ring *ring, uint8_t **span);
+
+/**
+ * @brief Publica len bytes escritos por el productor.
+ */
+void RingBuffer_CommitWrite(s_ring *ring, uint32_t len);
+
+/**
+ * @brief Devuelve el tramo contiguo con datos a partir del índice de lectura.
+ *
+ * Los datos se liberan con RingBuffer_Consume() una vez utilizados.
+ *
+ * @param ring Puntero al buffer circular.
+ * @param span Devuelve el puntero al inicio del tramo.
+ * @return Largo del tramo en bytes.
+ */
+uint32_t RingBuffer_ReadSpan(s_ring *ring, uint8_t **span);
+
+/**
+ * @brief Libera len bytes ya leídos por el consumidor.
+ */
+void RingBuffer_Consume(s_ring *ring, uint32_t len);
+
+/**
+ * @brief Cantidad de bytes disponibles para leer.
+ */
+static inline uint32_t RingBuffer_Count(const s_ring *ring){
+	return __atomic_load_n(&ring->write, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->read, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Cantidad de bytes libres para escribir.
+ */
+static inline uint32_t RingBuffer_Free(const s_ring *ring){
+	return ring->mask + 1 - RingBuffer_Count(ring);
+}
+
+/**
+ * @brief Capacidad total del buffer.
+ */
+static inline uint32_t RingBuffer_Size(const s_ring *ring){
+	return ring->mask + 1;
+}
+
+/**
+ * @brief Acceso al byte de índice absoluto index (sin verificar que esté ocupado).
+ */
+static inline uint8_t RingBuffer_At(const s_ring *ring, uint32_t index){
+	return ring->buffer[index & ring->mask];
+}
+
+/**
+ * @brief Escribe un único byte.
+ *
+ * @return 1 si se escribió, 0 si el buffer estaba lleno.
+ */
+static inline uint8_t RingBuffer_PushByte(s_ring *ring, uint8_t value){
+	uint32_t write = ring->write;
+
+	if(write - __atomic_load_n(&ring->read, __ATOMIC_ACQUIRE) > ring->mask)
+		return 0;
+	ring->buffer[write & ring->mask] = value;
+	__atomic_store_n(&ring->write, write + 1, __ATOMIC_RELEASE);
+	return 1;
+}
+
+#endif /* INC_RINGBUFFER_RING_BUFFER_H_ */
@@ -0,0 +1,146 @@
+/**
+ * @file param_store.h
+ * @brief Almacén de parámetros clave/valor en flash, escrito como un registro de agregados.
+ *
+ * Usa dos sectores de flash que se alternan. Cada Param_Set() agrega un registro al final
+ * del sector activo, sin borrar nada; el valor vigente de una clave es su último registro.
+ * Cuando el sector se llena la compactación copia sólo los registros vigentes al otro sector
+ * y lo activa, así cada sector se borra una vez por vuelta y el desgaste se reparte.
+ *
+ * Formato del sector:
+ * - Cabecera de 8 bytes: secuencia y luego PARAM_MAGIC. La secuencia más alta es el sector
+ *   activo. La compactación graba la cabecera al final, así un corte de energía a mitad de
+ *   camino deja válido el sector anterior.
+ * - Registros alineados a 4 bytes: clave (16 bits) y largo (16 bits), valor rellenado con
+ *   0xFF y CRC-32C de clave, largo y valor. El CRC se graba último: un registro cortado por
+ *   falta de energía no pasa el CRC y se ignora. Un largo 0 borra la clave.
+ *
+ * Al iniciar se recorre el sector activo una vez y se arma un índice en RAM con la posición
+ * del último registro de cada clave; después cada Param_Get() es O(1).
+ *
+ * La flash se accede a través de s_paramFlash, que el usuario completa con las funciones de
+ * borrado y grabación de su hardware; en la PC puede ser una imagen en RAM.
+ *
+ * @warning Borrar un sector de 128K tarda del orden de un segundo y detiene la lectura de
+ * flash. Compactar sólo con el robot detenido, o llamar a Param_Compact() en un momento seguro;
+ * con el robot en marcha usar Param_Try_Set(), que nunca compacta.
+ *
+ * @date 17 de octubre de 2026
+ */
+
+#ifndef INC_STORAGE_PARAM_STORE_H_
+#define INC_STORAGE_PARAM_STORE_H_
+
+#include "utilities.h"
+
+/** @brief Sectores que se alternan. */
+#define PARAM_SECTORS				2
+/** @brief Marca de sector formateado, "PRM1". */
+#define PARAM_MAGIC					0x314D5250UL
+/** @brief Bytes de la cabecera del sector. */
+#define PARAM_HEADER_SIZE			8
+/** @brief Bytes de un registro sin el valor: clave, largo y CRC. */
+#define PARAM_RECORD_OVERHEAD		8
+
+/** @brief Claves distintas admitidas, de 0 a PARAM_MAX_KEYS - 1. */
+#ifndef PARAM_MAX_KEYS
+#define PARAM_MAX_KEYS				16
+#endif
+
+/** @brief Largo máximo de un valor. */
+#ifndef PARAM_MAX_SIZE
+#define PARAM_MAX_SIZE				256
+#endif
+
+/**
+ * @brief Acceso a la flash de los dos sectores.
+ */
+typedef struct{
+	const uint8_t *sector[PARAM_SECTORS];					///< Dirección de lectura de cada sector
+	uint32_t sectorSize;									///< Bytes de cada sector
+	e_system (*Erase)(uint8_t sector);						///< Borra un sector, todo a 0xFF
+	e_system (*Program)(const uint8_t *address, uint32_t word);	///< Graba una palabra alineada
+}s_paramFlash;
+
+/**
+ * @brief Estado del almacén.
+ */
+typedef struct{
+	const s_paramFlash *flash;			///< Flash en uso
+	uint32_t seq;						///< Secuencia del sector activo
+	uint32_t writeOffset;				///< Posición del próximo registro en el sector activo
+	uint32_t index[PARAM_MAX_KEYS];		///< Posición del último registro de cada clave, 0 si no existe
+	uint32_t compactions;				///< Compactaciones desde el arranque
+	uint32_t corrupted;					///< Registros descartados por CRC o largo inválido
+	uint8_t active;						///< Sector activo
+	uint8_t isInit;						///< El almacén está montado
+}s_paramStore;
+
+/**
+ * @brief Monta el almacén: elige el sector activo y arma el índice.
+ *
+ * Si ningún sector tiene cabecera válida formatea el primero.
+ *
+ * @param store Puntero al almacén.
+ * @param flash Acceso a la flash, debe seguir existiendo mientras se use el almacén.
+ * @return SYS_OK si quedó montado, SYS_ERROR si falló la flash.
+ */
+e_system Param_Init(s_paramStore *store, const s_paramFlash *flash);
+
+/**
+ * @brief Lee el valor vigente de una clave.
+ *
+ * @param store Puntero al almacén.
+ * @param key Clave.
+ * @param data Destino del valor.
+ * @param size Bytes disponibles en data; si el valor es más largo se copia sólo el principio.
+ * @return Largo del valor guardado, 0 si la clave no existe.
+ */
+uint16_t Param_Get(s_paramStore *store, uint8_t key, void *data, uint16_t size);
+
+/**
+ * @brief Guarda el valor de una clave agregando un registro.
+ *
+ * Si el valor no cambió no graba nada. Si el sector está lleno compacta primero.
+ *
+ * @param store Puntero al almacén.
+ * @param key Clave.
+ * @param data Valor.
+ * @param len Largo del valor, hasta PARAM_MAX_SIZE; 0 borra la clave.
+ * @return SYS_OK si quedó guardado, SYS_ERROR si la clave o el largo no son válidos o falló la flash.
+ */
+e_system Param_Set(s_paramStore *store, uint8_t key, const void *data, uint16_t len);
+
+/**
+ * @brief Como Param_Set() pero nunca compacta: no borra ningún sector ni detiene la flash.
+ *
+ * Para los llamados desde comandos o tareas periódicas con el robot en marcha. Si el valor
+ * no entra en el sector activo no graba nada; el llamador lo reintenta después de un
+ * Param_Compact() hecho en un momento seguro, o usa Param_Set() con el robot detenido.
+ *
+ * @param store Puntero al almacén.
+ * @param key Clave.
+ * @param data Valor.
+ * @param len Largo del valor, hasta PARAM_MAX_SIZE; 0 borra la clave.
+ * @return SYS_OK si quedó guardado, SYS_BUSY si hace falta compactar, SYS_ERROR si la clave o
+ * el largo no son válidos o falló la flash.
+ */
+e_system Param_Try_Set(s_paramStore *store, uint8_t key, const void *data, uint16_t len);
+
+/**
+ * @brief Copia los registros vigentes al otro sector y lo activa.
+ *
+ * @param store Puntero al almacén.
+ * @return SYS_OK si terminó, SYS_ERROR si falló la flash; en ese caso sigue el sector anterior.
+ */
+e_system Param_Compact(s_paramStore *store);
+
+/**
+ * @brief Bytes libres en el sector activo.
+ *
+ * @param store Puntero al almacén.
+ * @return Bytes que todavía se pueden agregar sin compactar.
+ */
+uint32_t Param_Free(s_paramStore *store);
+
+#endif /* INC_STORAGE_PARAM_STORE_H_ */
@@ -0,0 +1,131 @@
+/**
+ * @file telemetry.h
+ * @brief Módulo de envío periódico de telemetría por suscripción.
+ *
+ * La PC se suscribe a un conjunto de canales con un divisor de tasa y el firmware envía
+ * tramas TELEMETRY desde los puntos de muestreo, sin que haga falta pedir cada muestra.
+ * Las muestras de un canal se agrupan en una misma trama para reducir la sobrecarga.
+ *
+ * Payload de una trama TELEMETRY:
+ * channel | seq (u16) | count | count * muestra
+ * donde seq se incrementa en cada trama del canal, aunque la trama no haya entrado en el
+ * buffer de transmisión, de modo que la PC puede detectar tramas perdidas.
+ *
+ * Con la suscripción comprimida (TLM_FLAG_DELTA) cada muestra se toma como palabras int16
+ * little-endian y se envía la diferencia contra la misma palabra de la muestra anterior del
+ * canal, codificada zigzag ((d << 1) ^ (d >> 15)) y luego varint (7 bits por byte, bit 7 en
+ * uno si sigue otro byte, primero los bits bajos). En ese modo channel lleva además:
+ * - TLM_CHANNEL_DELTA: las muestras de la trama están comprimidas.
+ * - TLM_CHANNEL_KEY: trama clave, la primera muestra se codifica contra cero.
+ * Se envía una trama clave cada TLM_KEYFRAME_PERIOD tramas y también después de una trama
+ * que no entró en el buffer, así el decodificador se resincroniza luego de una pérdida.
+ *
+ * Con TLM_FLAG_TIME channel lleva TLM_CHANNEL_TIME y después de count van first (u32) y
+ * last (u32), los instantes de la primera y la última muestra de la trama en microsegundos
+ * del reloj de Comm_Attach_Clock(). Las muestras intermedias se interpolan entre ambos y se
+ * llevan al reloj de la PC con el offset obtenido con TIMESYNC.
+ *
+ * @date 17 de octubre de 2026
+ */
+
+#ifndef INC_TELEMETRY_TELEMETRY_H_
+#define INC_TELEMETRY_TELEMETRY_H_
+
+#include <stdint.h>
+#include "Protocol_Handler/protocol_handler.h"
+
+/** @brief Cantidad máxima de canales de telemetría. */
+#ifndef TLM_NUM_CHANNELS
+#define TLM_NUM_CHANNELS			8
+#endif
+
+/** @brief Tramas entre tramas clave en modo comprimido. */
+#ifndef TLM_KEYFRAME_PERIOD
+#define TLM_KEYFRAME_PERIOD			16
+#endif
+
+/** @brief Tamaño máximo de muestra que admite la compresión; las más grandes se envían sin comprimir. */
+#define TLM_MAX_DELTA_SAMPLE		24
+
+/** @brief Opción de suscripción: comprimir las muestras con delta zigzag + varint. */
+#define TLM_FLAG_DELTA				0x01
+
+/** @brief Opción de suscripción: agregar a cada trama los instantes de su primera y última muestra. */
+#define TLM_FLAG_TIME				0x02
+
+/** @brief Marca en el byte channel de una trama con muestras comprimidas. */
+#define TLM_CHANNEL_DELTA			0x80
+
+/** @brief Marca en el byte channel de una trama clave. */
+#define TLM_CHANNEL_KEY				0x40
+
+/** @brief Marca en el byte channel de una trama con marcas de tiempo. */
+#define TLM_CHANNEL_TIME			0x20
+
+/** @brief Bytes de cabecera del payload: channel, seq y count. */
+#define TLM_HEADER_SIZE				4
+
+/** @brief Bytes de las marcas de tiempo first y last. */
+#define TLM_TIME_SIZE				8
+
+/** @brief Bytes de muestras que entran en una trama TELEMETRY, con o sin marcas de tiempo. */
+#define TLM_MAX_SAMPLES_SIZE		(COMM_MAX_PAYLOAD - TLM_HEADER_SIZE - TLM_TIME_SIZE)
+
+/**
+ * @brief Estado de un canal de telemetría.
+ */
+typedef struct{
+	uint8_t sampleSize;							/**< Bytes de cada muestra */
+	uint8_t maxBatch;							/**< Muestras por trama */
+	uint8_t count;								/**< Muestras acumuladas en batch */
+	uint8_t length;								/**< Bytes ocupados en batch */
+	uint8_t isDelta;							/**< Las muestras del canal se envían comprimidas */
+	uint8_t isKey;								/**< La trama en curso es clave */
+	uint8_t forceKey;							/**< La próxima trama debe ser clave */
+	uint8_t divider;							/**< Muestras a descartar hasta la próxima que se envía */
+	uint16_t seq;								/**< Número de secuencia de la próxima trama */
+	uint32_t firstTime;							/**< Instante de la primera muestra del batch */
+	uint32_t lastTime;							/**< Instante de la última muestra del batch */
+	int16_t last[TLM_MAX_DELTA_SAMPLE / 2];		/**< Última muestra enviada, referencia de la compresión */
+	uint8_t batch[TLM_MAX_SAMPLES_SIZE];		/**< Muestras pendientes de envío */
+}s_tlmChannel;
+
+/**
+ * @brief Configura un canal de telemetría.
+ *
+ * @param channel Número de canal, menor que TLM_NUM_CHANNELS.
+ * @param sampleSize Bytes de cada muestra.
+ * @param maxBatch Cantidad de muestras a agrupar en cada trama; se limita a lo que entra en una trama.
+ * @return SYS_OK si se configuró, SYS_ERROR si los parámetros no son válidos.
+ */
+e_system Telemetry_Add_Channel(uint8_t channel, uint8_t sampleSize, uint8_t maxBatch);
+
+/**
+ * @brief Reemplaza la suscripción activa.
+ *
+ * Descarta las muestras pendientes y reinicia los números de secuencia.
+ *
+ * @param comm Instancia por la que se envían las tramas.
+ * @param mask Máscara de canales, bit n habilita el canal n. Cero da de baja la suscripción.
+ * @param divisor Se envía una de cada divisor muestras de cada canal; cero equivale a uno.
+ * @param flags Opciones, combinación de TLM_FLAG_DELTA y TLM_FLAG_TIME.
+ */
+void Telemetry_Subscribe(s_commData *comm, uint8_t mask, uint8_t divisor, uint8_t flags);
+
+/**
+ * @brief Indica si el canal está suscripto.
+ */
+uint8_t Telemetry_Is_Active(uint8_t channel);
+
+/**
+ * @brief Agrega una muestra al canal y envía la trama cuando se completa el grupo.
+ *
+ * Cada canal debe alimentarse siempre desde el mismo contexto (lazo principal o una única
+ * interrupción). No hace nada si el canal no está suscripto.
+ *
+ * @param channel Número de canal.
+ * @param sample Muestra de sampleSize bytes, en little-endian.
+ */
+void Telemetry_Push(uint8_t channel, const uint8_t *sample);
+
+#endif /* INC_TELEMETRY_TELEMETRY_H_ */
@@ -45,6 +45,9 @@ typedef enum{
 #define ESP01RXBUFAT		128
 #define ESP01TXBUFAT		512
 
+/** Bytes que ocupa en el buffer de transmisión el "AT+CIPSEND=nnnn\r>" de un envío */
+#define ESP01_SEND_PREFIX	17
+
 #define MAX_SSID_LEN		32
 #define MAX_PASS_LEN		63
 #define MAX_IP_LEN			16
@@ -152,10 +155,18 @@ _eESP01STATUS ESP01_StateUDPTCP();
  * @param [in] irRingBuf: indice de lectura del buffer circular.
  * @param [in] sizeRingBuf: tamaño en bytes del buffer circular.
  *
- * @retVal Si pudo transmitir devuelve ESP01_SEND_READY
+ * @retVal Si pudo transmitir devuelve ESP01_SEND_READY. Si el comando y los datos no entran
+ * en el buffer de transmisión devuelve ESP01_SEND_ERROR sin encolar nada.
  */
 _eESP01STATUS ESP01_Send(uint8_t *buf, uint16_t irRingBuf, uint16_t length, uint16_t sizeRingBuf);
 
+/**
+ * @brief ESP01_Send_Max
+ *
+ * Devuelve la mayor cantidad de datos que ESP01_Send() puede encolar en este momento.
+ */
+uint16_t ESP01_Send_Max();
+
 
 /**
  * @brief ESP01_Init Inicializa el driver ESP01
@@ -88,6 +88,9 @@ void Error_Handler(void);
 #define M1_ENC_A_Pin GPIO_PIN_12
 #define M1_ENC_A_GPIO_Port GPIOB
 #define M1_ENC_A_EXTI_IRQn EXTI15_10_IRQn
+#define MPU_INT_Pin GPIO_PIN_14
+#define MPU_INT_GPIO_Port GPIOB
+#define MPU_INT_EXTI_IRQn EXTI15_10_IRQn
 #define M2_ENC_A_Pin GPIO_PIN_8
 #define M2_ENC_A_GPIO_Port GPIOA
 #define M2_ENC_A_EXTI_IRQn EXTI9_5_IRQn
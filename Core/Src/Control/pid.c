@@ -0,0 +1,115 @@
+/*
+ * pid.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "Control/pid.h"
+#include <math.h>
+
+/**
+ * @brief Convierte un real a punto fijo con redondeo, saturando a int32_t.
+ */
+static int32_t PID_To_Fixed(float value, float one){
+	float scaled = value * one;
+
+	if(scaled >= 2147483647.0f)
+		return INT32_MAX;
+	if(scaled <= -2147483648.0f)
+		return INT32_MIN;
+	return (int32_t)(scaled >= 0 ? scaled + 0.5f : scaled - 0.5f);
+}
+
+/**
+ * @brief Pasa las ganancias en float a las ganancias por muestra en punto fijo.
+ */
+static void PID_Apply_Gains(s_pidLoop *pid){
+	float dt = pid->dt_us * 1e-6f;
+
+	pid->kp = PID_To_Fixed(pid->gains.kp, 65536.0f);
+	pid->kiDt = PID_To_Fixed(pid->gains.ki * dt, 1073741824.0f);
+	pid->kdFs = PID_To_Fixed(pid->gains.kd / dt, 65536.0f);
+	pid->kff = PID_To_Fixed(pid->gains.kff, 65536.0f);
+}
+
+void PID_Init(s_pidLoop *pid, uint32_t dt_us, int32_t outMin, int32_t outMax){
+	pid->gains = (s_pidGains){0};
+	pid->dt_us = dt_us;
+	pid->outMin = outMin;
+	pid->outMax = outMax;
+	pid->dCutoff = 0;
+	pid->dAlpha = INT16_MAX;
+	PID_Apply_Gains(pid);
+	PID_Reset(pid);
+}
+
+void PID_Set_Gains(s_pidLoop *pid, const s_pidGains *gains){
+	pid->gains = *gains;
+	PID_Apply_Gains(pid);
+}
+
+void PID_Set_Period(s_pidLoop *pid, uint32_t dt_us){
+	pid->dt_us = dt_us;
+	PID_Apply_Gains(pid);
+	PID_Set_Derivative_Filter(pid, pid->dCutoff);
+}
+
+void PID_Set_Limits(s_pidLoop *pid, int32_t outMin, int32_t outMax){
+	pid->outMin = outMin;
+	pid->outMax = outMax;
+}
+
+void PID_Set_Derivative_Filter(s_pidLoop *pid, float cutoff){
+	float alpha = 1.0f;
+
+	pid->dCutoff = cutoff;
+	if(cutoff > 0)
+		alpha = 1.0f - expf(-2.0f * 3.14159265f * cutoff * pid->dt_us * 1e-6f);
+	pid->dAlpha = alpha >= 1.0f ? INT16_MAX : (int16_t)(alpha * 32768.0f + 0.5f);
+}
+
+void PID_Reset(s_pidLoop *pid){
+	pid->integral = 0;
+	pid->dTerm = 0;
+	pid->output = 0;
+	pid->isInit = FALSE;
+}
+
+int32_t PID_Update(s_pidLoop *pid, int32_t setpoint, int32_t measure, int32_t feedforward){
+	int32_t error = setpoint - measure;
+	int64_t limit, out;
+	int32_t dRaw;
+
+	if(!pid->isInit){
+		pid->prevMeasure = measure;								// Sin historia la primera derivada es cero
+		pid->isInit = TRUE;
+	}
+
+	// Anti-windup: no integra hacia el lado en que la salida anterior ya saturó
+	if(!(pid->output >= pid->outMax && error > 0) && !(pid->output <= pid->outMin && error < 0)){
+		pid->integral += ((int64_t)error * pid->kiDt) >> 14;
+		limit = (int64_t)pid->outMax << 16;
+		if(pid->integral > limit)
+			pid->integral = limit;
+		limit = (int64_t)pid->outMin << 16;
+		if(pid->integral < limit)
+			pid->integral = limit;
+	}
+
+	// Derivada de la medición, con el signo del error
+	dRaw = (int32_t)(((int64_t)(pid->prevMeasure - measure) * pid->kdFs) >> 16);
+	pid->prevMeasure = measure;
+	if(pid->dAlpha == INT16_MAX)
+		pid->dTerm = dRaw;
+	else
+		pid->dTerm += (int32_t)(((int64_t)(dRaw - pid->dTerm) * pid->dAlpha) >> 15);
+
+	out = (((int64_t)error * pid->kp) >> 16) + (pid->integral >> 16) + pid->dTerm +
+		  (((int64_t)setpoint * pid->kff) >> 16) + feedforward;
+	if(out > pid->outMax)
+		out = pid->outMax;
+	if(out < pid->outMin)
+		out = pid->outMin;
+	pid->output = (int32_t)out;
+	return pid->output;
+}
@@ -0,0 +1,156 @@
+/*
+ * ahrs.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "Estimators/ahrs.h"
+#include <math.h>
+
+#define RAD_TO_DEG	57.2957795f
+
+/**
+ * @brief Raíz cuadrada inversa rápida: estimación por bits y dos iteraciones de Newton.
+ *
+ * Con la constante 0x5F375A86 el error relativo queda cerca de 5e-6 (4.7e-6 en el peor
+ * caso), sin la división ni la raíz de la FPU.
+ */
+static float AHRS_InvSqrt(float x){
+	union{
+		float f;
+		uint32_t i;
+	}conv = { .f = x };
+	float half = 0.5f * x;
+
+	conv.i = 0x5F375A86 - (conv.i >> 1);
+	conv.f *= 1.5f - half * conv.f * conv.f;
+	conv.f *= 1.5f - half * conv.f * conv.f;
+	return conv.f;
+}
+
+void AHRS_Init(s_ahrs *ahrs, uint32_t dt_us){
+	ahrs->q[0] = 1.0f;
+	ahrs->q[1] = 0.0f;
+	ahrs->q[2] = 0.0f;
+	ahrs->q[3] = 0.0f;
+	ahrs->bias[0] = 0.0f;
+	ahrs->bias[1] = 0.0f;
+	ahrs->bias[2] = 0.0f;
+	ahrs->twoKp = AHRS_TWO_KP;
+	ahrs->twoKi = AHRS_TWO_KI;
+	ahrs->pitch = 0.0f;
+	ahrs->roll = 0.0f;
+	ahrs->yaw = 0.0f;
+	ahrs->yawDrift = 0.0f;
+	ahrs->stillCount = 0;
+	ahrs->isStill = FALSE;
+	AHRS_Set_Period(ahrs, dt_us);
+	AHRS_Set_Scale(ahrs, AHRS_GYRO_250DPS, AHRS_ACC_2G);
+}
+
+void AHRS_Set_Scale(s_ahrs *ahrs, float gyroScale, float accOneG){
+	ahrs->gyroScale = gyroScale;
+	ahrs->accOneG = accOneG;
+}
+
+void AHRS_Set_Period(s_ahrs *ahrs, uint32_t dt_us){
+	ahrs->dt = dt_us * 1e-6f;
+}
+
+void AHRS_Update(s_ahrs *ahrs, const int16_t gyro[3], const int16_t acc[3]){
+	float gx = gyro[0] * ahrs->gyroScale - ahrs->bias[0];
+	float gy = gyro[1] * ahrs->gyroScale - ahrs->bias[1];
+	float gz = gyro[2] * ahrs->gyroScale - ahrs->bias[2];
+	float ax = acc[0], ay = acc[1], az = acc[2];
+	float q0 = ahrs->q[0], q1 = ahrs->q[1], q2 = ahrs->q[2], q3 = ahrs->q[3];
+	float accNorm2 = ax * ax + ay * ay + az * az;
+	float oneG2 = ahrs->accOneG * ahrs->accOneG;
+	float recipNorm, halfex, halfey, halfez, halfvx, halfvy, halfvz;
+
+	// Quieto: sin giro aparente y sólo la gravedad. Lo que mide el giróscopo es sesgo
+	if(gx * gx + gy * gy + gz * gz < AHRS_STILL_RATE * AHRS_STILL_RATE &&
+	   fabsf(accNorm2 - oneG2) < AHRS_ACC_TOLERANCE * oneG2){
+		if(ahrs->stillCount < AHRS_STILL_SAMPLES)
+			ahrs->stillCount++;
+	}else{
+		ahrs->stillCount = 0;
+	}
+	ahrs->isStill = ahrs->stillCount >= AHRS_STILL_SAMPLES;
+	if(ahrs->isStill){
+		ahrs->bias[0] += AHRS_STILL_GAIN * gx;
+		ahrs->bias[1] += AHRS_STILL_GAIN * gy;
+		ahrs->bias[2] += AHRS_STILL_GAIN * gz;
+	}
+
+	// Corrige sólo si la aceleración es la gravedad: lejos de 1g el robot está acelerando
+	if(accNorm2 > (1.0f - AHRS_ACC_TOLERANCE) * (1.0f - AHRS_ACC_TOLERANCE) * oneG2 &&
+	   accNorm2 < (1.0f + AHRS_ACC_TOLERANCE) * (1.0f + AHRS_ACC_TOLERANCE) * oneG2){
+		recipNorm = AHRS_InvSqrt(accNorm2);
+		ax *= recipNorm;
+		ay *= recipNorm;
+		az *= recipNorm;
+
+		// Gravedad estimada por el cuaternión, la mitad
+		halfvx = q1 * q3 - q0 * q2;
+		halfvy = q0 * q1 + q2 * q3;
+		halfvz = q0 * q0 - 0.5f + q3 * q3;
+
+		// Error: producto vectorial entre la gravedad medida y la estimada
+		halfex = ay * halfvz - az * halfvy;
+		halfey = az * halfvx - ax * halfvz;
+		halfez = ax * halfvy - ay * halfvx;
+
+		if(ahrs->twoKi > 0.0f){
+			ahrs->bias[0] -= ahrs->twoKi * halfex * ahrs->dt;
+			ahrs->bias[1] -= ahrs->twoKi * halfey * ahrs->dt;
+			ahrs->bias[2] -= ahrs->twoKi * halfez * ahrs->dt;
+		}
+		gx += ahrs->twoKp * halfex;
+		gy += ahrs->twoKp * halfey;
+		gz += ahrs->twoKp * halfez;
+	}
+
+	// Integra la derivada del cuaternión
+	gx *= 0.5f * ahrs->dt;
+	gy *= 0.5f * ahrs->dt;
+	gz *= 0.5f * ahrs->dt;
+	ahrs->q[0] = q0 - q1 * gx - q2 * gy - q3 * gz;
+	ahrs->q[1] = q1 + q0 * gx + q2 * gz - q3 * gy;
+	ahrs->q[2] = q2 + q0 * gy - q1 * gz + q3 * gx;
+	ahrs->q[3] = q3 + q0 * gz + q1 * gy - q2 * gx;
+
+	recipNorm = AHRS_InvSqrt(ahrs->q[0] * ahrs->q[0] + ahrs->q[1] * ahrs->q[1] +
+							 ahrs->q[2] * ahrs->q[2] + ahrs->q[3] * ahrs->q[3]);
+	ahrs->q[0] *= recipNorm;
+	ahrs->q[1] *= recipNorm;
+	ahrs->q[2] *= recipNorm;
+	ahrs->q[3] *= recipNorm;
+}
+
+void AHRS_Get_Euler(s_ahrs *ahrs){
+	float q0 = ahrs->q[0], q1 = ahrs->q[1], q2 = ahrs->q[2], q3 = ahrs->q[3];
+	float sinY = 2.0f * (q0 * q2 - q3 * q1);
+
+	if(sinY > 1.0f)
+		sinY = 1.0f;
+	if(sinY < -1.0f)
+		sinY = -1.0f;
+
+	ahrs->pitch = atan2f(2.0f * (q0 * q1 + q2 * q3), 1.0f - 2.0f * (q1 * q1 + q2 * q2)) * RAD_TO_DEG;
+	ahrs->roll = asinf(sinY) * RAD_TO_DEG;
+	ahrs->yaw = atan2f(2.0f * (q0 * q3 + q1 * q2), 1.0f - 2.0f * (q2 * q2 + q3 * q3)) * RAD_TO_DEG;
+	ahrs->yawDrift = ahrs->bias[2] * RAD_TO_DEG;
+}
+
+void AHRS_Reset_Yaw(s_ahrs *ahrs){
+	float q0 = ahrs->q[0], q1 = ahrs->q[1], q2 = ahrs->q[2], q3 = ahrs->q[3];
+	float halfYaw = 0.5f * atan2f(2.0f * (q0 * q3 + q1 * q2), 1.0f - 2.0f * (q2 * q2 + q3 * q3));
+	float c = cosf(halfYaw), s = sinf(halfYaw);
+
+	// Gira el cuaternión -yaw alrededor de Z del mundo
+	ahrs->q[0] = c * q0 + s * q3;
+	ahrs->q[1] = c * q1 + s * q2;
+	ahrs->q[2] = c * q2 - s * q1;
+	ahrs->q[3] = c * q3 - s * q0;
+	ahrs->yaw = 0.0f;
+}
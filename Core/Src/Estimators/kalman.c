@@ -0,0 +1,204 @@
+/*
+ * kalman.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "Estimators/kalman.h"
+
+// Coeficientes de atan(z) en Q16 grados, polinomio impar en z para |z| <= 1
+#define ATAN_C1		3754433
+#define ATAN_C3		-1240254
+#define ATAN_C5		676418
+#define ATAN_C7		-319669
+#define ATAN_C9		78234
+
+#define DEG_90_Q16	(90 << 16)
+#define DEG_180_Q16	(180 << 16)
+
+/**
+ * @brief Producto con redondeo de un valor por un factor en Q32 sin signo.
+ */
+static inline int32_t Kalman_Mul_Q32(int32_t a, uint32_t b){
+	return (int32_t)(((int64_t)a * b + (1LL << 31)) >> 32);
+}
+
+/**
+ * @brief Producto con redondeo de un valor por un factor en Q30.
+ */
+static inline int32_t Kalman_Mul_Q30(int32_t a, int32_t b){
+	return (int32_t)(((int64_t)a * b + (1LL << 29)) >> 30);
+}
+
+/**
+ * @brief Raíz cuadrada entera, por aproximaciones bit a bit.
+ */
+static uint32_t Kalman_Sqrt(uint32_t value){
+	uint32_t root = 0;
+	uint32_t bit = 1UL << 30;
+
+	while(bit > value)
+		bit >>= 2;
+	while(bit){
+		if(value >= root + bit){
+			value -= root + bit;
+			root = (root >> 1) + bit;
+		}else{
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return root;
+}
+
+void Kalman_Init(s_kalman *k, uint32_t dt_us){
+	k->angle = 0;
+	k->bias = 0;
+	k->rate = 0;
+	k->P[0][0] = 0;
+	k->P[0][1] = 0;
+	k->P[1][0] = 0;
+	k->P[1][1] = 0;
+	k->isInit = FALSE;
+	Kalman_Set_Period(k, dt_us);
+	Kalman_Set_Noise(k, KALMAN_Q30(KALMAN_Q_ANGLE), KALMAN_Q30(KALMAN_Q_BIAS), KALMAN_Q30(KALMAN_R_MEASURE));
+}
+
+void Kalman_Set_Noise(s_kalman *k, int32_t qAngle, int32_t qBias, int32_t rMeasure){
+	k->qAngle = qAngle;
+	k->qBias = qBias;
+	k->rMeasure = rMeasure;
+}
+
+void Kalman_Set_Period(s_kalman *k, uint32_t dt_us){
+	k->dt = (uint32_t)(((uint64_t)dt_us << 32) / 1000000);
+}
+
+int32_t Kalman_Update(s_kalman *k, int32_t newAngle, int32_t newRate){
+	int32_t dtP11, S, K0, K1, y, P00, P01;
+
+	if(!k->isInit){
+		k->angle = newAngle;										// Sin historia, arranca en la medición
+		k->isInit = TRUE;
+	}
+
+	// Predicción: integra el giróscopo sin sesgo
+	k->rate = newRate - k->bias;
+	k->angle += Kalman_Mul_Q32(k->rate, k->dt);
+
+	dtP11 = Kalman_Mul_Q32(k->P[1][1], k->dt);
+	k->P[0][0] += Kalman_Mul_Q32(dtP11 - k->P[0][1] - k->P[1][0] + k->qAngle, k->dt);
+	k->P[0][1] -= dtP11;
+	k->P[1][0] -= dtP11;
+	k->P[1][1] += Kalman_Mul_Q32(k->qBias, k->dt);
+
+	// Corrección con el ángulo del acelerómetro
+	S = k->P[0][0] + k->rMeasure;
+	K0 = (int32_t)(((int64_t)k->P[0][0] << 30) / S);
+	K1 = (int32_t)(((int64_t)k->P[1][0] << 30) / S);
+
+	y = newAngle - k->angle;
+	k->angle += Kalman_Mul_Q30(K0, y);
+	k->bias += Kalman_Mul_Q30(K1, y);
+
+	P00 = k->P[0][0];
+	P01 = k->P[0][1];
+	k->P[0][0] -= Kalman_Mul_Q30(K0, P00);
+	k->P[0][1] -= Kalman_Mul_Q30(K0, P01);
+	k->P[1][0] -= Kalman_Mul_Q30(K1, P00);
+	k->P[1][1] -= Kalman_Mul_Q30(K1, P01);
+
+	return k->angle;
+}
+
+int32_t Kalman_Atan2(int32_t y, int32_t x){
+	uint32_t ay = y < 0 ? -(uint32_t)y : (uint32_t)y;
+	uint32_t ax = x < 0 ? -(uint32_t)x : (uint32_t)x;
+	uint32_t num, den;
+	int32_t z, z2, angle;
+
+	if(!ax && !ay)
+		return 0;
+
+	num = ay < ax ? ay : ax;
+	den = ay < ax ? ax : ay;
+	if(den > 0xFFFF){												// Para que num << 15 entre en 32 bits
+		uint8_t shift = 16 - __builtin_clz(den);
+
+		num = (num >> shift) + ((num >> (shift - 1)) & 1);
+		den = (den >> shift) + ((den >> (shift - 1)) & 1);
+	}
+	z = (int32_t)(((num << 15) + (den >> 1)) / den);				// Q15 redondeado, entre 0 y 1
+	z2 = (z * z) >> 15;
+
+	angle = ATAN_C9;
+	angle = ATAN_C7 + (int32_t)(((int64_t)angle * z2) >> 15);
+	angle = ATAN_C5 + (int32_t)(((int64_t)angle * z2) >> 15);
+	angle = ATAN_C3 + (int32_t)(((int64_t)angle * z2) >> 15);
+	angle = ATAN_C1 + (int32_t)(((int64_t)angle * z2) >> 15);
+	angle = (int32_t)(((int64_t)angle * z) >> 15);
+
+	if(ay > ax)
+		angle = DEG_90_Q16 - angle;
+	if(x < 0)
+		angle = DEG_180_Q16 - angle;
+	return y < 0 ? -angle : angle;
+}
+
+int32_t Kalman_Acc_Pitch(int16_t ax, int16_t ay, int16_t az){
+	uint32_t xz = (uint32_t)((int32_t)ax * ax) + (uint32_t)((int32_t)az * az);
+	return Kalman_Atan2(ay, (int32_t)Kalman_Sqrt(xz));
+}
+
+int32_t Kalman_Gyro_Rate(int16_t raw, int32_t scale){
+	return (int32_t)(((int64_t)raw * scale) >> 8);
+}
+
+void Kalman_Float_Init(s_kalmanFloat *k, float dt){
+	k->angle = 0.0f;
+	k->bias = 0.0f;
+	k->rate = 0.0f;
+	k->P[0][0] = 0.0f;
+	k->P[0][1] = 0.0f;
+	k->P[1][0] = 0.0f;
+	k->P[1][1] = 0.0f;
+	k->dt = dt;
+	k->isInit = FALSE;
+	k->qAngle = KALMAN_Q_ANGLE;
+	k->qBias = KALMAN_Q_BIAS;
+	k->rMeasure = KALMAN_R_MEASURE;
+}
+
+float Kalman_Float_Update(s_kalmanFloat *k, float newAngle, float newRate){
+	float S, K0, K1, y, P00, P01;
+
+	if(!k->isInit){
+		k->angle = newAngle;
+		k->isInit = TRUE;
+	}
+
+	k->rate = newRate - k->bias;
+	k->angle += k->dt * k->rate;
+
+	k->P[0][0] += k->dt * (k->dt * k->P[1][1] - k->P[0][1] - k->P[1][0] + k->qAngle);
+	k->P[0][1] -= k->dt * k->P[1][1];
+	k->P[1][0] -= k->dt * k->P[1][1];
+	k->P[1][1] += k->qBias * k->dt;
+
+	S = k->P[0][0] + k->rMeasure;
+	K0 = k->P[0][0] / S;
+	K1 = k->P[1][0] / S;
+
+	y = newAngle - k->angle;
+	k->angle += K0 * y;
+	k->bias += K1 * y;
+
+	P00 = k->P[0][0];
+	P01 = k->P[0][1];
+	k->P[0][0] -= K0 * P00;
+	k->P[0][1] -= K0 * P01;
+	k->P[1][0] -= K1 * P00;
+	k->P[1][1] -= K1 * P01;
+
+	return k->angle;
+}
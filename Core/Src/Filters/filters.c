@@ -0,0 +1,256 @@
+/*
+ * filters.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "Filters/filters.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#include "cmsis_compiler.h"
+#define FILTER_USE_DSP		1
+#endif
+
+/**
+ * @brief Lee dos muestras seguidas como una palabra: la primera en la mitad baja.
+ */
+static inline uint32_t Filter_Load_Pair(const int16_t *p){
+	uint32_t word;
+	memcpy(&word, p, 4);
+	return word;
+}
+
+/**
+ * @brief Guarda una palabra como dos muestras seguidas.
+ */
+static inline void Filter_Store_Pair(int16_t *p, uint32_t word){
+	memcpy(p, &word, 4);
+}
+
+/**
+ * @brief Arma una palabra con lo en la mitad baja y hi en la alta.
+ */
+static inline uint32_t Filter_Pack(int16_t lo, int16_t hi){
+#ifdef FILTER_USE_DSP
+	return __PKHBT((uint32_t)lo, (uint32_t)hi, 16);
+#else
+	return (uint16_t)lo | ((uint32_t)(uint16_t)hi << 16);
+#endif
+}
+
+/**
+ * @brief Mínimo de cada mitad de dos palabras.
+ */
+static inline uint32_t Filter_Min_Pair(uint32_t a, uint32_t b){
+#ifdef FILTER_USE_DSP
+	__SSUB16(a, b);													// GE de cada mitad: a >= b
+	return __SEL(b, a);
+#else
+	int16_t lo = (int16_t)a < (int16_t)b ? (int16_t)a : (int16_t)b;
+	int16_t hi = (int16_t)(a >> 16) < (int16_t)(b >> 16) ? (int16_t)(a >> 16) : (int16_t)(b >> 16);
+	return Filter_Pack(lo, hi);
+#endif
+}
+
+/**
+ * @brief Máximo de cada mitad de dos palabras.
+ */
+static inline uint32_t Filter_Max_Pair(uint32_t a, uint32_t b){
+#ifdef FILTER_USE_DSP
+	__SSUB16(a, b);
+	return __SEL(a, b);
+#else
+	int16_t lo = (int16_t)a > (int16_t)b ? (int16_t)a : (int16_t)b;
+	int16_t hi = (int16_t)(a >> 16) > (int16_t)(b >> 16) ? (int16_t)(a >> 16) : (int16_t)(b >> 16);
+	return Filter_Pack(lo, hi);
+#endif
+}
+
+/**
+ * @brief Suma al acumulador los dos productos de las mitades: lo*lo + hi*hi.
+ */
+static inline int64_t Filter_Mac_Pair(uint32_t a, uint32_t b, int64_t acc){
+#ifdef FILTER_USE_DSP
+	return (int64_t)__SMLALD(a, b, (uint64_t)acc);
+#else
+	return acc + (int32_t)(int16_t)a * (int16_t)b + (int32_t)(int16_t)(a >> 16) * (int16_t)(b >> 16);
+#endif
+}
+
+/**
+ * @brief Satura a int16_t.
+ */
+static inline int16_t Filter_Sat16(int32_t value){
+#ifdef FILTER_USE_DSP
+	return (int16_t)__SSAT(value, 16);
+#else
+	return value > INT16_MAX ? INT16_MAX : value < INT16_MIN ? INT16_MIN : (int16_t)value;
+#endif
+}
+
+void Filter_Maf_Init(s_filterMaf *f, int16_t *history, int32_t *sum, uint16_t channels, uint8_t bits){
+	f->history = history;
+	f->sum = sum;
+	f->channels = channels;
+	f->bits = bits;
+	f->index = 0;
+	memset(history, 0, ((uint32_t)channels << bits) * sizeof(int16_t));
+	memset(sum, 0, channels * sizeof(int32_t));
+}
+
+void Filter_Maf_Process(s_filterMaf *f, const int16_t *in, int16_t *out, uint16_t frames){
+	uint32_t mask = (1UL << f->bits) - 1;
+	int16_t *row;
+	int16_t sample;
+
+	// La suma es de 32 bits: no entra de a dos por registro, va canal por canal
+	while(frames--){
+		row = &f->history[(uint32_t)f->index * f->channels];
+		for(uint16_t ch = 0; ch < f->channels; ch++){
+			sample = in[ch];
+			f->sum[ch] += sample - row[ch];
+			row[ch] = sample;
+			out[ch] = (int16_t)(f->sum[ch] >> f->bits);
+		}
+		f->index = (f->index + 1) & mask;
+		in += f->channels;
+		out += f->channels;
+	}
+}
+
+void Filter_Iir_Init(s_filterIir *f, int32_t *state, uint16_t channels, int16_t alpha){
+	f->state = state;
+	f->channels = channels;
+	f->alpha = alpha;
+	f->isInit = FALSE;
+}
+
+void Filter_Iir_Process(s_filterIir *f, const int16_t *in, int16_t *out, uint16_t frames){
+	int32_t diff;
+
+	if(!f->isInit && frames){
+		for(uint16_t ch = 0; ch < f->channels; ch++)
+			f->state[ch] = (int32_t)in[ch] << 15;					// Sin historia, arranca en la muestra
+		f->isInit = TRUE;
+	}
+
+	while(frames--){
+		for(uint16_t ch = 0; ch < f->channels; ch++){
+			// Entrada y estado entre -2^30 y 2^30: la diferencia entra en 32 bits
+			diff = ((int32_t)in[ch] << 15) - f->state[ch];
+			f->state[ch] += (int32_t)(((int64_t)diff * f->alpha) >> 15);
+			out[ch] = (int16_t)((f->state[ch] + (1L << 14)) >> 15);
+		}
+		in += f->channels;
+		out += f->channels;
+	}
+}
+
+void Filter_Biquad_Init(s_filterBiquad *f, int16_t *state, uint16_t channels, const int16_t coef[5]){
+	f->state = state;
+	f->channels = channels;
+	f->b0b1 = Filter_Pack(coef[0], coef[1]);
+	f->b2a1 = Filter_Pack(coef[2], (int16_t)-coef[3]);
+	f->a2 = (int16_t)-coef[4];
+	memset(state, 0, 4 * channels * sizeof(int16_t));
+}
+
+void Filter_Biquad_Lowpass(int16_t coef[5], float cutoff, float sampleRate, float q){
+	float w0 = 2.0f * 3.14159265f * cutoff / sampleRate;
+	float cosW0 = cosf(w0);
+	float alpha = sinf(w0) / (2.0f * q);
+	float a0 = 1.0f + alpha;
+
+	coef[0] = FILTER_Q14((1.0f - cosW0) * 0.5f / a0);
+	coef[1] = FILTER_Q14((1.0f - cosW0) / a0);
+	coef[2] = coef[0];
+	coef[3] = FILTER_Q14(-2.0f * cosW0 / a0);
+	coef[4] = FILTER_Q14((1.0f - alpha) / a0);
+}
+
+void Filter_Biquad_Process(s_filterBiquad *f, const int16_t *in, int16_t *out, uint16_t frames){
+	int16_t *s;
+	uint32_t x0x1;
+	int64_t acc;
+	int16_t y;
+
+	while(frames--){
+		s = f->state;
+		for(uint16_t ch = 0; ch < f->channels; ch++, s += 4){
+			// s = x1, x2, y1, y2: (x0, x1) y (x2, y1) entran de a dos en cada MAC
+			x0x1 = Filter_Pack(in[ch], s[0]);
+			acc = Filter_Mac_Pair(x0x1, f->b0b1, 0);
+			acc = Filter_Mac_Pair(Filter_Load_Pair(&s[1]), f->b2a1, acc);
+			acc += (int32_t)s[3] * f->a2;
+			y = Filter_Sat16((int32_t)((acc + (1 << 13)) >> 14));
+
+			Filter_Store_Pair(&s[2], Filter_Pack(y, s[2]));
+			Filter_Store_Pair(&s[0], x0x1);
+			out[ch] = y;
+		}
+		in += f->channels;
+		out += f->channels;
+	}
+}
+
+e_system Filter_Median_Init(s_filterMedian *f, int16_t *history, uint16_t channels, uint8_t size){
+	if(size != 3 && size != 5)
+		return SYS_ERROR;
+	f->history = history;
+	f->channels = channels;
+	f->size = size;
+	f->index = 0;
+	memset(history, 0, (uint32_t)size * channels * sizeof(int16_t));
+	return SYS_OK;
+}
+
+/**
+ * @brief Ordena una pareja de palabras mitad por mitad: a queda con el menor.
+ */
+#define FILTER_SORT(a, b)	do{ uint32_t t = Filter_Min_Pair(a, b); b = Filter_Max_Pair(a, b); a = t; }while(0)
+
+/**
+ * @brief Mediana de cada mitad de las palabras de la ventana.
+ */
+static inline uint32_t Filter_Median_Pair(uint32_t p[FILTER_MEDIAN_MAX], uint8_t size){
+	if(size == 3)
+		return Filter_Max_Pair(Filter_Min_Pair(p[0], p[1]), Filter_Min_Pair(Filter_Max_Pair(p[0], p[1]), p[2]));
+
+	// Red de 7 comparaciones para 5 elementos
+	FILTER_SORT(p[0], p[1]);
+	FILTER_SORT(p[3], p[4]);
+	FILTER_SORT(p[0], p[3]);
+	FILTER_SORT(p[1], p[4]);
+	FILTER_SORT(p[1], p[2]);
+	FILTER_SORT(p[2], p[3]);
+	FILTER_SORT(p[1], p[2]);
+	return p[2];
+}
+
+void Filter_Median_Process(s_filterMedian *f, const int16_t *in, int16_t *out, uint16_t frames){
+	uint32_t p[FILTER_MEDIAN_MAX];
+	uint16_t ch;
+	uint8_t k;
+
+	while(frames--){
+		memcpy(&f->history[(uint32_t)f->index * f->channels], in, f->channels * sizeof(int16_t));
+		if(++f->index >= f->size)
+			f->index = 0;
+
+		// Dos canales por palabra; si la cantidad es impar el último va solo en la mitad baja
+		for(ch = 0; ch + 1 < f->channels; ch += 2){
+			for(k = 0; k < f->size; k++)
+				p[k] = Filter_Load_Pair(&f->history[(uint32_t)k * f->channels + ch]);
+			Filter_Store_Pair(&out[ch], Filter_Median_Pair(p, f->size));
+		}
+		if(ch < f->channels){
+			for(k = 0; k < f->size; k++)
+				p[k] = Filter_Pack(f->history[(uint32_t)k * f->channels + ch], 0);
+			out[ch] = (int16_t)Filter_Median_Pair(p, f->size);
+		}
+		in += f->channels;
+		out += f->channels;
+	}
+}
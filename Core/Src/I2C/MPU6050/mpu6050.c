@@ -7,9 +7,66 @@
 
 #include "I2C/MPU6050/mpu6050.h"
 #include "math.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
 
 static e_system (*I2C_Master_Transmit_Blocking)(uint16_t Dev_Address, uint8_t Mem_Adress, uint8_t Mem_AddSize, uint8_t *p_Data, uint16_t _Size, uint32_t _Timeout);
 static e_system (*I2C_Mem_Read)(uint16_t Dev_Address, uint8_t Mem_Adress, uint8_t Mem_AddSize, uint8_t *p_Data, uint16_t _Size, uint32_t _Timeout);
+static e_system (*I2C_DMA_Mem_Write)(uint16_t Dev_Address, uint8_t reg, uint8_t *p_Data, uint16_t _Size) = NULL;
+static e_system (*I2C_DMA_Mem_Read)(uint16_t Dev_Address, uint8_t reg, uint8_t *p_Data, uint16_t _Size) = NULL;
+static uint32_t (*MPU6050_Get_Time)(void) = NULL;
+
+/**
+ * @brief Arranca la lectura por DMA de la muestra que marcó el pin INT.
+ *
+ * @return TRUE si se tomó el bus I2C.
+ */
+static uint8_t MPU6050_DataReady_Read(s_MPU *mpu);
+
+/**
+ * @brief Suma una muestra cruda a la ventana de quietud y la evalúa al completarla.
+ *
+ * Las ventanas quietas alimentan la calibración en segundo plano y la recta de temperatura.
+ */
+static void MPU6050_Window_Sample(s_MPU *mpu);
+
+/**
+ * @brief Agrega la ventana quieta recién completada a la regresión de sesgo contra temperatura.
+ */
+static void MPU6050_Thermal_Update(s_MPU *mpu);
+
+/**
+ * @brief Calcula los offsets del giróscopo para la temperatura de la muestra.
+ */
+static void MPU6050_Thermal_Apply(s_MPU *mpu);
+
+/**
+ * @brief Pasa las muestras de la ráfaga leída a la cola.
+ */
+static void MPU6050_FIFO_Parse(s_MPU *mpu);
+
+/**
+ * @brief Saca la muestra más vieja de la cola y deja sus ejes en MAF.rawData.
+ *
+ * @return TRUE si había una muestra.
+ */
+static uint8_t MPU6050_FIFO_Pop(s_MPU *mpu);
+
+/**
+ * @brief Toma la configuración escrita en Config.regs: escalas, período, offsets y media móvil.
+ */
+static void MPU6050_Config_Apply(s_MPU *mpu);
+
+/**
+ * @brief Período de muestreo en us para un filtro y un divisor.
+ */
+static uint32_t MPU6050_Period_Us(uint8_t dlpf, uint8_t sampleDiv);
+
+/**
+ * @brief Pasa una lectura del rango from al rango to, redondeando.
+ */
+static int16_t MPU6050_Rescale(int16_t value, uint8_t from, uint8_t to);
 
 
 void MPU6050_Set_I2C_Communication(
@@ -19,7 +76,19 @@ void MPU6050_Set_I2C_Communication(
 	I2C_Mem_Read = Mem_Read_Blocking;
 }
 
+void MPU6050_Set_I2C_DMA(
+		e_system (*Mem_Write_DMA)(uint16_t Dev_Address, uint8_t reg, uint8_t *p_Data, uint16_t _Size),
+		e_system (*Mem_Read_DMA)(uint16_t Dev_Address, uint8_t reg, uint8_t *p_Data, uint16_t _Size)){
+	I2C_DMA_Mem_Write = Mem_Write_DMA;
+	I2C_DMA_Mem_Read = Mem_Read_DMA;
+}
+
+void MPU6050_Attach_TimeBase(uint32_t (*getTime)(void)){
+	MPU6050_Get_Time = getTime;
+}
+
 e_system MPU6050_Init(s_MPU *mpu){
+	uint8_t config[4] = {MPU_DEFAULT_SAMPLE_DIV, MPU_DEFAULT_DLPF, MPU_GYRO_250DPS << 3, MPU_ACC_2G << 3};
 	uint8_t data = 0;
 	e_system status = SYS_OK;
 	status += I2C_Mem_Read(MPU6050_ADDR, WHO_AM_I_MPU6050, 1, &data, 1, MPU_TIMEOUT);
@@ -27,21 +96,8 @@ e_system MPU6050_Init(s_MPU *mpu){
 		data = 0x00;
 		status += I2C_Master_Transmit_Blocking(MPU6050_ADDR, POWER_MANAGEMENT_REG, 1, &data, 1, MPU_TIMEOUT);
 
-		// Set data rate of 1 KHz (default)
-		data = 0x07;
-		status +=I2C_Master_Transmit_Blocking(MPU6050_ADDR, SMPLRT_DIV_REG, 1, &data, 1, MPU_TIMEOUT);
-
-		// Set accelerometer range of +/- 2g (default)
-		data = 0x00;
-		status += I2C_Master_Transmit_Blocking(MPU6050_ADDR, ACCEL_CONFIG_REG, 1, &data, 1, MPU_TIMEOUT);
-
-		// Set gyroscope range of +/- 250 degree/s (default)
-		data = 0x00;
-		status += I2C_Master_Transmit_Blocking(MPU6050_ADDR, GYRO_CONFIG_REG, 1, &data, 1, MPU_TIMEOUT);
-
-		// Set Digital Low Pass Filter
-		data = 0x03;
-		status += I2C_Master_Transmit_Blocking(MPU6050_ADDR, CONFIG, 1, &data, 1, MPU_TIMEOUT);
+		// Set data rate of 1 KHz, DLPF de 44Hz, +/- 250 degree/s y +/- 2g: registros consecutivos desde SMPLRT_DIV
+		status += I2C_Master_Transmit_Blocking(MPU6050_ADDR, SMPLRT_DIV_REG, 1, config, sizeof(config), MPU_TIMEOUT);
 		/*
 		data = 0x20;
 		I2C_Master_Transmit_Blocking(MPU6050_ADDR, INT_PIN_CFG, 1, &data, 1, MPU_TIMEOUT);
@@ -66,12 +122,14 @@ e_system MPU6050_Init(s_MPU *mpu){
 		        .mediaBuffer = {{0}},
 		        .rawData = {0},
 		        .filtredData = {0},
-		        .index = 0,
 		        .isOn = 0
 		    },
 		    .bit_data = {0},
 		    .isInit = 1
 		};
+		memcpy(mpu->Config.regs, config, sizeof(config));
+		MPU6050_Config_Apply(mpu);
+		MPU6050_Thermal_Reset(mpu, MPU_THERMAL_COMP);
 
 		if(status != SYS_OK){
 			return SYS_ERROR;
@@ -97,17 +155,248 @@ void MPU6050_Calibrate(s_MPU *mpu){
 	}
     mpu->Acc.offset.x = (int16_t)(temp_raw[0] >> NUM_SAMPLES_BITS);
     mpu->Acc.offset.y = (int16_t)(temp_raw[1] >> NUM_SAMPLES_BITS);
-    mpu->Acc.offset.z = (int16_t)(temp_raw[2] >> NUM_SAMPLES_BITS) - SCALE_FACTOR;
+    mpu->Acc.offset.z = (int16_t)(temp_raw[2] >> NUM_SAMPLES_BITS) - mpu->Config.accOneG;
 
     mpu->Gyro.offset.x = (int16_t)(temp_raw[3] >> NUM_SAMPLES_BITS);
 	mpu->Gyro.offset.y = (int16_t)(temp_raw[4] >> NUM_SAMPLES_BITS);
 	mpu->Gyro.offset.z = (int16_t)(temp_raw[5] >> NUM_SAMPLES_BITS);
+	mpu->Calib.isDone = TRUE;
 
 	//mpu->Angle.pitch = atan2f(mpu->Acc.offset.y, sqrtf(mpu->Acc.offset.x * mpu->Acc.offset.x + mpu->Acc.offset.z * mpu->Acc.offset.z)) * 180.0f / M_PI;
 	//mpu->Angle.roll  = atan2f(-mpu->Acc.offset.x, mpu->Acc.offset.z) * 180.0f / M_PI;
 }
 
-void MPU6050_I2C_DMA_Cplt(s_MPU *mpu){
+void MPU6050_Calibrate_Start(s_MPU *mpu){
+	for(uint8_t axis = 0; axis < NUM_AXIS; axis++){
+		mpu->Calib.sum[axis] = 0;
+		mpu->Calib.windowSum[axis] = 0;
+		mpu->Calib.sumSq[axis] = 0;
+	}
+	mpu->Calib.count = 0;
+	mpu->Calib.windows = 0;
+	mpu->Calib.rejected = 0;
+	mpu->Calib.isRunning = TRUE;
+}
+
+uint8_t MPU6050_Is_Calibrated(s_MPU *mpu){
+	return mpu->Calib.isDone;
+}
+
+void MPU6050_Set_Offsets(s_MPU *mpu, const int16_t offsets[NUM_AXIS]){
+	mpu->Acc.offset.x = MPU6050_Rescale(offsets[0], MPU_ACC_2G, mpu->Config.accRange);
+	mpu->Acc.offset.y = MPU6050_Rescale(offsets[1], MPU_ACC_2G, mpu->Config.accRange);
+	mpu->Acc.offset.z = MPU6050_Rescale(offsets[2], MPU_ACC_2G, mpu->Config.accRange);
+	mpu->Gyro.offset.x = MPU6050_Rescale(offsets[3], MPU_GYRO_250DPS, mpu->Config.gyroRange);
+	mpu->Gyro.offset.y = MPU6050_Rescale(offsets[4], MPU_GYRO_250DPS, mpu->Config.gyroRange);
+	mpu->Gyro.offset.z = MPU6050_Rescale(offsets[5], MPU_GYRO_250DPS, mpu->Config.gyroRange);
+	mpu->Calib.isRunning = FALSE;
+	mpu->Calib.isDone = TRUE;
+}
+
+void MPU6050_Get_Offsets(s_MPU *mpu, int16_t offsets[NUM_AXIS]){
+	offsets[0] = MPU6050_Rescale(mpu->Acc.offset.x, mpu->Config.accRange, MPU_ACC_2G);
+	offsets[1] = MPU6050_Rescale(mpu->Acc.offset.y, mpu->Config.accRange, MPU_ACC_2G);
+	offsets[2] = MPU6050_Rescale(mpu->Acc.offset.z, mpu->Config.accRange, MPU_ACC_2G);
+	offsets[3] = MPU6050_Rescale(mpu->Gyro.offset.x, mpu->Config.gyroRange, MPU_GYRO_250DPS);
+	offsets[4] = MPU6050_Rescale(mpu->Gyro.offset.y, mpu->Config.gyroRange, MPU_GYRO_250DPS);
+	offsets[5] = MPU6050_Rescale(mpu->Gyro.offset.z, mpu->Config.gyroRange, MPU_GYRO_250DPS);
+}
+
+void MPU6050_Thermal_Reset(s_MPU *mpu, uint8_t isOn){
+	mpu->Thermal.n = 0.0f;
+	mpu->Thermal.sT = 0.0f;
+	mpu->Thermal.sTT = 0.0f;
+	for(uint8_t axis = 0; axis < 3; axis++){
+		mpu->Thermal.sG[axis] = 0.0f;
+		mpu->Thermal.sTG[axis] = 0.0f;
+		mpu->Thermal.slope[axis] = 0;
+		mpu->Thermal.intercept[axis] = 0;
+	}
+	mpu->Thermal.points = 0;
+	mpu->Thermal.hasSlope = FALSE;
+	mpu->Thermal.isValid = FALSE;
+	mpu->Thermal.isOn = isOn;
+}
+
+e_system MPU6050_Configure(s_MPU *mpu, uint8_t accRange, uint8_t gyroRange, uint8_t dlpf, uint8_t sampleDiv){
+	if(accRange > MPU_ACC_16G || gyroRange > MPU_GYRO_2000DPS || dlpf > MPU_DLPF_5HZ ||
+	   MPU6050_Period_Us(dlpf, sampleDiv) < MPU_MIN_PERIOD_US)
+		return SYS_ERROR;
+	if(mpu->Config.isPending || mpu->Config.isWriting || mpu->Config.isWritten)
+		return SYS_BUSY;
+
+	mpu->Config.regs[0] = sampleDiv;
+	mpu->Config.regs[1] = dlpf;
+	mpu->Config.regs[2] = gyroRange << 3;
+	mpu->Config.regs[3] = accRange << 3;
+
+	if(I2C_DMA_Mem_Write == NULL){
+		if(I2C_Master_Transmit_Blocking(MPU6050_ADDR, SMPLRT_DIV_REG, 1, mpu->Config.regs, 4, MPU_TIMEOUT) != SYS_OK)
+			return SYS_ERROR;
+		MPU6050_Config_Apply(mpu);
+		return SYS_OK;
+	}
+	// Las lecturas por DMA corren en interrupciones: la marca va después de los registros
+	__atomic_store_n(&mpu->Config.isPending, TRUE, __ATOMIC_RELEASE);
+	return SYS_OK;
+}
+
+uint8_t MPU6050_Config_Start(s_MPU *mpu){
+	if(!mpu->Config.isPending || mpu->Config.isWriting || I2C_DMA_Mem_Write == NULL)
+		return FALSE;
+	if(I2C_DMA_Mem_Write(MPU6050_ADDR, SMPLRT_DIV_REG, mpu->Config.regs, 4) != SYS_OK)
+		return FALSE;
+	mpu->Config.isPending = FALSE;
+	mpu->Config.isWriting = TRUE;
+	return TRUE;
+}
+
+e_system MPU6050_FIFO_Enable(s_MPU *mpu){
+	uint8_t data;
+	e_system status = SYS_OK;
+
+	if(I2C_DMA_Mem_Write == NULL || I2C_DMA_Mem_Read == NULL)
+		return SYS_ERROR;
+
+	data = 0x00;
+	status += I2C_Master_Transmit_Blocking(MPU6050_ADDR, USER_CTRL, 1, &data, 1, MPU_TIMEOUT);
+	data = FIFO_EN_ACCEL_TEMP_GYRO;
+	status += I2C_Master_Transmit_Blocking(MPU6050_ADDR, FIFO_EN, 1, &data, 1, MPU_TIMEOUT);
+	data = USER_CTRL_FIFO_EN | USER_CTRL_FIFO_RESET;
+	status += I2C_Master_Transmit_Blocking(MPU6050_ADDR, USER_CTRL, 1, &data, 1, MPU_TIMEOUT);
+	if(status != SYS_OK)
+		return SYS_ERROR;
+
+	mpu->FIFO.head = 0;
+	mpu->FIFO.tail = 0;
+	mpu->FIFO.state = MPU_FIFO_IDLE;
+	mpu->FIFO.isOn = TRUE;
+	return SYS_OK;
+}
+
+e_system MPU6050_DataReady_Enable(s_MPU *mpu){
+	uint8_t data;
+	e_system status = SYS_OK;
+
+	if(I2C_DMA_Mem_Read == NULL)
+		return SYS_ERROR;
+
+	data = INT_PIN_CFG_PULSE_HIGH;
+	status += I2C_Master_Transmit_Blocking(MPU6050_ADDR, INT_PIN_CFG, 1, &data, 1, MPU_TIMEOUT);
+	data = INT_ENABLE_DATA_RDY;
+	status += I2C_Master_Transmit_Blocking(MPU6050_ADDR, INT_ENABLE, 1, &data, 1, MPU_TIMEOUT);
+	if(status != SYS_OK)
+		return SYS_ERROR;
+
+	mpu->DRDY.isPending = FALSE;
+	mpu->DRDY.isReading = FALSE;
+	mpu->DRDY.silence = 0;
+	mpu->DRDY.isOn = TRUE;
+	return SYS_OK;
+}
+
+void MPU6050_DataReady_Disable(s_MPU *mpu){
+	mpu->DRDY.isOn = FALSE;
+	mpu->DRDY.isPending = FALSE;
+}
+
+uint8_t MPU6050_DataReady_Watchdog(s_MPU *mpu, uint32_t elapsed){
+	if(!mpu->DRDY.isOn)
+		return FALSE;
+	mpu->DRDY.silence += elapsed;
+	if(mpu->DRDY.silence <= MPU_DRDY_TIMEOUT_PERIODS * mpu->Config.samplePeriod)
+		return FALSE;
+	MPU6050_DataReady_Disable(mpu);
+	return TRUE;
+}
+
+uint8_t MPU6050_DataReady_IRQ(s_MPU *mpu){
+	if(!mpu->DRDY.isOn)
+		return FALSE;
+
+	// La muestra anterior todavía no se leyó: el sensor ya la reemplazó
+	if(mpu->DRDY.isPending || mpu->DRDY.isReading)
+		mpu->DRDY.missed++;
+	mpu->DRDY.irqTime = MPU6050_Get_Time != NULL ? MPU6050_Get_Time() : 0;
+	mpu->DRDY.silence = 0;
+	mpu->DRDY.isPending = TRUE;
+
+	if(mpu->DRDY.isReading)
+		return FALSE;											// Se relee al terminar la lectura en curso
+	return MPU6050_DataReady_Read(mpu);
+}
+
+uint8_t MPU6050_DataReady_Retry(s_MPU *mpu){
+	if(!mpu->DRDY.isOn || !mpu->DRDY.isPending || mpu->DRDY.isReading)
+		return FALSE;
+	return MPU6050_DataReady_Read(mpu);
+}
+
+uint8_t MPU6050_FIFO_Start_Read(s_MPU *mpu){
+	if(!mpu->FIFO.isOn || mpu->FIFO.state != MPU_FIFO_IDLE)
+		return FALSE;
+	if(MPU6050_Config_Start(mpu)){
+		mpu->FIFO.state = MPU_FIFO_RESET;						// Después de la configuración se vacía la FIFO
+		return TRUE;
+	}
+	if(I2C_DMA_Mem_Read(MPU6050_ADDR, FIFO_COUNTH, mpu->FIFO.countData, 2) != SYS_OK)
+		return FALSE;
+	mpu->FIFO.state = MPU_FIFO_COUNT;
+	return TRUE;
+}
+
+uint8_t MPU6050_I2C_DMA_Cplt(s_MPU *mpu){
+	uint16_t count;
+
+	if(mpu->Config.isWriting){
+		mpu->Config.isWriting = FALSE;
+		__atomic_store_n(&mpu->Config.isWritten, TRUE, __ATOMIC_RELEASE);
+		if(mpu->FIFO.isOn){
+			// Lo que quedó en la FIFO se midió con la configuración anterior
+			mpu->FIFO.control = USER_CTRL_FIFO_EN | USER_CTRL_FIFO_RESET;
+			if(I2C_DMA_Mem_Write(MPU6050_ADDR, USER_CTRL, &mpu->FIFO.control, 1) == SYS_OK)
+				return FALSE;
+			mpu->FIFO.state = MPU_FIFO_IDLE;
+			return TRUE;
+		}
+		if(mpu->DRDY.isOn && mpu->DRDY.isPending)
+			return !MPU6050_DataReady_Read(mpu);
+		return TRUE;
+	}
+
+	if(mpu->FIFO.isOn){
+		switch(mpu->FIFO.state){
+		case MPU_FIFO_COUNT:
+			count = (mpu->FIFO.countData[0] << 8) | mpu->FIFO.countData[1];
+			// Al desbordar el sensor pisa los bytes más viejos y la FIFO deja de estar alineada a muestras
+			if(count > MPU_FIFO_SIZE - MPU_FIFO_FRAME){
+				mpu->FIFO.overflows++;
+				mpu->FIFO.control = USER_CTRL_FIFO_EN | USER_CTRL_FIFO_RESET;
+				if(I2C_DMA_Mem_Write(MPU6050_ADDR, USER_CTRL, &mpu->FIFO.control, 1) == SYS_OK){
+					mpu->FIFO.state = MPU_FIFO_RESET;
+					return FALSE;
+				}
+				break;
+			}
+			mpu->FIFO.frames = count / MPU_FIFO_FRAME;
+			if(mpu->FIFO.frames > MPU_FIFO_BURST)
+				mpu->FIFO.frames = MPU_FIFO_BURST;			// El resto se lee en la próxima ráfaga
+			if(mpu->FIFO.frames &&
+			   I2C_DMA_Mem_Read(MPU6050_ADDR, FIFO_R_W, mpu->FIFO.buffer, mpu->FIFO.frames * MPU_FIFO_FRAME) == SYS_OK){
+				mpu->FIFO.state = MPU_FIFO_DATA;
+				return FALSE;
+			}
+			break;
+		case MPU_FIFO_DATA:
+			MPU6050_FIFO_Parse(mpu);
+			break;
+		default:
+			break;
+		}
+		mpu->FIFO.state = MPU_FIFO_IDLE;
+		return TRUE;
+	}
+
 	// ACC: GET RAW INFORMATION
 	mpu->MAF.rawData[0] = (((mpu->bit_data[0] << 8) | mpu->bit_data[1]));
 	mpu->MAF.rawData[1] = (((mpu->bit_data[2] << 8) | mpu->bit_data[3]));
@@ -116,20 +405,38 @@ void MPU6050_I2C_DMA_Cplt(s_MPU *mpu){
 	mpu->MAF.rawData[3] = (((mpu->bit_data[8 ] << 8) | mpu->bit_data[9 ]));
 	mpu->MAF.rawData[4] = (((mpu->bit_data[10] << 8) | mpu->bit_data[11]));
 	mpu->MAF.rawData[5] = (((mpu->bit_data[12] << 8) | mpu->bit_data[13]));
+	// TEMP: entre el acelerómetro y el giróscopo
+	mpu->Thermal.raw = (int16_t)((mpu->bit_data[6] << 8) | mpu->bit_data[7]);
 	mpu->MAF.isOn = TRUE;
+
+	if(mpu->DRDY.isOn && mpu->DRDY.isReading){
+		mpu->DRDY.isReading = FALSE;
+		if(MPU6050_Get_Time != NULL){
+			mpu->DRDY.latency = MPU6050_Get_Time() - mpu->DRDY.readTime;
+			mpu->DRDY.totalLatency += mpu->DRDY.latency;
+			if(mpu->DRDY.latency > mpu->DRDY.maxLatency)
+				mpu->DRDY.maxLatency = mpu->DRDY.latency;
+		}
+		mpu->DRDY.samples++;
+		if(mpu->DRDY.isPending)
+			return !MPU6050_DataReady_Read(mpu);
+	}
+	return TRUE;
 }
 
-void MPU6050_MAF(s_MPU *mpu){ //Moving Average Filter
+uint8_t MPU6050_MAF(s_MPU *mpu){ //Moving Average Filter
+	if(__atomic_load_n(&mpu->Config.isWritten, __ATOMIC_ACQUIRE))
+		MPU6050_Config_Apply(mpu);
+	if(mpu->FIFO.isOn)
+		mpu->MAF.isOn = MPU6050_FIFO_Pop(mpu);
 	if(mpu->MAF.isOn){
 		mpu->MAF.isOn = FALSE;
-		for(uint8_t axis = 0; axis < NUM_AXIS; axis++){
-			mpu->MAF.sumData[axis] -= mpu->MAF.mediaBuffer[mpu->MAF.index][axis];
-			mpu->MAF.sumData[axis] += mpu->MAF.rawData[axis];
-			mpu->MAF.mediaBuffer[mpu->MAF.index][axis] = mpu->MAF.rawData[axis];
-			mpu->MAF.filtredData[axis] = (mpu->MAF.sumData[axis] >> NUM_MAF_BITS);
-		}
-		mpu->MAF.index++;
-		mpu->MAF.index &= (NUM_MAF - 1);
+		mpu->Thermal.celsius = (int16_t)((((int32_t)mpu->Thermal.raw * MPU_TEMP_CENTI_Q16) >> 16) + MPU_TEMP_OFFSET_CENTI);
+		if(mpu->Calib.isRunning || mpu->Thermal.isOn)
+			MPU6050_Window_Sample(mpu);
+		if(mpu->Thermal.isValid)
+			MPU6050_Thermal_Apply(mpu);
+		Filter_Maf_Process(&mpu->MAF.filter, mpu->MAF.rawData, mpu->MAF.filtredData, 1);
 
 		// ACC: CALCULATE TRUE ACCELERATION
 		mpu->Acc.x = mpu->MAF.filtredData[0] - mpu->Acc.offset.x;
@@ -139,5 +446,216 @@ void MPU6050_MAF(s_MPU *mpu){ //Moving Average Filter
 		mpu->Gyro.x = mpu->MAF.filtredData[3] - mpu->Gyro.offset.x;
 		mpu->Gyro.y = mpu->MAF.filtredData[4] - mpu->Gyro.offset.y;
 		mpu->Gyro.z = mpu->MAF.filtredData[5] - mpu->Gyro.offset.z;
+		return TRUE;
+	}
+	return FALSE;
+}
+
+void MPU6050_Get_Frame(s_MPU *mpu, uint8_t frame[MPU_FIFO_FRAME]){
+	int16_t word;
+
+	for(uint8_t i = 0; i < MPU_FRAME_WORDS; i++, frame += 2){
+		// La temperatura va entre el acelerómetro y el giróscopo, como en los registros
+		word = i < 3 ? mpu->MAF.rawData[i] : i == 3 ? mpu->Thermal.raw : mpu->MAF.rawData[i - 1];
+		frame[0] = (uint8_t)((uint16_t)word >> 8);
+		frame[1] = (uint8_t)word;
+	}
+}
+
+static void MPU6050_Window_Sample(s_MPU *mpu){
+	uint8_t isStill = TRUE;
+	int32_t mean, variance;
+
+	for(uint8_t axis = 0; axis < NUM_AXIS; axis++){
+		mpu->Calib.windowSum[axis] += mpu->MAF.rawData[axis];
+		mpu->Calib.sumSq[axis] += (int32_t)mpu->MAF.rawData[axis] * mpu->MAF.rawData[axis];
+	}
+	mpu->Calib.windowTemp += mpu->Thermal.raw;
+	mpu->Calib.count++;
+	if(mpu->Calib.count < MPU_CALIB_WINDOW)
+		return;
+
+	// Ventana completa: quieto si la varianza de cada eje es chica
+	for(uint8_t axis = 0; axis < NUM_AXIS; axis++){
+		mean = mpu->Calib.windowSum[axis] >> MPU_CALIB_WINDOW_BITS;
+		variance = (int32_t)((mpu->Calib.sumSq[axis] -
+							 (((int64_t)mpu->Calib.windowSum[axis] * mpu->Calib.windowSum[axis]) >> MPU_CALIB_WINDOW_BITS)) >> MPU_CALIB_WINDOW_BITS);
+		if(variance > (axis < 3 ? MPU_CALIB_ACC_VAR : MPU_CALIB_GYRO_VAR))
+			isStill = FALSE;
+		// Un giro lento y parejo pasa la varianza pero corre la media del giróscopo
+		if(mpu->Calib.isRunning && axis >= 3 && mpu->Calib.windows &&
+		   abs(mean - mpu->Calib.sum[axis] / (mpu->Calib.windows << MPU_CALIB_WINDOW_BITS)) > MPU_CALIB_GYRO_DRIFT)
+			isStill = FALSE;
 	}
+
+	if(isStill){
+		if(mpu->Calib.isRunning){
+			for(uint8_t axis = 0; axis < NUM_AXIS; axis++)
+				mpu->Calib.sum[axis] += mpu->Calib.windowSum[axis];
+			mpu->Calib.windows++;
+		}
+		if(mpu->Thermal.isOn)
+			MPU6050_Thermal_Update(mpu);
+	}else{
+		mpu->Calib.rejected++;
+	}
+	for(uint8_t axis = 0; axis < NUM_AXIS; axis++){
+		mpu->Calib.windowSum[axis] = 0;
+		mpu->Calib.sumSq[axis] = 0;
+	}
+	mpu->Calib.windowTemp = 0;
+	mpu->Calib.count = 0;
+
+	if(mpu->Calib.isRunning && mpu->Calib.windows >= (NUM_SAMPLES >> MPU_CALIB_WINDOW_BITS)){
+		mpu->Acc.offset.x = (int16_t)(mpu->Calib.sum[0] >> NUM_SAMPLES_BITS);
+		mpu->Acc.offset.y = (int16_t)(mpu->Calib.sum[1] >> NUM_SAMPLES_BITS);
+		mpu->Acc.offset.z = (int16_t)(mpu->Calib.sum[2] >> NUM_SAMPLES_BITS) - mpu->Config.accOneG;
+		mpu->Gyro.offset.x = (int16_t)(mpu->Calib.sum[3] >> NUM_SAMPLES_BITS);
+		mpu->Gyro.offset.y = (int16_t)(mpu->Calib.sum[4] >> NUM_SAMPLES_BITS);
+		mpu->Gyro.offset.z = (int16_t)(mpu->Calib.sum[5] >> NUM_SAMPLES_BITS);
+		mpu->Calib.isRunning = FALSE;
+		mpu->Calib.isDone = TRUE;
+	}
+}
+
+static void MPU6050_Thermal_Update(s_MPU *mpu){
+	const float keep = 1.0f - 1.0f / MPU_THERMAL_MEMORY;
+	float t, g, meanT, meanG, varT, slope;
+	int32_t slopeQ16;
+
+	// Temperatura respecto de la primera ventana, así los cuadrados no pierden precisión
+	if(!mpu->Thermal.points)
+		mpu->Thermal.tRef = (int16_t)(mpu->Calib.windowTemp >> MPU_CALIB_WINDOW_BITS);
+	t = (mpu->Calib.windowTemp - ((int32_t)mpu->Thermal.tRef << MPU_CALIB_WINDOW_BITS)) * (1.0f / MPU_CALIB_WINDOW);
+
+	// Mínimos cuadrados con olvido: una ventana por cada 256 muestras, no en cada muestra
+	mpu->Thermal.n = mpu->Thermal.n * keep + 1.0f;
+	mpu->Thermal.sT = mpu->Thermal.sT * keep + t;
+	mpu->Thermal.sTT = mpu->Thermal.sTT * keep + t * t;
+	for(uint8_t axis = 0; axis < 3; axis++){
+		g = mpu->Calib.windowSum[axis + 3] * (1.0f / MPU_CALIB_WINDOW);
+		mpu->Thermal.sG[axis] = mpu->Thermal.sG[axis] * keep + g;
+		mpu->Thermal.sTG[axis] = mpu->Thermal.sTG[axis] * keep + t * g;
+	}
+	if(mpu->Thermal.points < MPU_THERMAL_MIN_POINTS){
+		mpu->Thermal.points++;
+		if(mpu->Thermal.points < MPU_THERMAL_MIN_POINTS)
+			return;
+	}
+
+	meanT = mpu->Thermal.sT / mpu->Thermal.n;
+	varT = mpu->Thermal.sTT / mpu->Thermal.n - meanT * meanT;
+	for(uint8_t axis = 0; axis < 3; axis++){
+		meanG = mpu->Thermal.sG[axis] / mpu->Thermal.n;
+		// Sin rango de temperatura la pendiente no se ve: queda la última, o cero
+		if(varT >= MPU_THERMAL_MIN_VAR){
+			slope = (mpu->Thermal.sTG[axis] / mpu->Thermal.n - meanT * meanG) / varT;
+			slopeQ16 = (int32_t)(slope * 65536.0f);
+			if(slopeQ16 >= -MPU_THERMAL_MAX_SLOPE && slopeQ16 <= MPU_THERMAL_MAX_SLOPE){
+				mpu->Thermal.slope[axis] = slopeQ16;
+				mpu->Thermal.hasSlope = TRUE;
+			}
+		}
+		mpu->Thermal.intercept[axis] = (int32_t)(meanG * 65536.0f) - (int32_t)(mpu->Thermal.slope[axis] * meanT);
+	}
+	mpu->Thermal.isValid = TRUE;
+}
+
+static void MPU6050_Thermal_Apply(s_MPU *mpu){
+	int32_t dT = mpu->Thermal.raw - mpu->Thermal.tRef;
+
+	// Una multiplicación y suma de 64 bits por eje (SMLAL)
+	mpu->Gyro.offset.x = (int16_t)(((int64_t)mpu->Thermal.slope[0] * dT + mpu->Thermal.intercept[0] + 0x8000) >> 16);
+	mpu->Gyro.offset.y = (int16_t)(((int64_t)mpu->Thermal.slope[1] * dT + mpu->Thermal.intercept[1] + 0x8000) >> 16);
+	mpu->Gyro.offset.z = (int16_t)(((int64_t)mpu->Thermal.slope[2] * dT + mpu->Thermal.intercept[2] + 0x8000) >> 16);
+}
+
+static void MPU6050_FIFO_Parse(s_MPU *mpu){
+	const uint8_t *frame = mpu->FIFO.buffer;
+	uint8_t head = mpu->FIFO.head;
+
+	for(uint8_t n = 0; n < mpu->FIFO.frames; n++, frame += MPU_FIFO_FRAME){
+		if((uint8_t)(head - __atomic_load_n(&mpu->FIFO.tail, __ATOMIC_ACQUIRE)) >= MPU_QUEUE_SIZE){
+			mpu->FIFO.dropped += mpu->FIFO.frames - n;
+			break;
+		}
+		for(uint8_t word = 0; word < MPU_FRAME_WORDS; word++){
+			mpu->FIFO.queue[head & (MPU_QUEUE_SIZE - 1)][word] = (int16_t)((frame[2 * word] << 8) | frame[2 * word + 1]);
+		}
+		head++;
+	}
+	__atomic_store_n(&mpu->FIFO.head, head, __ATOMIC_RELEASE);
+}
+
+static uint8_t MPU6050_FIFO_Pop(s_MPU *mpu){
+	uint8_t tail = mpu->FIFO.tail;
+	const int16_t *sample;
+
+	if(tail == __atomic_load_n(&mpu->FIFO.head, __ATOMIC_ACQUIRE))
+		return FALSE;
+
+	sample = mpu->FIFO.queue[tail & (MPU_QUEUE_SIZE - 1)];
+	for(uint8_t axis = 0; axis < 3; axis++){
+		mpu->MAF.rawData[axis] = sample[axis];					// Acc
+		mpu->MAF.rawData[axis + 3] = sample[axis + 4];			// Gyro, después de la temperatura
+	}
+	mpu->Thermal.raw = sample[3];
+	__atomic_store_n(&mpu->FIFO.tail, (uint8_t)(tail + 1), __ATOMIC_RELEASE);
+	return TRUE;
+}
+
+static uint8_t MPU6050_DataReady_Read(s_MPU *mpu){
+	if(mpu->Config.isWriting)
+		return FALSE;											// Se lee al terminar la escritura
+	if(MPU6050_Config_Start(mpu))
+		return TRUE;
+	if(I2C_DMA_Mem_Read(MPU6050_ADDR, ACCEL_XOUT_REG, mpu->bit_data, 14) != SYS_OK)
+		return FALSE;
+	mpu->DRDY.readTime = mpu->DRDY.irqTime;
+	mpu->DRDY.isPending = FALSE;
+	mpu->DRDY.isReading = TRUE;
+	return TRUE;
+}
+
+static void MPU6050_Config_Apply(s_MPU *mpu){
+	uint8_t accRange = (mpu->Config.regs[3] >> 3) & 0x03;
+	uint8_t gyroRange = (mpu->Config.regs[2] >> 3) & 0x03;
+
+	// Los offsets pasan al rango nuevo; la media móvil y la recta de temperatura son del anterior
+	if(gyroRange != mpu->Config.gyroRange)
+		MPU6050_Thermal_Reset(mpu, mpu->Thermal.isOn);
+	mpu->Acc.offset.x = MPU6050_Rescale(mpu->Acc.offset.x, mpu->Config.accRange, accRange);
+	mpu->Acc.offset.y = MPU6050_Rescale(mpu->Acc.offset.y, mpu->Config.accRange, accRange);
+	mpu->Acc.offset.z = MPU6050_Rescale(mpu->Acc.offset.z, mpu->Config.accRange, accRange);
+	mpu->Gyro.offset.x = MPU6050_Rescale(mpu->Gyro.offset.x, mpu->Config.gyroRange, gyroRange);
+	mpu->Gyro.offset.y = MPU6050_Rescale(mpu->Gyro.offset.y, mpu->Config.gyroRange, gyroRange);
+	mpu->Gyro.offset.z = MPU6050_Rescale(mpu->Gyro.offset.z, mpu->Config.gyroRange, gyroRange);
+	Filter_Maf_Init(&mpu->MAF.filter, &mpu->MAF.mediaBuffer[0][0], mpu->MAF.sumData, NUM_AXIS, NUM_MAF_BITS);
+
+	mpu->Config.sampleDiv = mpu->Config.regs[0];
+	mpu->Config.dlpf = mpu->Config.regs[1];
+	mpu->Config.gyroRange = gyroRange;
+	mpu->Config.accRange = accRange;
+	mpu->Config.gyroScale = MPU_GYRO_DPS_Q24 << gyroRange;
+	mpu->Config.accScale = MPU_ACC_MS2_Q24 << accRange;
+	mpu->Config.accOneG = SCALE_FACTOR >> accRange;
+	mpu->Config.samplePeriod = MPU6050_Period_Us(mpu->Config.dlpf, mpu->Config.sampleDiv);
+
+	if(mpu->Calib.isRunning)
+		MPU6050_Calibrate_Start(mpu);							// Las ventanas sumadas son de la escala anterior
+	mpu->Config.changes++;
+	__atomic_store_n(&mpu->Config.isWritten, FALSE, __ATOMIC_RELEASE);
+}
+
+static uint32_t MPU6050_Period_Us(uint8_t dlpf, uint8_t sampleDiv){
+	// Sin DLPF el muestreo base del giróscopo es de 8kHz
+	return (dlpf == MPU_DLPF_260HZ ? 125UL : 1000UL) * (1 + sampleDiv);
+}
+
+static int16_t MPU6050_Rescale(int16_t value, uint8_t from, uint8_t to){
+	int32_t scaled = (int32_t)value << from;					// LSB del rango más fino
+
+	if(to)
+		scaled = (scaled + (1L << (to - 1))) >> to;
+	return (int16_t)scaled;
 }
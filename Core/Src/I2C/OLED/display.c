@@ -180,6 +180,10 @@ void Display_I2C_Refresh_Ready(uint8_t val){
 	Update.Ready_To_Refresh = val;
 }
 
+const uint8_t *Display_Get_Buffer(void){
+	return OLED_DMA_BUFFER;
+}
+
 void SSD1306_ON(void){
 	SSD1306_WRITECOMMAND(0x8D);
 	SSD1306_WRITECOMMAND(0x14);
@@ -8,144 +8,1069 @@
 #include "Protocol_Handler/protocol_handler.h"
 #include <string.h>
 #include "WiFi/ESP01.h"
+#include "CRC/crc.h"
+#include "utilities.h"
 
-static uint8_t i = 0;
-static uint8_t auxIndex = 0;
-static uint8_t TxAuxBuffer[30];
-static uint8_t indexStart;
-static uint8_t indexStartValue;
-static uint8_t checksum;
+/**
+ * @brief Lee cuatro bytes como una palabra, sin suponer alineación ni violar el aliasing.
+ *
+ * Con el puntero alineado el compilador lo resuelve con un único LDR.
+ */
+static inline uint32_t Comm_Load_Word(const uint8_t *p){
+	uint32_t word;
+	memcpy(&word, p, 4);
+	return word;
+}
+
+/**
+ * @brief Handler interno de CMDSTATS.
+ *
+ * Con un byte de payload responde las estadísticas de ese comando; sin payload responde una
+ * trama por cada comando que se haya ejecutado al menos una vez.
+ */
+static void Comm_Cmd_Stats(s_commData *comm, const s_payload *payload);
+
+/**
+ * @brief Envía una trama CMDSTATS con cmd, cantidad de llamadas y tiempo máximo.
+ */
+static void Comm_Send_Stats(s_commData *comm, uint8_t cmd);
+
+/**
+ * @brief Handler interno de CHECKMODE: cambia el checksum y responde con el modo nuevo.
+ */
+static void Comm_Cmd_CheckMode(s_commData *comm, const s_payload *payload);
+
+/**
+ * @brief Bytes de checksum que agrega a la trama el modo indicado.
+ */
+static uint8_t Comm_CheckSize(uint8_t mode);
+
+/**
+ * @brief Verifica el checksum de una trama completa del buffer circular.
+ *
+ * @return TRUE si el checksum coincide.
+ */
+static uint8_t Comm_CheckFrame(const s_ring *ring, uint32_t read, uint32_t frameSize, uint8_t mode);
+
+/**
+ * @brief CRC del modo indicado sobre len bytes del buffer circular a partir de read.
+ */
+static uint32_t Comm_CrcSpan(const s_ring *ring, uint32_t read, uint32_t len, uint8_t mode);
+
+/**
+ * @brief Handler interno de BULKREAD: valida el pedido y arranca la transferencia.
+ */
+static void Comm_Cmd_BulkRead(s_commData *comm, const s_payload *payload);
+
+/**
+ * @brief Handler interno de BULKACK: avanza la ventana y marca los fragmentos a reenviar.
+ */
+static void Comm_Cmd_BulkAck(s_commData *comm, const s_payload *payload);
+
+/**
+ * @brief Envía los fragmentos pendientes de la transferencia en curso mientras haya lugar en Tx.
+ */
+static void Comm_Bulk_Task(s_commData *comm);
+
+/**
+ * @brief Envía el fragmento seq de la transferencia en curso.
+ *
+ * @return TRUE si la trama entró en el buffer Tx.
+ */
+static uint8_t Comm_Bulk_Send(s_commData *comm, uint16_t seq);
+
+/**
+ * @brief Handler interno de PIPELINE: informa cuántas solicitudes puede tener en curso la PC.
+ *
+ * Con un byte de payload la PC pide esa cantidad y se le concede hasta COMM_MAX_INFLIGHT.
+ */
+static void Comm_Cmd_Pipeline(s_commData *comm, const s_payload *payload);
+
+/**
+ * @brief Handler interno de TXSTATS: responde la demora en cola de cada clase.
+ */
+static void Comm_Cmd_TxStats(s_commData *comm, const s_payload *payload);
+
+/**
+ * @brief Handler interno de TIMESYNC: responde las marcas de tiempo del robot.
+ */
+static void Comm_Cmd_TimeSync(s_commData *comm, const s_payload *payload);
+
+/**
+ * @brief Handler interno de LATENCY: responde el histograma de ida y vuelta del enlace.
+ */
+static void Comm_Cmd_Latency(s_commData *comm, const s_payload *payload);
+
+/**
+ * @brief Largo total de la trama que empieza en start, leído de su nBytes.
+ */
+static uint32_t Comm_FrameSize(const s_ring *ring, uint32_t start);
+
+static comm_handler commandTable[COMM_NUM_COMMANDS] = {
+	[CMDSTATS] = &Comm_Cmd_Stats,
+	[CHECKMODE] = &Comm_Cmd_CheckMode,
+	[BULKREAD] = &Comm_Cmd_BulkRead,
+	[BULKACK] = &Comm_Cmd_BulkAck,
+	[PIPELINE] = &Comm_Cmd_Pipeline,
+	[TXSTATS] = &Comm_Cmd_TxStats,
+	[TIMESYNC] = &Comm_Cmd_TimeSync,
+	[LATENCY] = &Comm_Cmd_Latency,
+};
+
+static uint8_t txClassTable[COMM_NUM_COMMANDS] = {
+	[TELEMETRY] = COMM_TX_NORMAL,
+	[BULKDATA] = COMM_TX_NORMAL,
+	[USERTEXT] = COMM_TX_NORMAL,
+	[DEBUGER] = COMM_TX_NORMAL,
+};
+
+static struct{
+	const uint8_t *base;
+	uint32_t size;
+}regions[COMM_NUM_REGIONS];
+
+static s_cmdStats commandStats[COMM_NUM_COMMANDS];
+
+static uint32_t (*Comm_Get_Time)(void) = NULL;
+
+static uint32_t (*Comm_Get_Micros)(void) = NULL;
+
+static void (*Comm_On_Error)(void) = NULL;
+
+/**
+ * @brief Devuelve la cantidad de bytes a descartar hasta el próximo 'U'.
+ *
+ * Recorre los segmentos contiguos del buffer comparando cuatro bytes por vez.
+ */
+static uint32_t Comm_FindStart(const s_ring *ring, uint32_t read, uint32_t count);
+
+/**
+ * @brief Arma la palabra de 32 bits de cabecera a partir de read, respetando el giro del buffer.
+ */
+static uint32_t Comm_PeekHeader(const s_ring *ring, uint32_t read);
+
+/**
+ * @brief XOR de len bytes del buffer circular a partir de read.
+ */
+static uint8_t Comm_XorSpan(const s_ring *ring, uint32_t read, uint32_t len);
+
+/**
+ * @brief XOR de un bloque contiguo, procesando de a palabras de 32 bits.
+ */
+static uint8_t Comm_Xor(const uint8_t *data, uint32_t len);
+
+/**
+ * @brief Da por terminada la escritura de un productor de la cola.
+ *
+ * El último productor en terminar publica ring.write hasta el final de todo lo reservado,
+ * de modo que una trama interrumpida por otra enviada desde una ISR nunca queda visible
+ * a medio escribir.
+ */
+static void Comm_ReleaseTx(s_txQueue *queue);
+
+/**
+ * @brief Reserva una trama, con etiqueta si isTagged y se está respondiendo una solicitud etiquetada.
+ */
+static uint8_t Comm_Reserve(s_commData *datosCom, s_frame *frame, _eID cmd, uint16_t maxLen, uint8_t isTagged);
+
+/**
+ * @brief Escribe una trama PADDING de size bytes a partir de start.
+ *
+ * size debe ser al menos Comm_PadSize() del modo.
+ */
+static void Comm_Pad(s_ring *ring, uint32_t start, uint32_t size, uint8_t mode);
+
+/**
+ * @brief Largo de la trama PADDING más corta en el modo indicado: cabecera, cmd y checksum.
+ */
+static inline uint8_t Comm_PadSize(uint8_t mode);
+
+/**
+ * @brief Escribe un byte en la posición actual de la trama, sin tocar el checksum.
+ */
+static inline void Comm_FramePut(s_frame *frame, uint8_t value){
+	frame->ring->buffer[frame->index++ & frame->ring->mask] = value;
+}
 
 void Comm_Init(s_commData* comm, void (*dataD)(s_commData *comm), void (*dataW)(s_commData *comm)){
 	comm->dataDecoder = dataD;
 	comm->dataWriter = dataW;
 	comm->timeOut = 0;
 	comm->indexStart = 0;
-	comm->checksumRx = 0;
-	comm->Tx.write=0;
-	comm->Tx.read=0;
-	comm->Rx.write=0;
-	comm->Rx.read=0;
+	comm->indexCmd = 0;
+	comm->rxLength = 0;
+	comm->rxTag = 0;
+	comm->isTagged = FALSE;
+	comm->isReplying = FALSE;
+	RingBuffer_Init(&comm->txQueue[COMM_TX_URGENT].ring, comm->txUrgentBuffer, COMM_TX_URGENT_SIZE);
+	RingBuffer_Init(&comm->txQueue[COMM_TX_NORMAL].ring, comm->txBuffer, COMM_TX_BUFFER_SIZE);
+	comm->txQueue[COMM_TX_URGENT].stamp = comm->txUrgentStamp;
+	comm->txQueue[COMM_TX_NORMAL].stamp = comm->txStamp;
+	for(uint8_t txClass = 0; txClass < COMM_TX_CLASSES; txClass++){
+		comm->txQueue[txClass].reserve = 0;
+		comm->txQueue[txClass].writers = 0;
+		memset(&comm->txQueue[txClass].stats, 0, sizeof(s_txStats));
+	}
+	comm->txActive = COMM_TX_URGENT;
+	comm->txEnd = 0;
+	comm->txFrame = 0;
+	RingBuffer_Init(&comm->Rx, comm->rxBuffer, COMM_RX_BUFFER_SIZE);
 	comm->isESP01 = 0;
-	comm->protocolState = START;
+	comm->checkMode = CHECK_XOR;
+	comm->maxChunk = 0;
+	comm->dataPending = NULL;
+	comm->bulk.isActive = FALSE;
+	memset(comm->rttHist, 0, sizeof(comm->rttHist));
 }
 
 void Comm_Task(s_commData* comm){
-	if(comm->Rx.read != comm->Rx.write){
+	if(RingBuffer_Count(&comm->Rx)){
 		decodeProtocol(comm);
 	}
-	if (comm->Tx.read != comm->Tx.write) {
+	if(comm->bulk.isActive){
+		Comm_Bulk_Task(comm);
+	}
+	if(Comm_Tx_Count(comm) || (comm->dataPending != NULL && comm->dataPending())){
 		if(comm->dataWriter != NULL)
 			comm->dataWriter(comm);
 	}
 }
 
 void decodeProtocol(s_commData *datosCom){
-	static uint8_t nBytes=0;
-	uint8_t indexWriteRxCopy = datosCom->Rx.write;
-
-	while (datosCom->Rx.read != indexWriteRxCopy){
-		switch(datosCom->protocolState){
-		case START:
-			if (datosCom->Rx.buffer[datosCom->Rx.read++] == 'U'){
-				datosCom->protocolState = HEADER_1;
-				datosCom->checksumRx = 0;
-			}
-			break;
-		case HEADER_1:
-			if (datosCom->Rx.buffer[datosCom->Rx.read++] == 'N')
-				datosCom->protocolState = HEADER_2;
-			else{
-				datosCom->Rx.read--;
-				datosCom->protocolState = START;
-			}
-			break;
-		case HEADER_2:
-			if (datosCom->Rx.buffer[datosCom->Rx.read++] == 'E')
-				datosCom->protocolState = HEADER_3;
-			else{
-				datosCom->Rx.read--;
-				datosCom->protocolState = START;
-			}
-			break;
-		case HEADER_3:
-			if (datosCom->Rx.buffer[datosCom->Rx.read++] == 'R')
-				datosCom->protocolState = NBYTES;
-			else{
-				datosCom->Rx.read--;
-				datosCom->protocolState = START;
-			}
-			break;
-		case NBYTES:
-			datosCom->indexStart = datosCom->Rx.read;
-			nBytes = datosCom->Rx.buffer[datosCom->Rx.read++];
-			datosCom->protocolState = TOKEN;
-			break;
-		case TOKEN:
-			if (datosCom->Rx.buffer[datosCom->Rx.read++] == ':'){
-				datosCom->protocolState = PAYLOAD;
-				datosCom->checksumRx ='U' ^ 'N' ^ 'E' ^ 'R' ^ nBytes ^ ':';
-			}
-			else{
-				datosCom->Rx.read--;
-				datosCom->protocolState = START;
-			}
+	uint32_t read = datosCom->Rx.read;
+	uint32_t pending = RingBuffer_Count(&datosCom->Rx);
+	uint32_t nBytes;
+	uint32_t frameSize;
+	uint32_t prefix;
+	uint8_t mode;
+	uint8_t token, isTagged;
+	s_txQueue *reply = &datosCom->txQueue[COMM_TX_URGENT];
+
+	while(pending){
+		// Descarta todo lo que no pueda ser inicio de trama
+		nBytes = Comm_FindStart(&datosCom->Rx, read, pending);
+		read += nBytes;
+		pending -= nBytes;
+
+		if(pending < FRAME_MIN_SIZE)
 			break;
-		case PAYLOAD:
-			if (nBytes > 1){
-				datosCom->checksumRx ^= datosCom->Rx.buffer[datosCom->Rx.read++];
-			}
-			nBytes--;
-			if(nBytes<=0){
-				datosCom->protocolState = START;
-				if(datosCom->checksumRx == datosCom->Rx.buffer[datosCom->Rx.read]){
-					if(datosCom->dataDecoder != NULL)
-						datosCom->dataDecoder(datosCom);
-				}
+
+		token = RingBuffer_At(&datosCom->Rx, read + FRAME_PREFIX - 1);
+		if(Comm_PeekHeader(&datosCom->Rx, read) != UNER_HEADER || (token != FRAME_TOKEN && token != FRAME_TOKEN_TAGGED)){
+			read++;
+			pending--;
+			continue;
+		}
+
+		nBytes = RingBuffer_At(&datosCom->Rx, read + FRAME_PREFIX - 2);
+		prefix = FRAME_PREFIX;
+		if(!nBytes){												// Trama extendida, FRAME_MIN_SIZE asegura que el largo ya llegó
+			nBytes = RingBuffer_At(&datosCom->Rx, read + FRAME_PREFIX) |
+					 (RingBuffer_At(&datosCom->Rx, read + FRAME_PREFIX + 1) << 8);
+			prefix = FRAME_EXT_PREFIX;
+		}
+		if(nBytes < 2 || prefix + nBytes > RingBuffer_Size(&datosCom->Rx)){
+			read++;
+			pending--;
+			continue;
+		}
+
+		frameSize = prefix + nBytes;
+		if(pending < frameSize)
+			break;													// Trama incompleta, se espera al resto
+
+		isTagged = (token == FRAME_TOKEN_TAGGED);
+		mode = datosCom->checkMode;
+		if(nBytes < 1U + isTagged + Comm_CheckSize(mode) || !Comm_CheckFrame(&datosCom->Rx, read, frameSize, mode)){
+			// Un CHECKMODE con XOR se acepta siempre, para poder renegociar sin conocer el modo
+			if(mode == CHECK_XOR || nBytes < 2U + isTagged || RingBuffer_At(&datosCom->Rx, read + prefix + isTagged) != CHECKMODE ||
+			   !Comm_CheckFrame(&datosCom->Rx, read, frameSize, CHECK_XOR)){
+				read++;												// Se resincroniza desde cabecera+1
+				pending--;
+				continue;
 			}
+			mode = CHECK_XOR;
+		}
+
+		// Sin lugar para la respuesta la solicitud queda en Rx hasta que se vacíe la cola urgente
+		if(RingBuffer_Size(&reply->ring) - (__atomic_load_n(&reply->reserve, __ATOMIC_ACQUIRE) - __atomic_load_n(&reply->ring.read, __ATOMIC_ACQUIRE)) < COMM_REPLY_RESERVE)
 			break;
-		default:
-			datosCom->protocolState = START;
-			break;
+
+		datosCom->indexStart = read + FRAME_PREFIX - 2;
+		datosCom->indexCmd = read + prefix + isTagged;
+		datosCom->rxLength = nBytes - 1 - isTagged - Comm_CheckSize(mode);	// nBytes sin etiqueta, cmd ni checksum
+		datosCom->rxTag = isTagged ? RingBuffer_At(&datosCom->Rx, read + prefix) : 0;
+		datosCom->isTagged = isTagged;
+		if(datosCom->dataDecoder != NULL){
+			datosCom->isReplying = TRUE;
+			datosCom->dataDecoder(datosCom);
+			datosCom->isReplying = FALSE;
+		}
+
+		read += frameSize;
+		pending -= frameSize;
+	}
+
+	RingBuffer_Consume(&datosCom->Rx, read - datosCom->Rx.read);
+}
+
+e_system Comm_Register_Command(uint8_t cmd, comm_handler handler){
+	if(handler != NULL && commandTable[cmd] != NULL && commandTable[cmd] != handler)
+		return SYS_BUSY;
+	commandTable[cmd] = handler;
+	return SYS_OK;
+}
+
+void Comm_Attach_TimeBase(uint32_t (*getTime)(void)){
+	Comm_Get_Time = getTime;
+}
+
+void Comm_Attach_Clock(uint32_t (*getMicros)(void)){
+	Comm_Get_Micros = getMicros;
+}
+
+void Comm_Attach_OnError(void (*onError)(void)){
+	Comm_On_Error = onError;
+}
+
+uint32_t Comm_Micros(void){
+	return Comm_Get_Micros != NULL ? Comm_Get_Micros() : 0;
+}
+
+void Comm_Dispatch(s_commData *comm){
+	uint8_t cmd = RingBuffer_At(&comm->Rx, comm->indexCmd);
+	comm_handler handler = commandTable[cmd];
+	uint32_t offset, segment, start, elapsed;
+	s_payload payload;
+
+	if(handler == NULL){
+		comm_sendCMD(comm, SYSWARNING, (uint8_t*)"NO CMD", 6);
+		return;
+	}
+
+	payload.length = comm->rxLength;
+	offset = (comm->indexCmd + 1) & comm->Rx.mask;
+	segment = RingBuffer_Size(&comm->Rx) - offset;
+	if(payload.length <= segment){
+		payload.data = &comm->Rx.buffer[offset];
+	}else{
+		memcpy(comm->rxLinear, &comm->Rx.buffer[offset], segment);
+		memcpy(&comm->rxLinear[segment], comm->Rx.buffer, payload.length - segment);
+		payload.data = comm->rxLinear;
+	}
+
+	if(Comm_Get_Time == NULL){
+		handler(comm, &payload);
+		commandStats[cmd].calls++;
+		return;
+	}
+
+	start = Comm_Get_Time();
+	handler(comm, &payload);
+	elapsed = Comm_Get_Time() - start;
+
+	commandStats[cmd].calls++;
+	if(elapsed > commandStats[cmd].maxTime)
+		commandStats[cmd].maxTime = elapsed;
+}
+
+e_system Comm_Set_CheckMode(s_commData *comm, uint8_t mode){
+	if(mode > CHECK_CRC32C)
+		return SYS_ERROR;
+	__atomic_store_n(&comm->checkMode, mode, __ATOMIC_RELEASE);
+	return SYS_OK;
+}
+
+e_system Comm_Register_Region(uint8_t id, const void *base, uint32_t size){
+	if(id >= COMM_NUM_REGIONS)
+		return SYS_ERROR;
+	regions[id].base = base;
+	regions[id].size = size;
+	return SYS_OK;
+}
+
+void Comm_Set_MaxChunk(s_commData *comm, uint16_t size){
+	comm->maxChunk = size;
+}
+
+void Comm_Set_Tx_Pending(s_commData *comm, uint8_t (*dataP)(void)){
+	comm->dataPending = dataP;
+}
+
+e_system Comm_Set_TxClass(uint8_t cmd, uint8_t txClass){
+	if(txClass >= COMM_TX_CLASSES)
+		return SYS_ERROR;
+	txClassTable[cmd] = txClass;
+	return SYS_OK;
+}
+
+s_ring *Comm_Tx_Next(s_commData *comm, uint32_t *length){
+	s_txQueue *queue = &comm->txQueue[comm->txActive];
+	uint32_t write, size;
+
+	if(queue->ring.read == comm->txEnd){
+		// Ráfaga terminada: se elige la cola de mayor prioridad con tramas publicadas
+		for(comm->txActive = 0; comm->txActive < COMM_TX_CLASSES - 1; comm->txActive++){
+			if(RingBuffer_Count(&comm->txQueue[comm->txActive].ring))
+				break;
+		}
+		queue = &comm->txQueue[comm->txActive];
+		write = __atomic_load_n(&queue->ring.write, __ATOMIC_ACQUIRE);
+		comm->txEnd = queue->ring.read;
+		comm->txFrame = queue->ring.read;
+		while(comm->txEnd != write){
+			size = Comm_FrameSize(&queue->ring, comm->txEnd);
+			if(comm->txEnd != queue->ring.read && comm->txEnd + size - queue->ring.read > COMM_TX_BURST)
+				break;
+			comm->txEnd += size;
+		}
+	}
+
+	*length = comm->txEnd - queue->ring.read;
+	return *length ? &queue->ring : NULL;
+}
+
+void Comm_Tx_Consume(s_commData *comm, uint32_t len){
+	s_txQueue *queue = &comm->txQueue[comm->txActive];
+	uint32_t read = queue->ring.read;
+	uint32_t delay;
+
+	if(len > comm->txEnd - read)
+		len = comm->txEnd - read;
+
+	// Se mide cada trama cuyo primer byte se entregó, antes de liberar el espacio
+	while(comm->txFrame != comm->txEnd && comm->txFrame - read < len){
+		queue->stats.frames++;
+		if(Comm_Get_Time != NULL){
+			delay = Comm_Get_Time() - queue->stamp[(comm->txFrame & queue->ring.mask) / FRAME_MIN_SIZE];
+			queue->stats.totalDelay += delay;
+			if(delay > queue->stats.maxDelay)
+				queue->stats.maxDelay = delay;
 		}
+		comm->txFrame += Comm_FrameSize(&queue->ring, comm->txFrame);
+	}
+
+	RingBuffer_Consume(&queue->ring, len);
+}
+
+uint32_t Comm_Tx_Read(s_commData *comm, uint8_t *data, uint32_t len){
+	uint32_t copied = 0;
+	uint32_t length, offset, segment;
+	s_ring *tx;
+
+	while(copied < len && (tx = Comm_Tx_Next(comm, &length)) != NULL){
+		if(length > len - copied)
+			length = len - copied;
+		offset = tx->read & tx->mask;
+		segment = RingBuffer_Size(tx) - offset;
+		if(segment > length)
+			segment = length;
+		memcpy(&data[copied], &tx->buffer[offset], segment);
+		memcpy(&data[copied + segment], tx->buffer, length - segment);
+		Comm_Tx_Consume(comm, length);
+		copied += length;
 	}
+	return copied;
+}
+
+uint32_t Comm_Tx_Count(s_commData *comm){
+	uint32_t count = 0;
+
+	for(uint8_t txClass = 0; txClass < COMM_TX_CLASSES; txClass++){
+		count += RingBuffer_Count(&comm->txQueue[txClass].ring);
+	}
+	return count;
+}
+
+const s_cmdStats *Comm_Get_Stats(uint8_t cmd){
+	return &commandStats[cmd];
+}
+
+void Comm_Reset_Stats(void){
+	memset(commandStats, 0, sizeof(commandStats));
 }
 
 void comm_sendCMD(s_commData *datosCom, _eID cmd, uint8_t *str, uint8_t len){
-    i = 0;
-    auxIndex = 0;
+	s_frame frame;
+	uint8_t isText = (cmd == USERTEXT || cmd == SYSERROR);
+
+	if(str == NULL)
+		len = 0;
 
-    // Cabecera
-    TxAuxBuffer[auxIndex++] = 'U'; // Start
-    TxAuxBuffer[auxIndex++] = 'N'; // Header 1
-    TxAuxBuffer[auxIndex++] = 'E'; // Header 2
-    TxAuxBuffer[auxIndex++] = 'R'; // Header 3
+	// Aunque la trama no entre en el buffer, el error se informa
+	if(cmd == SYSERROR && Comm_On_Error != NULL)
+		Comm_On_Error();
 
-    indexStart = auxIndex; // Se guarda la posición del primer dato del mensaje (cmd)
-    TxAuxBuffer[auxIndex++] = 0;   // Placeholder del indexStart, se sobrescribirá después
+	if(!comm_reserveFrame(datosCom, &frame, cmd, len + isText))
+		return;
 
-    TxAuxBuffer[auxIndex++] = ':'; // Token
-    TxAuxBuffer[auxIndex++] = cmd; // Comando
+	if(isText)
+		comm_put_u8(&frame, len);
+	comm_put_bytes(&frame, str, len);
 
-    if(cmd == USERTEXT || cmd == SYSERROR)
-    	TxAuxBuffer[auxIndex++] = len;
+	comm_commitFrame(datosCom, &frame);
+}
+
+uint8_t comm_reserveFrame(s_commData *datosCom, s_frame *frame, _eID cmd, uint16_t maxLen){
+	return Comm_Reserve(datosCom, frame, cmd, maxLen, TRUE);
+}
+
+uint8_t comm_reserveUntagged(s_commData *datosCom, s_frame *frame, _eID cmd, uint16_t maxLen){
+	return Comm_Reserve(datosCom, frame, cmd, maxLen, FALSE);
+}
+
+static uint8_t Comm_Reserve(s_commData *datosCom, s_frame *frame, _eID cmd, uint16_t maxLen, uint8_t isTagged){
+	uint32_t start, end;
+	uint8_t mode = __atomic_load_n(&datosCom->checkMode, __ATOMIC_ACQUIRE);
+	uint32_t nBytes, size;
+	uint8_t token = FRAME_TOKEN;
+	uint8_t tag = datosCom->rxTag;
+	uint8_t isExtended;
+	uint8_t txClass = txClassTable[cmd];
+	uint8_t slack = maxLen ? Comm_PadSize(mode) : 0;
+	s_txQueue *queue;
+
+	isTagged = isTagged && datosCom->isReplying && datosCom->isTagged;
+	nBytes = isTagged + 1 + maxLen + Comm_CheckSize(mode);			// etiqueta + cmd + payload + checksum
+	isExtended = nBytes > 255;
+	// Una trama que puede quedar corta reserva además lugar para cerrar el sobrante con PADDING
+	size = (isExtended ? FRAME_EXT_PREFIX : FRAME_PREFIX) + nBytes + slack;
+
+	if(size > RingBuffer_Size(&datosCom->txQueue[txClass].ring))
+		txClass = COMM_TX_NORMAL;
+	queue = &datosCom->txQueue[txClass];
+	if(size > RingBuffer_Size(&queue->ring) || nBytes > 0xFFFF)
+		return FALSE;
+
+	// Se anota como productor antes de reservar para que nadie publique la reserva a medio escribir
+	__atomic_add_fetch(&queue->writers, 1, __ATOMIC_ACQ_REL);
+
+	start = __atomic_load_n(&queue->reserve, __ATOMIC_ACQUIRE);
+	do{
+		if(size > RingBuffer_Size(&queue->ring) - (start - __atomic_load_n(&queue->ring.read, __ATOMIC_ACQUIRE))){
+			Comm_ReleaseTx(queue);
+			return FALSE;
+		}
+		end = start + size;
+	}while(!__atomic_compare_exchange_n(&queue->reserve, &start, end, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+	frame->ring = &queue->ring;
+	frame->txClass = txClass;
+	frame->start = start;
+	frame->index = start;
+	frame->remaining = maxLen;
+	frame->checkMode = mode;
+	frame->isExtended = isExtended;
+	frame->slack = slack;
+
+	Comm_FramePut(frame, 'U');
+	Comm_FramePut(frame, 'N');
+	Comm_FramePut(frame, 'E');
+	Comm_FramePut(frame, 'R');
+	frame->index++;													// nBytes, se completa en el commit
+	if(isTagged)
+		token = FRAME_TOKEN_TAGGED;
+	Comm_FramePut(frame, token);
+	if(isExtended)
+		frame->index += 2;											// nBytes de 16 bits, también en el commit
+	frame->checksum = 'U' ^ 'N' ^ 'E' ^ 'R' ^ token ^ cmd;
+	if(isTagged){
+		Comm_FramePut(frame, tag);
+		frame->checksum ^= tag;
+	}
+	Comm_FramePut(frame, cmd);
+
+	return TRUE;
+}
+
+void comm_commitFrame(s_commData *datosCom, s_frame *frame){
+	s_txQueue *queue = &datosCom->txQueue[frame->txClass];
+	uint8_t checkSize = Comm_CheckSize(frame->checkMode);
+	uint32_t gap = frame->remaining + frame->slack;
+	uint32_t reservedEnd = frame->index + checkSize + gap;
+	uint32_t crc;
+	uint32_t nBytes;
+
+	// El sobrante se devuelve a la cola, salvo que otro productor ya haya reservado a
+	// continuación: en ese caso queda para una trama PADDING después de esta
+	if(gap && __atomic_compare_exchange_n(&queue->reserve, &reservedEnd, frame->index + checkSize, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		gap = 0;
+
+	if(frame->isExtended){
+		nBytes = frame->index - frame->start - FRAME_EXT_PREFIX + checkSize;
+		frame->ring->buffer[(frame->start + FRAME_PREFIX - 2) & frame->ring->mask] = 0;
+		frame->ring->buffer[(frame->start + FRAME_PREFIX) & frame->ring->mask] = (uint8_t)nBytes;
+		frame->ring->buffer[(frame->start + FRAME_PREFIX + 1) & frame->ring->mask] = (uint8_t)(nBytes >> 8);
+	}else{
+		nBytes = frame->index - frame->start - FRAME_PREFIX + checkSize;	// cmd + payload + checksum
+		frame->ring->buffer[(frame->start + FRAME_PREFIX - 2) & frame->ring->mask] = (uint8_t)nBytes;
+	}
+	if(frame->checkMode == CHECK_XOR){
+		Comm_FramePut(frame, frame->checksum ^ (uint8_t)nBytes ^ (uint8_t)(nBytes >> 8));
+	}else{
+		crc = Comm_CrcSpan(frame->ring, frame->start, frame->index - frame->start, frame->checkMode);
+		while(checkSize--){
+			Comm_FramePut(frame, (uint8_t)crc);
+			crc >>= 8;
+		}
+	}
+
+	if(gap)
+		Comm_Pad(frame->ring, frame->index, gap, frame->checkMode);
+
+	if(Comm_Get_Time != NULL){
+		queue->stamp[(frame->start & frame->ring->mask) / FRAME_MIN_SIZE] = Comm_Get_Time();
+		if(gap)
+			queue->stamp[(frame->index & frame->ring->mask) / FRAME_MIN_SIZE] = queue->stamp[(frame->start & frame->ring->mask) / FRAME_MIN_SIZE];
+	}
+	Comm_ReleaseTx(queue);
+}
+
+uint16_t comm_get_u16(const uint8_t *data){
+	return (uint16_t)(data[0] | (data[1] << 8));
+}
+
+uint32_t comm_get_u32(const uint8_t *data){
+	return (uint32_t)comm_get_u16(data) | ((uint32_t)comm_get_u16(data + 2) << 16);
+}
+
+float comm_get_f32(const uint8_t *data){
+	u_conv conv;
+
+	conv.ui32 = comm_get_u32(data);
+	return conv.f;
+}
+
+void comm_put_u8(s_frame *frame, uint8_t value){
+	if(!frame->remaining)
+		return;
+	frame->remaining--;
+	frame->checksum ^= value;
+	Comm_FramePut(frame, value);
+}
+
+void comm_put_u16(s_frame *frame, uint16_t value){
+	comm_put_u8(frame, (uint8_t)value);
+	comm_put_u8(frame, (uint8_t)(value >> 8));
+}
+
+void comm_put_i16(s_frame *frame, int16_t value){
+	comm_put_u16(frame, (uint16_t)value);
+}
+
+void comm_put_u32(s_frame *frame, uint32_t value){
+	comm_put_u16(frame, (uint16_t)value);
+	comm_put_u16(frame, (uint16_t)(value >> 16));
+}
+
+void comm_put_f32(s_frame *frame, float value){
+	u_conv conv;
+
+	conv.f = value;
+	comm_put_u32(frame, conv.ui32);
+}
+
+void comm_put_bytes(s_frame *frame, const uint8_t *data, uint16_t len){
+	if(data == NULL)
+		return;
+	if(len > frame->remaining)
+		len = frame->remaining;
+	while(len--){
+		comm_put_u8(frame, *data++);
+	}
+}
+
+static void Comm_Cmd_Stats(s_commData *comm, const s_payload *payload){
+	if(payload->length){
+		Comm_Send_Stats(comm, payload->data[0]);
+		return;
+	}
+	for(uint32_t cmd = 0; cmd < COMM_NUM_COMMANDS; cmd++){
+		if(commandStats[cmd].calls)
+			Comm_Send_Stats(comm, cmd);
+	}
+}
+
+static void Comm_Send_Stats(s_commData *comm, uint8_t cmd){
+	s_frame frame;
+
+	if(comm_reserveFrame(comm, &frame, CMDSTATS, 9)){
+		comm_put_u8(&frame, cmd);
+		comm_put_u32(&frame, commandStats[cmd].calls);
+		comm_put_u32(&frame, commandStats[cmd].maxTime);
+		comm_commitFrame(comm, &frame);
+	}
+}
+
+static void Comm_Cmd_CheckMode(s_commData *comm, const s_payload *payload){
+	if(!payload->length || Comm_Set_CheckMode(comm, payload->data[0]) != SYS_OK){
+		comm_sendCMD(comm, SYSWARNING, (uint8_t*)"NO MODE", 7);
+		return;
+	}
+	comm->auxBuffer[0] = payload->data[0];
+	comm_sendCMD(comm, CHECKMODE, comm->auxBuffer, 1);
+}
+
+static void Comm_Cmd_BulkRead(s_commData *comm, const s_payload *payload){
+	s_bulk *bulk = &comm->bulk;
+	s_frame frame;
+	uint32_t offset, length, total, limit;
+	uint16_t fragSize;
+	uint8_t id, window;
+
+	if(payload->length < 12){
+		comm_sendCMD(comm, SYSWARNING, (uint8_t*)"NO BULK", 7);
+		return;
+	}
+	id = payload->data[0];
+	offset = comm_get_u32(&payload->data[1]);
+	length = comm_get_u32(&payload->data[5]);
+	fragSize = comm_get_u16(&payload->data[9]);
+	window = payload->data[11];
+
+	bulk->isActive = FALSE;											// Un pedido nuevo cancela el anterior
+
+	// La trama de un fragmento, con etiqueta, CRC-32C y lugar para PADDING, tiene que entrar
+	// en la cola y en un envío del puerto
+	limit = RingBuffer_Size(&comm->txQueue[COMM_TX_NORMAL].ring);
+	if(comm->maxChunk && comm->maxChunk < limit)
+		limit = comm->maxChunk;
+	limit -= (uint32_t)(FRAME_EXT_PREFIX + 1 + 1 + 3 + 4 + Comm_PadSize(CHECK_CRC32C));
+	if(fragSize > limit)
+		fragSize = (uint16_t)limit;
+	total = fragSize ? (length + fragSize - 1) / fragSize : 0;
+
+	if(length && (id >= COMM_NUM_REGIONS || regions[id].base == NULL || offset > regions[id].size ||
+	   length > regions[id].size - offset || !fragSize || total > 0xFFFF || !window || window > BULK_MAX_WINDOW)){
+		comm_sendCMD(comm, SYSWARNING, (uint8_t*)"NO BULK", 7);
+		return;
+	}
+
+	if(comm_reserveFrame(comm, &frame, BULKREAD, 5)){
+		comm_put_u8(&frame, id);
+		comm_put_u16(&frame, total);
+		comm_put_u16(&frame, fragSize);
+		comm_commitFrame(comm, &frame);
+	}
+	if(!length)
+		return;
+
+	bulk->data = regions[id].base + offset;
+	bulk->length = length;
+	bulk->fragSize = fragSize;
+	bulk->total = total;
+	bulk->base = 0;
+	bulk->next = 0;
+	bulk->retransmit = 0;
+	bulk->window = window;
+	bulk->id = id;
+	bulk->isActive = TRUE;
+}
+
+static void Comm_Cmd_BulkAck(s_commData *comm, const s_payload *payload){
+	s_bulk *bulk = &comm->bulk;
+	uint16_t base;
+	uint32_t bitmap, sent;
+
+	if(payload->length < 7 || !bulk->isActive || payload->data[0] != bulk->id)
+		return;
+
+	base = comm_get_u16(&payload->data[1]);
+	bitmap = comm_get_u32(&payload->data[3]);
+	if(base < bulk->base || base > bulk->next)
+		return;														// Confirmación vieja o de fragmentos no enviados
+
+	bulk->base = base;
+	if(bulk->base >= bulk->total){
+		bulk->isActive = FALSE;
+		return;
+	}
+
+	// Todo lo enviado que la PC no marcó como recibido se vuelve a enviar
+	sent = bulk->next - bulk->base;
+	bulk->retransmit = ~bitmap & (sent >= 32 ? 0xFFFFFFFFUL : (1UL << sent) - 1);
+}
 
-    // Copia de datos si hay
-    if (str != NULL && len > 0) {
-        memcpy(&TxAuxBuffer[auxIndex], str, len);
-        auxIndex += len;
-    }
+static void Comm_Bulk_Task(s_commData *comm){
+	s_bulk *bulk = &comm->bulk;
+	uint32_t k;
 
-    indexStartValue = auxIndex - indexStart - 1; // Cantidad de datos desde cmd hasta checksum
-    TxAuxBuffer[indexStart] = indexStartValue;
+	while(bulk->retransmit){
+		k = __builtin_ctz(bulk->retransmit);
+		if(!Comm_Bulk_Send(comm, bulk->base + k))
+			return;
+		bulk->retransmit &= ~(1UL << k);
+	}
+	while(bulk->next < bulk->total && bulk->next - bulk->base < bulk->window){
+		if(!Comm_Bulk_Send(comm, bulk->next))
+			return;
+		bulk->next++;
+	}
+}
+
+static uint8_t Comm_Bulk_Send(s_commData *comm, uint16_t seq){
+	s_bulk *bulk = &comm->bulk;
+	uint32_t offset = (uint32_t)seq * bulk->fragSize;
+	uint16_t len = bulk->length - offset < bulk->fragSize ? bulk->length - offset : bulk->fragSize;
+	s_frame frame;
+
+	if(!comm_reserveFrame(comm, &frame, BULKDATA, 3 + len))
+		return FALSE;
+	comm_put_u8(&frame, bulk->id);
+	comm_put_u16(&frame, seq);
+	comm_put_bytes(&frame, bulk->data + offset, len);
+	comm_commitFrame(comm, &frame);
+	return TRUE;
+}
+
+static void Comm_Cmd_Pipeline(s_commData *comm, const s_payload *payload){
+	s_frame frame;
+	uint8_t credit = COMM_MAX_INFLIGHT;
+
+	if(payload->length && payload->data[0] && payload->data[0] < credit)
+		credit = payload->data[0];
+
+	if(comm_reserveFrame(comm, &frame, PIPELINE, 3)){
+		comm_put_u8(&frame, credit);
+		comm_put_u16(&frame, RingBuffer_Size(&comm->Rx));
+		comm_commitFrame(comm, &frame);
+	}
+}
+
+static void Comm_Cmd_TxStats(s_commData *comm, const s_payload *payload){
+	s_frame frame;
+
+	for(uint8_t txClass = 0; txClass < COMM_TX_CLASSES; txClass++){
+		if(comm_reserveFrame(comm, &frame, TXSTATS, 13)){
+			comm_put_u8(&frame, txClass);
+			comm_put_u32(&frame, comm->txQueue[txClass].stats.frames);
+			comm_put_u32(&frame, comm->txQueue[txClass].stats.maxDelay);
+			comm_put_u32(&frame, comm->txQueue[txClass].stats.totalDelay);
+			comm_commitFrame(comm, &frame);
+		}
+		if(payload->length && payload->data[0])
+			memset(&comm->txQueue[txClass].stats, 0, sizeof(s_txStats));
+	}
+}
+
+static void Comm_Cmd_TimeSync(s_commData *comm, const s_payload *payload){
+	uint32_t received = Comm_Micros();
+	uint32_t rtt;
+	uint8_t bin = 0;
+	s_frame frame;
+
+	if(payload->length < 8){
+		comm_sendCMD(comm, SYSWARNING, (uint8_t*)"NO TIME", 7);
+		return;
+	}
+	if(comm_reserveFrame(comm, &frame, TIMESYNC, 16)){
+		comm_put_bytes(&frame, payload->data, 8);
+		comm_put_u32(&frame, received);
+		comm_put_u32(&frame, Comm_Micros());
+		comm_commitFrame(comm, &frame);
+	}
+
+	if(payload->length >= 12){
+		rtt = comm_get_u32(&payload->data[8]);
+		if(rtt)
+			bin = 31 - __builtin_clz(rtt);
+		if(bin >= COMM_RTT_BINS)
+			bin = COMM_RTT_BINS - 1;
+		comm->rttHist[bin]++;
+	}
+}
+
+static void Comm_Cmd_Latency(s_commData *comm, const s_payload *payload){
+	s_frame frame;
+
+	if(comm_reserveFrame(comm, &frame, LATENCY, COMM_RTT_BINS * 4)){
+		for(uint8_t bin = 0; bin < COMM_RTT_BINS; bin++){
+			comm_put_u32(&frame, comm->rttHist[bin]);
+		}
+		comm_commitFrame(comm, &frame);
+	}
+	if(payload->length && payload->data[0])
+		memset(comm->rttHist, 0, sizeof(comm->rttHist));
+}
+
+static uint32_t Comm_FrameSize(const s_ring *ring, uint32_t start){
+	uint32_t nBytes = RingBuffer_At(ring, start + FRAME_PREFIX - 2);
+
+	if(!nBytes)
+		return FRAME_EXT_PREFIX + (RingBuffer_At(ring, start + FRAME_PREFIX) | (RingBuffer_At(ring, start + FRAME_PREFIX + 1) << 8));
+	return FRAME_PREFIX + nBytes;
+}
+
+static inline uint8_t Comm_PadSize(uint8_t mode){
+	return FRAME_PREFIX + 1 + Comm_CheckSize(mode);
+}
+
+static void Comm_Pad(s_ring *ring, uint32_t start, uint32_t size, uint8_t mode){
+	s_frame pad = {.ring = ring, .index = start};
+	uint8_t checkSize = Comm_CheckSize(mode);
+	uint32_t nBytes = size - FRAME_PREFIX;
+	uint32_t check;
+
+	Comm_FramePut(&pad, 'U');
+	Comm_FramePut(&pad, 'N');
+	Comm_FramePut(&pad, 'E');
+	Comm_FramePut(&pad, 'R');
+	if(nBytes > 255){
+		nBytes = size - FRAME_EXT_PREFIX;
+		Comm_FramePut(&pad, 0);
+		Comm_FramePut(&pad, FRAME_TOKEN);
+		Comm_FramePut(&pad, (uint8_t)nBytes);
+		Comm_FramePut(&pad, (uint8_t)(nBytes >> 8));
+	}else{
+		Comm_FramePut(&pad, (uint8_t)nBytes);
+		Comm_FramePut(&pad, FRAME_TOKEN);
+	}
+	Comm_FramePut(&pad, PADDING);
+	while(pad.index != start + size - checkSize)
+		Comm_FramePut(&pad, 0);
+
+	if(mode == CHECK_XOR)
+		check = Comm_XorSpan(ring, start, size - checkSize);
+	else
+		check = Comm_CrcSpan(ring, start, size - checkSize, mode);
+	while(checkSize--){
+		Comm_FramePut(&pad, (uint8_t)check);
+		check >>= 8;
+	}
+}
+
+static uint8_t Comm_CheckSize(uint8_t mode){
+	switch(mode){
+	case CHECK_CRC16:
+		return 2;
+	case CHECK_CRC32C:
+		return 4;
+	default:
+		return 1;
+	}
+}
+
+static uint8_t Comm_CheckFrame(const s_ring *ring, uint32_t read, uint32_t frameSize, uint8_t mode){
+	uint8_t checkSize = Comm_CheckSize(mode);
+	uint32_t len = frameSize - checkSize;
+	uint32_t received = 0;
+
+	if(mode == CHECK_XOR)
+		return Comm_XorSpan(ring, read, len) == RingBuffer_At(ring, read + len);
+
+	while(checkSize--){
+		received = (received << 8) | RingBuffer_At(ring, read + len + checkSize);
+	}
+	return Comm_CrcSpan(ring, read, len, mode) == received;
+}
+
+static uint32_t Comm_CrcSpan(const s_ring *ring, uint32_t read, uint32_t len, uint8_t mode){
+	uint32_t offset = read & ring->mask;
+	uint32_t segment = RingBuffer_Size(ring) - offset;
+
+	if(segment > len)
+		segment = len;
+
+	if(mode == CHECK_CRC16)
+		return CRC16_Update(CRC16_Update(CRC16_INIT, &ring->buffer[offset], segment), ring->buffer, len - segment);
+	return CRC32C_Update(CRC32C_Update(CRC32C_INIT, &ring->buffer[offset], segment), ring->buffer, len - segment);
+}
+
+static void Comm_ReleaseTx(s_txQueue *queue){
+	uint32_t write, reserve;
+
+	if(__atomic_sub_fetch(&queue->writers, 1, __ATOMIC_ACQ_REL))
+		return;
+
+	// Si una ISR publica entre la lectura de write y el CAS, el CAS falla y se reintenta
+	write = __atomic_load_n(&queue->ring.write, __ATOMIC_ACQUIRE);
+	do{
+		reserve = __atomic_load_n(&queue->reserve, __ATOMIC_ACQUIRE);
+		if(__atomic_load_n(&queue->writers, __ATOMIC_ACQUIRE))
+			return;
+	}while(!__atomic_compare_exchange_n(&queue->ring.write, &write, reserve, 0, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE));
+}
+
+static uint32_t Comm_FindStart(const s_ring *ring, uint32_t read, uint32_t count){
+	const uint8_t *p = &ring->buffer[read & ring->mask];
+	uint32_t segment = RingBuffer_Size(ring) - (read & ring->mask);
+	uint32_t skipped = 0;
+	uint32_t word;
+
+	if(segment > count)
+		segment = count;
 
-    // Checksum
-    checksum = 0;
-    for (i = 0; i < auxIndex; i++) {
-        checksum ^= TxAuxBuffer[i];
-        datosCom->Tx.buffer[datosCom->Tx.write++] = TxAuxBuffer[i];
-    }
+	while(1){
+		const uint8_t *end = p + segment;
 
-    datosCom->Tx.buffer[datosCom->Tx.write++] = checksum;
+		while(p < end && ((uintptr_t)p & 3)){
+			if(*p == 'U')
+				return skipped;
+			p++;
+			skipped++;
+		}
+		while(end - p >= 4){
+			word = Comm_Load_Word(p) ^ 0x55555555UL;	// Los bytes 'U' quedan en cero
+			word = (word - 0x01010101UL) & ~word & 0x80808080UL;
+			if(word)
+				return skipped + (__builtin_ctz(word) >> 3);
+			p += 4;
+			skipped += 4;
+		}
+		while(p < end){
+			if(*p == 'U')
+				return skipped;
+			p++;
+			skipped++;
+		}
+
+		if(skipped >= count)
+			return count;
+		p = ring->buffer;											// Segundo segmento, desde el inicio
+		segment = count - skipped;
+	}
 }
 
+static uint32_t Comm_PeekHeader(const s_ring *ring, uint32_t read){
+	uint32_t offset = read & ring->mask;
+
+	if(offset <= ring->mask - 3)
+		return Comm_Load_Word(&ring->buffer[offset]);
+
+	return (uint32_t)RingBuffer_At(ring, read) |
+		   ((uint32_t)RingBuffer_At(ring, read + 1) << 8) |
+		   ((uint32_t)RingBuffer_At(ring, read + 2) << 16) |
+		   ((uint32_t)RingBuffer_At(ring, read + 3) << 24);
+}
+
+static uint8_t Comm_XorSpan(const s_ring *ring, uint32_t read, uint32_t len){
+	uint32_t offset = read & ring->mask;
+	uint32_t segment = RingBuffer_Size(ring) - offset;
+
+	if(segment >= len)
+		return Comm_Xor(&ring->buffer[offset], len);
+
+	return Comm_Xor(&ring->buffer[offset], segment) ^ Comm_Xor(ring->buffer, len - segment);
+}
+
+static uint8_t Comm_Xor(const uint8_t *data, uint32_t len){
+	uint32_t acc = 0;
+	uint8_t result = 0;
+
+	while(len && ((uintptr_t)data & 3)){
+		result ^= *data++;
+		len--;
+	}
+	while(len >= 4){
+		acc ^= Comm_Load_Word(data);
+		data += 4;
+		len -= 4;
+	}
+	while(len--){
+		result ^= *data++;
+	}
+
+	acc ^= acc >> 16;
+	acc ^= acc >> 8;
+	return result ^ (uint8_t)acc;
+}
@@ -0,0 +1,97 @@
+/*
+ * recorder.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "Recorder/recorder.h"
+#include <stddef.h>
+
+static uint32_t (*Recorder_Get_Time)(void) = NULL;
+
+e_system Recorder_Init(s_recorder *rec, uint8_t *buffer, uint32_t size, uint16_t recordSize, uint16_t postTrigger){
+	uint32_t capacity = recordSize ? size / recordSize : 0;
+
+	if(!capacity || capacity > UINT16_MAX)
+		return SYS_ERROR;
+	rec->buffer = buffer;
+
+	// Contenido congelado antes de un reset: se conserva hasta que lo vuelvan a armar
+	if(rec->magic == RECORDER_MAGIC && rec->isFrozen && rec->recordSize == recordSize &&
+	   rec->capacity == capacity && rec->index < capacity){
+		rec->resets++;
+		return SYS_OK;
+	}
+
+	rec->magic = 0;
+	rec->recordSize = recordSize;
+	rec->capacity = (uint16_t)capacity;
+	rec->resets = 0;
+	if(Recorder_Arm(rec, postTrigger) != SYS_OK)
+		return SYS_ERROR;
+	rec->magic = RECORDER_MAGIC;
+	return SYS_OK;
+}
+
+e_system Recorder_Arm(s_recorder *rec, uint16_t postTrigger){
+	if(postTrigger >= rec->capacity)
+		return SYS_ERROR;
+
+	// Primero se congela, así una grabación en curso no pisa el estado a medio armar
+	rec->isFrozen = TRUE;
+	rec->isTriggered = FALSE;
+	rec->cause = RECORDER_CAUSE_NONE;
+	rec->postTrigger = postTrigger;
+	rec->remaining = 0;
+	rec->index = 0;
+	rec->total = 0;
+	rec->triggerTotal = 0;
+	rec->lastCost = 0;
+	rec->maxCost = 0;
+	rec->isFrozen = FALSE;
+	return SYS_OK;
+}
+
+uint8_t *Recorder_Begin(s_recorder *rec){
+	if(rec->isFrozen)
+		return NULL;
+	if(Recorder_Get_Time != NULL)
+		rec->startTime = Recorder_Get_Time();
+	return &rec->buffer[(uint32_t)rec->index * rec->recordSize];
+}
+
+void Recorder_End(s_recorder *rec){
+	uint32_t cost;
+
+	if(rec->isFrozen)
+		return;
+	if(++rec->index >= rec->capacity)
+		rec->index = 0;
+	rec->total++;
+	if(rec->isTriggered && !--rec->remaining)
+		rec->isFrozen = TRUE;
+
+	if(Recorder_Get_Time != NULL){
+		cost = Recorder_Get_Time() - rec->startTime;
+		rec->lastCost = cost;
+		if(cost > rec->maxCost)
+			rec->maxCost = cost;
+	}
+}
+
+void Recorder_Trigger(s_recorder *rec, uint8_t cause){
+	if(rec->isTriggered || rec->isFrozen || cause == RECORDER_CAUSE_NONE)
+		return;
+
+	rec->cause = cause;
+	rec->triggerTotal = rec->total;
+	rec->remaining = rec->postTrigger;
+	// isTriggered al final: Recorder_End() no ve un disparo con remaining sin cargar
+	if(!rec->remaining)
+		rec->isFrozen = TRUE;
+	rec->isTriggered = TRUE;
+}
+
+void Recorder_Attach_TimeBase(uint32_t (*getTime)(void)){
+	Recorder_Get_Time = getTime;
+}
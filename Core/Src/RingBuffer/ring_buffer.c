@@ -0,0 +1,90 @@
+/*
+ * ring_buffer.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "RingBuffer/ring_buffer.h"
+#include <string.h>
+
+void RingBuffer_Init(s_ring *ring, uint8_t *buffer, uint32_t size){
+	ring->buffer = buffer;
+	ring->mask = size - 1;
+	ring->write = 0;
+	ring->read = 0;
+}
+
+void RingBuffer_Reset(s_ring *ring){
+	ring->write = 0;
+	ring->read = 0;
+}
+
+uint32_t RingBuffer_Push(s_ring *ring, const uint8_t *data, uint32_t len){
+	uint32_t write = ring->write;
+	uint32_t free = ring->mask + 1 - (write - __atomic_load_n(&ring->read, __ATOMIC_ACQUIRE));
+	uint32_t offset = write & ring->mask;
+	uint32_t first;
+
+	if(len > free)
+		len = free;
+
+	first = ring->mask + 1 - offset;
+	if(first > len)
+		first = len;
+
+	memcpy(&ring->buffer[offset], data, first);
+	memcpy(ring->buffer, data + first, len - first);
+
+	__atomic_store_n(&ring->write, write + len, __ATOMIC_RELEASE);
+	return len;
+}
+
+uint32_t RingBuffer_Pop(s_ring *ring, uint8_t *data, uint32_t len){
+	uint32_t read = ring->read;
+	uint32_t count = __atomic_load_n(&ring->write, __ATOMIC_ACQUIRE) - read;
+	uint32_t offset = read & ring->mask;
+	uint32_t first;
+
+	if(len > count)
+		len = count;
+
+	first = ring->mask + 1 - offset;
+	if(first > len)
+		first = len;
+
+	memcpy(data, &ring->buffer[offset], first);
+	memcpy(data + first, ring->buffer, len - first);
+
+	__atomic_store_n(&ring->read, read + len, __ATOMIC_RELEASE);
+	return len;
+}
+
+uint32_t RingBuffer_WriteSpan(s_ring *ring, uint8_t **span){
+	uint32_t write = ring->write;
+	uint32_t free = ring->mask + 1 - (write - __atomic_load_n(&ring->read, __ATOMIC_ACQUIRE));
+	uint32_t offset = write & ring->mask;
+
+	*span = &ring->buffer[offset];
+	if(free > ring->mask + 1 - offset)
+		free = ring->mask + 1 - offset;
+	return free;
+}
+
+void RingBuffer_CommitWrite(s_ring *ring, uint32_t len){
+	__atomic_store_n(&ring->write, ring->write + len, __ATOMIC_RELEASE);
+}
+
+uint32_t RingBuffer_ReadSpan(s_ring *ring, uint8_t **span){
+	uint32_t read = ring->read;
+	uint32_t count = __atomic_load_n(&ring->write, __ATOMIC_ACQUIRE) - read;
+	uint32_t offset = read & ring->mask;
+
+	*span = &ring->buffer[offset];
+	if(count > ring->mask + 1 - offset)
+		count = ring->mask + 1 - offset;
+	return count;
+}
+
+void RingBuffer_Consume(s_ring *ring, uint32_t len){
+	__atomic_store_n(&ring->read, ring->read + len, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,222 @@
+/*
+ * param_store.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "Storage/param_store.h"
+#include "CRC/crc.h"
+#include <string.h>
+
+#define PARAM_ERASED_WORD	0xFFFFFFFFUL
+#define PARAM_ALIGN(len)	(((uint32_t)(len) + 3) & ~3UL)
+
+/**
+ * @brief Lee una palabra del sector indicado.
+ */
+static uint32_t Param_Read_Word(s_paramStore *store, uint8_t sector, uint32_t offset){
+	uint32_t word;
+	memcpy(&word, store->flash->sector[sector] + offset, 4);
+	return word;
+}
+
+/**
+ * @brief Recorre el sector activo, arma el índice y ubica el final del registro.
+ */
+static void Param_Scan(s_paramStore *store){
+	uint32_t offset = PARAM_HEADER_SIZE, head, size, crc;
+	uint16_t key, len;
+	const uint8_t *base = store->flash->sector[store->active];
+
+	for(uint8_t i = 0; i < PARAM_MAX_KEYS; i++)
+		store->index[i] = 0;
+
+	while(offset + PARAM_RECORD_OVERHEAD <= store->flash->sectorSize){
+		head = Param_Read_Word(store, store->active, offset);
+		if(head == PARAM_ERASED_WORD)
+			break;													// Fin del registro
+
+		key = (uint16_t)head;
+		len = (uint16_t)(head >> 16);
+		size = PARAM_RECORD_OVERHEAD + PARAM_ALIGN(len);
+		if(len > PARAM_MAX_SIZE || offset + size > store->flash->sectorSize){
+			// Cabecera dañada: no se sabe dónde sigue, no se agrega más hasta compactar
+			store->corrupted++;
+			offset = store->flash->sectorSize;
+			break;
+		}
+
+		crc = CRC32C_Update(CRC32C_INIT, base + offset, 4 + len);
+		if(crc == Param_Read_Word(store, store->active, offset + size - 4) && key < PARAM_MAX_KEYS)
+			store->index[key] = len ? offset : 0;
+		else
+			store->corrupted++;
+		offset += size;
+	}
+	store->writeOffset = offset;
+}
+
+/**
+ * @brief Graba la cabecera del sector: primero la secuencia y al final la marca.
+ */
+static e_system Param_Write_Header(s_paramStore *store, uint8_t sector, uint32_t seq){
+	const uint8_t *base = store->flash->sector[sector];
+
+	if(store->flash->Program(base, seq) != SYS_OK)
+		return SYS_ERROR;
+	return store->flash->Program(base + 4, PARAM_MAGIC);
+}
+
+/**
+ * @brief Graba un registro completo en la posición indicada; el CRC va último.
+ */
+static e_system Param_Write_Record(s_paramStore *store, uint8_t sector, uint32_t offset,
+								   uint8_t key, const uint8_t *data, uint16_t len){
+	const uint8_t *address = store->flash->sector[sector] + offset;
+	uint32_t head = (uint32_t)key | ((uint32_t)len << 16);
+	uint32_t word, crc;
+
+	crc = CRC32C_Update(CRC32C_INIT, (const uint8_t*)&head, 4);
+	crc = CRC32C_Update(crc, data, len);
+
+	if(store->flash->Program(address, head) != SYS_OK)
+		return SYS_ERROR;
+	address += 4;
+	for(uint16_t i = 0; i < len; i += 4, address += 4){
+		word = PARAM_ERASED_WORD;
+		memcpy(&word, data + i, len - i < 4 ? len - i : 4);
+		if(store->flash->Program(address, word) != SYS_OK)
+			return SYS_ERROR;
+	}
+	return store->flash->Program(address, crc);
+}
+
+e_system Param_Init(s_paramStore *store, const s_paramFlash *flash){
+	uint8_t isValid[PARAM_SECTORS];
+	uint32_t seq[PARAM_SECTORS];
+
+	store->flash = flash;
+	store->compactions = 0;
+	store->corrupted = 0;
+	store->isInit = FALSE;
+
+	for(uint8_t s = 0; s < PARAM_SECTORS; s++){
+		seq[s] = Param_Read_Word(store, s, 0);
+		isValid[s] = Param_Read_Word(store, s, 4) == PARAM_MAGIC;
+	}
+
+	if(isValid[0] && isValid[1])
+		store->active = (int32_t)(seq[1] - seq[0]) > 0 ? 1 : 0;
+	else if(isValid[0] || isValid[1])
+		store->active = isValid[1] ? 1 : 0;
+	else{
+		// Flash virgen o ambos sectores dañados: formatea el primero
+		if(flash->Erase(0) != SYS_OK || Param_Write_Header(store, 0, 1) != SYS_OK)
+			return SYS_ERROR;
+		seq[0] = 1;
+		store->active = 0;
+	}
+	store->seq = seq[store->active];
+
+	Param_Scan(store);
+	store->isInit = TRUE;
+	return SYS_OK;
+}
+
+uint16_t Param_Get(s_paramStore *store, uint8_t key, void *data, uint16_t size){
+	uint32_t offset;
+	uint16_t len;
+
+	if(!store->isInit || key >= PARAM_MAX_KEYS || !store->index[key])
+		return 0;
+
+	offset = store->index[key];
+	len = (uint16_t)(Param_Read_Word(store, store->active, offset) >> 16);
+	memcpy(data, store->flash->sector[store->active] + offset + 4, len < size ? len : size);
+	return len;
+}
+
+/**
+ * @brief Guarda el valor de una clave; compacta sólo si canCompact, si no devuelve SYS_BUSY.
+ */
+static e_system Param_Write(s_paramStore *store, uint8_t key, const void *data, uint16_t len, uint8_t canCompact){
+	uint32_t offset, size = PARAM_RECORD_OVERHEAD + PARAM_ALIGN(len);
+
+	if(!store->isInit || key >= PARAM_MAX_KEYS || len > PARAM_MAX_SIZE)
+		return SYS_ERROR;
+
+	// Sin cambios no se graba: cuida la flash
+	offset = store->index[key];
+	if(offset){
+		if((uint16_t)(Param_Read_Word(store, store->active, offset) >> 16) == len &&
+		   !memcmp(store->flash->sector[store->active] + offset + 4, data, len))
+			return SYS_OK;
+	}else if(!len){
+		return SYS_OK;
+	}
+
+	if(store->writeOffset + size > store->flash->sectorSize){
+		if(!canCompact)
+			return SYS_BUSY;
+		if(Param_Compact(store) != SYS_OK || store->writeOffset + size > store->flash->sectorSize)
+			return SYS_ERROR;
+	}
+
+	offset = store->writeOffset;
+	store->writeOffset += size;								// Aunque falle, ese lugar ya no está borrado
+	if(Param_Write_Record(store, store->active, offset, key, data, len) != SYS_OK)
+		return SYS_ERROR;
+	store->index[key] = len ? offset : 0;
+	return SYS_OK;
+}
+
+e_system Param_Set(s_paramStore *store, uint8_t key, const void *data, uint16_t len){
+	return Param_Write(store, key, data, len, TRUE);
+}
+
+e_system Param_Try_Set(s_paramStore *store, uint8_t key, const void *data, uint16_t len){
+	return Param_Write(store, key, data, len, FALSE);
+}
+
+e_system Param_Compact(s_paramStore *store){
+	uint8_t next = store->active ^ 1;
+	uint32_t offset = PARAM_HEADER_SIZE, size, word;
+	uint32_t index[PARAM_MAX_KEYS];
+	const uint8_t *src;
+
+	if(!store->isInit || store->flash->Erase(next) != SYS_OK)
+		return SYS_ERROR;
+
+	// Copia tal cual los registros vigentes, con su CRC
+	for(uint8_t key = 0; key < PARAM_MAX_KEYS; key++){
+		index[key] = 0;
+		if(!store->index[key])
+			continue;
+		src = store->flash->sector[store->active] + store->index[key];
+		memcpy(&word, src, 4);
+		size = PARAM_RECORD_OVERHEAD + PARAM_ALIGN(word >> 16);
+		for(uint32_t i = 0; i < size; i += 4){
+			memcpy(&word, src + i, 4);
+			if(store->flash->Program(store->flash->sector[next] + offset + i, word) != SYS_OK)
+				return SYS_ERROR;
+		}
+		index[key] = offset;
+		offset += size;
+	}
+
+	if(Param_Write_Header(store, next, store->seq + 1) != SYS_OK)
+		return SYS_ERROR;
+
+	store->active = next;
+	store->seq++;
+	store->writeOffset = offset;
+	memcpy(store->index, index, sizeof(index));
+	store->compactions++;
+	return SYS_OK;
+}
+
+uint32_t Param_Free(s_paramStore *store){
+	if(!store->isInit || store->writeOffset + PARAM_RECORD_OVERHEAD > store->flash->sectorSize)
+		return 0;
+	return store->flash->sectorSize - store->writeOffset - PARAM_RECORD_OVERHEAD;
+}
@@ -0,0 +1,169 @@
+/*
+ * telemetry.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "Telemetry/telemetry.h"
+#include <string.h>
+
+/**
+ * @brief Arma la trama TELEMETRY con las muestras acumuladas del canal y la publica.
+ */
+static void Telemetry_Flush(uint8_t channel);
+
+/**
+ * @brief Agrega al batch la muestra comprimida con delta zigzag + varint.
+ *
+ * @return Cantidad de bytes escritos.
+ */
+static uint8_t Telemetry_Encode(s_tlmChannel *ch, const uint8_t *sample);
+
+static s_tlmChannel channels[TLM_NUM_CHANNELS];
+
+static s_commData *target = NULL;
+
+static uint8_t activeMask = 0;
+
+static uint8_t rateDivisor = 1;
+
+static uint8_t isTimed = FALSE;
+
+e_system Telemetry_Add_Channel(uint8_t channel, uint8_t sampleSize, uint8_t maxBatch){
+	if(channel >= TLM_NUM_CHANNELS || !sampleSize || sampleSize > TLM_MAX_SAMPLES_SIZE || !maxBatch)
+		return SYS_ERROR;
+
+	if(maxBatch > TLM_MAX_SAMPLES_SIZE / sampleSize)
+		maxBatch = TLM_MAX_SAMPLES_SIZE / sampleSize;
+
+	channels[channel].sampleSize = sampleSize;
+	channels[channel].maxBatch = maxBatch;
+	channels[channel].count = 0;
+	channels[channel].length = 0;
+	channels[channel].divider = 0;
+	channels[channel].seq = 0;
+	channels[channel].isDelta = FALSE;
+	return SYS_OK;
+}
+
+void Telemetry_Subscribe(s_commData *comm, uint8_t mask, uint8_t divisor, uint8_t flags){
+	// Se deshabilita todo antes de tocar los canales para que ninguna interrupción agregue
+	// muestras a un canal a medio reiniciar
+	__atomic_store_n(&activeMask, 0, __ATOMIC_RELEASE);
+
+	for(uint8_t channel = 0; channel < TLM_NUM_CHANNELS; channel++){
+		s_tlmChannel *ch = &channels[channel];
+
+		ch->count = 0;
+		ch->length = 0;
+		ch->divider = 0;
+		ch->seq = 0;
+		ch->forceKey = TRUE;
+		// Sólo se comprimen muestras formadas por palabras de 16 bits
+		ch->isDelta = (flags & TLM_FLAG_DELTA) && !(ch->sampleSize & 1) && ch->sampleSize <= TLM_MAX_DELTA_SAMPLE;
+		if(!ch->sampleSize)
+			mask &= ~(1U << channel);
+	}
+
+	target = comm;
+	rateDivisor = divisor ? divisor : 1;
+	isTimed = (flags & TLM_FLAG_TIME) != 0;
+
+	if(comm != NULL)
+		__atomic_store_n(&activeMask, mask, __ATOMIC_RELEASE);
+}
+
+uint8_t Telemetry_Is_Active(uint8_t channel){
+	return (__atomic_load_n(&activeMask, __ATOMIC_ACQUIRE) >> channel) & 1;
+}
+
+void Telemetry_Push(uint8_t channel, const uint8_t *sample){
+	s_tlmChannel *ch;
+
+	if(channel >= TLM_NUM_CHANNELS || !Telemetry_Is_Active(channel))
+		return;
+
+	ch = &channels[channel];
+	if(ch->divider){
+		ch->divider--;
+		return;
+	}
+	ch->divider = rateDivisor - 1;
+
+	if(isTimed){
+		ch->lastTime = Comm_Micros();
+		if(!ch->count)
+			ch->firstTime = ch->lastTime;
+	}
+
+	if(!ch->isDelta){
+		memcpy(&ch->batch[ch->length], sample, ch->sampleSize);
+		ch->length += ch->sampleSize;
+		ch->count++;
+		if(ch->count >= ch->maxBatch)
+			Telemetry_Flush(channel);
+		return;
+	}
+
+	if(!ch->count){
+		ch->isKey = ch->forceKey || !(ch->seq % TLM_KEYFRAME_PERIOD);
+		ch->forceKey = FALSE;
+		if(ch->isKey)
+			memset(ch->last, 0, sizeof(ch->last));
+	}
+
+	ch->length += Telemetry_Encode(ch, sample);
+	ch->count++;
+	// Cada palabra ocupa como máximo 3 bytes codificada
+	if(ch->count >= ch->maxBatch || TLM_MAX_SAMPLES_SIZE - ch->length < ch->sampleSize / 2 * 3)
+		Telemetry_Flush(channel);
+}
+
+static void Telemetry_Flush(uint8_t channel){
+	s_tlmChannel *ch = &channels[channel];
+	uint8_t id = channel;
+	s_frame frame;
+
+	if(ch->isDelta)
+		id |= TLM_CHANNEL_DELTA | (ch->isKey ? TLM_CHANNEL_KEY : 0);
+	if(isTimed)
+		id |= TLM_CHANNEL_TIME;
+
+	if(comm_reserveUntagged(target, &frame, TELEMETRY, TLM_HEADER_SIZE + (isTimed ? TLM_TIME_SIZE : 0) + ch->length)){
+		comm_put_u8(&frame, id);
+		comm_put_u16(&frame, ch->seq);
+		comm_put_u8(&frame, ch->count);
+		if(isTimed){
+			comm_put_u32(&frame, ch->firstTime);
+			comm_put_u32(&frame, ch->lastTime);
+		}
+		comm_put_bytes(&frame, ch->batch, ch->length);
+		comm_commitFrame(target, &frame);
+	}else{
+		ch->forceKey = TRUE;										// La PC perdió la referencia
+	}
+	ch->seq++;
+	ch->count = 0;
+	ch->length = 0;
+}
+
+static uint8_t Telemetry_Encode(s_tlmChannel *ch, const uint8_t *sample){
+	uint8_t *out = &ch->batch[ch->length];
+	uint8_t written = 0;
+	int16_t value, delta;
+	uint16_t zigzag;
+
+	for(uint8_t word = 0; word < ch->sampleSize / 2; word++){
+		value = (int16_t)(sample[2 * word] | (sample[2 * word + 1] << 8));
+		delta = (int16_t)(value - ch->last[word]);					// Módulo 2^16, igual que en la PC
+		ch->last[word] = value;
+
+		zigzag = ((uint16_t)delta << 1) ^ (uint16_t)(delta >> 15);
+		while(zigzag >= 0x80){
+			out[written++] = (uint8_t)zigzag | 0x80;
+			zigzag >>= 7;
+		}
+		out[written++] = (uint8_t)zigzag;
+	}
+	return written;
+}
@@ -6,6 +6,7 @@
 #define DEMOSTRACION_REGULARIZACION
 
 #include "WiFi/ESP01.h"
+#include "RingBuffer/ring_buffer.h"
 #include <stddef.h>
 #include <string.h>
 #include <stdlib.h>
@@ -81,12 +82,8 @@ static char esp01LocalPORT[6] = {0};
 
 static uint8_t esp01HState = 0;
 static uint16_t	esp01nBytes = 0;
-static uint8_t esp01RXATBuf[ESP01RXBUFAT];
-static uint8_t esp01TXATBuf[ESP01TXBUFAT];
-static uint16_t	esp01iwRXAT = 0;
-static uint16_t	esp01irRXAT = 0;
-static uint16_t esp01irTX = 0;
-static uint16_t esp01iwTX = 0;
+RINGBUFFER_DEFINE(static, esp01RXAT, ESP01RXBUFAT);
+RINGBUFFER_DEFINE(static, esp01TXAT, ESP01TXBUFAT);
 
 static uint8_t esp01TriesAT = 0;
 
@@ -282,9 +279,7 @@ _eESP01STATUS ESP01_StateUDPTCP(){
 void ESP01_WriteRX(uint8_t value){
 //	if(esp01Handle.bufRX == NULL)
 //		return;
-	esp01RXATBuf[esp01iwRXAT++] = value;
-	if(esp01iwRXAT == ESP01RXBUFAT)
-		esp01iwRXAT = 0;
+	RingBuffer_PushByte(&esp01RXAT, value);
 }
 
 _eESP01STATUS ESP01_Send(uint8_t *buf, uint16_t irRingBuf, uint16_t length, uint16_t sizeRingBuf){
@@ -302,15 +297,17 @@ _eESP01STATUS ESP01_Send(uint8_t *buf, uint16_t irRingBuf, uint16_t length, uint
 		l = strlen(strInt);
 		if(l>4 || l==0)
 			return ESP01_SEND_ERROR;
+		// Todo o nada: un comando a medio encolar desincroniza al ESP01
+		if(RingBuffer_Free(&esp01TXAT) < sizeof(ATCIPSEND) - 1 + l + 2 + length)
+			return ESP01_SEND_ERROR;
 		ESP01StrToBufTX(ATCIPSEND);
 		ESP01StrToBufTX(strInt);
 		ESP01StrToBufTX("\r>");
-		for(uint16_t i=0; i<length; i++){
-			esp01TXATBuf[esp01iwTX++] = buf[irRingBuf++];
-			if(esp01iwTX == ESP01TXBUFAT)
-				esp01iwTX = 0;
-			if(irRingBuf == sizeRingBuf)
-				irRingBuf = 0;
+		if(irRingBuf + length > sizeRingBuf){
+			RingBuffer_Push(&esp01TXAT, &buf[irRingBuf], sizeRingBuf - irRingBuf);
+			RingBuffer_Push(&esp01TXAT, buf, length - (sizeRingBuf - irRingBuf));
+		}else{
+			RingBuffer_Push(&esp01TXAT, &buf[irRingBuf], length);
 		}
 		esp01Flags.bit.TXCIPSEND = 1;
 		esp01Flags.bit.SENDINGDATA = 1;
@@ -326,6 +323,13 @@ _eESP01STATUS ESP01_Send(uint8_t *buf, uint16_t irRingBuf, uint16_t length, uint
 	return ESP01_SEND_BUSY;
 }
 
+uint16_t ESP01_Send_Max(){
+	uint32_t free = RingBuffer_Free(&esp01TXAT);
+
+	if(free <= ESP01_SEND_PREFIX)
+		return 0;
+	return free - ESP01_SEND_PREFIX;
+}
 
 void ESP01_Init(_sESP01Handle *hESP01){
 
@@ -333,10 +337,8 @@ void ESP01_Init(_sESP01Handle *hESP01){
 
 	esp01ATState = ESP01ATIDLE;
 	esp01HState = 0;
-	esp01irTX = 0;
-	esp01iwTX = 0;
-	esp01irRXAT = 0;
-	esp01iwRXAT = 0;
+	RingBuffer_Reset(&esp01TXAT);
+	RingBuffer_Reset(&esp01RXAT);
 	esp01Flags.byte = 0;
 	ESP01ChangeState = NULL;
 	ESP01DbgStr = NULL;
@@ -358,7 +360,7 @@ void ESP01_Timeout10ms(){
 }
 
 void ESP01_Task(){
-	if(esp01irRXAT != esp01iwRXAT)
+	if(RingBuffer_Count(&esp01RXAT))
 		ESP01ATDecode();
 
 	if(!esp01TimeoutTask)
@@ -383,17 +385,18 @@ int ESP01_IsHDRRST(){
 
 /* Private Functions */
 static void ESP01ATDecode(){
-	uint16_t i;
+	uint32_t i;
+	uint32_t esp01irRXAT = esp01RXAT.read;
 	uint8_t value;
 	if(esp01ATState==ESP01ATHARDRST0 || esp01ATState==ESP01ATHARDRST1 ||
 	   esp01ATState==ESP01ATHARDRSTSTOP){
-		esp01irRXAT = esp01iwRXAT;
+		RingBuffer_Consume(&esp01RXAT, RingBuffer_Count(&esp01RXAT));
 		return;
 	}
-	i = esp01iwRXAT;
+	i = esp01irRXAT + RingBuffer_Count(&esp01RXAT);
 	esp01TimeoutDataRx = 2;
 	while(esp01irRXAT != i){
-		value = esp01RXATBuf[esp01irRXAT];
+		value = RingBuffer_At(&esp01RXAT, esp01irRXAT);
 		switch(esp01HState){
 		case 0:
             indexResponse = 0;
@@ -474,7 +477,7 @@ static void ESP01ATDecode(){
 					if(esp01Flags.bit.SENDINGDATA){
 						esp01Flags.bit.SENDINGDATA = 0;
 						esp01Flags.bit.UDPTCPCONNECTED = 0;
-						esp01irTX = esp01iwTX;
+						RingBuffer_Consume(&esp01TXAT, RingBuffer_Count(&esp01TXAT));
 					}
 					break;
 				case 4://WIFI GOT IP
@@ -620,7 +623,7 @@ static void ESP01ATDecode(){
 		case 13:
 			if(esp01ATState == ESP01_WAITING_CONNECTION){
 				esp01userConnected = 1;
-				esp01Link = esp01RXATBuf[esp01irRXAT-16];
+				esp01Link = RingBuffer_At(&esp01RXAT, esp01irRXAT-16);
 				if(ESP01DbgStr != NULL){
 					ESP01DbgStr("+&DBGLINKED");
 					ESP01DbgStr(&esp01Link);
@@ -628,7 +631,7 @@ static void ESP01ATDecode(){
 			}
 			if(esp01ATState == ESP01ATWAITSERVERDATA){
 				esp01userConnected = 1;
-				esp01Link = esp01RXATBuf[esp01irRXAT-16];
+				esp01Link = RingBuffer_At(&esp01RXAT, esp01irRXAT-16);
 				if(ESP01DbgStr != NULL){
 					ESP01DbgStr("+&DBGLINKED");
 					ESP01DbgStr(&esp01Link);
@@ -711,9 +714,8 @@ static void ESP01ATDecode(){
 		}
 
 		esp01irRXAT++;
-		if(esp01irRXAT == ESP01RXBUFAT)
-			esp01irRXAT = 0;
 	}
+	RingBuffer_Consume(&esp01RXAT, esp01irRXAT - esp01RXAT.read);
 }
 
 _emode ESP01_GETMODE(){
@@ -1038,46 +1040,38 @@ static void ESP01SENDData(){
 	uint8_t value;
 	if(esp01Flags.bit.WAITINGSYMBOL){
 		if(!esp01TimeoutTxSymbol){
-			esp01irTX = esp01iwTX;
+			RingBuffer_Consume(&esp01TXAT, RingBuffer_Count(&esp01TXAT));
 			esp01Flags.bit.WAITINGSYMBOL = 0;
 			esp01ATState = ESP01ATAT;
 			esp01TimeoutTask = 10;
 		}
 		return;
 	}
-	if(esp01irTX != esp01iwTX){
-		value = esp01TXATBuf[esp01irTX];
+	if(RingBuffer_Count(&esp01TXAT)){
+		value = RingBuffer_At(&esp01TXAT, esp01TXAT.read);
 		if(esp01Flags.bit.TXCIPSEND){
 			if(value == '>')
 				value = '\n';
 		}
 		if(esp01Handle.WriteUSARTByte(value)){
 			if(esp01Flags.bit.TXCIPSEND){
-				if(esp01TXATBuf[esp01irTX] == '>'){
+				if(RingBuffer_At(&esp01TXAT, esp01TXAT.read) == '>'){
 					esp01Flags.bit.TXCIPSEND = 0;
 					esp01Flags.bit.WAITINGSYMBOL = 1;
 					esp01TimeoutTxSymbol = 5;
 				}
 			}
-			esp01irTX++;
-			if(esp01irTX == ESP01TXBUFAT)
-				esp01irTX = 0;
+			RingBuffer_Consume(&esp01TXAT, 1);
 		}
 	}
 }
 
 static void ESP01StrToBufTX(const char *str){
-	for(int i=0; str[i]; i++){
-		esp01TXATBuf[esp01iwTX++] = str[i];
-		if(esp01iwTX == ESP01TXBUFAT)
-			esp01iwTX = 0;
-	}
+	RingBuffer_Push(&esp01TXAT, (const uint8_t *)str, strlen(str));
 }
 
 static void ESP01ByteToBufTX(uint8_t value){
-	esp01TXATBuf[esp01iwTX++] = value;
-	if(esp01iwTX == ESP01TXBUFAT)
-		esp01iwTX = 0;
+	RingBuffer_PushByte(&esp01TXAT, value);
 }
 
 static int is_valid_ip(const char* ip) {
@@ -31,6 +31,12 @@
 #include "Motors/encoder.h"
 #include "I2C/OLED/display.h"
 #include "I2C/MPU6050/mpu6050.h"
+#include "Telemetry/telemetry.h"
+#include "Estimators/kalman.h"
+#include "Estimators/ahrs.h"
+#include "Storage/param_store.h"
+#include "Recorder/recorder.h"
+#include "Control/pid.h"
 
 #include "WiFi/ESP01.h"
 /* USER CODE END Includes */
@@ -40,7 +46,8 @@
 typedef enum{
 	IDLE,
 	FOLLOW_LINE,
-	GO_FROM_TO
+	GO_FROM_TO,
+	STAND			//< En equilibrio en el lugar
 }e_Car_state;
 
 typedef enum{
@@ -48,6 +55,59 @@ typedef enum{
 	MENU,
 	INPUTS
 }e_Disp_state;
+
+/* Canales de telemetría, el bit n de la máscara de SUBSCRIBE habilita el canal n */
+typedef enum{
+	TLM_ADC,		//< Analog.value[], 4kHz
+	TLM_IMU,		//< MPU6050.Acc y Gyro, 1kHz
+	TLM_ENCODER,	//< EncoderL/R.pps, 100Hz
+	TLM_MOTOR,		//< MotorL/R.vel, 100Hz
+	TLM_IMU_RAW		//< Trama cruda del MPU6050 como la entrega el sensor, 1kHz; para reprocesarla en la PC
+}e_Tlm_channel;
+
+/* Regiones de memoria que la PC puede leer con BULKREAD */
+typedef enum{
+	BULK_FRAMEBUFFER,	//< Framebuffer del display
+	BULK_MPU6050,		//< Estructura del MPU6050, incluye offsets de calibración
+	BULK_ANALOG,		//< Valores crudos y filtrados del ADC
+	BULK_RECORDER		//< Registrador de vuelo: s_recorder seguido de los registros
+}e_Bulk_region;
+
+/* Claves del almacén de parámetros en flash; no reordenar, quedan grabadas */
+typedef enum{
+	PARAM_MPU_OFFSETS,	//< Offsets del MPU6050, Acc x,y,z y Gyro x,y,z
+	PARAM_WIFI,			//< Credenciales WiFi "ssid\0password", sin terminador final
+	PARAM_IMU_CONFIG,	//< Rango del acelerómetro y del giróscopo, DLPF y divisor del MPU6050
+	PARAM_PID_GAINS		//< Ganancias de los lazos de inclinación, velocidad y giro, s_pidGains[3]
+}e_Param_key;
+
+/* Causas de disparo del registrador de vuelo */
+typedef enum{
+	REC_CAUSE_TILT = 1,	//< Pitch o roll fuera del límite de inclinación
+	REC_CAUSE_ERROR,	//< Se envió un SYSERROR
+	REC_CAUSE_COMMAND	//< Pedido de la PC con RECORDER
+}e_Rec_cause;
+
+/* Operaciones del comando RECORDER, primer byte del payload; sin payload sólo responde el estado */
+typedef enum{
+	REC_OP_STATUS,		//< Sólo el estado
+	REC_OP_TRIGGER,		//< Dispara con REC_CAUSE_COMMAND
+	REC_OP_ARM			//< Borra y vuelve a armar | postTrigger (u16) | tiltLimit (u16), ambos opcionales
+}e_Rec_op;
+
+/* Registro del registrador de vuelo: el estado de un paso de control, 48 bytes */
+typedef struct __attribute__((packed)){
+	uint32_t time;					//< Microsegundos, SysTick_Get_Micros()
+	int16_t acc[3];					//< MPU6050.Acc, promediado y sin offset
+	int16_t gyro[3];				//< Giróscopo sin promediar y sin offset, el que usan los estimadores
+	int16_t angle[3];				//< Pitch, roll y rumbo, centésimas de grado
+	uint8_t adc[(ADC_NUM_SENSORS * 3 + 1) / 2];	//< Analog.value[] de 12 bits, de a dos en 3 bytes: a | b << 12
+	uint16_t pps[2];				//< EncoderL/R.pps
+	int16_t vel[2];					//< MotorL/R.vel
+	int16_t temperature;			//< Centésimas de grado
+	uint8_t flags;					//< REC_FLAG_*
+	uint8_t reserved;
+}s_flightRecord;
 /* USER CODE END PTD */
 
 /* Private define ------------------------------------------------------------*/
@@ -58,8 +118,35 @@ typedef enum{
 
 #define ENCODER_FASTPPS_COUNTER_10MS			10 //< Toma el valor de los encoders cada 100ms
 
-#define RXBUF									data->Rx.buffer
-#define RXCMD									data->indexStart+POSID
+#define TIM1_TICK_US							250 //< Período de TIM1, 4kHz
+#define MPU_READ_PERIOD_TICKS					4 	//< Vigilancia de data-ready cada 1ms, con TIM1 a 4kHz; la lectura directa sigue al período de muestreo
+#define MPU_FIFO_PERIOD_TICKS					20 	//< Vaciado de la FIFO del MPU6050 cada 5ms, unas 5 muestras
+#ifndef MPU_USE_DATA_READY
+#define MPU_USE_DATA_READY						0 	//< En 1 la lectura la dispara el pin INT del MPU6050 (PB14); sin probar en el robot, por defecto la FIFO
+#endif
+
+#define PARAM_FLASH_SECTOR_A					FLASH_SECTOR_6	//< Almacén de parámetros: sectores 6 y 7, fuera de FLASH en el .ld
+#define PARAM_FLASH_ADDR_A						0x08040000
+#define PARAM_FLASH_ADDR_B						0x08060000
+#define PARAM_FLASH_SECTOR_SIZE					0x20000 	//< 128K cada uno
+
+#define TLM_ADC_BATCH							8 	//< Muestras por trama: 2ms de ADC
+#define TLM_IMU_BATCH							8 	//< Muestras por trama: 8ms de IMU
+#define TLM_SLOW_BATCH							4 	//< Muestras por trama: 40ms de encoders y motores
+
+#define CONTROL_PERIOD_US						10000 	//< Lazos de velocidad y giro cada 10ms
+#define CONTROL_FALL_CDEG						4000 	//< Con más inclinación se da por caído y se cortan los motores
+#define CONTROL_TILT_REF_MAX					8.0f 	//< Inclinación máxima que pide el lazo de velocidad, grados
+#define CONTROL_TURN_MAX						30.0f 	//< PWM diferencial máximo del lazo de giro, %
+#define CONTROL_TILT_DCUTOFF_HZ					40.0f 	//< Pasabajos de la derivada del lazo de inclinación
+
+#define REC_NUM_RECORDS							1024 	//< Registros del registrador de vuelo: 1s de control a 1kHz, 48K de RAM
+#define REC_POST_TRIGGER						256 	//< Registros que se graban después del disparo
+#define REC_TILT_LIMIT_CDEG						4500 	//< Disparo por inclinación, centésimas de grado; 0 lo deshabilita
+
+#define REC_FLAG_CALIBRATED						0x01 	//< Offsets del MPU6050 válidos, los ángulos también
+#define REC_FLAG_STILL							0x02 	//< El AHRS considera al robot quieto
+#define REC_FLAG_THERMAL						0x04 	//< Sesgo del giróscopo compensado por temperatura
 
 #define IS10MS									generalFlags.bit.b0
 #define IS5MS									generalFlags.bit.b1
@@ -86,9 +173,9 @@ UART_HandleTypeDef huart1;
 /* USER CODE BEGIN PV */
 u_flag generalFlags;
 
-uint8_t is100ms1 = 10, is1s = 10, is5ms = 20, is20s = 10;
-
-u_conv decom;
+uint8_t is100ms1 = 10, is1s = 10, is20s = 10;
+uint16_t isMpuRead = MPU_READ_PERIOD_TICKS;
+uint32_t mpuReadRemainder = 0;				//< Fracción de tick que le falta a la lectura directa para el período de muestreo, us
 
 uint8_t key;
 
@@ -98,6 +185,31 @@ s_encoder EncoderL, EncoderR;
 
 s_MPU MPU6050;
 
+s_kalman PitchFilter;
+
+s_ahrs Attitude;
+
+s_paramStore Params;
+
+s_pidLoop TiltLoop;			//< Pitch -> PWM, con cada muestra del MPU6050
+s_pidLoop SpeedLoop;		//< Velocidad de avance -> inclinación de referencia, cada 10ms
+s_pidLoop SteerLoop;		//< Diferencia de velocidad entre ruedas -> PWM diferencial, cada 10ms
+
+uint8_t isMpuOffsetStored = FALSE;
+uint8_t isParamCompactFailed = FALSE;		//< No se reintenta compactar hasta el próximo arranque
+uint8_t isPidGainsDirty = FALSE;			//< Ganancias cambiadas con SETPID y todavía no guardadas
+volatile uint8_t isMpuDrdyLost = FALSE;		//< No llegan interrupciones de data-ready: se volvió a leer por TIM1
+uint8_t imuConfigChanges = 0;
+
+/* Sin inicializar en el arranque para conservar un registro congelado después de un reset.
+ * Estado y registros juntos: la PC los lee con un solo BULKREAD */
+struct{
+	s_recorder state;
+	uint8_t records[REC_NUM_RECORDS * sizeof(s_flightRecord)];
+}FlightRecorder __attribute__((section(".noinit")));
+
+uint16_t recTiltLimit = REC_TILT_LIMIT_CDEG;
+
 struct{
 	uint8_t isInit;
 	uint8_t buffer[SSD1306_WIDTH * SSD1306_HEIGHT / 8];
@@ -118,21 +230,25 @@ struct{
 
 struct USB_DATA{
 	s_commData data;
-	uint8_t bytesToTx;
 }USB;
 
 struct ESP_DATA{
 	_sESP01Handle Config;
 	char *ssid;
 	char *password;
+	char credentials[96];
 	char *IP;
 	s_commData data;
 	uint8_t AT_Rx_data;
-	uint8_t bytesToTx;
+	uint16_t bytesToTx;
 }ESP;
 
 struct CAR_DATA{
 	e_Car_state state;
+	int32_t speedRef;		//< Velocidad de avance pedida, Q16 pulsos/s
+	int32_t turnRef;		//< Diferencia de velocidad pedida entre rueda izquierda y derecha, Q16 pulsos/s
+	int32_t tiltRef;		//< Inclinación que pide el lazo de velocidad, Q16 grados
+	int32_t turn;			//< PWM diferencial del lazo de giro, Q16 %
 }Car;
 
 uint8_t	dataRx;
@@ -152,6 +268,9 @@ void Init_Timing();
 void Init_MPU6050();
 void Init_Display();
 void Init_WiFi();
+void Init_Params();
+void Init_Recorder();
+void Init_Control();
 /* HAL FUNCTIONS */
 void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim);
 
@@ -165,12 +284,9 @@ void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin);
 /* END HAL FUNCTIONS */
 
 /**
-* @brief esta funcion se llama desde la librería "protocol_handler" y
-* ejecuta una acción según el comando decodificado
-*
-* @param data puntero a la estructura de datos de comunicación
+* @brief Registra en el protocolo los handlers de los comandos de cada módulo
 */
-void decodeOn_USB(s_commData *data);
+void Init_Commands();
 
 /**
  * @brief Funcion llamada automaticamente al haber un cambio de estado en user key, simula una interrupción
@@ -179,6 +295,43 @@ void decodeOn_USB(s_commData *data);
  */
 void onKeyChangeState(e_Estados value);
 
+/**
+ * @brief Actualiza el pitch y la actitud con la última muestra; llamar con cada muestra nueva del MPU6050
+ */
+void IMU_Update_Angles();
+
+/**
+ * @brief Pasa a los estimadores la escala y el período de la configuración vigente del MPU6050
+ */
+void IMU_Apply_Config();
+
+/**
+ * @brief Graba el paso de control en el registrador de vuelo y lo dispara si la inclinación supera el límite
+ */
+void Flight_Record();
+
+/**
+ * @brief Funcion llamada por el protocolo al enviar un SYSERROR, dispara el registrador de vuelo
+ */
+void onCommError();
+
+/**
+ * @brief Cambia el estado del auto; al salir de IDLE arranca los lazos sin historia y al volver corta los motores
+ *
+ * @param state Estado nuevo
+ */
+void Car_Set_State(e_Car_state state);
+
+/**
+ * @brief Lazo de inclinación: con cada muestra del MPU6050 lleva el pitch a la referencia y actualiza los motores
+ */
+void Balance_Update();
+
+/**
+ * @brief Lazos de velocidad y giro: cada 10ms fijan la inclinación de referencia y el PWM diferencial
+ */
+void Cruise_Update();
+
 /************************************ FUNCIONES PARA ABSTRACCIÓN DE HARDWARE ************************************/
 
 /**
@@ -202,20 +355,31 @@ uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len);
 
 /**
  * @brief esta funcion se llama desde la librería "protocol_handler" y
- * envía un bloque de datos a la librería USB
+ * arranca la transmisión USB si estaba detenida
  *
  * @param data puntero a la estructura de datos de comunicación
  */
 void writeOn_USB(s_commData *data);
 
+/**
+ * @brief esta funcion se llama desde la librería USB, también desde la interrupción de fin
+ * de transferencia, y copia los datos pendientes de "protocol_handler" a su buffer
+ *
+ * @param buff buffer de transmisión USB
+ * @param size tamaño del buffer
+ * @retval cantidad de bytes copiados
+ */
+uint16_t dataTxOn_USB(uint8_t *buff, uint16_t size);
+
 /**
  * @brief esta funcion se llama desde la librería USB y
  * envía un bloque de datos a la librería "protocol_handler"
  *
  * @param buff recibe un puntero al buffer de datos recibidos
  * @param len tamaño del buffer
+ * @retval TRUE si entra otro paquete en el buffer de recepción, FALSE para pausar la recepción
  */
-void dataRxOn_USB(uint8_t *buff, uint32_t len);
+uint8_t dataRxOn_USB(uint8_t *buff, uint32_t len);
 
 /**
  * @brief abstracción de hardware para setear el valor de PMW del motor izquierdo
@@ -259,6 +423,19 @@ void Motor_Right_SetPins(uint8_t pinA, uint8_t pinB);
  */
 e_system I2C1_DMA_Mem_Write(uint16_t Dev_Address, uint8_t reg, uint8_t *p_Data, uint16_t _Size);
 
+/**
+ * @brief abstracción de hardware de la función HAL_I2C_Mem_Read_DMA()
+ * 		Read an amount of data in non-blocking mode with DMA from a specific memory address
+ *
+ * @param  DevAddress Target device address: The device 7 bits address value
+ *         in datasheet must be shifted to the left before calling the interface
+ * @param  MemAddress Internal memory address
+ * @param  pData Pointer to data buffer
+ * @param  Size Amount of data to be read
+ * @retval HAL status
+ */
+e_system I2C1_DMA_Mem_Read(uint16_t Dev_Address, uint8_t reg, uint8_t *p_Data, uint16_t _Size);
+
 /**
   * @brief abstracción de hardware de la función HAL_I2C_Master_Transmit()
   * 		Transmits in master mode an amount of data in blocking mode.
@@ -317,6 +494,36 @@ void onESP01Debug(const char *dbgStr);
 void setESP01_CHPD(uint8_t val);
 
 void writeOn_ESP(s_commData *data);
+
+/**
+ * @brief Borra un sector del almacén de parámetros
+ *
+ * @param sector: 0 para el sector 6, 1 para el sector 7
+ */
+e_system Flash_Param_Erase(uint8_t sector);
+
+/**
+ * @brief Graba una palabra en el almacén de parámetros
+ */
+e_system Flash_Param_Program(const uint8_t *address, uint32_t word);
+
+const s_paramFlash ParamFlash = {
+	.sector = {(const uint8_t*)PARAM_FLASH_ADDR_A, (const uint8_t*)PARAM_FLASH_ADDR_B},
+	.sectorSize = PARAM_FLASH_SECTOR_SIZE,
+	.Erase = &Flash_Param_Erase,
+	.Program = &Flash_Param_Program
+};
+
+/**
+ * @brief Devuelve el contador de ciclos de CPU, base de tiempo de las estadísticas de comandos
+ */
+uint32_t DWT_Get_Cycles();
+
+/**
+ * @brief Devuelve el tiempo desde el arranque en microsegundos, armado con el tick de HAL
+ * y el valor actual del SysTick. Se usa como reloj de TIMESYNC y de la telemetría.
+ */
+uint32_t SysTick_Get_Micros();
 /************************************ FIN FUNCIONES PARA ABSTRACCIÓN DE HARDWARE ************************************/
 /* USER CODE END PFP */
 
@@ -357,16 +564,17 @@ void OLED_Print_Data_Task(){
 			}
 
 			if(MPU6050.isInit){
-				MPU6050.Acc.x = (MPU6050.Acc.x / 16384.0) * 9.8f;
-				MPU6050.Acc.y = (MPU6050.Acc.y / 16384.0) * 9.8f;
-				MPU6050.Acc.z = (MPU6050.Acc.z / 16384.0) * 9.8f;
-				sprintf((char*)Display.auxString, "Ax:%d", MPU6050.Acc.x);
+				// m/s² con la escala del rango vigente, sin pisar las lecturas
+				int32_t acc[3] = {(int32_t)(((int64_t)MPU6050.Acc.x * MPU6050.Config.accScale) >> 24),
+								  (int32_t)(((int64_t)MPU6050.Acc.y * MPU6050.Config.accScale) >> 24),
+								  (int32_t)(((int64_t)MPU6050.Acc.z * MPU6050.Config.accScale) >> 24)};
+				sprintf((char*)Display.auxString, "Ax:%ld", (long)acc[0]);
 				Display_SetCursor(25, 17);
 				Display_WriteString((char*)Display.auxString, Font_7x10, SSD1306_COLOR_WHITE);
-				sprintf((char*)Display.auxString, "Ay:%d", MPU6050.Acc.y);
+				sprintf((char*)Display.auxString, "Ay:%ld", (long)acc[1]);
 				Display_SetCursor(25, 34);
 				Display_WriteString((char*)Display.auxString, Font_7x10, SSD1306_COLOR_WHITE);
-				sprintf((char*)Display.auxString, "Az:%d", MPU6050.Acc.z);
+				sprintf((char*)Display.auxString, "Az:%ld", (long)acc[2]);
 				Display_SetCursor(25, 51);
 				Display_WriteString((char*)Display.auxString, Font_7x10, SSD1306_COLOR_WHITE);
 				sprintf((char*)Display.auxString, "Gx:%d", MPU6050.Gyro.x);
@@ -399,98 +607,301 @@ void BateryLevel_Set(){
 	}
 }
 
-void decodeOn_USB(s_commData *data){
-	switch(RXBUF[RXCMD]){
-	case GETALIVE:
-		data->auxBuffer[0] = ACK;
-		comm_sendCMD(data, GETALIVE, &data->auxBuffer[0], 1);
-		break;
-	case FIRMWARE:
-		break;
-	case USERTEXT:
-		break;
-	case ADCSINGLE:
-		if(RXBUF[RXCMD + 1] <= 8 && RXBUF[RXCMD + 1] >= 0){
-			decom.ui16[0] = Analog.value[RXBUF[RXCMD + 1]];
-			data->auxBuffer[0] = RXBUF[RXCMD + 1];
-			data->auxBuffer[1] = decom.ui8[0];
-			data->auxBuffer[2] = decom.ui8[1];
-			comm_sendCMD(data, ADCSINGLE, &data->auxBuffer[0], 3);
-		}else{
-			comm_sendCMD(data, SYSWARNING, (uint8_t*)"NO ADC", 6);
+/************************************ HANDLERS DE COMANDOS ****************************************/
+/**
+ * @brief Avisa por qué no se guardó un parámetro; SYS_BUSY es un sector lleno que se compacta en IDLE
+ */
+static void cmd_paramStatus(s_commData *data, e_system status){
+	if(status == SYS_BUSY)
+		comm_sendCMD(data, SYSWARNING, (uint8_t*)"PARAM BUSY", 10);
+	else if(status != SYS_OK)
+		comm_sendCMD(data, SYSERROR, (uint8_t*)"PARAM FLASH", 11);
+}
+
+/* SISTEMA */
+static void cmd_getAlive(s_commData *data, const s_payload *payload){
+	data->auxBuffer[0] = ACK;
+	comm_sendCMD(data, GETALIVE, &data->auxBuffer[0], 1);
+}
+
+static void cmd_noAction(s_commData *data, const s_payload *payload){
+}
+/* FIN SISTEMA */
+
+/* ADC */
+static void cmd_adcSingle(s_commData *data, const s_payload *payload){
+	s_frame frame;
+
+	if(payload->length >= 1 && payload->data[0] < ADC_NUM_SENSORS){
+		if(comm_reserveFrame(data, &frame, ADCSINGLE, 3)){
+			comm_put_u8(&frame, payload->data[0]);
+			comm_put_u16(&frame, Analog.value[payload->data[0]]);
+			comm_commitFrame(data, &frame);
 		}
-		break;
-	case ADCBLOCK:
+	}else{
+		comm_sendCMD(data, SYSWARNING, (uint8_t*)"NO ADC", 6);
+	}
+}
+
+static void cmd_adcBlock(s_commData *data, const s_payload *payload){
+	s_frame frame;
+
+	if(comm_reserveFrame(data, &frame, ADCBLOCK, ADC_NUM_SENSORS * 2)){
 		for(uint8_t i = 0; i < ADC_NUM_SENSORS; i++){
-			decom.ui16[0] = Analog.value[i];
-			data->auxBuffer[i*2] = decom.ui8[0];
-			data->auxBuffer[i*2+1] = decom.ui8[1];
+			comm_put_u16(&frame, Analog.value[i]);
 		}
-		comm_sendCMD(data, ADCBLOCK, data->auxBuffer, 17);
-		break;
-	case DEBUGER:
+		comm_commitFrame(data, &frame);
+	}
+}
+/* FIN ADC */
+
+/* MOTORES Y ENCODERS */
+static void cmd_setMotor(s_commData *data, const s_payload *payload){
+	if(payload->length >= 2 && payload->data[0] == MOTOR_L){
+		Motor_Set_Speed(&MotorL, payload->data[1]);
+	}else if(payload->length >= 2 && payload->data[0] == MOTOR_R){
+		Motor_Set_Speed(&MotorR, payload->data[1]);
+	}else{
+		comm_sendCMD(data, SYSWARNING, (uint8_t*)"NO MOTOR", 8);
+		return;
+	}
+	data->auxBuffer[0] = ACK;
+	comm_sendCMD(data, SETMOTOR, data->auxBuffer, 1);
+}
 
-		break;
-	case SETMOTOR:
-		if(RXBUF[RXCMD + 1] == MOTOR_L){
-			Motor_Set_Speed(&MotorL, RXBUF[RXCMD + 2]);
-			USB.data.auxBuffer[0] = ACK;
-			comm_sendCMD(data, SETMOTOR, data->auxBuffer, 1);
-		}
-		if(RXBUF[RXCMD + 1] == MOTOR_R){
-			Motor_Set_Speed(&MotorR, RXBUF[RXCMD + 2]);
-			USB.data.auxBuffer[0] = ACK;
-			comm_sendCMD(data, SETMOTOR, data->auxBuffer, 1);
-		}else{
-			comm_sendCMD(data, SYSWARNING, (uint8_t*)"NO MOTOR", 8);
-		}
-		break;
-	case GET_ENCODER:
-		if(RXBUF[RXCMD + 1] == ENCODER_L){
-			decom.ui16[0] = EncoderL.pps;
-			data->auxBuffer[0] = ENCODER_L;
-			data->auxBuffer[1] = decom.ui8[0];
-			data->auxBuffer[2] = decom.ui8[1];
-			comm_sendCMD(data, GET_ENCODER, &data->auxBuffer[0], 3);
-		}else if(RXBUF[RXCMD + 1] == ENCODER_R){
-			decom.ui16[0] = EncoderR.pps;
-			data->auxBuffer[0] = ENCODER_R;
-			data->auxBuffer[1] = decom.ui8[0];
-			data->auxBuffer[2] = decom.ui8[1];
-			comm_sendCMD(data, GET_ENCODER, &data->auxBuffer[0], 3);
-		}else{
-			comm_sendCMD(data, SYSWARNING, (uint8_t*)"NO ENCODER", 10);
+static void cmd_getEncoder(s_commData *data, const s_payload *payload){
+	s_frame frame;
+
+	if(payload->length >= 1 && (payload->data[0] == ENCODER_L || payload->data[0] == ENCODER_R)){
+		if(comm_reserveFrame(data, &frame, GET_ENCODER, 3)){
+			comm_put_u8(&frame, payload->data[0]);
+			comm_put_u16(&frame, payload->data[0] == ENCODER_L ? EncoderL.pps : EncoderR.pps);
+			comm_commitFrame(data, &frame);
 		}
-		break;
-	case MPUBLOCK:
-		decom.i16[0] = MPU6050.Acc.x;
-		data->auxBuffer[0] = decom.ui8[0];
-		data->auxBuffer[1] = decom.ui8[1];
-		decom.i16[0] = MPU6050.Acc.y;
-		data->auxBuffer[2] = decom.ui8[0];
-		data->auxBuffer[3] = decom.ui8[1];
-		decom.i16[0] = MPU6050.Acc.z;
-		data->auxBuffer[4] = decom.ui8[0];
-		data->auxBuffer[5] = decom.ui8[1];
-		decom.i16[0] = MPU6050.Gyro.x;
-		data->auxBuffer[6] = decom.ui8[0];
-		data->auxBuffer[7] = decom.ui8[1];
-		decom.i16[0] = MPU6050.Gyro.y;
-		data->auxBuffer[8] = decom.ui8[0];
-		data->auxBuffer[9] = decom.ui8[1];
-		decom.i16[0] = MPU6050.Gyro.z;
-		data->auxBuffer[10] = decom.ui8[0];
-		data->auxBuffer[11] = decom.ui8[1];
-		comm_sendCMD(data, MPUBLOCK, data->auxBuffer, 12);
-		break;
+	}else{
+		comm_sendCMD(data, SYSWARNING, (uint8_t*)"NO ENCODER", 10);
+	}
+}
+/* FIN MOTORES Y ENCODERS */
+
+/* MPU6050 */
+static void cmd_mpuBlock(s_commData *data, const s_payload *payload){
+	s_frame frame;
+
+	if(comm_reserveFrame(data, &frame, MPUBLOCK, 12)){
+		comm_put_i16(&frame, MPU6050.Acc.x);
+		comm_put_i16(&frame, MPU6050.Acc.y);
+		comm_put_i16(&frame, MPU6050.Acc.z);
+		comm_put_i16(&frame, MPU6050.Gyro.x);
+		comm_put_i16(&frame, MPU6050.Gyro.y);
+		comm_put_i16(&frame, MPU6050.Gyro.z);
+		comm_commitFrame(data, &frame);
+	}
+}
+
+static void cmd_mpuConfig(s_commData *data, const s_payload *payload){
+	s_frame frame;
+	e_system status = SYS_OK;
+
+	if(payload->length >= 4){
+		status = MPU6050_Configure(&MPU6050, payload->data[0], payload->data[1], payload->data[2], payload->data[3]);
+		if(status == SYS_OK)
+			cmd_paramStatus(data, Param_Try_Set(&Params, PARAM_IMU_CONFIG, payload->data, 4));
+	}
+	// Responde la configuración vigente: la nueva se aplica con la próxima muestra
+	if(comm_reserveFrame(data, &frame, MPUCONFIG, 19)){
+		comm_put_u8(&frame, status);
+		comm_put_u8(&frame, MPU6050.Config.accRange);
+		comm_put_u8(&frame, MPU6050.Config.gyroRange);
+		comm_put_u8(&frame, MPU6050.Config.dlpf);
+		comm_put_u8(&frame, MPU6050.Config.sampleDiv);
+		comm_put_u32(&frame, MPU6050.Config.samplePeriod);
+		comm_put_u16(&frame, MPU6050.Config.accOneG);
+		comm_put_u32(&frame, MPU6050.Config.gyroScale);
+		comm_put_u32(&frame, MPU6050.Config.accScale);
+		comm_commitFrame(data, &frame);
+	}
+}
+
+static void cmd_mpuOffset(s_commData *data, const s_payload *payload){
+	s_frame frame;
+	int16_t offsets[NUM_AXIS];
+
+	if(payload->length >= 1 && payload->data[0] == 1){
+		MPU6050_Calibrate_Start(&MPU6050);					// Al terminar se guardan de nuevo
+		isMpuOffsetStored = FALSE;
+	}
+	MPU6050_Get_Offsets(&MPU6050, offsets);
+	if(comm_reserveFrame(data, &frame, MPUOFFSET, 2 * NUM_AXIS)){
+		for(uint8_t axis = 0; axis < NUM_AXIS; axis++)
+			comm_put_i16(&frame, offsets[axis]);
+		comm_commitFrame(data, &frame);
+	}
+}
+/* FIN MPU6050 */
+
+/* CONTROL */
+/**
+ * @brief Lazo que corresponde a un índice de SETPID; los motores no tienen lazo propio
+ */
+static s_pidLoop *Control_Get_Loop(uint8_t index){
+	switch(index){
+	case BALANCE:
+		return &TiltLoop;
+	case SPEED:
+		return &SpeedLoop;
+	case LINE_FOLLOWER:
+		return &SteerLoop;
 	default:
-		comm_sendCMD(data, SYSWARNING, (uint8_t*)"NO CMD", 6);
-		break;
+		return NULL;
 	}
 }
 
-void onKeyChangeState(e_Estados value){
+/**
+ * @brief Guarda en flash las ganancias de los tres lazos si cambiaron desde la última vez
+ *
+ * @param canCompact TRUE sólo con el robot detenido: compactar detiene la flash un segundo o más
+ * @return Resultado de Param_Set(); con SYS_BUSY quedan pendientes para IDLE
+ */
+static e_system Control_Save_Gains(uint8_t canCompact){
+	s_pidGains gains[3] = {TiltLoop.gains, SpeedLoop.gains, SteerLoop.gains};
+	e_system status;
+
+	if(!isPidGainsDirty)
+		return SYS_OK;
+	status = canCompact ? Param_Set(&Params, PARAM_PID_GAINS, gains, sizeof(gains)) :
+						  Param_Try_Set(&Params, PARAM_PID_GAINS, gains, sizeof(gains));
+	// Un error de la flash no se reintenta en cada ciclo: queda para el próximo SETPID o SAVEPID
+	if(status != SYS_BUSY)
+		isPidGainsDirty = FALSE;
+	return status;
+}
+
+static void cmd_setPid(s_commData *data, const s_payload *payload){
+	s_pidLoop *loop = payload->length >= 1 ? Control_Get_Loop(payload->data[0]) : NULL;
+	s_pidGains gains;
+	s_frame frame;
+
+	if(loop == NULL){
+		comm_sendCMD(data, SYSWARNING, (uint8_t*)"NO PID", 6);
+		return;
+	}
+	// index | kp | ki | kd | kff (f32), kff opcional; sólo con el índice responde las vigentes
+	if(payload->length >= 13){
+		gains = (s_pidGains){
+			.kp = comm_get_f32(&payload->data[1]),
+			.ki = comm_get_f32(&payload->data[5]),
+			.kd = comm_get_f32(&payload->data[9]),
+			.kff = payload->length >= 17 ? comm_get_f32(&payload->data[13]) : loop->gains.kff
+		};
+		// Se aplican en la próxima actualización sin perder el integral; se guardan en IDLE o con SAVEPID
+		PID_Set_Gains(loop, &gains);
+		isPidGainsDirty = TRUE;
+	}
+	if(comm_reserveFrame(data, &frame, SETPID, 17)){
+		comm_put_u8(&frame, payload->data[0]);
+		comm_put_f32(&frame, loop->gains.kp);
+		comm_put_f32(&frame, loop->gains.ki);
+		comm_put_f32(&frame, loop->gains.kd);
+		comm_put_f32(&frame, loop->gains.kff);
+		comm_commitFrame(data, &frame);
+	}
+}
+
+static void cmd_savePid(s_commData *data, const s_payload *payload){
+	e_system status = Control_Save_Gains(Car.state == IDLE);
+
+	if(status != SYS_OK){
+		cmd_paramStatus(data, status);
+		return;
+	}
+	data->auxBuffer[0] = ACK;
+	comm_sendCMD(data, SAVEPID, data->auxBuffer, 1);
+}
+/* FIN CONTROL */
+
+/* REGISTRADOR DE VUELO */
+static void cmd_recorder(s_commData *data, const s_payload *payload){
+	s_recorder *rec = &FlightRecorder.state;
+	s_frame frame;
+	e_system status = SYS_OK;
+
+	if(payload->length >= 1 && payload->data[0] == REC_OP_TRIGGER){
+		Recorder_Trigger(rec, REC_CAUSE_COMMAND);
+	}else if(payload->length >= 1 && payload->data[0] == REC_OP_ARM){
+		if(payload->length >= 5)
+			recTiltLimit = comm_get_u16(&payload->data[3]);
+		status = Recorder_Arm(rec, payload->length >= 3 ? comm_get_u16(&payload->data[1]) : rec->postTrigger);
+	}
+
+	// El contenido se lee con BULKREAD de BULK_RECORDER
+	if(comm_reserveFrame(data, &frame, RECORDER, 32)){
+		comm_put_u8(&frame, status);
+		comm_put_u8(&frame, rec->cause);
+		comm_put_u8(&frame, rec->isTriggered | (rec->isFrozen << 1));
+		comm_put_u8(&frame, rec->resets);
+		comm_put_u16(&frame, rec->capacity);
+		comm_put_u16(&frame, rec->recordSize);
+		comm_put_u16(&frame, rec->index);
+		comm_put_u16(&frame, rec->postTrigger);
+		comm_put_u32(&frame, rec->total);
+		comm_put_u32(&frame, rec->triggerTotal);
+		comm_put_u32(&frame, rec->lastCost);
+		comm_put_u32(&frame, rec->maxCost);
+		comm_put_u16(&frame, recTiltLimit);
+		comm_put_u16(&frame, sizeof(s_recorder));
+		comm_commitFrame(data, &frame);
+	}
+}
+/* FIN REGISTRADOR DE VUELO */
+
+/* WIFI */
+static void cmd_setWiFi(s_commData *data, const s_payload *payload){
+	uint16_t ssidLen = 0;
+	e_system status;
+
+	while(ssidLen < payload->length && payload->data[ssidLen] != '\0')
+		ssidLen++;
+	// Límites del ESP01: SSID de hasta 63 caracteres y contraseña de hasta 31
+	if(!ssidLen || ssidLen > 63 || payload->length - ssidLen > 32 || payload->length >= sizeof(ESP.credentials)){
+		comm_sendCMD(data, SYSWARNING, (uint8_t*)"BAD WIFI", 8);
+		return;
+	}
+
+	status = Param_Try_Set(&Params, PARAM_WIFI, payload->data, payload->length);
+	if(status != SYS_OK){
+		cmd_paramStatus(data, status);
+		return;
+	}
+	data->auxBuffer[0] = ACK;
+	comm_sendCMD(data, SETWIFI, data->auxBuffer, 1);
+}
+/* FIN WIFI */
+
+/* TELEMETRÍA */
+static void cmd_subscribe(s_commData *data, const s_payload *payload){
+	if(!payload->length){
+		comm_sendCMD(data, SYSWARNING, (uint8_t*)"NO MASK", 7);
+		return;
+	}
+	Telemetry_Subscribe(data, payload->data[0], payload->length >= 2 ? payload->data[1] : 1,
+						payload->length >= 3 ? payload->data[2] : 0);
+	data->auxBuffer[0] = ACK;
+	comm_sendCMD(data, SUBSCRIBE, data->auxBuffer, 1);
+}
+/* FIN TELEMETRÍA */
+/********************************** FIN HANDLERS DE COMANDOS **************************************/
 
+void onKeyChangeState(e_Estados value){
+	// Pulsador activo en bajo: cada pulsación arranca o detiene el equilibrio
+	if(value != FALLING)
+		return;
+	if(Car.state != IDLE)
+		Car_Set_State(IDLE);
+	else if(MPU6050_Is_Calibrated(&MPU6050))
+		Car_Set_State(STAND);
+	else
+		comm_sendCMD(&USB.data, SYSWARNING, (uint8_t*)"NO CALIB", 8);
 }
 
 void onESP01ChangeState(_eESP01STATUS esp01State) {
@@ -547,9 +958,179 @@ void onESP01Debug(const char *dbgStr) {
     comm_sendCMD(&USB.data, USERTEXT, (uint8_t *)dbgStr, strlen(dbgStr));
 }
 
+void IMU_Apply_Config(){
+	// Una vez por cambio de configuración, no en cada muestra
+	imuConfigChanges = MPU6050.Config.changes;
+	Kalman_Set_Period(&PitchFilter, MPU6050.Config.samplePeriod);
+	AHRS_Set_Period(&Attitude, MPU6050.Config.samplePeriod);
+	AHRS_Set_Scale(&Attitude, MPU6050.Config.gyroScale * (3.14159265f / 180.0f / 16777216.0f), MPU6050.Config.accOneG);
+	PID_Set_Period(&TiltLoop, MPU6050.Config.samplePeriod);
+}
+
+void IMU_Update_Angles(){
+	// Giróscopo sin el promedio móvil, para no sumarle demora al lazo de equilibrio
+	int16_t gyro[3] = {MPU6050.MAF.rawData[3] - MPU6050.Gyro.offset.x,
+					   MPU6050.MAF.rawData[4] - MPU6050.Gyro.offset.y,
+					   MPU6050.MAF.rawData[5] - MPU6050.Gyro.offset.z};
+	int16_t acc[3] = {MPU6050.Acc.x, MPU6050.Acc.y, MPU6050.Acc.z};
+	int32_t pitch;
+
+	if(imuConfigChanges != MPU6050.Config.changes)
+		IMU_Apply_Config();
+	pitch = Kalman_Update(&PitchFilter,
+						  Kalman_Acc_Pitch(acc[0], acc[1], acc[2]),
+						  Kalman_Gyro_Rate(gyro[0], MPU6050.Config.gyroScale));
+
+	MPU6050.Angle.pitch = (int16_t)(((int64_t)pitch * 100) >> 16);
+	AHRS_Update(&Attitude, gyro, acc);
+}
+
+void Flight_Record(){
+	s_flightRecord *rec;
+	uint8_t *adc;
+	uint8_t i;
+
+	// Sin calibrar los ángulos no valen: el límite de inclinación no se revisa
+	if(recTiltLimit && MPU6050_Is_Calibrated(&MPU6050) &&
+	   (MPU6050.Angle.pitch > recTiltLimit || MPU6050.Angle.pitch < -recTiltLimit ||
+		MPU6050.Angle.roll > recTiltLimit || MPU6050.Angle.roll < -recTiltLimit))
+		Recorder_Trigger(&FlightRecorder.state, REC_CAUSE_TILT);
+
+	rec = (s_flightRecord*)Recorder_Begin(&FlightRecorder.state);
+	if(rec == NULL)
+		return;
+
+	rec->time = SysTick_Get_Micros();
+	rec->acc[0] = MPU6050.Acc.x;
+	rec->acc[1] = MPU6050.Acc.y;
+	rec->acc[2] = MPU6050.Acc.z;
+	rec->gyro[0] = MPU6050.MAF.rawData[3] - MPU6050.Gyro.offset.x;
+	rec->gyro[1] = MPU6050.MAF.rawData[4] - MPU6050.Gyro.offset.y;
+	rec->gyro[2] = MPU6050.MAF.rawData[5] - MPU6050.Gyro.offset.z;
+	rec->angle[0] = MPU6050.Angle.pitch;
+	rec->angle[1] = MPU6050.Angle.roll;
+	rec->angle[2] = MPU6050.Angle.yaw;
+
+	// 12 bits por valor: nueve canales en 14 bytes en vez de 18
+	adc = rec->adc;
+	for(i = 0; i + 1 < ADC_NUM_SENSORS; i += 2, adc += 3){
+		adc[0] = (uint8_t)Analog.value[i];
+		adc[1] = (uint8_t)((Analog.value[i] >> 8) | (Analog.value[i + 1] << 4));
+		adc[2] = (uint8_t)(Analog.value[i + 1] >> 4);
+	}
+	if(i < ADC_NUM_SENSORS){
+		adc[0] = (uint8_t)Analog.value[i];
+		adc[1] = (uint8_t)(Analog.value[i] >> 8);
+	}
+
+	rec->pps[0] = EncoderL.pps;
+	rec->pps[1] = EncoderR.pps;
+	rec->vel[0] = (int16_t)MotorL.vel;
+	rec->vel[1] = (int16_t)MotorR.vel;
+	rec->temperature = MPU6050.Thermal.celsius;
+	rec->flags = (MPU6050_Is_Calibrated(&MPU6050) ? REC_FLAG_CALIBRATED : 0) |
+				 (Attitude.isStill ? REC_FLAG_STILL : 0) |
+				 (MPU6050.Thermal.isValid ? REC_FLAG_THERMAL : 0);
+	rec->reserved = 0;
+
+	Recorder_End(&FlightRecorder.state);
+}
+
+/**
+ * @brief Pasa una salida en Q16 % al porcentaje entero que admite el motor
+ */
+static int8_t Control_To_Percent(int32_t value){
+	value >>= 16;
+	return value > 100 ? 100 : value < -100 ? -100 : (int8_t)value;
+}
+
+/**
+ * @brief Velocidad de una rueda con signo en Q16 pulsos/s; el encoder no distingue el sentido, lo da el motor
+ */
+static int32_t Control_Wheel_Speed(s_encoder *enc, s_motor *motor){
+	int32_t pps = enc->pps > INT16_MAX ? INT16_MAX : enc->pps;
+	return (motor->direction == BACKWARD ? -pps : pps) * 65536;
+}
+
+void Car_Set_State(e_Car_state state){
+	if(state == Car.state)
+		return;
+	if(state == IDLE){
+		Motor_Set_Speed(&MotorL, 0);
+		Motor_Set_Speed(&MotorR, 0);
+	}else if(Car.state == IDLE){
+		PID_Reset(&TiltLoop);
+		PID_Reset(&SpeedLoop);
+		PID_Reset(&SteerLoop);
+		Car.tiltRef = 0;
+		Car.turn = 0;
+	}
+	Car.state = state;
+}
+
+void Balance_Update(){
+	int32_t pwm;
+
+	// Caído: no tiene sentido seguir empujando, se cortan los motores hasta otra pulsación
+	if(MPU6050.Angle.pitch > CONTROL_FALL_CDEG || MPU6050.Angle.pitch < -CONTROL_FALL_CDEG){
+		Car_Set_State(IDLE);
+		return;
+	}
+	pwm = PID_Update(&TiltLoop, Car.tiltRef, PitchFilter.angle, 0);
+	Motor_Set_Speed(&MotorL, Control_To_Percent(pwm + Car.turn));
+	Motor_Set_Speed(&MotorR, Control_To_Percent(pwm - Car.turn));
+}
+
+void Cruise_Update(){
+	int32_t left = Control_Wheel_Speed(&EncoderL, &MotorL);
+	int32_t right = Control_Wheel_Speed(&EncoderR, &MotorR);
+
+	Car.tiltRef = PID_Update(&SpeedLoop, Car.speedRef, (left >> 1) + (right >> 1), 0);
+	Car.turn = PID_Update(&SteerLoop, Car.turnRef, left - right, 0);
+}
+
+void onCommError(){
+	Recorder_Trigger(&FlightRecorder.state, REC_CAUSE_ERROR);
+}
+
 void task_10ms(){
 	IS10MS = FALSE;
 
+	// Calibración en segundo plano terminada: se guarda para no repetirla en el próximo arranque
+	if(!isMpuOffsetStored && MPU6050_Is_Calibrated(&MPU6050) && !MPU6050.Calib.isRunning){
+		int16_t offsets[NUM_AXIS];
+		e_system status;
+		MPU6050_Get_Offsets(&MPU6050, offsets);
+		status = Param_Try_Set(&Params, PARAM_MPU_OFFSETS, offsets, sizeof(offsets));
+		if(status == SYS_ERROR)
+			comm_sendCMD(&USB.data, SYSWARNING, (uint8_t*)"PARAM MPU", 9);
+		// Con el sector lleno se reintenta después de la compactación en IDLE
+		isMpuOffsetStored = status != SYS_BUSY;
+	}
+
+	if(isMpuDrdyLost){
+		isMpuDrdyLost = FALSE;
+		comm_sendCMD(&USB.data, SYSWARNING, (uint8_t*)"MPU6050 NO DRDY", 15);
+	}
+
+	// Ganancias de SETPID: se graban al detenerse el robot, nunca con los lazos cerrados
+	if(isPidGainsDirty && Car.state == IDLE)
+		cmd_paramStatus(&USB.data, Control_Save_Gains(TRUE));
+
+	// Compactar detiene la flash un segundo o más: sólo con el robot detenido, y antes de que
+	// un Param_Try_Set() se quede sin lugar para un valor del tamaño máximo
+	if(Car.state == IDLE && Params.isInit && !isParamCompactFailed && Param_Free(&Params) < PARAM_MAX_SIZE){
+		if(Param_Compact(&Params) != SYS_OK){
+			isParamCompactFailed = TRUE;
+			comm_sendCMD(&USB.data, SYSERROR, (uint8_t*)"PARAM FLASH", 11);
+		}
+	}
+
+	// Los ángulos de Euler no hacen falta a 1kHz: roll y rumbo a 100Hz
+	AHRS_Get_Euler(&Attitude);
+	MPU6050.Angle.roll = (int16_t)(Attitude.roll * 100.0f);
+	MPU6050.Angle.yaw = (int16_t)(Attitude.yaw * 100.0f);
+
 	is100ms1--;
 	if(!is100ms1){
 		is100ms1 = 10;
@@ -588,6 +1169,17 @@ void task_10ms(){
 	Motor_Break_Timeout(&MotorR);
 	Encoder_Task(&EncoderL);
 	Encoder_Task(&EncoderR);
+	if(Car.state != IDLE)
+		Cruise_Update();
+
+	if(Telemetry_Is_Active(TLM_ENCODER)){
+		uint16_t pps[2] = {EncoderL.pps, EncoderR.pps};
+		Telemetry_Push(TLM_ENCODER, (uint8_t*)pps);
+	}
+	if(Telemetry_Is_Active(TLM_MOTOR)){
+		int16_t vel[2] = {(int16_t)MotorL.vel, (int16_t)MotorR.vel};
+		Telemetry_Push(TLM_MOTOR, (uint8_t*)vel);
+	}
 }
 /* USER CODE END 0 */
 
@@ -631,15 +1223,30 @@ int main(void)
   MX_USART1_UART_Init();
   /* USER CODE BEGIN 2 */
   /* INICIALIZACIÓN DE PROTOCOLO MEDIANTE USB */
-  Comm_Init(&USB.data, &decodeOn_USB, &writeOn_USB);
+  Init_Commands();
+  Comm_Init(&USB.data, &Comm_Dispatch, &writeOn_USB);
   CDC_Attach_Rx(&dataRxOn_USB);
+  CDC_Attach_Tx(&dataTxOn_USB);
+  Comm_Set_Tx_Pending(&USB.data, &CDC_Tx_Pending);
   /* FIN INICIALIZACIÓN DE PROTOCOLO MEDIANTE USB */
 
+  /* INICIALIZACIÓN DEL REGISTRADOR DE VUELO */
+  Init_Recorder();
+  /* FIN INICIALIZACIÓN DEL REGISTRADOR DE VUELO */
+
   /* INICIALIZACIÓN DE USER KEY Y DEBOUNCE */
   Debounce_Init();
   key = Debounce_Add(&KEY_Read_Value, &onKeyChangeState);
   /* FIN INICIALIZACIÓN DE USER KEY Y DEBOUNCE */
 
+  /* INICIALIZACIÓN DE PARÁMETROS GUARDADOS */
+  Init_Params();
+  /* FIN INICIALIZACIÓN DE PARÁMETROS GUARDADOS */
+
+  /* INICIALIZACIÓN DE LAZOS DE CONTROL */
+  Init_Control();
+  /* FIN INICIALIZACIÓN DE LAZOS DE CONTROL */
+
   /* INICIALIZACIÓN DE MPU6050 */
   Init_MPU6050();
   /* FIN INICIALIZACIÓN DE MPU6050 */
@@ -673,9 +1280,27 @@ int main(void)
     /* USER CODE BEGIN 3 */
 	  /* USER TASK */
 	Comm_Task(&USB.data);
+	if(RingBuffer_Free(&USB.data.Rx) >= CDC_DATA_FS_MAX_PACKET_SIZE)
+		CDC_Resume_Rx();
 	Comm_Task(&ESP.data);
 	Display_UpdateScreen_Task();
-	MPU6050_MAF(&MPU6050);
+	while(MPU6050_MAF(&MPU6050)){
+		if(MPU6050_Is_Calibrated(&MPU6050)){
+			IMU_Update_Angles();
+			if(Car.state != IDLE)
+				Balance_Update();
+		}
+		Flight_Record();
+		if(Telemetry_Is_Active(TLM_IMU)){
+			int16_t imu[6] = {MPU6050.Acc.x, MPU6050.Acc.y, MPU6050.Acc.z, MPU6050.Gyro.x, MPU6050.Gyro.y, MPU6050.Gyro.z};
+			Telemetry_Push(TLM_IMU, (uint8_t*)imu);
+		}
+		if(Telemetry_Is_Active(TLM_IMU_RAW)){
+			uint8_t frame[MPU_FIFO_FRAME];
+			MPU6050_Get_Frame(&MPU6050, frame);
+			Telemetry_Push(TLM_IMU_RAW, frame);
+		}
+	}
 	ESP01_Task();
 	/* END USER TASK */
 
@@ -692,6 +1317,10 @@ int main(void)
 		break;
 	case GO_FROM_TO:
 
+		break;
+	case STAND:
+		Car.speedRef = 0;
+		Car.turnRef = 0;
 		break;
 	}
   }
@@ -1126,14 +1755,20 @@ static void MX_GPIO_Init(void)
   GPIO_InitStruct.Pull = GPIO_NOPULL;
   HAL_GPIO_Init(M1_ENC_A_GPIO_Port, &GPIO_InitStruct);
 
-  /*Configure GPIO pins : PB13 PB14 PB15 */
-  GPIO_InitStruct.Pin = GPIO_PIN_13|GPIO_PIN_14|GPIO_PIN_15;
+  /*Configure GPIO pins : PB13 PB15 */
+  GPIO_InitStruct.Pin = GPIO_PIN_13|GPIO_PIN_15;
   GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
   GPIO_InitStruct.Pull = GPIO_NOPULL;
   GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
   GPIO_InitStruct.Alternate = GPIO_AF5_SPI2;
   HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
 
+  /*Configure GPIO pin : MPU_INT_Pin */
+  GPIO_InitStruct.Pin = MPU_INT_Pin;
+  GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING;
+  GPIO_InitStruct.Pull = GPIO_PULLDOWN;
+  HAL_GPIO_Init(MPU_INT_GPIO_Port, &GPIO_InitStruct);
+
   /*Configure GPIO pin : M2_ENC_A_Pin */
   GPIO_InitStruct.Pin = M2_ENC_A_Pin;
   GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING;
@@ -1177,8 +1812,52 @@ void Init_Timing(){
 	  }
 }
 /* FIN INICIALIZACIÓN DE TIMERS Y PWM*/
+/* INICIALIZACIÓN DE COMANDOS */
+void Init_Commands(){
+	// Contador de ciclos como base de tiempo para medir los handlers
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	Comm_Attach_TimeBase(&DWT_Get_Cycles);
+	Comm_Attach_Clock(&SysTick_Get_Micros);
+
+	Comm_Register_Command(GETALIVE, &cmd_getAlive);
+	Comm_Register_Command(FIRMWARE, &cmd_noAction);
+	Comm_Register_Command(USERTEXT, &cmd_noAction);
+	Comm_Register_Command(DEBUGER, &cmd_noAction);
+
+	Comm_Register_Command(ADCSINGLE, &cmd_adcSingle);
+	Comm_Register_Command(ADCBLOCK, &cmd_adcBlock);
+
+	Comm_Register_Command(SETMOTOR, &cmd_setMotor);
+	Comm_Register_Command(GET_ENCODER, &cmd_getEncoder);
+
+	Comm_Register_Command(MPUBLOCK, &cmd_mpuBlock);
+	Comm_Register_Command(MPUOFFSET, &cmd_mpuOffset);
+	Comm_Register_Command(MPUCONFIG, &cmd_mpuConfig);
+	Comm_Register_Command(SETWIFI, &cmd_setWiFi);
+	Comm_Register_Command(RECORDER, &cmd_recorder);
+	Comm_Register_Command(SETPID, &cmd_setPid);
+	Comm_Register_Command(SAVEPID, &cmd_savePid);
+
+	Telemetry_Add_Channel(TLM_ADC, ADC_NUM_SENSORS * 2, TLM_ADC_BATCH);
+	Telemetry_Add_Channel(TLM_IMU, 12, TLM_IMU_BATCH);
+	Telemetry_Add_Channel(TLM_ENCODER, 4, TLM_SLOW_BATCH);
+	Telemetry_Add_Channel(TLM_MOTOR, 4, TLM_SLOW_BATCH);
+	Telemetry_Add_Channel(TLM_IMU_RAW, MPU_FIFO_FRAME, TLM_IMU_BATCH);
+	Comm_Register_Command(SUBSCRIBE, &cmd_subscribe);
+
+	Comm_Register_Region(BULK_FRAMEBUFFER, Display_Get_Buffer(), OLED_DMA_BUFFER_SIZE);
+	Comm_Register_Region(BULK_MPU6050, &MPU6050, sizeof(MPU6050));
+	Comm_Register_Region(BULK_ANALOG, &Analog, sizeof(Analog));
+	Comm_Register_Region(BULK_RECORDER, &FlightRecorder, sizeof(FlightRecorder));
+}
+/* FIN INICIALIZACIÓN DE COMANDOS */
 /* INICIALIZACIÓN DE MPU6050 */
 void Init_MPU6050(){
+	int16_t offsets[NUM_AXIS];
+	uint8_t config[4];
+
 	if(HAL_I2C_IsDeviceReady(&hi2c1, MPU6050_ADDR, 1, 1000) != HAL_OK){
 		comm_sendCMD(&USB.data, SYSERROR, (uint8_t*)"MPU6050 READY", 13);
 	}else{
@@ -1186,7 +1865,28 @@ void Init_MPU6050(){
 		if(MPU6050_Init(&MPU6050) != SYS_OK){
 			comm_sendCMD(&USB.data, SYSERROR, (uint8_t*)"MPU6050 INIT", 12);
 		}else{
-			MPU6050_Calibrate(&MPU6050);
+			// Todavía sin DMA: la configuración guardada se escribe enseguida
+			if(Param_Get(&Params, PARAM_IMU_CONFIG, config, sizeof(config)) == sizeof(config) &&
+			   MPU6050_Configure(&MPU6050, config[0], config[1], config[2], config[3]) != SYS_OK)
+				comm_sendCMD(&USB.data, SYSWARNING, (uint8_t*)"MPU6050 CONFIG", 14);
+			if(Param_Get(&Params, PARAM_MPU_OFFSETS, offsets, sizeof(offsets)) == sizeof(offsets)){
+				MPU6050_Set_Offsets(&MPU6050, offsets);
+				isMpuOffsetStored = TRUE;
+			}else{
+				MPU6050_Calibrate_Start(&MPU6050);			// Termina sola con el robot quieto, sin demorar el arranque
+			}
+			Kalman_Init(&PitchFilter, MPU6050.Config.samplePeriod);
+			AHRS_Init(&Attitude, MPU6050.Config.samplePeriod);
+			IMU_Apply_Config();
+			MPU6050_Set_I2C_DMA(&I2C1_DMA_Mem_Write, &I2C1_DMA_Mem_Read);
+#if MPU_USE_DATA_READY
+			MPU6050_Attach_TimeBase(&SysTick_Get_Micros);
+			if(MPU6050_DataReady_Enable(&MPU6050) != SYS_OK)
+				comm_sendCMD(&USB.data, SYSERROR, (uint8_t*)"MPU6050 DRDY", 12);
+#else
+			if(MPU6050_FIFO_Enable(&MPU6050) != SYS_OK)
+				comm_sendCMD(&USB.data, SYSERROR, (uint8_t*)"MPU6050 FIFO", 12);
+#endif
 		}
 	}
 }
@@ -1214,12 +1914,30 @@ void Init_Display(){
 
 /* INICIALIZACIÓN WIFI */
 void Init_WiFi(){
-	ESP.password = 	"wlan412877";
-	ESP.ssid = 		"InternetPlus_bed788";
+	uint16_t len, ssidLen;
+
+	// Sin credenciales guardadas con SETWIFI el ESP queda sin red y abre su portal de configuración
+	ESP.ssid = NULL;
+	ESP.password = NULL;
+	len = Param_Get(&Params, PARAM_WIFI, ESP.credentials, sizeof(ESP.credentials) - 1);
+	if(len && len < sizeof(ESP.credentials)){
+		ESP.credentials[len] = '\0';
+		ssidLen = strlen(ESP.credentials);
+		ESP.ssid = ESP.credentials;
+		ESP.password = ssidLen < len ? &ESP.credentials[ssidLen + 1] : &ESP.credentials[len];
+	}
+#if defined(WIFI_BOOT_SSID) && defined(WIFI_BOOT_PASSWORD)
+	else{
+		// Sólo para la primera carga: se pasan con -D al compilar y nunca se guardan en el repositorio
+		ESP.ssid = WIFI_BOOT_SSID;
+		ESP.password = WIFI_BOOT_PASSWORD;
+	}
+#endif
 	ESP.IP = 		"192.168.1.10";
 
-	Comm_Init(&ESP.data, &decodeOn_USB, &writeOn_ESP);
+	Comm_Init(&ESP.data, &Comm_Dispatch, &writeOn_ESP);
 	ESP.data.isESP01 = TRUE;
+	Comm_Set_MaxChunk(&ESP.data, ESP01TXBUFAT - ESP01_SEND_PREFIX);	// Cada trama en un único AT+CIPSEND
 	HAL_UART_Receive_IT(&huart1, &ESP.AT_Rx_data, 1);
 
 	ESP.Config.DoCHPD = setESP01_CHPD;
@@ -1227,7 +1945,10 @@ void Init_WiFi(){
 	ESP.Config.WriteByteToBufRX = ESP01_Data_Recived;
 
 	ESP01_Init(&ESP.Config);
-	ESP01_SetWIFI(ESP.ssid, ESP.password);
+	if(ESP.ssid != NULL)
+		ESP01_SetWIFI(ESP.ssid, ESP.password);
+	else
+		comm_sendCMD(&USB.data, SYSWARNING, (uint8_t*)"WIFI NOT SET", 12);
 	ESP01_StartUDP("192.168.1.10", 30010, 30000);
 	//ESP01_AttachChangeState(&onESP01ChangeState);
 	ESP01_AttachDebugStr(&onESP01Debug);
@@ -1236,17 +1957,76 @@ void Init_WiFi(){
 }
 /* END INICIALIZACIÓN WIFI */
 
+/* INICIALIZACIÓN DE PARÁMETROS GUARDADOS */
+void Init_Params(){
+	if(Param_Init(&Params, &ParamFlash) != SYS_OK)
+		comm_sendCMD(&USB.data, SYSERROR, (uint8_t*)"PARAM FLASH", 11);
+}
+/* FIN INICIALIZACIÓN DE PARÁMETROS GUARDADOS */
+
+/* INICIALIZACIÓN DE LAZOS DE CONTROL */
+void Init_Control(){
+	s_pidGains gains[3];
+
+	// El período del lazo de inclinación lo fija IMU_Apply_Config() con la configuración del MPU6050
+	PID_Init(&TiltLoop, MPU_MIN_PERIOD_US, PID_Q16(-100), PID_Q16(100));
+	PID_Set_Derivative_Filter(&TiltLoop, CONTROL_TILT_DCUTOFF_HZ);
+	PID_Init(&SpeedLoop, CONTROL_PERIOD_US, PID_Q16(-CONTROL_TILT_REF_MAX), PID_Q16(CONTROL_TILT_REF_MAX));
+	PID_Init(&SteerLoop, CONTROL_PERIOD_US, PID_Q16(-CONTROL_TURN_MAX), PID_Q16(CONTROL_TURN_MAX));
+
+	// Sin ganancias guardadas los lazos quedan en cero hasta configurarlos con SETPID
+	if(Param_Get(&Params, PARAM_PID_GAINS, gains, sizeof(gains)) == sizeof(gains)){
+		PID_Set_Gains(&TiltLoop, &gains[0]);
+		PID_Set_Gains(&SpeedLoop, &gains[1]);
+		PID_Set_Gains(&SteerLoop, &gains[2]);
+	}
+}
+/* FIN INICIALIZACIÓN DE LAZOS DE CONTROL */
+
+/* INICIALIZACIÓN DEL REGISTRADOR DE VUELO */
+void Init_Recorder(){
+	// Antes de asignar el disparo por SYSERROR: hasta acá el estado puede ser basura de la RAM
+	if(Recorder_Init(&FlightRecorder.state, FlightRecorder.records, sizeof(FlightRecorder.records),
+					 sizeof(s_flightRecord), REC_POST_TRIGGER) != SYS_OK){
+		comm_sendCMD(&USB.data, SYSERROR, (uint8_t*)"RECORDER INIT", 13);
+		return;
+	}
+	if(FlightRecorder.state.isFrozen)
+		comm_sendCMD(&USB.data, SYSWARNING, (uint8_t*)"RECORDER KEPT", 13);
+	Recorder_Attach_TimeBase(&DWT_Get_Cycles);
+	Comm_Attach_OnError(&onCommError);
+}
+/* FIN INICIALIZACIÓN DEL REGISTRADOR DE VUELO */
+
 /************************************ END USER INIT FUNCTIONS ****************************************/
 /***************************************** HAL CALLBACKS *********************************************/
 void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim){ //								1/4000s
 	if(htim->Instance == TIM1){
 		HAL_ADC_Start_DMA(&hadc1, (uint32_t*)&Analog.raw, ADC_NUM_SENSORS);
-		is5ms--;
-		if(!is5ms){
-			is5ms = 20;
-			if(MPU6050.isInit){
-				HAL_I2C_Mem_Read_DMA(&hi2c1, MPU6050_ADDR, ACCEL_XOUT_REG, 1, MPU6050.bit_data, 14);
-				Display_I2C_DMA_Ready(FALSE);
+		isMpuRead--;
+		if(!isMpuRead){
+			if(MPU6050.DRDY.isOn){
+				isMpuRead = MPU_READ_PERIOD_TICKS;		// Las lecturas las dispara el pin INT
+				// Sin flancos en el pin se deja data-ready y las próximas lecturas las arranca TIM1
+				if(MPU6050_DataReady_Watchdog(&MPU6050, MPU_READ_PERIOD_TICKS * TIM1_TICK_US))
+					isMpuDrdyLost = TRUE;
+			}else if(MPU6050.FIFO.isOn){
+				isMpuRead = MPU_FIFO_PERIOD_TICKS;
+				if(MPU6050_FIFO_Start_Read(&MPU6050))
+					Display_I2C_DMA_Ready(FALSE);
+			}else{
+				// Una lectura por muestra del sensor: con un período que no es múltiplo del tick
+				// se arrastra el resto, así el promedio es el período de muestreo
+				mpuReadRemainder += MPU6050.Config.samplePeriod;
+				isMpuRead = mpuReadRemainder / TIM1_TICK_US;
+				mpuReadRemainder -= isMpuRead * TIM1_TICK_US;
+				if(!isMpuRead)
+					isMpuRead = MPU_READ_PERIOD_TICKS;
+				if(MPU6050.isInit){
+					if(MPU6050_Config_Start(&MPU6050) ||
+					   HAL_I2C_Mem_Read_DMA(&hi2c1, MPU6050_ADDR, ACCEL_XOUT_REG, 1, MPU6050.bit_data, 14) == HAL_OK)
+						Display_I2C_DMA_Ready(FALSE);
+				}
 			}
 		}
 	}
@@ -1256,22 +2036,29 @@ void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim){ //								1/4000s
 }
 
 void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c){
+	if(hi2c->Devaddress == MPU6050_ADDR){
+		if(MPU6050_I2C_DMA_Cplt(&MPU6050))
+			Display_I2C_DMA_Ready(TRUE);
+	}
 	if(hi2c->Devaddress == SSD1306_I2C_ADDR){
 		if(!MPU6050.isInit){
 			Display_I2C_DMA_Ready(TRUE);
+		}else if(MPU6050_DataReady_Retry(&MPU6050)){
+			Display_I2C_DMA_Ready(FALSE);
 		}
 	}
 }
 
 void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c){
 	if(hi2c->Devaddress == MPU6050_ADDR){
-		MPU6050_I2C_DMA_Cplt(&MPU6050);
-		Display_I2C_DMA_Ready(TRUE);
+		if(MPU6050_I2C_DMA_Cplt(&MPU6050))
+			Display_I2C_DMA_Ready(TRUE);
 	}
 }
 
 void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef* hadc){
 	ADC_Conversion_Cplt(Analog.raw, Analog.value);
+	Telemetry_Push(TLM_ADC, (uint8_t*)Analog.value);
 }
 
 void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin){
@@ -1281,6 +2068,10 @@ void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin){
     if (GPIO_Pin == M2_ENC_A_Pin){
     	Encoder_Add_Pulse(&EncoderR);
 	}
+    if (GPIO_Pin == MPU_INT_Pin){
+    	if(MPU6050_DataReady_IRQ(&MPU6050))
+    		Display_I2C_DMA_Ready(FALSE);
+    }
 }
 /**************************************** END HAL CALLBACKS ***************************************/
 
@@ -1301,13 +2092,21 @@ int ESP01_UART_Transmit(uint8_t val){
 }
 
 void ESP01_Data_Recived(uint8_t value){
-	ESP.data.Rx.buffer[ESP.data.Rx.write++] = value;
+	RingBuffer_PushByte(&ESP.data.Rx, value);
 }
 
 void writeOn_ESP(s_commData *data){
-	ESP.bytesToTx = data->Tx.write - data->Tx.read;
-	if(ESP01_Send(data->Tx.buffer,  data->Tx.read,  ESP.bytesToTx,  RINGBUFFLENGTH) == ESP01_SEND_READY){
-		data->Tx.read += ESP.bytesToTx;
+	uint32_t length;
+	uint16_t max = ESP01_Send_Max();
+	s_ring *tx = Comm_Tx_Next(data, &length);
+
+	if(tx == NULL || !max)
+		return;
+	if(length > max)
+		length = max;												// El resto de la ráfaga sale en el próximo envío
+	ESP.bytesToTx = length;
+	if(ESP01_Send(tx->buffer, tx->read & tx->mask, ESP.bytesToTx, RingBuffer_Size(tx)) == ESP01_SEND_READY){
+		Comm_Tx_Consume(data, ESP.bytesToTx);
 	}
 }
 /******************************************** END ESP ***********************************************/
@@ -1317,6 +2116,10 @@ e_system I2C1_DMA_Mem_Write(uint16_t Dev_Address, uint8_t reg, uint8_t *p_Data,
 	return (e_system)HAL_I2C_Mem_Write_DMA(&hi2c1, Dev_Address, reg, 1, p_Data, _Size);
 }
 
+e_system I2C1_DMA_Mem_Read(uint16_t Dev_Address, uint8_t reg, uint8_t *p_Data, uint16_t _Size){
+	return (e_system)HAL_I2C_Mem_Read_DMA(&hi2c1, Dev_Address, reg, 1, p_Data, _Size);
+}
+
 e_system I2C1_Master_Transmit(uint16_t Dev_Address, uint8_t *p_Data, uint16_t _Size, uint32_t _Timeout){
 	return (e_system)HAL_I2C_Master_Transmit(&hi2c1, Dev_Address, p_Data, _Size, _Timeout);
 }
@@ -1333,27 +2136,68 @@ void setESP01_CHPD(uint8_t val){
 	HAL_GPIO_WritePin(ESP_EN_GPIO_Port, ESP_EN_Pin, val);
 }
 
+e_system Flash_Param_Erase(uint8_t sector){
+	FLASH_EraseInitTypeDef erase = {
+		.TypeErase = FLASH_TYPEERASE_SECTORS,
+		.Sector = PARAM_FLASH_SECTOR_A + sector,
+		.NbSectors = 1,
+		.VoltageRange = FLASH_VOLTAGE_RANGE_3
+	};
+	uint32_t sectorError;
+	HAL_StatusTypeDef status;
+
+	HAL_FLASH_Unlock();
+	status = HAL_FLASHEx_Erase(&erase, &sectorError);
+	HAL_FLASH_Lock();
+	return status == HAL_OK ? SYS_OK : SYS_ERROR;
+}
+
+e_system Flash_Param_Program(const uint8_t *address, uint32_t word){
+	HAL_StatusTypeDef status;
+
+	HAL_FLASH_Unlock();
+	status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, (uint32_t)address, word);
+	HAL_FLASH_Lock();
+	return status == HAL_OK ? SYS_OK : SYS_ERROR;
+}
+
+uint32_t DWT_Get_Cycles(){
+	return DWT->CYCCNT;
+}
+
+uint32_t SysTick_Get_Micros(){
+	uint32_t ms, val, isPending;
+	uint32_t load = SysTick->LOAD + 1;
+
+	do{
+		ms = HAL_GetTick();
+		val = SysTick->VAL;
+		isPending = SCB->ICSR & SCB_ICSR_PENDSTSET_Msk;
+	}while(ms != HAL_GetTick());
+
+	// Desde una interrupción de mayor prioridad el SysTick pudo recargar sin sumar el tick
+	if(isPending && val > load / 2)
+		ms++;
+	return ms * 1000 + (load - 1 - val) * 1000 / load;
+}
+
 uint8_t KEY_Read_Value(){
 	return HAL_GPIO_ReadPin(KEY_GPIO_Port, KEY_Pin);
 }
 
 void writeOn_USB(s_commData *data){
-	if(USB.data.Tx.write > USB.data.Tx.read){
-		USB.bytesToTx = USB.data.Tx.write - USB.data.Tx.read;
-	}else{
-		USB.bytesToTx = RINGBUFFLENGTH - USB.data.Tx.read;
-	}
-	if(CDC_Transmit_FS(&USB.data.Tx.buffer[USB.data.Tx.read], USB.bytesToTx) == USBD_OK){
-		USB.data.Tx.read += USB.bytesToTx;
-	}
+	CDC_Start_Tx();
 }
 
-void dataRxOn_USB(uint8_t *buff, uint32_t len){
+uint16_t dataTxOn_USB(uint8_t *buff, uint16_t size){
+	return Comm_Tx_Read(&USB.data, buff, size);
+}
+
+uint8_t dataRxOn_USB(uint8_t *buff, uint32_t len){
 	if(buff != NULL){
-		for(uint16_t i = 0; i < len; i++){
-			USB.data.Rx.buffer[USB.data.Rx.write++] = buff[i];
-		}
+		RingBuffer_Push(&USB.data.Rx, buff, len);
 	}
+	return RingBuffer_Free(&USB.data.Rx) >= CDC_DATA_FS_MAX_PACKET_SIZE;
 }
 
 void Motor_Left_SetPins(uint8_t pinA, uint8_t pinB){
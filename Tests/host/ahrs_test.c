@@ -0,0 +1,292 @@
+/**
+ * @file ahrs_test.c
+ * @brief Pruebas de ahrs.c en la PC: deriva sobre rotaciones sintéticas y costo por muestra.
+ *
+ * La actitud verdadera se integra en double desde una velocidad angular conocida y de ella
+ * salen las lecturas crudas que vería el MPU6050 a ±250 grados/s y ±2g: giróscopo con sesgo y
+ * ruido, acelerómetro con la gravedad en ejes del cuerpo y ruido. El error de inclinación es
+ * el ángulo entre la gravedad estimada y la verdadera; el de yaw, la diferencia de rumbos.
+ *
+ * Uso: ahrs_test [-b]
+ */
+
+#include "Estimators/ahrs.h"
+#include "test.h"
+#include <math.h>
+
+#define TEST_DT_US			1000
+#define TEST_RATE_LSB		131.0		///< LSB por grado/s
+#define TEST_ONE_G			16384.0
+#define TEST_SUBSTEPS		10			///< Pasos de integración de la verdad por muestra
+#define BENCH_SAMPLES		200000
+
+/** @brief Actitud verdadera y perturbaciones de la simulación. */
+typedef struct{
+	double q[4];			///< Cuerpo a mundo, w x y z
+	double bias[3];			///< Sesgo del giróscopo, grados/s
+	double linear[3];		///< Aceleración lineal en ejes del cuerpo, g
+	uint32_t seed;
+}s_truth;
+
+/** @brief Errores de una corrida. */
+typedef struct{
+	double tilt;			///< Peor error de inclinación, grados
+	double yaw;				///< Peor error de yaw, grados
+	double norm;			///< Peor desvío del módulo del cuaternión
+}s_error;
+
+static s_ahrs ahrs;
+
+static int Test_Noise(s_truth *t, int amp){
+	t->seed = t->seed * 1664525u + 1013904223u;
+	return (int)((t->seed >> 8) % (2 * amp + 1)) - amp;
+}
+
+/** @brief Gravedad en ejes del cuerpo, la misma expresión que usa AHRS_Update(). */
+static void Test_Gravity(const double q[4], double v[3]){
+	v[0] = 2 * (q[1] * q[3] - q[0] * q[2]);
+	v[1] = 2 * (q[0] * q[1] + q[2] * q[3]);
+	v[2] = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+}
+
+static double Test_Yaw(double q0, double q1, double q2, double q3){
+	return atan2(2 * (q0 * q3 + q1 * q2), 1 - 2 * (q2 * q2 + q3 * q3)) * 180.0 / M_PI;
+}
+
+static void Test_Init(s_truth *t){
+	memset(t, 0, sizeof *t);
+	t->q[0] = 1.0;
+	t->seed = 11;
+	AHRS_Init(&ahrs, TEST_DT_US);
+}
+
+/**
+ * @brief Avanza una muestra con velocidad angular w (grados/s, ejes del cuerpo) y la procesa.
+ */
+static void Test_Step(s_truth *t, const double w[3], s_error *e){
+	double h = TEST_DT_US * 1e-6 / TEST_SUBSTEPS * 0.5 * M_PI / 180.0, v[3], n, dot, err;
+	double vx, vy, vz;
+	int16_t gyro[3], acc[3];
+	float *q = ahrs.q;
+
+	for(uint8_t s = 0; s < TEST_SUBSTEPS; s++){
+		double q0 = t->q[0], q1 = t->q[1], q2 = t->q[2], q3 = t->q[3];
+
+		t->q[0] = q0 - h * (q1 * w[0] + q2 * w[1] + q3 * w[2]);
+		t->q[1] = q1 + h * (q0 * w[0] + q2 * w[2] - q3 * w[1]);
+		t->q[2] = q2 + h * (q0 * w[1] - q1 * w[2] + q3 * w[0]);
+		t->q[3] = q3 + h * (q0 * w[2] + q1 * w[1] - q2 * w[0]);
+		n = sqrt(t->q[0] * t->q[0] + t->q[1] * t->q[1] + t->q[2] * t->q[2] + t->q[3] * t->q[3]);
+		for(uint8_t i = 0; i < 4; i++)
+			t->q[i] /= n;
+	}
+
+	Test_Gravity(t->q, v);
+	for(uint8_t i = 0; i < 3; i++){
+		gyro[i] = (int16_t)lround((w[i] + t->bias[i]) * TEST_RATE_LSB + Test_Noise(t, 3));
+		acc[i] = (int16_t)lround((v[i] + t->linear[i]) * TEST_ONE_G + Test_Noise(t, 40));
+	}
+	AHRS_Update(&ahrs, gyro, acc);
+
+	vx = 2 * (q[1] * q[3] - q[0] * q[2]);
+	vy = 2 * (q[0] * q[1] + q[2] * q[3]);
+	vz = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+	dot = (vx * v[0] + vy * v[1] + vz * v[2]) / sqrt(vx * vx + vy * vy + vz * vz);
+	err = acos(dot > 1.0 ? 1.0 : dot) * 180.0 / M_PI;
+	if(err > e->tilt)
+		e->tilt = err;
+	err = fabs(Test_Yaw(q[0], q[1], q[2], q[3]) - Test_Yaw(t->q[0], t->q[1], t->q[2], t->q[3]));
+	if(err > 180.0)
+		err = 360.0 - err;
+	if(err > e->yaw)
+		e->yaw = err;
+	err = fabs(sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]) - 1.0);
+	if(err > e->norm)
+		e->norm = err;
+}
+
+/** @brief Corre seconds segundos a velocidad angular constante. */
+static void Test_Hold(s_truth *t, double wx, double wy, double wz, double seconds, s_error *e){
+	const double w[3] = {wx, wy, wz};
+
+	for(uint32_t i = 0; i < seconds * 1e6 / TEST_DT_US; i++)
+		Test_Step(t, w, e);
+}
+
+/**
+ * @brief Giros sobre cada eje y un cono, sin sesgo: la inclinación sigue a la verdad y el
+ * yaw, que sólo integra el giróscopo, no se aparta más que el ruido.
+ */
+static void Test_Rotations(void){
+	s_truth t;
+	s_error e = {0}, settled = {0};
+
+	Test_Init(&t);
+	Test_Hold(&t, 0, 0, 0, 2.0, &e);
+	Test_Hold(&t, 90, 0, 0, 0.5, &settled);				// 45 grados sobre X
+	Test_Hold(&t, 0, 60, 0, 0.5, &settled);				// 30 grados sobre Y
+	Test_Hold(&t, 0, 0, 180, 2.0, &settled);			// Una vuelta sobre Z inclinado
+	for(uint32_t i = 0; i < 5000; i++){					// Cono de 5 s
+		double a = 2 * M_PI * 1.0 * i * TEST_DT_US * 1e-6;
+		const double w[3] = {40 * cos(a), 40 * sin(a), 20};
+
+		Test_Step(&t, w, &settled);
+	}
+	Test_Hold(&t, -90, 0, 0, 0.5, &settled);
+	Test_Hold(&t, 0, -60, 0, 0.5, &settled);
+	Test_Hold(&t, 0, 0, 0, 2.0, &settled);
+	CHECK(e.tilt < 0.3);
+	CHECK(settled.tilt < 2.0);
+	CHECK(settled.yaw < 2.0);
+	CHECK(settled.norm < 1e-5);
+	printf("ahrs: rotaciones, inclinación %.3f grados, yaw %.3f grados, módulo %.1e\n",
+		   settled.tilt, settled.yaw, settled.norm);
+}
+
+/**
+ * @brief Sesgo de 1.5 grados/s en X e Y con balanceo continuo: el término integral lo
+ * aprende con una constante de tiempo twoKp / twoKi = 50 s y la inclinación deja de tener el
+ * error de régimen sesgo / twoKp.
+ */
+static void Test_Tilt_Bias(void){
+	s_truth t;
+	s_error e = {0}, late = {0};
+
+	Test_Init(&t);
+	t.bias[0] = 1.5;
+	t.bias[1] = -1.5;
+	for(uint32_t i = 0; i < 240000; i++){
+		double a = 2 * M_PI * 0.3 * i * TEST_DT_US * 1e-6;
+		const double w[3] = {25 * sin(a), 15 * cos(a), 0};
+
+		Test_Step(&t, w, i < 200000 ? &e : &late);
+	}
+	CHECK(late.tilt < 0.5);
+	CHECK_NEAR(ahrs.bias[0] * 180.0 / M_PI, 1.5, 0.15);
+	CHECK_NEAR(ahrs.bias[1] * 180.0 / M_PI, -1.5, 0.15);
+	printf("ahrs: sesgo en X e Y, inclinación %.3f grados al final, sesgo %.3f %.3f grados/s\n",
+		   late.tilt, ahrs.bias[0] * 180.0 / M_PI, ahrs.bias[1] * 180.0 / M_PI);
+}
+
+/**
+ * @brief Sesgo de 0.5 grados/s en Z con el robot quieto y nivelado: el acelerómetro no lo
+ * ve y el yaw derivaría 30 grados por minuto; aprendido estando quieto, deja de derivar.
+ */
+static void Test_Yaw_Drift(void){
+	s_truth t;
+	s_error e = {0};
+	double yaw0, yaw1;
+
+	Test_Init(&t);
+	t.bias[2] = 0.5;
+	Test_Hold(&t, 0, 0, 0, 50.0, &e);
+	AHRS_Get_Euler(&ahrs);
+	yaw0 = ahrs.yaw;
+	CHECK(ahrs.isStill);
+	Test_Hold(&t, 0, 0, 0, 10.0, &e);
+	AHRS_Get_Euler(&ahrs);
+	yaw1 = ahrs.yaw;
+	CHECK(fabs(yaw1 - yaw0) / 10.0 < 0.01);
+	CHECK_NEAR(ahrs.yawDrift, 0.5, 0.02);
+	CHECK(e.tilt < 0.3);
+
+	// Al moverse deja de aprender pero conserva lo aprendido
+	Test_Hold(&t, 0, 0, 90, 4.0, &e);
+	CHECK(!ahrs.isStill);
+	CHECK_NEAR(ahrs.bias[2] * 180.0 / M_PI, 0.5, 0.02);
+	printf("ahrs: sesgo en Z, deriva del yaw %.4f grados/s (sin compensar 0.5), estimado %.3f grados/s\n",
+		   (yaw1 - yaw0) / 10.0, ahrs.yawDrift);
+}
+
+/**
+ * @brief Aceleración lineal de 0.6g: fuera de la tolerancia de 1g, no se corrige con ella
+ * y la inclinación no se va hacia el vector aparente.
+ */
+static void Test_Linear_Acceleration(void){
+	s_truth t;
+	s_error e = {0};
+
+	Test_Init(&t);
+	Test_Hold(&t, 0, 0, 0, 2.0, &e);
+	t.linear[0] = 0.6;
+	Test_Hold(&t, 0, 0, 0, 1.0, &e);
+	t.linear[0] = 0.0;
+	Test_Hold(&t, 0, 0, 0, 1.0, &e);
+	CHECK(e.tilt < 0.3);
+}
+
+/**
+ * @brief AHRS_Reset_Yaw() lleva el rumbo a cero sin cambiar la inclinación.
+ */
+static void Test_Reset_Yaw(void){
+	s_truth t;
+	s_error e = {0};
+	float pitch, roll;
+
+	Test_Init(&t);
+	Test_Hold(&t, 60, 0, 0, 0.5, &e);
+	Test_Hold(&t, 0, 0, 90, 1.0, &e);
+	AHRS_Get_Euler(&ahrs);
+	pitch = ahrs.pitch;
+	roll = ahrs.roll;
+	CHECK(fabsf(ahrs.yaw) > 45.0f);
+	AHRS_Reset_Yaw(&ahrs);
+	AHRS_Get_Euler(&ahrs);
+	CHECK_NEAR(ahrs.yaw, 0.0, 1e-3);
+	CHECK_NEAR(ahrs.pitch, pitch, 1e-3);
+	CHECK_NEAR(ahrs.roll, roll, 1e-3);
+}
+
+/** @brief Costo de AHRS_Update() y AHRS_Get_Euler() en tiempo y ciclos. */
+static void Test_Bench(void){
+	static int16_t gyro[BENCH_SAMPLES][3], acc[BENCH_SAMPLES][3];
+	s_truth t;
+	uint64_t t0, t1, c0, c1;
+
+	Test_Init(&t);
+	for(uint32_t i = 0; i < BENCH_SAMPLES; i++){
+		double a = 2 * M_PI * 0.5 * i * TEST_DT_US * 1e-6;
+
+		gyro[i][0] = (int16_t)lround(30 * cos(a) * TEST_RATE_LSB + Test_Noise(&t, 3));
+		gyro[i][1] = (int16_t)Test_Noise(&t, 3);
+		gyro[i][2] = (int16_t)lround(20 * TEST_RATE_LSB);
+		acc[i][0] = (int16_t)Test_Noise(&t, 40);
+		acc[i][1] = (int16_t)lround(TEST_ONE_G * sin(0.3 * sin(a)) + Test_Noise(&t, 40));
+		acc[i][2] = (int16_t)lround(TEST_ONE_G * cos(0.3 * sin(a)) + Test_Noise(&t, 40));
+	}
+
+	AHRS_Init(&ahrs, TEST_DT_US);
+	t0 = Test_Now_Ns();
+	c0 = Test_Cycles();
+	for(uint32_t i = 0; i < BENCH_SAMPLES; i++)
+		AHRS_Update(&ahrs, gyro[i], acc[i]);
+	c1 = Test_Cycles();
+	t1 = Test_Now_Ns();
+	Test_Keep(&ahrs);
+	printf("ahrs: AHRS_Update %.1f ns, %.1f ciclos por muestra\n",
+		   (double)(t1 - t0) / BENCH_SAMPLES, (double)(c1 - c0) / BENCH_SAMPLES);
+
+	t0 = Test_Now_Ns();
+	c0 = Test_Cycles();
+	for(uint32_t i = 0; i < BENCH_SAMPLES; i++){
+		AHRS_Get_Euler(&ahrs);
+		Test_Keep(&ahrs);
+	}
+	c1 = Test_Cycles();
+	t1 = Test_Now_Ns();
+	printf("ahrs: AHRS_Get_Euler %.1f ns, %.1f ciclos\n",
+		   (double)(t1 - t0) / BENCH_SAMPLES, (double)(c1 - c0) / BENCH_SAMPLES);
+}
+
+int main(int argc, char **argv){
+	if(argc > 1 && !strcmp(argv[1], "-b")){
+		Test_Bench();
+		return 0;
+	}
+	Test_Rotations();
+	Test_Tilt_Bias();
+	Test_Yaw_Drift();
+	Test_Linear_Acceleration();
+	Test_Reset_Yaw();
+	return Test_Summary("ahrs_test");
+}
@@ -0,0 +1,133 @@
+/**
+ * @file crc_test.c
+ * @brief Pruebas de crc.c en la PC: valores de verificación, equivalencia contra una
+ * implementación bit a bit, cálculo por partes y medición.
+ *
+ * Uso: crc_test [-b]
+ */
+
+#include "CRC/crc.h"
+#include "test.h"
+#include <stdlib.h>
+
+#define RANDOM_CASES		20000
+#define BENCH_SIZE			(1u << 20)
+
+static uint32_t seed = 3;
+
+static uint32_t Test_Rand(void){
+	seed = seed * 1664525u + 1013904223u;
+	return seed >> 8;
+}
+
+/** @brief CRC-16/CCITT-FALSE de referencia, bit a bit. */
+static uint16_t Ref_CRC16(const uint8_t *data, uint32_t len){
+	uint16_t crc = 0xFFFF;
+
+	while(len--){
+		crc ^= (uint16_t)(*data++ << 8);
+		for(uint8_t b = 0; b < 8; b++)
+			crc = crc & 0x8000 ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+	}
+	return crc;
+}
+
+/** @brief CRC-32C de referencia, bit a bit y reflejado. */
+static uint32_t Ref_CRC32C(const uint8_t *data, uint32_t len){
+	uint32_t crc = 0xFFFFFFFFUL;
+
+	while(len--){
+		crc ^= *data++;
+		for(uint8_t b = 0; b < 8; b++)
+			crc = crc & 1 ? (crc >> 1) ^ 0x82F63B78UL : crc >> 1;
+	}
+	return crc ^ 0xFFFFFFFFUL;
+}
+
+static void Test_Check_Values(void){
+	static const uint8_t check[] = "123456789";
+
+	CHECK(CRC16_Update(CRC16_INIT, check, 9) == 0x29B1);
+	CHECK(CRC32C_Update(CRC32C_INIT, check, 9) == 0xE3069283UL);
+	CHECK(CRC16_Update(CRC16_INIT, check, 0) == CRC16_INIT);
+	CHECK(CRC32C_Update(CRC32C_INIT, check, 0) == CRC32C_INIT);
+}
+
+/**
+ * @brief Largos y alineaciones al azar, partidos en dos o tres tramos al azar.
+ */
+static void Test_Random(void){
+	static uint8_t buffer[600];
+	uint32_t offset, len, cut1, cut2;
+	uint16_t crc16;
+	uint32_t crc32;
+
+	for(uint32_t i = 0; i < sizeof buffer; i++)
+		buffer[i] = (uint8_t)Test_Rand();
+
+	for(uint32_t i = 0; i < RANDOM_CASES; i++){
+		offset = Test_Rand() % 8;
+		len = Test_Rand() % (sizeof buffer - 8);
+		cut1 = len ? Test_Rand() % (len + 1) : 0;
+		cut2 = cut1 + (len - cut1 ? Test_Rand() % (len - cut1 + 1) : 0);
+
+		crc16 = CRC16_Update(CRC16_INIT, &buffer[offset], len);
+		crc32 = CRC32C_Update(CRC32C_INIT, &buffer[offset], len);
+		CHECK(crc16 == Ref_CRC16(&buffer[offset], len));
+		CHECK(crc32 == Ref_CRC32C(&buffer[offset], len));
+
+		// Por partes, como el buffer circular cuando la trama da la vuelta
+		CHECK(CRC16_Update(CRC16_Update(CRC16_Update(CRC16_INIT, &buffer[offset], cut1),
+										&buffer[offset + cut1], cut2 - cut1),
+						   &buffer[offset + cut2], len - cut2) == crc16);
+		CHECK(CRC32C_Update(CRC32C_Update(CRC32C_Update(CRC32C_INIT, &buffer[offset], cut1),
+										  &buffer[offset + cut1], cut2 - cut1),
+							&buffer[offset + cut2], len - cut2) == crc32);
+		if(testFails)
+			break;
+	}
+}
+
+static void Test_Bench(void){
+	static const uint32_t sizes[] = {16, 64, 256, BENCH_SIZE};
+	uint8_t *data = malloc(BENCH_SIZE);
+	volatile uint32_t sink = 0;
+	uint64_t start, ns[4];
+
+	for(uint32_t i = 0; i < BENCH_SIZE; i++)
+		data[i] = (uint8_t)Test_Rand();
+
+	for(uint32_t s = 0; s < sizeof sizes / sizeof sizes[0]; s++){
+		uint32_t reps = (64u << 20) / sizes[s];
+
+		start = Test_Now_Ns();
+		for(uint32_t r = 0; r < reps; r++)
+			sink += CRC16_Update(CRC16_INIT, data, sizes[s]);
+		ns[0] = Test_Now_Ns() - start;
+		start = Test_Now_Ns();
+		for(uint32_t r = 0; r < reps; r++)
+			sink += CRC32C_Update(CRC32C_INIT, data, sizes[s]);
+		ns[1] = Test_Now_Ns() - start;
+		start = Test_Now_Ns();
+		for(uint32_t r = 0; r < reps / 16; r++)
+			sink += Ref_CRC16(data, sizes[s]);
+		ns[2] = (Test_Now_Ns() - start) * 16;
+		start = Test_Now_Ns();
+		for(uint32_t r = 0; r < reps / 16; r++)
+			sink += Ref_CRC32C(data, sizes[s]);
+		ns[3] = (Test_Now_Ns() - start) * 16;
+
+		printf("crc: bloques de %7u bytes  CRC16 %7.1f MB/s (bit a bit %6.1f)  CRC32C %7.1f MB/s (bit a bit %6.1f)\n",
+			   sizes[s], (64u << 20) * 1e3 / ns[0], (64u << 20) * 1e3 / ns[2],
+			   (64u << 20) * 1e3 / ns[1], (64u << 20) * 1e3 / ns[3]);
+	}
+	free(data);
+}
+
+int main(int argc, char **argv){
+	Test_Check_Values();
+	Test_Random();
+	if(argc > 1 && !strcmp(argv[1], "-b"))
+		Test_Bench();
+	return Test_Summary("crc_test");
+}
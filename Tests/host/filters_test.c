@@ -0,0 +1,390 @@
+/**
+ * @file filters_test.c
+ * @brief Pruebas y mediciones de los filtros de filters.c.
+ *
+ * Cada filtro se compara con una referencia directa: la media móvil y la mediana contra la
+ * ventana recalculada y ordenada en cada trama, el IIR contra float y el biquad contra double
+ * con los coeficientes sin cuantizar. La media móvil además se compara con los lazos que
+ * reemplazó en ADC_Conversion_Cplt() y MPU6050_MAF().
+ *
+ * En la PC se compila la versión portable; en el Cortex-M4 la de SMLALD, SSUB16 y SEL da el
+ * mismo resultado bit a bit. Con -b mide cada filtro por trama contra los lazos anteriores.
+ */
+
+#include "Filters/filters.h"
+#include "ADC/ADC_handler.h"
+#include "test.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define TEST_FRAMES			20000
+#define TEST_CHANNELS		9		///< Como el ADC: impar, el último canal de la mediana va solo
+#define TEST_IMU_AXIS		6
+#define TEST_IMU_BITS		3
+#define BENCH_REPS			50
+
+static int16_t input[TEST_FRAMES][TEST_CHANNELS];
+static int16_t output[TEST_FRAMES][TEST_CHANNELS];
+static uint32_t lcg = 777;
+
+static uint32_t Test_Rand(void){
+	lcg = lcg * 1664525u + 1013904223u;
+	return lcg >> 8;
+}
+
+/**
+ * @brief Señal de prueba: senoidales de distinta frecuencia por canal, ruido y picos aislados.
+ *
+ * @param amplitude Amplitud de la senoidal.
+ * @param offset Valor medio.
+ * @param spikes Con TRUE agrega picos de una muestra.
+ */
+static void Test_Signal(int32_t amplitude, int32_t offset, uint8_t spikes){
+	for(uint32_t i = 0; i < TEST_FRAMES; i++){
+		for(uint16_t ch = 0; ch < TEST_CHANNELS; ch++){
+			double v = offset + amplitude * sin(i * 0.003 * (ch + 1)) + (int32_t)(Test_Rand() % 201) - 100;
+
+			if(spikes && Test_Rand() % 50 == 0)
+				v += Test_Rand() % 2 ? 8000 : -8000;
+			input[i][ch] = (int16_t)(v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v);
+		}
+	}
+}
+
+/* Lazos de antes de filters.c, tal cual: sirven de referencia y para la medición */
+
+static uint16_t oldAdcBuffer[ADC_MEDIA_SIZE][ADC_NUM_SENSORS];
+static uint16_t oldAdcSum[ADC_NUM_SENSORS];
+static uint8_t oldAdcIndex;
+
+static void Old_Adc_Conversion_Cplt(uint16_t *rawData, uint16_t *filtredData){
+	for(uint8_t channel = 0; channel < ADC_NUM_SENSORS; channel++){
+		oldAdcSum[channel] -= oldAdcBuffer[oldAdcIndex][channel];
+		oldAdcSum[channel] += rawData[channel];
+		oldAdcBuffer[oldAdcIndex][channel] = rawData[channel];
+		filtredData[channel] = (oldAdcSum[channel] >> ADC_DESPLAZAMIENTOS);
+	}
+	oldAdcIndex++;
+	oldAdcIndex &= (ADC_MEDIA_SIZE - 1);
+}
+
+static int16_t oldImuBuffer[1 << TEST_IMU_BITS][TEST_IMU_AXIS];
+static int32_t oldImuSum[TEST_IMU_AXIS];
+static uint8_t oldImuIndex;
+
+static void Old_MPU6050_MAF(const int16_t *rawData, int16_t *filtredData){
+	for(uint8_t axis = 0; axis < TEST_IMU_AXIS; axis++){
+		oldImuSum[axis] -= oldImuBuffer[oldImuIndex][axis];
+		oldImuSum[axis] += rawData[axis];
+		oldImuBuffer[oldImuIndex][axis] = rawData[axis];
+		filtredData[axis] = (oldImuSum[axis] >> TEST_IMU_BITS);
+	}
+	oldImuIndex++;
+	oldImuIndex &= ((1 << TEST_IMU_BITS) - 1);
+}
+
+/**
+ * @brief Biquad directo, canal por canal y sin pares: como quedaría escrito sin filters.c.
+ */
+static void Old_Biquad(int16_t state[][4], const int16_t coef[5], const int16_t *in, int16_t *out, uint16_t channels){
+	for(uint16_t ch = 0; ch < channels; ch++){
+		int16_t *s = state[ch];
+		int64_t acc = (int32_t)coef[0] * in[ch] + (int32_t)coef[1] * s[0] + (int32_t)coef[2] * s[1]
+					- (int32_t)coef[3] * s[2] - (int32_t)coef[4] * s[3];
+		int32_t y = (int32_t)((acc + (1 << 13)) >> 14);
+
+		y = y > INT16_MAX ? INT16_MAX : y < INT16_MIN ? INT16_MIN : y;
+		s[1] = s[0];
+		s[0] = in[ch];
+		s[3] = s[2];
+		s[2] = (int16_t)y;
+		out[ch] = (int16_t)y;
+	}
+}
+
+static int Test_Compare_I16(const void *a, const void *b){
+	return *(const int16_t*)a - *(const int16_t*)b;
+}
+
+/**
+ * @brief Mediana con la ventana copiada y ordenada: la de referencia.
+ */
+static int16_t Old_Median(const int16_t *window, uint8_t size){
+	int16_t sorted[FILTER_MEDIAN_MAX];
+
+	memcpy(sorted, window, size * sizeof(int16_t));
+	qsort(sorted, size, sizeof(int16_t), Test_Compare_I16);
+	return sorted[size / 2];
+}
+
+/**
+ * @brief Media móvil contra la suma recalculada, por bloques y en el lugar.
+ */
+static void Test_Maf(void){
+	static int16_t history[1 << ADC_DESPLAZAMIENTOS][TEST_CHANNELS];
+	static int16_t inPlace[TEST_FRAMES][TEST_CHANNELS];
+	int32_t sum[TEST_CHANNELS];
+	uint16_t oldOut[TEST_CHANNELS];
+	uint32_t wrong = 0, mismatches = 0, window = 1 << ADC_DESPLAZAMIENTOS;
+	s_filterMaf maf;
+
+	// Datos de 12 bits como los del ADC
+	Test_Signal(1800, 2048, FALSE);
+	Filter_Maf_Init(&maf, &history[0][0], sum, TEST_CHANNELS, ADC_DESPLAZAMIENTOS);
+	for(uint32_t i = 0; i < TEST_FRAMES; i += 100)
+		Filter_Maf_Process(&maf, input[i], output[i], 100);
+
+	for(uint32_t i = 0; i < TEST_FRAMES; i++){
+		Old_Adc_Conversion_Cplt((uint16_t*)input[i], oldOut);
+		for(uint16_t ch = 0; ch < TEST_CHANNELS; ch++){
+			int32_t ref = 0;
+
+			for(uint32_t k = 0; k < window && k <= i; k++)
+				ref += input[i - k][ch];
+			if(output[i][ch] != ref >> ADC_DESPLAZAMIENTOS)
+				mismatches++;
+			if(oldOut[ch] != ref >> ADC_DESPLAZAMIENTOS)
+				wrong++;
+		}
+	}
+	CHECK(mismatches == 0);
+	// La suma de 16 bits del lazo anterior desbordaba con 32 muestras de 12 bits
+	CHECK(wrong > 0);
+
+	// En el lugar y de a una trama da lo mismo
+	memcpy(inPlace, input, sizeof inPlace);
+	Filter_Maf_Init(&maf, &history[0][0], sum, TEST_CHANNELS, ADC_DESPLAZAMIENTOS);
+	for(uint32_t i = 0; i < TEST_FRAMES; i++)
+		Filter_Maf_Process(&maf, inPlace[i], inPlace[i], 1);
+	CHECK(!memcmp(inPlace, output, sizeof inPlace));
+	printf("filters: media móvil exacta; el lazo anterior del ADC erraba %u de %u salidas\n",
+		   (unsigned)wrong, TEST_FRAMES * TEST_CHANNELS);
+
+	// Datos del IMU con signo y fondo de escala: idéntica al lazo anterior de MPU6050_MAF()
+	Test_Signal(32000, 0, TRUE);
+	Filter_Maf_Init(&maf, &history[0][0], sum, TEST_IMU_AXIS, TEST_IMU_BITS);
+	mismatches = 0;
+	for(uint32_t i = 0; i < TEST_FRAMES; i++){
+		int16_t ref[TEST_IMU_AXIS], out[TEST_IMU_AXIS];
+
+		Old_MPU6050_MAF(input[i], ref);
+		Filter_Maf_Process(&maf, input[i], out, 1);
+		mismatches += memcmp(ref, out, sizeof out) != 0;
+	}
+	CHECK(mismatches == 0);
+}
+
+/**
+ * @brief IIR de primer orden contra float.
+ */
+static void Test_Iir(void){
+	const float alphas[] = {0.5f, 0.1f, 0.01f};
+	int32_t state[TEST_CHANNELS];
+	s_filterIir iir;
+	double worst = 0;
+
+	Test_Signal(20000, 0, FALSE);
+	for(uint8_t a = 0; a < sizeof alphas / sizeof alphas[0]; a++){
+		float ref[TEST_CHANNELS];
+		double alpha = FILTER_Q15(alphas[a]) / 32768.0;
+
+		Filter_Iir_Init(&iir, state, TEST_CHANNELS, FILTER_Q15(alphas[a]));
+		Filter_Iir_Process(&iir, input[0], output[0], TEST_FRAMES);
+		for(uint16_t ch = 0; ch < TEST_CHANNELS; ch++)
+			ref[ch] = input[0][ch];
+		for(uint32_t i = 0; i < TEST_FRAMES; i++){
+			for(uint16_t ch = 0; ch < TEST_CHANNELS; ch++){
+				ref[ch] += (float)(alpha * (input[i][ch] - ref[ch]));
+				if(fabs(output[i][ch] - ref[ch]) > worst)
+					worst = fabs(output[i][ch] - ref[ch]);
+			}
+		}
+	}
+	CHECK(worst < 1.0);
+
+	// Un alfa chico llega igual al escalón: el estado guarda 15 bits de fracción
+	for(uint32_t i = 0; i < TEST_FRAMES; i++)
+		input[i][0] = i ? 1000 : 0;
+	Filter_Iir_Init(&iir, state, 1, FILTER_Q15(0.001f));
+	for(uint32_t i = 0; i < TEST_FRAMES; i++)
+		Filter_Iir_Process(&iir, input[i], output[i], 1);
+	CHECK(output[TEST_FRAMES - 1][0] == 1000);
+	printf("filters: IIR a %.2f LSB de float\n", worst);
+}
+
+/**
+ * @brief Biquad contra double con los coeficientes sin cuantizar, y contra el lazo directo.
+ */
+static void Test_Biquad(void){
+	static int16_t state[TEST_CHANNELS][4], oldState[TEST_CHANNELS][4];
+	const double ratio = 0.02, q = 0.70710678;
+	double w0 = 2 * M_PI * ratio, alpha = sin(w0) / (2 * q), a0 = 1 + alpha;
+	double b[3] = {(1 - cos(w0)) / 2 / a0, (1 - cos(w0)) / a0, (1 - cos(w0)) / 2 / a0};
+	double a[2] = {-2 * cos(w0) / a0, (1 - alpha) / a0};
+	double x[TEST_CHANNELS][2] = {{0}}, y[TEST_CHANNELS][2] = {{0}}, worst = 0, gain;
+	int16_t coef[5], old[TEST_CHANNELS];
+	uint32_t mismatches = 0;
+	s_filterBiquad bq;
+
+	Filter_Biquad_Lowpass(coef, (float)ratio * 1000.0f, 1000.0f, (float)q);
+	for(uint8_t k = 0; k < 3; k++)
+		CHECK(abs(coef[k] - (int16_t)lround(b[k] * 16384)) <= 1);
+	CHECK(abs(coef[3] - (int16_t)lround(a[0] * 16384)) <= 1);
+	CHECK(abs(coef[4] - (int16_t)lround(a[1] * 16384)) <= 1);
+
+	Test_Signal(8000, 0, FALSE);
+	Filter_Biquad_Init(&bq, &state[0][0], TEST_CHANNELS, coef);
+	Filter_Biquad_Process(&bq, input[0], output[0], TEST_FRAMES);
+	for(uint32_t i = 0; i < TEST_FRAMES; i++){
+		Old_Biquad(oldState, coef, input[i], old, TEST_CHANNELS);
+		mismatches += memcmp(old, output[i], sizeof old) != 0;
+		for(uint16_t ch = 0; ch < TEST_CHANNELS; ch++){
+			double v = b[0] * input[i][ch] + b[1] * x[ch][0] + b[2] * x[ch][1] - a[0] * y[ch][0] - a[1] * y[ch][1];
+
+			x[ch][1] = x[ch][0];
+			x[ch][0] = input[i][ch];
+			y[ch][1] = y[ch][0];
+			y[ch][0] = v;
+			if(fabs(output[i][ch] - v) > worst)
+				worst = fabs(output[i][ch] - v);
+		}
+	}
+	CHECK(mismatches == 0);
+	// Límite de Q14 en fc/fs = 0.02, casi independiente de la amplitud: ver Filter_Biquad_Lowpass()
+	CHECK(worst < 24);
+
+	// Ganancia en continua: los coeficientes redondeados no suman exactamente 1
+	for(uint32_t i = 0; i < TEST_FRAMES; i++)
+		input[i][0] = 10000;
+	Filter_Biquad_Init(&bq, &state[0][0], 1, coef);
+	for(uint32_t i = 0; i < TEST_FRAMES; i++)
+		Filter_Biquad_Process(&bq, input[i], output[i], 1);
+	gain = output[TEST_FRAMES - 1][0] / 10000.0;
+	CHECK_NEAR(gain, 0.9974, 0.0005);
+	printf("filters: biquad fc/fs %.2f a %.1f LSB de double, ganancia en continua %.4f\n", ratio, worst, gain);
+
+	// Satura en vez de dar la vuelta
+	for(uint32_t i = 0; i < 200; i++)
+		input[i][0] = i & 8 ? INT16_MAX : INT16_MIN;
+	Filter_Biquad_Lowpass(coef, 200.0f, 1000.0f, 4.0f);
+	Filter_Biquad_Init(&bq, &state[0][0], 1, coef);
+	memset(oldState, 0, sizeof oldState);
+	for(uint32_t i = 0; i < 200; i++){
+		Old_Biquad(oldState, coef, input[i], old, 1);
+		Filter_Biquad_Process(&bq, input[i], output[i], 1);
+		mismatches += old[0] != output[i][0];
+	}
+	CHECK(mismatches == 0);
+}
+
+/**
+ * @brief Mediana de 3 y de 5 contra la ventana ordenada, con una cantidad impar de canales.
+ */
+static void Test_Median(void){
+	static int16_t history[FILTER_MEDIAN_MAX][TEST_CHANNELS];
+	const uint8_t sizes[] = {3, 5};
+	s_filterMedian med;
+	uint32_t mismatches = 0;
+
+	CHECK(Filter_Median_Init(&med, &history[0][0], TEST_CHANNELS, 4) == SYS_ERROR);
+	Test_Signal(30000, 0, TRUE);
+	for(uint8_t s = 0; s < sizeof sizes; s++){
+		uint8_t size = sizes[s];
+
+		CHECK(Filter_Median_Init(&med, &history[0][0], TEST_CHANNELS, size) == SYS_OK);
+		Filter_Median_Process(&med, input[0], output[0], TEST_FRAMES);
+		for(uint32_t i = 0; i < TEST_FRAMES; i++){
+			for(uint16_t ch = 0; ch < TEST_CHANNELS; ch++){
+				int16_t window[FILTER_MEDIAN_MAX];
+
+				// Antes de llenar la ventana el historial tiene ceros
+				for(uint8_t k = 0; k < size; k++)
+					window[k] = k <= i ? input[i - k][ch] : 0;
+				mismatches += Old_Median(window, size) != output[i][ch];
+			}
+		}
+	}
+	CHECK(mismatches == 0);
+}
+
+/**
+ * @brief Tiempo por trama de cada filtro contra el lazo que reemplaza.
+ */
+static void Test_Bench(void){
+	static int16_t history[1 << ADC_DESPLAZAMIENTOS][TEST_CHANNELS], state[TEST_CHANNELS][4];
+	int32_t sum[TEST_CHANNELS];
+	int16_t coef[5];
+	uint64_t t[9];
+	s_filterMaf maf;
+	s_filterBiquad bq;
+	s_filterMedian med;
+
+	Test_Signal(1800, 2048, FALSE);
+	Filter_Biquad_Lowpass(coef, 20.0f, 1000.0f, 0.7071f);
+
+	t[0] = Test_Now_Ns();
+	for(uint32_t r = 0; r < BENCH_REPS; r++)
+		for(uint32_t i = 0; i < TEST_FRAMES; i++)
+			Old_Adc_Conversion_Cplt((uint16_t*)input[i], (uint16_t*)output[i]);
+	t[1] = Test_Now_Ns();
+	Filter_Maf_Init(&maf, &history[0][0], sum, TEST_CHANNELS, ADC_DESPLAZAMIENTOS);
+	for(uint32_t r = 0; r < BENCH_REPS; r++)
+		for(uint32_t i = 0; i < TEST_FRAMES; i++)
+			Filter_Maf_Process(&maf, input[i], output[i], 1);
+	t[2] = Test_Now_Ns();
+	for(uint32_t r = 0; r < BENCH_REPS; r++)
+		for(uint32_t i = 0; i < TEST_FRAMES; i++)
+			Old_MPU6050_MAF(input[i], output[i]);
+	t[3] = Test_Now_Ns();
+	Filter_Maf_Init(&maf, &history[0][0], sum, TEST_IMU_AXIS, TEST_IMU_BITS);
+	for(uint32_t r = 0; r < BENCH_REPS; r++)
+		for(uint32_t i = 0; i < TEST_FRAMES; i++)
+			Filter_Maf_Process(&maf, input[i], output[i], 1);
+	t[4] = Test_Now_Ns();
+	memset(state, 0, sizeof state);
+	for(uint32_t r = 0; r < BENCH_REPS; r++)
+		for(uint32_t i = 0; i < TEST_FRAMES; i++)
+			Old_Biquad(state, coef, input[i], output[i], TEST_IMU_AXIS);
+	t[5] = Test_Now_Ns();
+	Filter_Biquad_Init(&bq, &state[0][0], TEST_IMU_AXIS, coef);
+	for(uint32_t r = 0; r < BENCH_REPS; r++)
+		Filter_Biquad_Process(&bq, input[0], output[0], TEST_FRAMES);
+	t[6] = Test_Now_Ns();
+	for(uint32_t r = 0; r < BENCH_REPS; r++){
+		for(uint32_t i = 0; i < TEST_FRAMES; i++){
+			for(uint16_t ch = 0; ch < TEST_IMU_AXIS; ch++){
+				int16_t window[5];
+
+				for(uint8_t k = 0; k < 5; k++)
+					window[k] = input[i >= k ? i - k : 0][ch];
+				output[i][ch] = Old_Median(window, 5);
+			}
+		}
+	}
+	t[7] = Test_Now_Ns();
+	Filter_Median_Init(&med, &history[0][0], TEST_IMU_AXIS, 5);
+	for(uint32_t r = 0; r < BENCH_REPS; r++)
+		Filter_Median_Process(&med, input[0], output[0], TEST_FRAMES);
+	t[8] = Test_Now_Ns();
+	Test_Keep(output);
+
+#define NS(k)	((double)(t[k + 1] - t[k]) / (BENCH_REPS * TEST_FRAMES))
+	printf("filters: ns por trama, anterior / filters.c\n");
+	printf("  media ADC 9 canales   %6.1f / %6.1f\n", NS(0), NS(1));
+	printf("  media IMU 6 ejes      %6.1f / %6.1f\n", NS(2), NS(3));
+	printf("  biquad 6 ejes         %6.1f / %6.1f\n", NS(4), NS(5));
+	printf("  mediana 5, 6 ejes     %6.1f / %6.1f\n", NS(6), NS(7));
+#undef NS
+}
+
+int main(int argc, char **argv){
+	if(argc > 1 && !strcmp(argv[1], "-b")){
+		Test_Bench();
+		return 0;
+	}
+	Test_Maf();
+	Test_Iir();
+	Test_Biquad();
+	Test_Median();
+	return Test_Summary("filters_test");
+}
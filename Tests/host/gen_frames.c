@@ -0,0 +1,59 @@
+/**
+ * @file gen_frames.c
+ * @brief Genera un registro sintético de cuadros crudos del MPU6050 para replay.
+ *
+ * Cuadros de 14 bytes big endian (acc x y z, temperatura, gyro x y z), como los de la FIFO y
+ * del canal TLM_IMU_RAW: un vaivén de inclinación de 0.3 rad sobre X, visto por el acelerómetro y
+ * con su velocidad angular coherente en el giróscopo, ruido uniforme y una rampa de temperatura. El ruido sale de un generador
+ * congruencial propio para que el archivo sea idéntico en cualquier PC.
+ *
+ * Uso: gen_frames <salida.bin> [cuadros]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+static uint32_t seed = 1;
+
+static int Noise(int amplitude){
+	seed = seed * 1664525u + 1013904223u;
+	return (int)((seed >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+int main(int argc, char **argv){
+	unsigned long frames = argc > 2 ? strtoul(argv[2], NULL, 0) : 4000;
+	uint8_t frame[14];
+	FILE *out;
+
+	if(argc < 2){
+		fprintf(stderr, "uso: %s <salida.bin> [cuadros]\n", argv[0]);
+		return 2;
+	}
+	out = fopen(argv[1], "wb");
+	if(out == NULL){
+		perror(argv[1]);
+		return 1;
+	}
+
+	for(unsigned long i = 0; i < frames; i++){
+		double t = i * 1e-3, angle = 0.3 * sin(t * 2);
+		int16_t w[7] = {
+			Noise(50),
+			(int16_t)lround(16384 * sin(angle)) + Noise(50),
+			(int16_t)lround(16384 * cos(angle)) + Noise(50),
+			(int16_t)(-2000 + i / 100),
+			(int16_t)lround(0.6 * cos(t * 2) * 180 / M_PI * 131) + Noise(10),
+			Noise(10),
+			Noise(10)};
+
+		for(int j = 0; j < 7; j++){
+			frame[2 * j] = (uint8_t)((uint16_t)w[j] >> 8);
+			frame[2 * j + 1] = (uint8_t)w[j];
+		}
+		fwrite(frame, 1, sizeof frame, out);
+	}
+	fclose(out);
+	return 0;
+}
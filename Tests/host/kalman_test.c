@@ -0,0 +1,269 @@
+/**
+ * @file kalman_test.c
+ * @brief Pruebas de kalman.c en la PC: la versión en punto fijo contra la de referencia en
+ * float, precisión de Kalman_Atan2(), Kalman_Acc_Pitch() y Kalman_Gyro_Rate(), y medición.
+ *
+ * Las dos versiones reciben exactamente las mismas mediciones (las de punto fijo pasadas a
+ * float) de un balanceo sintético de ±30 grados con ruido y sesgo del giróscopo, así la
+ * diferencia es sólo la del redondeo de la aritmética.
+ *
+ * Uso: kalman_test [-b]
+ */
+
+#include "Estimators/kalman.h"
+#include "test.h"
+#include <stdlib.h>
+#include <math.h>
+
+#define TEST_SAMPLES		60000
+#define TEST_DT_US			1000
+#define TEST_GYRO_LSB		131.0		///< LSB por grado/s a ±250 grados/s
+#define TEST_BIAS			2.5			///< Sesgo del giróscopo, grados/s
+#define TEST_FILTER_TOL		0.001		///< Diferencia admitida entre las dos versiones, grados
+#define TEST_BIAS_TOL		0.01		///< Diferencia admitida en el sesgo, grados/s
+#define TEST_ATAN_TOL		0.002		///< Error admitido de la arcotangente, grados
+#define BENCH_REPS			20
+
+typedef struct{
+	int16_t acc[3];
+	int16_t gyro;
+}s_imuSample;
+
+static s_imuSample samples[TEST_SAMPLES];
+static uint32_t seed = 7;
+
+static uint32_t Test_Rand(void){
+	seed = seed * 1664525u + 1013904223u;
+	return seed >> 8;
+}
+
+/** @brief Ruido uniforme entre -amp y amp. */
+static int Test_Noise(int amp){
+	return (int)(Test_Rand() % (2 * amp + 1)) - amp;
+}
+
+static double Q16_To_Deg(int32_t value){
+	return value / 65536.0;
+}
+
+/** @brief Balanceo de ±30 grados sobre X a 0.4 Hz, con un escalón a los 40 s. */
+static void Test_Generate(void){
+	const double dt = TEST_DT_US * 1e-6, w = 2 * M_PI * 0.4;
+
+	for(uint32_t i = 0; i < TEST_SAMPLES; i++){
+		double t = i * dt;
+		double angle = 30.0 * sin(w * t) + (t >= 40.0 ? 15.0 : 0.0);
+		double rate = 30.0 * w * cos(w * t);						// grados/s
+		double rad = angle * M_PI / 180.0;
+
+		samples[i].acc[0] = (int16_t)(Test_Noise(60));
+		samples[i].acc[1] = (int16_t)lround(16384.0 * sin(rad) + Test_Noise(60));
+		samples[i].acc[2] = (int16_t)lround(16384.0 * cos(rad) + Test_Noise(60));
+		samples[i].gyro = (int16_t)lround((rate + TEST_BIAS) * TEST_GYRO_LSB + Test_Noise(15));
+	}
+}
+
+/**
+ * @brief Arcotangente en los cuatro cuadrantes y en todo el rango de magnitudes.
+ */
+static void Test_Atan2(void){
+	static const int32_t radius[] = {1000, 16384, 32767, 1 << 20, 0x7FFFFFFF};
+	double worst = 0, err;
+	int32_t x, y;
+
+	CHECK(Kalman_Atan2(0, 0) == 0);
+	CHECK(Kalman_Atan2(0, 5) == 0);
+	CHECK(Kalman_Atan2(5, 0) == 90 << 16);
+	CHECK(Kalman_Atan2(-5, 0) == -(90 << 16));
+	CHECK(Kalman_Atan2(0, -5) == 180 << 16);
+	for(uint32_t r = 0; r < sizeof radius / sizeof radius[0]; r++){
+		for(int32_t step = -36000; step <= 36000; step += 7){
+			double a = step * 0.005 * M_PI / 180.0;
+
+			x = (int32_t)lround(radius[r] * cos(a) * 0.999);
+			y = (int32_t)lround(radius[r] * sin(a) * 0.999);
+			if(!x && !y)
+				continue;
+			err = Q16_To_Deg(Kalman_Atan2(y, x)) - atan2(y, x) * 180.0 / M_PI;
+			// En ±180 grados ambos resultados son válidos
+			if(err > 180)
+				err -= 360;
+			if(err < -180)
+				err += 360;
+			err = fabs(err);
+			if(err > worst)
+				worst = err;
+		}
+	}
+	CHECK(worst < TEST_ATAN_TOL);
+	printf("kalman: error máximo de Kalman_Atan2 %.4f grados\n", worst);
+}
+
+/**
+ * @brief Pitch del acelerómetro y escala del giróscopo contra el cálculo en double.
+ */
+static void Test_Conversions(void){
+	double worst = 0, err, expected;
+
+	for(uint32_t i = 0; i < TEST_SAMPLES; i += 3){
+		const s_imuSample *s = &samples[i];
+
+		expected = atan2(s->acc[1], sqrt((double)s->acc[0] * s->acc[0] + (double)s->acc[2] * s->acc[2])) * 180.0 / M_PI;
+		err = fabs(Q16_To_Deg(Kalman_Acc_Pitch(s->acc[0], s->acc[1], s->acc[2])) - expected);
+		if(err > worst)
+			worst = err;
+	}
+	// La raíz entera agrega hasta media unidad sobre ~16384
+	CHECK(worst < TEST_ATAN_TOL + 0.002);
+	printf("kalman: error máximo de Kalman_Acc_Pitch %.4f grados\n", worst);
+	CHECK(Kalman_Acc_Pitch(0, 0, 0) == 0);
+	CHECK(Kalman_Acc_Pitch(-32768, -32768, -32768) < 0);
+
+	for(int32_t raw = -32768; raw <= 32767; raw += 97)
+		CHECK_NEAR(Q16_To_Deg(Kalman_Gyro_Rate((int16_t)raw, KALMAN_GYRO_250DPS)), raw / TEST_GYRO_LSB, 1e-5 * abs(raw) + 2e-5);
+}
+
+/**
+ * @brief Mismas mediciones por las dos versiones: ángulo y sesgo coinciden en cada muestra.
+ *
+ * @param dt_us Período de muestreo.
+ */
+static void Test_Against_Float(uint32_t dt_us){
+	s_kalman fixed;
+	s_kalmanFloat ref;
+	double worst = 0, worstBias = 0, err;
+	int32_t angle, rate;
+
+	Kalman_Init(&fixed, dt_us);
+	Kalman_Float_Init(&ref, dt_us * 1e-6f);
+	for(uint32_t i = 0; i < TEST_SAMPLES; i++){
+		const s_imuSample *s = &samples[i];
+
+		angle = Kalman_Acc_Pitch(s->acc[0], s->acc[1], s->acc[2]);
+		rate = Kalman_Gyro_Rate(s->gyro, KALMAN_GYRO_250DPS);
+		err = fabs(Q16_To_Deg(Kalman_Update(&fixed, angle, rate)) -
+				   Kalman_Float_Update(&ref, (float)Q16_To_Deg(angle), (float)Q16_To_Deg(rate)));
+		if(err > worst)
+			worst = err;
+		err = fabs(Q16_To_Deg(fixed.bias) - ref.bias);
+		if(err > worstBias)
+			worstBias = err;
+	}
+	CHECK(worst < TEST_FILTER_TOL);
+	CHECK(worstBias < TEST_BIAS_TOL);
+	CHECK_NEAR(fixed.P[0][0] / 1073741824.0, ref.P[0][0], 1e-5);
+	CHECK_NEAR(fixed.P[1][1] / 1073741824.0, ref.P[1][1], 1e-5);
+	printf("kalman: dt %u us, diferencia máxima con float %.5f grados, sesgo %.5f grados/s\n",
+		   (unsigned)dt_us, worst, worstBias);
+}
+
+/**
+ * @brief El filtro sigue el balanceo y estima el sesgo del giróscopo.
+ */
+static void Test_Tracking(void){
+	s_kalman k;
+	double err, worst = 0, t, truth;
+
+	Kalman_Init(&k, TEST_DT_US);
+	for(uint32_t i = 0; i < TEST_SAMPLES; i++){
+		const s_imuSample *s = &samples[i];
+
+		Kalman_Update(&k, Kalman_Acc_Pitch(s->acc[0], s->acc[1], s->acc[2]),
+					  Kalman_Gyro_Rate(s->gyro, KALMAN_GYRO_250DPS));
+		t = i * TEST_DT_US * 1e-6;
+		truth = 30.0 * sin(2 * M_PI * 0.4 * t) + (t >= 40.0 ? 15.0 : 0.0);
+		// Fuera del arranque y del escalón, que el filtro sigue con su propia dinámica
+		if(t > 20.0 && (t < 40.0 || t > 45.0)){
+			err = fabs(Q16_To_Deg(k.angle) - truth);
+			if(err > worst)
+				worst = err;
+		}
+	}
+	CHECK(worst < 0.5);
+	CHECK_NEAR(Q16_To_Deg(k.bias), TEST_BIAS, 0.1);
+}
+
+/**
+ * @brief Cambio de período en marcha: sigue igual a la referencia con el período nuevo.
+ */
+static void Test_Set_Period(void){
+	s_kalman fixed;
+	s_kalmanFloat ref;
+	double worst = 0, err;
+	int32_t angle, rate;
+
+	Kalman_Init(&fixed, TEST_DT_US);
+	Kalman_Float_Init(&ref, TEST_DT_US * 1e-6f);
+	for(uint32_t i = 0; i < TEST_SAMPLES; i++){
+		const s_imuSample *s = &samples[i];
+
+		if(i == TEST_SAMPLES / 2){
+			Kalman_Set_Period(&fixed, 2 * TEST_DT_US);
+			ref.dt = 2 * TEST_DT_US * 1e-6f;
+		}
+		angle = Kalman_Acc_Pitch(s->acc[0], s->acc[1], s->acc[2]);
+		rate = Kalman_Gyro_Rate(s->gyro, KALMAN_GYRO_250DPS);
+		err = fabs(Q16_To_Deg(Kalman_Update(&fixed, angle, rate)) -
+				   Kalman_Float_Update(&ref, (float)Q16_To_Deg(angle), (float)Q16_To_Deg(rate)));
+		if(err > worst)
+			worst = err;
+	}
+	CHECK(worst < TEST_FILTER_TOL);
+}
+
+/** @brief Costo de una actualización de cada versión y de las conversiones. */
+static void Test_Bench(void){
+	static int32_t angle[TEST_SAMPLES], rate[TEST_SAMPLES];
+	static float angleF[TEST_SAMPLES], rateF[TEST_SAMPLES];
+	s_kalman fixed;
+	s_kalmanFloat ref;
+	uint64_t t0, t1, t2, t3;
+	int32_t sink = 0;
+	float sinkF = 0;
+
+	for(uint32_t i = 0; i < TEST_SAMPLES; i++){
+		angle[i] = Kalman_Acc_Pitch(samples[i].acc[0], samples[i].acc[1], samples[i].acc[2]);
+		rate[i] = Kalman_Gyro_Rate(samples[i].gyro, KALMAN_GYRO_250DPS);
+		angleF[i] = (float)Q16_To_Deg(angle[i]);
+		rateF[i] = (float)Q16_To_Deg(rate[i]);
+	}
+
+	t0 = Test_Now_Ns();
+	for(uint32_t r = 0; r < BENCH_REPS; r++){
+		Kalman_Init(&fixed, TEST_DT_US);
+		for(uint32_t i = 0; i < TEST_SAMPLES; i++)
+			sink += Kalman_Update(&fixed, angle[i], rate[i]);
+	}
+	t1 = Test_Now_Ns();
+	for(uint32_t r = 0; r < BENCH_REPS; r++){
+		Kalman_Float_Init(&ref, TEST_DT_US * 1e-6f);
+		for(uint32_t i = 0; i < TEST_SAMPLES; i++)
+			sinkF += Kalman_Float_Update(&ref, angleF[i], rateF[i]);
+	}
+	t2 = Test_Now_Ns();
+	for(uint32_t r = 0; r < BENCH_REPS; r++){
+		for(uint32_t i = 0; i < TEST_SAMPLES; i++)
+			sink += Kalman_Acc_Pitch(samples[i].acc[0], samples[i].acc[1], samples[i].acc[2]);
+	}
+	t3 = Test_Now_Ns();
+	Test_Keep(&sink);
+	Test_Keep(&sinkF);
+	printf("kalman: Kalman_Update %.1f ns, Kalman_Float_Update %.1f ns, Kalman_Acc_Pitch %.1f ns\n",
+		   (double)(t1 - t0) / (BENCH_REPS * TEST_SAMPLES), (double)(t2 - t1) / (BENCH_REPS * TEST_SAMPLES),
+		   (double)(t3 - t2) / (BENCH_REPS * TEST_SAMPLES));
+}
+
+int main(int argc, char **argv){
+	Test_Generate();
+	if(argc > 1 && !strcmp(argv[1], "-b")){
+		Test_Bench();
+		return 0;
+	}
+	Test_Atan2();
+	Test_Conversions();
+	Test_Against_Float(TEST_DT_US);
+	Test_Against_Float(4 * TEST_DT_US);
+	Test_Tracking();
+	Test_Set_Period();
+	return Test_Summary("kalman_test");
+}
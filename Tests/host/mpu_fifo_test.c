@@ -0,0 +1,412 @@
+/**
+ * @file mpu_fifo_test.c
+ * @brief Pruebas del modo FIFO de mpu6050.c contra un MPU6050 simulado a nivel de registros.
+ *
+ * El simulador guarda los registros que escribe el driver, arma una muestra de 14 bytes por
+ * milisegundo en una FIFO de MPU_FIFO_SIZE bytes mientras FIFO_EN y USER_CTRL la habilitan,
+ * y al llenarse pisa el byte más viejo como el sensor real: como 1024 no es múltiplo de 14,
+ * después de un desborde la FIFO deja de empezar en el borde de una muestra. FIFO_COUNTH y
+ * FIFO_R_W se leen como en el sensor y USER_CTRL con FIFO_RESET la vacía.
+ *
+ * Las transferencias DMA terminan unos ticks de 250 us después, según los bytes a 400 kHz, y
+ * entonces se llama a MPU6050_I2C_DMA_Cplt(), como en los callbacks de main.c. Cada muestra
+ * lleva su número de secuencia y un patrón que se verifica byte a byte con MPU6050_Get_Frame():
+ * una muestra desalineada o repetida se detecta enseguida.
+ *
+ * También se prueba la vigilancia del modo data-ready, que vuelve a las lecturas periódicas
+ * cuando dejan de llegar flancos del pin INT.
+ */
+
+#include "I2C/MPU6050/mpu6050.h"
+#include "test.h"
+
+#define SIM_TICKS_PER_SAMPLE	4		///< TIM1 a 4 kHz y muestreo a 1 kHz
+#define SIM_US_PER_TICK			250
+#define SIM_US_PER_BYTE			23		///< 9 bits a 400 kHz
+
+/** @brief Estado del sensor simulado. */
+typedef struct{
+	uint8_t reg[128];				///< Registros escritos por el driver
+	uint8_t fifo[MPU_FIFO_SIZE];
+	uint16_t read;					///< Próximo byte a leer de la FIFO
+	uint16_t count;					///< Bytes en la FIFO
+	uint32_t seq;					///< Número de la próxima muestra
+	uint32_t resets;				///< Veces que se vació la FIFO con FIFO_RESET
+	uint32_t dmaTicks;				///< Ticks que le faltan a la transferencia en curso, 0 libre
+	uint8_t failNext;				///< La próxima transferencia DMA falla al arrancar
+	uint32_t tick;
+}s_mpuSim;
+
+/** @brief Resultado de consumir las muestras con MPU6050_MAF(). */
+typedef struct{
+	uint32_t samples;				///< Muestras entregadas
+	uint32_t bad;					///< Muestras que no coinciden con ninguna generada
+	uint32_t missing;				///< Muestras salteadas entre entregadas consecutivas
+	uint32_t gaps;					///< Saltos en la secuencia
+	uint32_t last;					///< Secuencia de la última entregada
+	uint8_t hasLast;
+}s_consumer;
+
+static s_mpuSim sim;
+static s_MPU mpu;
+static s_consumer use;
+
+/** @brief Muestra número seq tal como sale del sensor, en big-endian. */
+static void Sim_Frame(uint32_t seq, uint8_t frame[MPU_FIFO_FRAME]){
+	uint16_t word[MPU_FRAME_WORDS] = {
+		(uint16_t)seq, (uint16_t)(seq >> 16), (uint16_t)(16384 + (seq % 97)),
+		(uint16_t)((seq * 2654435761u) >> 16),
+		(uint16_t)(seq * 31), (uint16_t)-(int32_t)(seq % 1000), (uint16_t)(seq ^ 0x5A5A)
+	};
+
+	for(uint8_t i = 0; i < MPU_FRAME_WORDS; i++){
+		frame[2 * i] = (uint8_t)(word[i] >> 8);
+		frame[2 * i + 1] = (uint8_t)word[i];
+	}
+}
+
+static void Sim_Push(uint8_t byte){
+	sim.fifo[(sim.read + sim.count) % MPU_FIFO_SIZE] = byte;
+	if(sim.count == MPU_FIFO_SIZE)
+		sim.read = (sim.read + 1) % MPU_FIFO_SIZE;		// Pisa el byte más viejo
+	else
+		sim.count++;
+}
+
+static uint8_t Sim_Pop(void){
+	uint8_t byte;
+
+	if(!sim.count)
+		return 0xFF;
+	byte = sim.fifo[sim.read];
+	sim.read = (sim.read + 1) % MPU_FIFO_SIZE;
+	sim.count--;
+	return byte;
+}
+
+static void Sim_Write(uint8_t reg, const uint8_t *data, uint16_t len){
+	for(uint16_t i = 0; i < len; i++, reg++){
+		sim.reg[reg & 0x7F] = data[i];
+		if(reg == USER_CTRL && (data[i] & USER_CTRL_FIFO_RESET)){
+			sim.read = 0;
+			sim.count = 0;
+			sim.resets++;
+			sim.reg[USER_CTRL] &= (uint8_t)~USER_CTRL_FIFO_RESET;
+		}
+	}
+}
+
+static void Sim_Read(uint8_t reg, uint8_t *data, uint16_t len){
+	for(uint16_t i = 0; i < len; i++){
+		if(reg == FIFO_R_W){
+			data[i] = Sim_Pop();						// FIFO_R_W no avanza la dirección
+			continue;
+		}
+		if(reg == FIFO_COUNTH)
+			data[i] = (uint8_t)(sim.count >> 8);
+		else if(reg == FIFO_COUNTH + 1)
+			data[i] = (uint8_t)sim.count;
+		else if(reg == WHO_AM_I_MPU6050)
+			data[i] = WHO_AM_I_DEFAULT_VALUE;
+		else
+			data[i] = sim.reg[reg & 0x7F];
+		reg++;
+	}
+}
+
+static e_system Sim_Write_Blocking(uint16_t dev, uint8_t reg, uint8_t size, uint8_t *data, uint16_t len, uint32_t timeout){
+	(void)dev; (void)size; (void)timeout;
+	Sim_Write(reg, data, len);
+	return SYS_OK;
+}
+
+static e_system Sim_Read_Blocking(uint16_t dev, uint8_t reg, uint8_t size, uint8_t *data, uint16_t len, uint32_t timeout){
+	(void)dev; (void)size; (void)timeout;
+	Sim_Read(reg, data, len);
+	return SYS_OK;
+}
+
+/** @brief Arranca una transferencia DMA; los datos se mueven ya y el fin llega más tarde. */
+static e_system Sim_DMA_Start(uint16_t len){
+	CHECK(sim.dmaTicks == 0);								// El driver nunca solapa transferencias
+	if(sim.dmaTicks)
+		return SYS_BUSY;
+	if(sim.failNext){
+		sim.failNext = FALSE;
+		return SYS_ERROR;
+	}
+	sim.dmaTicks = 1 + (len + 2) * SIM_US_PER_BYTE / SIM_US_PER_TICK;
+	return SYS_OK;
+}
+
+static e_system Sim_DMA_Write(uint16_t dev, uint8_t reg, uint8_t *data, uint16_t len){
+	e_system status = Sim_DMA_Start(len);
+
+	(void)dev;
+	if(status == SYS_OK)
+		Sim_Write(reg, data, len);
+	return status;
+}
+
+static e_system Sim_DMA_Read(uint16_t dev, uint8_t reg, uint8_t *data, uint16_t len){
+	e_system status = Sim_DMA_Start(len);
+
+	(void)dev;
+	if(status == SYS_OK)
+		Sim_Read(reg, data, len);
+	return status;
+}
+
+/** @brief Saca del driver las muestras listas y las compara con las generadas. */
+static void Test_Consume(void){
+	uint8_t frame[MPU_FIFO_FRAME], expected[MPU_FIFO_FRAME];
+	uint32_t seq;
+
+	while(MPU6050_MAF(&mpu)){
+		MPU6050_Get_Frame(&mpu, frame);
+		seq = (uint32_t)((frame[0] << 8) | frame[1]) | (uint32_t)((frame[2] << 8) | frame[3]) << 16;
+		Sim_Frame(seq, expected);
+		use.samples++;
+		if(memcmp(frame, expected, MPU_FIFO_FRAME) || seq >= sim.seq || (use.hasLast && seq <= use.last)){
+			use.bad++;
+			continue;
+		}
+		if(use.hasLast && seq != use.last + 1){
+			use.missing += seq - use.last - 1;
+			use.gaps++;
+		}
+		use.last = seq;
+		use.hasLast = TRUE;
+	}
+}
+
+/**
+ * @brief Avanza la simulación.
+ *
+ * @param ticks Ticks de 250 us a simular.
+ * @param pollTicks Cada cuántos ticks se llama a MPU6050_FIFO_Start_Read(), 0 nunca.
+ * @param consume Si el lazo principal saca las muestras con MPU6050_MAF().
+ */
+static void Test_Run(uint32_t ticks, uint32_t pollTicks, uint8_t consume){
+	uint8_t frame[MPU_FIFO_FRAME];
+
+	for(uint32_t t = 0; t < ticks; t++, sim.tick++){
+		if(sim.tick % SIM_TICKS_PER_SAMPLE == 0){
+			if((sim.reg[USER_CTRL] & USER_CTRL_FIFO_EN) && sim.reg[FIFO_EN] == FIFO_EN_ACCEL_TEMP_GYRO){
+				Sim_Frame(sim.seq, frame);
+				for(uint8_t i = 0; i < MPU_FIFO_FRAME; i++)
+					Sim_Push(frame[i]);
+			}
+			sim.seq++;
+		}
+		if(sim.dmaTicks && !--sim.dmaTicks)
+			MPU6050_I2C_DMA_Cplt(&mpu);
+		if(pollTicks && sim.tick % pollTicks == 0)
+			MPU6050_FIFO_Start_Read(&mpu);
+		if(consume)
+			Test_Consume();
+	}
+}
+
+/** @brief Deja que termine lo que esté en curso y saca todo lo pendiente. */
+static void Test_Settle(void){
+	Test_Run(200, 8, TRUE);
+}
+
+static void Test_Init(void){
+	memset(&sim, 0, sizeof sim);
+	memset(&use, 0, sizeof use);
+	MPU6050_Set_I2C_Communication(Sim_Write_Blocking, Sim_Read_Blocking);
+	MPU6050_Set_I2C_DMA(Sim_DMA_Write, Sim_DMA_Read);
+	CHECK(MPU6050_Init(&mpu) == SYS_OK);
+	CHECK(MPU6050_FIFO_Enable(&mpu) == SYS_OK);
+	CHECK(sim.reg[FIFO_EN] == FIFO_EN_ACCEL_TEMP_GYRO && (sim.reg[USER_CTRL] & USER_CTRL_FIFO_EN));
+	CHECK(sim.resets == 1);
+}
+
+/**
+ * @brief Lectura cada 2 ms: todas las muestras llegan en orden, sin desbordes ni descartes.
+ */
+static void Test_Steady(void){
+	Test_Init();
+	Test_Run(40000, 8, TRUE);
+	Test_Settle();
+	CHECK(use.samples > 10000 - 10);
+	CHECK(use.bad == 0 && use.gaps == 0);
+	CHECK(mpu.FIFO.overflows == 0 && mpu.FIFO.dropped == 0);
+	CHECK(sim.resets == 1);
+	CHECK(use.last + 1 + sim.count / MPU_FIFO_FRAME >= sim.seq - 2);	// Lo que falta sigue en la FIFO
+}
+
+/**
+ * @brief Atraso de 60 ms, menos de lo que llena la FIFO: se pone al día de a MPU_FIFO_BURST
+ * muestras por lectura sin perder ninguna.
+ */
+static void Test_Catch_Up(void){
+	uint32_t resets;
+
+	Test_Init();
+	Test_Run(400, 8, TRUE);
+	resets = sim.resets;
+	Test_Run(60 * SIM_TICKS_PER_SAMPLE, 0, TRUE);
+	CHECK(sim.count == 60 * MPU_FIFO_FRAME || sim.count == 61 * MPU_FIFO_FRAME);
+	Test_Run(400, 8, TRUE);
+	CHECK(sim.count < 4 * MPU_FIFO_FRAME);
+	Test_Settle();
+	CHECK(use.bad == 0 && use.gaps == 0);
+	CHECK(mpu.FIFO.overflows == 0 && sim.resets == resets);
+}
+
+/**
+ * @brief Atraso de 120 ms: la FIFO desborda y queda desalineada. El driver lo detecta por la
+ * cuenta, la vacía y sigue con muestras enteras; se pierde sólo lo del desborde.
+ */
+static void Test_Overflow(void){
+	uint32_t resets, before;
+
+	Test_Init();
+	Test_Run(400, 8, TRUE);
+	Test_Settle();
+	resets = sim.resets;
+	before = use.samples;
+
+	Test_Run(120 * SIM_TICKS_PER_SAMPLE, 0, TRUE);
+	CHECK(sim.count == MPU_FIFO_SIZE);
+	CHECK(sim.read % MPU_FIFO_FRAME != 0);					// Sin vaciarla, se leerían muestras corridas
+	CHECK(use.samples == before);
+
+	Test_Run(2000, 8, TRUE);
+	Test_Settle();
+	CHECK(mpu.FIFO.overflows == 1);
+	CHECK(sim.resets == resets + 1);
+	CHECK(use.bad == 0);
+	CHECK(use.gaps == 1);
+	CHECK(use.missing >= 120 && use.missing < 130);
+	CHECK(use.samples - before > 500 - 20);
+	CHECK(mpu.FIFO.state == MPU_FIFO_IDLE);
+}
+
+/**
+ * @brief El lazo principal deja de consumir: la cola del driver se llena y descarta lo que
+ * no entra, sin tocar la FIFO del sensor. Al volver sigue desde la muestra siguiente.
+ */
+static void Test_Queue_Full(void){
+	uint32_t dropped;
+
+	Test_Init();
+	Test_Run(400, 8, TRUE);
+	Test_Run(100 * SIM_TICKS_PER_SAMPLE, 8, FALSE);
+	dropped = mpu.FIFO.dropped;
+	CHECK(dropped >= 100 - MPU_QUEUE_SIZE - 2 && dropped <= 100 - MPU_QUEUE_SIZE + 2);
+	CHECK(mpu.FIFO.overflows == 0);
+	Test_Run(400, 8, TRUE);
+	Test_Settle();
+	CHECK(use.bad == 0 && use.gaps == 1 && use.missing == dropped);
+}
+
+/**
+ * @brief Falla del bus al arrancar una lectura: el driver queda libre y la próxima lectura
+ * trae lo acumulado.
+ */
+static void Test_Bus_Error(void){
+	Test_Init();
+	Test_Run(400, 8, TRUE);
+	Test_Run(7, 0, TRUE);
+	sim.failNext = TRUE;
+	CHECK(!MPU6050_FIFO_Start_Read(&mpu));
+	CHECK(mpu.FIFO.state == MPU_FIFO_IDLE);
+	Test_Run(400, 8, TRUE);
+	Test_Settle();
+	CHECK(use.bad == 0 && use.gaps == 0 && mpu.FIFO.overflows == 0);
+}
+
+/**
+ * @brief Cambio de configuración en marcha: se escribe intercalado con las lecturas, se vacía
+ * la FIFO medida con la configuración anterior y las muestras siguen enteras.
+ */
+static void Test_Configure(void){
+	uint32_t resets;
+	uint8_t changes;
+
+	Test_Init();
+	Test_Run(400, 8, TRUE);
+	resets = sim.resets;
+	changes = mpu.Config.changes;
+	CHECK(MPU6050_Configure(&mpu, MPU_ACC_4G, MPU_GYRO_500DPS, MPU_DLPF_94HZ, 0) == SYS_OK);
+	Test_Run(400, 8, TRUE);
+	Test_Settle();
+	CHECK(sim.reg[ACCEL_CONFIG_REG] == MPU_ACC_4G << 3 && sim.reg[GYRO_CONFIG_REG] == MPU_GYRO_500DPS << 3);
+	CHECK(sim.resets == resets + 1);
+	CHECK(mpu.Config.changes == (uint8_t)(changes + 1));
+	CHECK(use.bad == 0 && use.gaps <= 1 && use.missing < 8);
+	CHECK(mpu.FIFO.overflows == 0);
+}
+
+/** @brief Tick del último flanco del pin INT en modo data-ready. */
+static uint32_t lastIrqTick;
+
+/**
+ * @brief Avanza en modo data-ready como el TIM1 de main.c: vigila cada 1 ms y, si isPinOn,
+ * el pin INT da un flanco por muestra.
+ *
+ * @return TRUE si MPU6050_DataReady_Watchdog() dejó el modo; la simulación se detiene ahí.
+ */
+static uint8_t Test_Run_DataReady(uint32_t ticks, uint8_t isPinOn){
+	for(uint32_t t = 0; t < ticks; t++, sim.tick++){
+		if(sim.dmaTicks && !--sim.dmaTicks)
+			MPU6050_I2C_DMA_Cplt(&mpu);
+		if(isPinOn && sim.tick % SIM_TICKS_PER_SAMPLE == 0){
+			MPU6050_DataReady_IRQ(&mpu);
+			lastIrqTick = sim.tick;
+		}
+		if(sim.tick % SIM_TICKS_PER_SAMPLE == 1 &&
+		   MPU6050_DataReady_Watchdog(&mpu, SIM_TICKS_PER_SAMPLE * SIM_US_PER_TICK))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/**
+ * @brief Sin flancos en el pin INT se deja el modo data-ready a los MPU_DRDY_TIMEOUT_PERIODS
+ * períodos; con flancos, o con un hueco más corto, sigue.
+ */
+static void Test_DataReady_Watchdog(void){
+	uint32_t samples, silence;
+
+	memset(&sim, 0, sizeof sim);
+	MPU6050_Set_I2C_Communication(Sim_Write_Blocking, Sim_Read_Blocking);
+	MPU6050_Set_I2C_DMA(Sim_DMA_Write, Sim_DMA_Read);
+	CHECK(MPU6050_Init(&mpu) == SYS_OK);
+	CHECK(MPU6050_DataReady_Enable(&mpu) == SYS_OK);
+	CHECK(mpu.Config.samplePeriod == 1000);
+
+	CHECK(!Test_Run_DataReady(4000, TRUE));
+	samples = mpu.DRDY.samples;
+	CHECK(samples >= 990 && mpu.DRDY.isOn);
+
+	// Un hueco de la mitad del límite no alcanza
+	CHECK(!Test_Run_DataReady(MPU_DRDY_TIMEOUT_PERIODS / 2 * SIM_TICKS_PER_SAMPLE, FALSE));
+	CHECK(!Test_Run_DataReady(400, TRUE) && mpu.DRDY.isOn);
+	CHECK(mpu.DRDY.samples > samples);
+
+	// El pin deja de dar flancos: se sale entre MPU_DRDY_TIMEOUT_PERIODS y uno más
+	CHECK(Test_Run_DataReady(1000, FALSE));
+	silence = sim.tick - lastIrqTick;
+	CHECK(!mpu.DRDY.isOn);
+	CHECK(silence >= MPU_DRDY_TIMEOUT_PERIODS * SIM_TICKS_PER_SAMPLE && silence <= (MPU_DRDY_TIMEOUT_PERIODS + 1) * SIM_TICKS_PER_SAMPLE);
+	CHECK(!MPU6050_DataReady_IRQ(&mpu));						// Un flanco tardío se ignora
+	CHECK(!MPU6050_DataReady_Watchdog(&mpu, 1000000));
+	Test_Run_DataReady(20, FALSE);
+	CHECK(sim.dmaTicks == 0);
+}
+
+int main(void){
+	Test_Steady();
+	Test_Catch_Up();
+	Test_Overflow();
+	Test_Queue_Full();
+	Test_Bus_Error();
+	Test_Configure();
+	Test_DataReady_Watchdog();
+	return Test_Summary("mpu_fifo_test");
+}
@@ -0,0 +1,324 @@
+/**
+ * @file param_store_test.c
+ * @brief Pruebas del almacén de parámetros sobre una flash en RAM con cortes de energía.
+ *
+ * La flash simulada se comporta como la NOR del STM32: el borrado deja todo en 0xFF y grabar
+ * sólo puede bajar bits. Un corte de energía en la operación n deja esa operación a medias
+ * (una palabra con parte de sus bits grabados, o un sector borrado hasta la mitad) y ninguna
+ * de las siguientes llega a la flash.
+ *
+ * Se corre un guion fijo de escrituras, borrados de claves y compactaciones cortándolo en
+ * cada una de sus operaciones de flash. Después de cada corte se vuelve a montar la misma
+ * imagen con Param_Init(): cada clave tiene que valer lo último que se confirmó, o el valor
+ * nuevo si el corte fue durante su escritura, y el almacén tiene que seguir aceptando datos.
+ */
+
+#include "Storage/param_store.h"
+#include "test.h"
+
+#define TEST_SECTOR_SIZE	1024
+#define TEST_KEYS			6
+#define TEST_MAX_LEN		48
+#define TEST_STEPS			160
+#define TEST_NO_CUT			0xFFFFFFFFU
+#define TEST_ERASED			0xFFFFFFFFU
+
+/** @brief Un paso del guion: compacta, o guarda len bytes en key (len 0 borra la clave). */
+typedef struct{
+	uint8_t isCompact;
+	uint8_t key;
+	uint16_t len;
+	uint8_t data[TEST_MAX_LEN];
+}s_testStep;
+
+/** @brief Valores confirmados, como los debería devolver el almacén. */
+typedef struct{
+	uint16_t len[TEST_KEYS];
+	uint8_t data[TEST_KEYS][TEST_MAX_LEN];
+}s_testModel;
+
+static uint8_t image[PARAM_SECTORS][TEST_SECTOR_SIZE] __attribute__((aligned(4)));
+static uint32_t ops, cutAt = TEST_NO_CUT;
+static uint32_t erases, overwrites;
+static uint8_t isDead;
+static uint32_t lcg = 2026;
+static s_testStep script[TEST_STEPS];
+
+static uint32_t Test_Rand(void){
+	lcg = lcg * 1664525u + 1013904223u;
+	return lcg >> 8;
+}
+
+/** @brief Cuenta la operación; devuelve TRUE si es la que corta la energía. */
+static uint8_t Test_Is_Cut(void){
+	return ops++ == cutAt;
+}
+
+static e_system Test_Erase(uint8_t sector){
+	if(isDead || sector >= PARAM_SECTORS)
+		return SYS_ERROR;
+	if(Test_Is_Cut()){
+		// Borrado interrumpido: un prefijo de largo cualquiera queda en 0xFF
+		memset(image[sector], 0xFF, (Test_Rand() % (TEST_SECTOR_SIZE / 4)) * 4);
+		isDead = TRUE;
+		return SYS_ERROR;
+	}
+	memset(image[sector], 0xFF, TEST_SECTOR_SIZE);
+	erases++;
+	return SYS_OK;
+}
+
+static e_system Test_Program(const uint8_t *address, uint32_t word){
+	uint32_t old;
+	uint8_t *p = NULL;
+
+	for(uint8_t s = 0; s < PARAM_SECTORS; s++){
+		if(address >= image[s] && address + 4 <= image[s] + TEST_SECTOR_SIZE)
+			p = image[s] + (address - image[s]);
+	}
+	if(isDead || !p || ((uintptr_t)p & 3))
+		return SYS_ERROR;
+
+	memcpy(&old, p, 4);
+	if(old != TEST_ERASED)
+		overwrites++;
+	if(Test_Is_Cut()){
+		// Grabación interrumpida: sólo baja una parte de los bits
+		word |= Test_Rand() | Test_Rand() << 16;
+		isDead = TRUE;
+	}
+	old &= word;
+	memcpy(p, &old, 4);
+	return isDead ? SYS_ERROR : SYS_OK;
+}
+
+static const s_paramFlash flash = {
+	.sector = {image[0], image[1]},
+	.sectorSize = TEST_SECTOR_SIZE,
+	.Erase = Test_Erase,
+	.Program = Test_Program
+};
+
+/** @brief Flash virgen y sin cortes programados. */
+static void Test_Blank(void){
+	memset(image, 0xFF, sizeof image);
+	ops = 0;
+	cutAt = TEST_NO_CUT;
+	isDead = FALSE;
+	erases = 0;
+}
+
+/** @brief Vuelve la energía y monta otra vez la misma imagen. */
+static void Test_Reboot(s_paramStore *store){
+	isDead = FALSE;
+	cutAt = TEST_NO_CUT;
+	CHECK(Param_Init(store, &flash) == SYS_OK);
+}
+
+/** @brief Graba una palabra en la imagen por fuera del almacén, para armar casos. */
+static void Test_Poke(uint8_t sector, uint32_t offset, uint32_t word){
+	memcpy(&image[sector][offset], &word, 4);
+}
+
+static uint8_t Test_Has(s_paramStore *store, uint8_t key, const uint8_t *data, uint16_t len){
+	uint8_t value[PARAM_MAX_SIZE];
+
+	return Param_Get(store, key, value, sizeof value) == len && !memcmp(value, data, len);
+}
+
+static void Test_Make_Script(void){
+	for(uint32_t i = 0; i < TEST_STEPS; i++){
+		s_testStep *step = &script[i];
+
+		step->isCompact = i % 37 == 36;
+		step->key = Test_Rand() % TEST_KEYS;
+		step->len = Test_Rand() % 8 ? 1 + Test_Rand() % TEST_MAX_LEN : 0;
+		for(uint16_t b = 0; b < step->len; b++)
+			step->data[b] = (uint8_t)Test_Rand();
+	}
+}
+
+/**
+ * @brief Corre el guion cortando la energía en la operación cut y verifica la recuperación.
+ *
+ * @return Operaciones de flash que usó el guion hasta terminar o hasta el corte.
+ */
+static uint32_t Test_Power_Cut(uint32_t cut){
+	s_paramStore store;
+	s_testModel model = {0};
+	const s_testStep *inFlight = NULL;
+	uint32_t used;
+	uint8_t value[TEST_MAX_LEN] = {0x5A, 0xA5, 0x3C};
+
+	Test_Blank();
+	cutAt = cut;
+	if(Param_Init(&store, &flash) == SYS_OK){
+		for(uint32_t i = 0; i < TEST_STEPS && !isDead; i++){
+			const s_testStep *step = &script[i];
+			e_system status;
+
+			inFlight = step->isCompact ? NULL : step;
+			status = step->isCompact ? Param_Compact(&store) : Param_Set(&store, step->key, step->data, step->len);
+			if(isDead)
+				break;
+			CHECK(status == SYS_OK);
+			if(!step->isCompact){
+				model.len[step->key] = step->len;
+				memcpy(model.data[step->key], step->data, step->len);
+			}
+			inFlight = NULL;
+		}
+	}
+	used = ops;
+	if(cut == TEST_NO_CUT)
+		CHECK(!isDead);
+
+	Test_Reboot(&store);
+	// Un corte deja a lo sumo un registro a medias
+	CHECK(store.corrupted <= 1);
+	for(uint8_t key = 0; key < TEST_KEYS; key++){
+		uint8_t isOld = Test_Has(&store, key, model.data[key], model.len[key]);
+		uint8_t isNew = inFlight && inFlight->key == key && Test_Has(&store, key, inFlight->data, inFlight->len);
+
+		CHECK(isOld || isNew);
+	}
+
+	// Sigue aceptando datos y los conserva en el próximo arranque
+	CHECK(Param_Set(&store, 0, value, sizeof value) == SYS_OK);
+	CHECK(Param_Set(&store, TEST_KEYS, value, 1) == SYS_OK);
+	Test_Reboot(&store);
+	CHECK(Test_Has(&store, 0, value, sizeof value));
+	CHECK(Test_Has(&store, TEST_KEYS, value, 1));
+	CHECK(overwrites == 0);
+	return used;
+}
+
+/**
+ * @brief Param_Try_Set() nunca borra: con el sector lleno devuelve SYS_BUSY y no toca nada.
+ */
+static void Test_Try_Set(void){
+	s_paramStore store;
+	uint8_t value[32];
+	uint32_t count = 0;
+	e_system status;
+
+	Test_Blank();
+	CHECK(Param_Init(&store, &flash) == SYS_OK);
+	CHECK(erases == 1);
+
+	memset(value, 0, sizeof value);
+	do{
+		value[0] = (uint8_t)++count;
+		status = Param_Try_Set(&store, 1, value, sizeof value);
+	}while(status == SYS_OK);
+	CHECK(status == SYS_BUSY);
+	CHECK(count == (TEST_SECTOR_SIZE - PARAM_HEADER_SIZE) / (PARAM_RECORD_OVERHEAD + sizeof value) + 1);
+	CHECK(erases == 1 && store.compactions == 0);
+	CHECK(Param_Free(&store) < sizeof value);
+
+	// El valor vigente sigue siendo el último que entró; uno igual no necesita lugar
+	value[0] = (uint8_t)(count - 1);
+	CHECK(Test_Has(&store, 1, value, sizeof value));
+	CHECK(Param_Try_Set(&store, 1, value, sizeof value) == SYS_OK);
+	CHECK(Param_Try_Set(&store, PARAM_MAX_KEYS, value, 1) == SYS_ERROR);
+
+	// Param_Set() sí compacta
+	value[0] = (uint8_t)count;
+	CHECK(Param_Set(&store, 1, value, sizeof value) == SYS_OK);
+	CHECK(erases == 2 && store.compactions == 1);
+	CHECK(store.active == 1 && store.seq == 2);
+	Test_Reboot(&store);
+	CHECK(store.active == 1 && store.seq == 2);
+	CHECK(Test_Has(&store, 1, value, sizeof value));
+}
+
+/**
+ * @brief Elección del sector activo por secuencia y marca.
+ */
+static void Test_Headers(void){
+	s_paramStore store;
+	uint8_t value[8] = "SEQWRAP";
+
+	// La secuencia da la vuelta: 0 es posterior a 0xFFFFFFFF
+	Test_Blank();
+	Test_Poke(0, 0, 0xFFFFFFFFU);
+	Test_Poke(0, 4, PARAM_MAGIC);
+	Test_Poke(1, 0, 0xFFFFFFFEU);
+	Test_Poke(1, 4, PARAM_MAGIC);
+	Test_Reboot(&store);
+	CHECK(store.active == 0 && store.seq == 0xFFFFFFFFU);
+	CHECK(Param_Set(&store, 2, value, sizeof value) == SYS_OK);
+	CHECK(Param_Compact(&store) == SYS_OK);
+	Test_Reboot(&store);
+	CHECK(store.active == 1 && store.seq == 0);
+	CHECK(Test_Has(&store, 2, value, sizeof value));
+
+	// Compactación cortada antes de la marca: la secuencia más alta no cuenta sin PARAM_MAGIC
+	Test_Poke(0, 0, 7);
+	Test_Poke(0, 4, TEST_ERASED);
+	Test_Reboot(&store);
+	CHECK(store.active == 1 && store.seq == 0);
+	CHECK(Test_Has(&store, 2, value, sizeof value));
+
+	// Sin ninguna cabecera válida formatea el primer sector
+	for(uint32_t offset = 0; offset < TEST_SECTOR_SIZE; offset += 4){
+		Test_Poke(0, offset, Test_Rand());
+		Test_Poke(1, offset, Test_Rand());
+	}
+	erases = 0;
+	Test_Reboot(&store);
+	CHECK(erases == 1);
+	CHECK(store.active == 0 && store.seq == 1 && store.writeOffset == PARAM_HEADER_SIZE);
+	CHECK(Param_Get(&store, 2, value, sizeof value) == 0);
+}
+
+/**
+ * @brief Registros dañados después del montaje: CRC y cabecera.
+ */
+static void Test_Corrupted(void){
+	s_paramStore store;
+	uint8_t old[4] = {1, 2, 3, 4}, new[4] = {5, 6, 7, 8};
+	uint32_t offset;
+
+	Test_Blank();
+	CHECK(Param_Init(&store, &flash) == SYS_OK);
+	CHECK(Param_Set(&store, 3, old, 4) == SYS_OK);
+	CHECK(Param_Set(&store, 3, new, 4) == SYS_OK);
+	offset = store.index[3];
+
+	// Un bit bajado en el valor: el CRC lo descarta y vuelve el registro anterior
+	image[0][offset + 4] &= 0xFE;
+	Test_Reboot(&store);
+	CHECK(store.corrupted == 1);
+	CHECK(Test_Has(&store, 3, old, 4));
+	CHECK(store.writeOffset == offset + PARAM_RECORD_OVERHEAD + 4);
+
+	// Cabecera con un largo imposible: no se sabe dónde sigue, el sector queda lleno
+	Test_Poke(0, store.writeOffset, 0x7FFF0003U);
+	Test_Reboot(&store);
+	CHECK(store.corrupted == 2);
+	CHECK(Param_Free(&store) == 0);
+	CHECK(Param_Try_Set(&store, 3, new, 4) == SYS_BUSY);
+	CHECK(Param_Set(&store, 3, new, 4) == SYS_OK);
+	Test_Reboot(&store);
+	CHECK(store.active == 1 && store.corrupted == 0);
+	CHECK(Test_Has(&store, 3, new, 4));
+}
+
+int main(void){
+	uint32_t total, cut;
+
+	Test_Try_Set();
+	Test_Headers();
+	Test_Corrupted();
+
+	Test_Make_Script();
+	overwrites = 0;
+	total = Test_Power_Cut(TEST_NO_CUT);
+	CHECK(total > 1000);
+	for(cut = 0; cut < total; cut++)
+		Test_Power_Cut(cut);
+
+	printf("param_store: %u operaciones de flash en el guion, cortado en cada una\n", (unsigned)total);
+	return Test_Summary("param_store_test");
+}
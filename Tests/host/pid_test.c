@@ -0,0 +1,237 @@
+/**
+ * @file pid_test.c
+ * @brief Pruebas y medición del PID en punto fijo de pid.c.
+ *
+ * La referencia es el mismo algoritmo en double: derivada sobre la medición con su pasabajos,
+ * anti-windup condicional y prealimentación. Se compara paso a paso en lazo cerrado contra una
+ * planta de primer orden con demora, y se verifican por separado cada término y los cambios en
+ * marcha (ganancias, período, límites). Con -b mide PID_Update() en ns y ciclos de la PC.
+ */
+
+#include "Control/pid.h"
+#include "test.h"
+#include <math.h>
+
+#define TEST_DT_US			1000
+#define TEST_STEPS			20000
+#define BENCH_REPS			200
+
+/** @brief PID de referencia en double, mismas ecuaciones que pid.c. */
+typedef struct{
+	s_pidGains gains;
+	double dt, integral, dTerm, prevMeasure, outMin, outMax, output, alpha;
+	uint8_t isInit;
+}s_pidRef;
+
+static void Ref_Init(s_pidRef *ref, const s_pidGains *gains, double dt, double outMin, double outMax, double cutoff){
+	memset(ref, 0, sizeof *ref);
+	ref->gains = *gains;
+	ref->dt = dt;
+	ref->outMin = outMin;
+	ref->outMax = outMax;
+	ref->alpha = cutoff > 0 ? 1.0 - exp(-2.0 * M_PI * cutoff * dt) : 1.0;
+}
+
+static double Ref_Update(s_pidRef *ref, double setpoint, double measure){
+	double error = setpoint - measure, dRaw, out;
+
+	if(!ref->isInit){
+		ref->prevMeasure = measure;
+		ref->isInit = TRUE;
+	}
+	if(!(ref->output >= ref->outMax && error > 0) && !(ref->output <= ref->outMin && error < 0)){
+		ref->integral += ref->gains.ki * ref->dt * error;
+		ref->integral = fmin(fmax(ref->integral, ref->outMin), ref->outMax);
+	}
+	dRaw = ref->gains.kd / ref->dt * (ref->prevMeasure - measure);
+	ref->prevMeasure = measure;
+	ref->dTerm += ref->alpha * (dRaw - ref->dTerm);
+	out = ref->gains.kp * error + ref->integral + ref->dTerm + ref->gains.kff * setpoint;
+	ref->output = fmin(fmax(out, ref->outMin), ref->outMax);
+	return ref->output;
+}
+
+static double Test_Real(int32_t q16){
+	return q16 / 65536.0;
+}
+
+/**
+ * @brief Conversión de las ganancias a punto fijo, con el período incluido.
+ */
+static void Test_Gains(void){
+	s_pidLoop pid;
+	s_pidGains gains = {.kp = 8.0f, .ki = 40.0f, .kd = 0.3f, .kff = -0.25f};
+
+	PID_Init(&pid, TEST_DT_US, PID_Q16(-100), PID_Q16(100));
+	CHECK(pid.kp == 0 && pid.kiDt == 0 && pid.kdFs == 0 && pid.kff == 0);
+	PID_Set_Gains(&pid, &gains);
+	CHECK(pid.kp == 8 << 16);
+	CHECK_NEAR(pid.kiDt, 0.04 * (1 << 30), 64);
+	CHECK_NEAR(pid.kdFs, 300.0 * 65536, 2);
+	CHECK(pid.kff == -(1 << 14));
+
+	// El período entra en las ganancias por muestra
+	PID_Set_Period(&pid, 4 * TEST_DT_US);
+	CHECK_NEAR(pid.kiDt, 0.16 * (1 << 30), 256);
+	CHECK_NEAR(pid.kdFs, 75.0 * 65536, 1);
+
+	// Ganancias fuera de rango saturan en vez de dar la vuelta
+	gains.kd = 1e6f;
+	PID_Set_Gains(&pid, &gains);
+	CHECK(pid.kdFs == INT32_MAX);
+}
+
+/**
+ * @brief Cada término por separado, la derivada sin patada y la saturación.
+ */
+static void Test_Terms(void){
+	s_pidLoop pid;
+	s_pidGains gains = {.kp = 2.0f};
+	int32_t out;
+
+	PID_Init(&pid, TEST_DT_US, PID_Q16(-100), PID_Q16(100));
+	PID_Set_Gains(&pid, &gains);
+	CHECK(PID_Update(&pid, PID_Q16(3), PID_Q16(1), 0) == PID_Q16(4));
+	CHECK(PID_Update(&pid, PID_Q16(3), PID_Q16(1), PID_Q16(5)) == PID_Q16(9));
+	CHECK(PID_Update(&pid, PID_Q16(300), 0, 0) == PID_Q16(100));
+	CHECK(PID_Update(&pid, PID_Q16(-300), 0, 0) == PID_Q16(-100));
+	PID_Set_Limits(&pid, PID_Q16(-5), PID_Q16(5));
+	CHECK(PID_Update(&pid, PID_Q16(300), 0, 0) == PID_Q16(5));
+	PID_Set_Limits(&pid, PID_Q16(-100), PID_Q16(100));
+
+	// Integral: ki * e * t
+	gains = (s_pidGains){.ki = 10.0f};
+	PID_Set_Gains(&pid, &gains);
+	PID_Reset(&pid);
+	for(uint32_t i = 0; i < 500; i++)
+		out = PID_Update(&pid, PID_Q16(2), 0, 0);
+	CHECK_NEAR(Test_Real(out), 10.0 * 2.0 * 0.5, 0.001);
+
+	// Derivada sobre la medición: un escalón de referencia no la mueve
+	gains = (s_pidGains){.kd = 0.5f};
+	PID_Set_Gains(&pid, &gains);
+	PID_Reset(&pid);
+	CHECK(PID_Update(&pid, 0, PID_Q16(7), 0) == 0);			// Sin historia la primera es cero
+	CHECK(PID_Update(&pid, PID_Q16(50), PID_Q16(7), 0) == 0);
+	out = PID_Update(&pid, PID_Q16(50), PID_Q16(7.01), 0);
+	CHECK_NEAR(Test_Real(out), -0.5 * Test_Real(PID_Q16(7.01) - PID_Q16(7)) / 0.001, 0.001);
+
+	// Con pasabajos la primera respuesta a un salto es alfa por la derivada
+	PID_Set_Derivative_Filter(&pid, 50.0f);
+	PID_Reset(&pid);
+	PID_Update(&pid, 0, 0, 0);
+	out = PID_Update(&pid, 0, PID_Q16(-0.01), 0);
+	CHECK_NEAR(Test_Real(out), 5.0 * (1.0 - exp(-2.0 * M_PI * 50.0 * 0.001)), 0.001);
+	PID_Set_Derivative_Filter(&pid, 0);
+	CHECK(pid.dAlpha == INT16_MAX);
+}
+
+/**
+ * @brief Anti-windup: saturado mucho tiempo, sale de la saturación apenas cambia el error.
+ */
+static void Test_Windup(void){
+	s_pidLoop pid;
+	s_pidGains gains = {.kp = 0.2f, .ki = 50.0f};
+	uint32_t steps = 0, saturated = 0;
+
+	PID_Init(&pid, TEST_DT_US, PID_Q16(-10), PID_Q16(10));
+	PID_Set_Gains(&pid, &gains);
+	for(uint32_t i = 0; i < 10000; i++)
+		saturated += PID_Update(&pid, PID_Q16(20), 0, 0) == PID_Q16(10);
+	CHECK(saturated > 9900);
+	// Deja de integrar al saturar: el integral queda en lo justo para llegar al límite
+	CHECK_NEAR(Test_Real((int32_t)(pid.integral >> 16)), 10.0 - 0.2 * 20.0, 1.0);
+
+	// Con el error invertido la salida baja en pocos pasos
+	while(PID_Update(&pid, 0, PID_Q16(1), 0) >= PID_Q16(10) && steps < 10000)
+		steps++;
+	CHECK(steps == 0);
+	for(steps = 0; PID_Update(&pid, 0, PID_Q16(1), 0) > 0 && steps < 10000; steps++);
+	CHECK(steps < 150);
+	printf("pid: con el error invertido la salida cruza cero en %u pasos\n", (unsigned)steps);
+}
+
+/**
+ * @brief Lazo cerrado contra la referencia en double, y cambios de ganancias en marcha.
+ */
+static void Test_Closed_Loop(void){
+	s_pidLoop pid;
+	s_pidRef ref;
+	s_pidGains gains = {.kp = 4.0f, .ki = 20.0f, .kd = 0.05f, .kff = 0.1f};
+	double plant = 0, plantRef = 0, delay[5] = {0}, delayRef[5] = {0}, worst = 0, out, outRef;
+	int64_t integral;
+
+	PID_Init(&pid, TEST_DT_US, PID_Q16(-100), PID_Q16(100));
+	PID_Set_Gains(&pid, &gains);
+	PID_Set_Derivative_Filter(&pid, 30.0f);
+	Ref_Init(&ref, &gains, TEST_DT_US * 1e-6, -100, 100, 30.0);
+
+	for(uint32_t i = 0; i < TEST_STEPS; i++){
+		double setpoint = (i / 2000) % 2 ? 20.0 : -5.0;
+
+		// Cambio de ganancias en marcha, como SETPID: el integral sigue
+		if(i == TEST_STEPS / 2){
+			gains.kp = 6.0f;
+			gains.ki = 30.0f;
+			integral = pid.integral;
+			PID_Set_Gains(&pid, &gains);
+			ref.gains = gains;
+			CHECK(pid.integral == integral);
+		}
+		out = Test_Real(PID_Update(&pid, PID_Q16(setpoint), PID_Q16(plant), 0));
+		outRef = Ref_Update(&ref, setpoint, plantRef);
+		if(fabs(out - outRef) > worst)
+			worst = fabs(out - outRef);
+
+		// Planta de primer orden, 50 ms, con 5 ms de demora
+		memmove(&delay[1], delay, 4 * sizeof(double));
+		memmove(&delayRef[1], delayRef, 4 * sizeof(double));
+		delay[0] = out;
+		delayRef[0] = outRef;
+		plant += (delay[4] * 0.5 - plant) * 0.02;
+		plantRef += (delayRef[4] * 0.5 - plantRef) * 0.02;
+	}
+	CHECK(worst < 0.01);
+	CHECK_NEAR(plant, 20.0, 0.05);
+	printf("pid: lazo cerrado a %.5f de double (salida ±100)\n", worst);
+}
+
+/**
+ * @brief Tiempo de PID_Update() con los tres términos y el pasabajos de la derivada.
+ */
+static void Test_Bench(void){
+	static int32_t measure[TEST_STEPS];
+	s_pidLoop pid;
+	s_pidGains gains = {.kp = 8.0f, .ki = 40.0f, .kd = 0.3f, .kff = 0.1f};
+	uint64_t t0, t1, c0, c1;
+	int32_t sink = 0;
+
+	for(uint32_t i = 0; i < TEST_STEPS; i++)
+		measure[i] = PID_Q16(3.0 * sin(i * 0.01));
+	PID_Init(&pid, TEST_DT_US, PID_Q16(-100), PID_Q16(100));
+	PID_Set_Gains(&pid, &gains);
+	PID_Set_Derivative_Filter(&pid, 50.0f);
+
+	t0 = Test_Now_Ns();
+	c0 = Test_Cycles();
+	for(uint32_t r = 0; r < BENCH_REPS; r++)
+		for(uint32_t i = 0; i < TEST_STEPS; i++)
+			sink += PID_Update(&pid, 0, measure[i], 0);
+	c1 = Test_Cycles();
+	t1 = Test_Now_Ns();
+	Test_Keep(&sink);
+	printf("pid: PID_Update %.2f ns, %.1f ciclos de la PC\n",
+		   (double)(t1 - t0) / (BENCH_REPS * TEST_STEPS), (double)(c1 - c0) / (BENCH_REPS * TEST_STEPS));
+}
+
+int main(int argc, char **argv){
+	if(argc > 1 && !strcmp(argv[1], "-b")){
+		Test_Bench();
+		return 0;
+	}
+	Test_Gains();
+	Test_Terms();
+	Test_Windup();
+	Test_Closed_Loop();
+	return Test_Summary("pid_test");
+}
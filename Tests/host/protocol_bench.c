@@ -0,0 +1,118 @@
+/**
+ * @file protocol_bench.c
+ * @brief Medición del decodificador UNER en la PC: tramas/s y bytes/s.
+ *
+ * Compila protocol_handler.c tal cual, con ring_buffer.c y crc.c. Se miden tres flujos:
+ * - limpio: tramas seguidas, entregadas en paquetes de 64 bytes como los del CDC;
+ * - ruidoso: basura entre tramas (con 'U' sueltas y cabeceras falsas) y un 10 % de tramas
+ *   con el checksum roto;
+ * - fragmentado: el flujo limpio entregado de a 1 a 7 bytes.
+ * En cada caso se verifica que se despache exactamente cada trama válida.
+ */
+
+#include "Protocol_Handler/protocol_handler.h"
+#include "uner.h"
+#include "test.h"
+#include <stdlib.h>
+
+#define BENCH_FRAMES		20000
+#define BENCH_REPS			20
+
+static s_commData comm;
+static uint32_t dispatched;
+static uint32_t payloadSum;
+static uint32_t seed = 1;
+
+static uint32_t Bench_Rand(void){
+	seed = seed * 1664525u + 1013904223u;
+	return seed >> 8;
+}
+
+static void Bench_Handler(s_commData *c, const s_payload *payload){
+	(void)c;
+	dispatched++;
+	payloadSum += payload->length;
+}
+
+/**
+ * @brief Arma el flujo de prueba.
+ *
+ * @return Cantidad de bytes del flujo; en valid devuelve las tramas que deben despacharse.
+ */
+static uint32_t Bench_Build(uint8_t *stream, uint8_t isNoisy, uint32_t *valid){
+	static const uint8_t junk[] = "UNE UN U xyzUNER\x05:UNER";
+	uint8_t payload[COMM_MAX_PAYLOAD];
+	uint32_t len = 0, size;
+
+	*valid = 0;
+	for(uint32_t i = 0; i < BENCH_FRAMES; i++){
+		uint16_t n = (uint16_t)(Bench_Rand() % 48);
+
+		for(uint16_t k = 0; k < n; k++)
+			payload[k] = (uint8_t)Bench_Rand();
+		if(isNoisy){
+			uint32_t gap = Bench_Rand() % 12;
+
+			for(uint32_t k = 0; k < gap; k++)
+				stream[len++] = Bench_Rand() & 1 ? junk[Bench_Rand() % (sizeof junk - 1)] : (uint8_t)Bench_Rand();
+		}
+		size = Uner_Encode(&stream[len], USERNUMBER, payload, n, -1, CHECK_XOR);
+		if(isNoisy && Bench_Rand() % 10 == 0)
+			stream[len + size - 1] ^= 0x5A;
+		else
+			(*valid)++;
+		len += size;
+	}
+	return len;
+}
+
+/**
+ * @brief Entrega el flujo al buffer de recepción de a chunk bytes (0: al azar de 1 a 7).
+ */
+static void Bench_Feed(const uint8_t *stream, uint32_t len, uint32_t chunk){
+	uint32_t pos = 0, n;
+
+	Comm_Init(&comm, Comm_Dispatch, NULL);
+	while(pos < len){
+		n = chunk ? chunk : 1 + Bench_Rand() % 7;
+		if(n > len - pos)
+			n = len - pos;
+		pos += RingBuffer_Push(&comm.Rx, &stream[pos], n);
+		decodeProtocol(&comm);
+	}
+}
+
+static void Bench_Run(const char *name, const uint8_t *stream, uint32_t len, uint32_t valid, uint32_t chunk){
+	uint64_t start, elapsed;
+
+	dispatched = 0;
+	Bench_Feed(stream, len, chunk);
+	CHECK(dispatched == valid);
+	CHECK(RingBuffer_Count(&comm.Rx) < FRAME_MIN_SIZE);
+
+	start = Test_Now_Ns();
+	for(uint32_t r = 0; r < BENCH_REPS; r++)
+		Bench_Feed(stream, len, chunk);
+	elapsed = Test_Now_Ns() - start;
+	printf("%-12s %8u tramas %8u bytes  %6.2f Mtramas/s  %7.1f MB/s\n", name, valid, len,
+		   (double)valid * BENCH_REPS * 1e3 / elapsed, (double)len * BENCH_REPS * 1e3 / elapsed);
+}
+
+int main(void){
+	uint8_t *clean = malloc(BENCH_FRAMES * 64);
+	uint8_t *noisy = malloc(BENCH_FRAMES * 80);
+	uint32_t cleanLen, noisyLen, cleanValid, noisyValid;
+
+	Comm_Register_Command(USERNUMBER, Bench_Handler);
+	cleanLen = Bench_Build(clean, FALSE, &cleanValid);
+	noisyLen = Bench_Build(noisy, TRUE, &noisyValid);
+
+	Bench_Run("limpio", clean, cleanLen, cleanValid, 64);
+	Bench_Run("ruidoso", noisy, noisyLen, noisyValid, 64);
+	Bench_Run("fragmentado", clean, cleanLen, cleanValid, 0);
+	Test_Keep(&payloadSum);
+
+	free(clean);
+	free(noisy);
+	return Test_Summary("protocol_bench");
+}
@@ -0,0 +1,362 @@
+/**
+ * @file protocol_test.c
+ * @brief Pruebas de protocol_handler.c en la PC.
+ *
+ * Las tramas que arma el firmware se sacan de la cola con Comm_Tx_Read(), como lo hace el
+ * puerto, y se leen con el decodificador de uner.h.
+ */
+
+#include "Protocol_Handler/protocol_handler.h"
+#include "uner.h"
+#include "test.h"
+
+static s_commData comm, other;
+static uint8_t txOut[4096];
+static uint32_t txLen;
+
+static void Test_Drain(void){
+	txLen += Comm_Tx_Read(&comm, &txOut[txLen], sizeof txOut - txLen);
+}
+
+/**
+ * @brief Lee la próxima trama de lo que salió por el puerto.
+ *
+ * @return Largo de la trama, cero si no hay una trama válida en la posición pos.
+ */
+static uint32_t Test_Next(uint32_t pos, uint8_t mode, s_unerFrame *frame){
+	return Uner_Decode(&txOut[pos], txLen - pos, mode, frame);
+}
+
+/**
+ * @brief Entrega una solicitud al buffer de recepción y la decodifica.
+ *
+ * @param tag Etiqueta, o negativo para una solicitud sin etiqueta.
+ */
+static void Test_Request(uint8_t cmd, const uint8_t *payload, uint16_t len, int tag){
+	uint8_t frame[COMM_RX_BUFFER_SIZE];
+	uint32_t size = Uner_Encode(frame, cmd, payload, len, tag, comm.checkMode);
+
+	CHECK(RingBuffer_Push(&comm.Rx, frame, size) == size);
+	decodeProtocol(&comm);
+}
+
+/**
+ * @brief Una trama más corta que lo reservado, con otra reservada detrás, se cierra con PADDING.
+ */
+static void Test_Padding(uint8_t mode){
+	static const uint8_t data[5] = {1, 2, 3, 4, 5};
+	s_frame a, b;
+	s_unerFrame f;
+	uint32_t pos = 0, n, published;
+
+	Comm_Init(&comm, Comm_Dispatch, NULL);
+	Comm_Set_CheckMode(&comm, mode);
+	txLen = 0;
+
+	// Sin otra reserva detrás el sobrante se devuelve: no hay relleno
+	CHECK(comm_reserveUntagged(&comm, &a, USERNUMBER, 40));
+	comm_put_bytes(&a, data, 2);
+	comm_commitFrame(&comm, &a);
+	published = Comm_Tx_Count(&comm);
+
+	// Con b reservada detrás de a, lo que a no usa queda entre las dos
+	CHECK(comm_reserveUntagged(&comm, &a, USERNUMBER, 20));
+	CHECK(comm_reserveUntagged(&comm, &b, USERNUMBER, 3));
+	comm_put_bytes(&b, data, 3);
+	comm_put_bytes(&a, data, 5);
+	comm_commitFrame(&comm, &b);
+	CHECK(Comm_Tx_Count(&comm) == published);				// a todavía se está escribiendo
+	comm_commitFrame(&comm, &a);
+
+	// Una trama extendida que queda casi vacía deja un hueco que necesita PADDING extendido
+	CHECK(comm_reserveUntagged(&comm, &a, USERTEXT, 400));
+	CHECK(comm_reserveUntagged(&comm, &b, USERTEXT, 1));
+	comm_put_u8(&a, 7);
+	comm_put_u8(&b, 9);
+	comm_commitFrame(&comm, &a);
+	comm_commitFrame(&comm, &b);
+	Test_Drain();
+
+	n = Test_Next(pos, mode, &f);
+	CHECK(n && f.cmd == USERNUMBER && f.length == 2);
+	pos += n;
+	n = Test_Next(pos, mode, &f);
+	CHECK(n && f.cmd == USERNUMBER && f.length == 5 && !memcmp(f.payload, data, 5));
+	pos += n;
+	n = Test_Next(pos, mode, &f);
+	CHECK(n && f.cmd == PADDING && !f.isTagged);
+	pos += n;
+	n = Test_Next(pos, mode, &f);
+	CHECK(n && f.cmd == USERNUMBER && f.length == 3 && !memcmp(f.payload, data, 3));
+	pos += n;
+	n = Test_Next(pos, mode, &f);
+	CHECK(n && f.cmd == USERTEXT && f.length == 1 && f.payload[0] == 7);
+	pos += n;
+	n = Test_Next(pos, mode, &f);
+	CHECK(n > 255 && f.cmd == PADDING);
+	pos += n;
+	n = Test_Next(pos, mode, &f);
+	CHECK(n && f.cmd == USERTEXT && f.length == 1 && f.payload[0] == 9);
+	pos += n;
+	CHECK(pos == txLen);
+}
+
+/**
+ * @brief BULKREAD por un puerto con bloque máximo: el fragmento pedido se achica para que
+ * cada trama BULKDATA entre en un envío, y la respuesta informa el tamaño usado.
+ */
+static void Test_Bulk(void){
+	static uint8_t region[3000];
+	static uint8_t copy[sizeof region];
+	uint8_t request[12] = {3}, ack[7] = {3};
+	uint16_t total = 0, fragSize = 0, base = 0;
+	uint32_t pos = 0, n, bitmap = 0, frames = 0;
+	s_unerFrame f;
+
+	for(uint32_t i = 0; i < sizeof region; i++)
+		region[i] = (uint8_t)(i * 7 + 1);
+	Comm_Init(&comm, Comm_Dispatch, NULL);
+	Comm_Set_MaxChunk(&comm, 200);
+	CHECK(Comm_Register_Region(3, region, sizeof region) == SYS_OK);
+	txLen = 0;
+
+	request[5] = (uint8_t)sizeof region;						// offset 0, length, fragSize 1000, window 4
+	request[6] = (uint8_t)(sizeof region >> 8);
+	request[9] = 1000 & 0xFF;
+	request[10] = 1000 >> 8;
+	request[11] = 4;
+	Test_Request(BULKREAD, request, sizeof request, 9);
+
+	while(frames < 200){
+		Comm_Task(&comm);
+		Test_Drain();
+		while(pos < txLen && (n = Test_Next(pos, CHECK_XOR, &f)) != 0){
+			pos += n;
+			frames++;
+			if(f.cmd == BULKREAD){
+				CHECK(f.isTagged && f.tag == 9 && f.length == 5);
+				total = comm_get_u16(&f.payload[1]);
+				fragSize = comm_get_u16(&f.payload[3]);
+			}else if(f.cmd == BULKDATA){
+				uint16_t seq = comm_get_u16(&f.payload[1]);
+
+				CHECK(n <= 200);
+				CHECK(fragSize && (uint32_t)seq * fragSize + f.length - 3 <= sizeof region);
+				memcpy(&copy[seq * fragSize], &f.payload[3], f.length - 3);
+				bitmap |= 1UL << (seq - base);
+			}
+		}
+		if(total && base >= total)
+			break;
+		while(bitmap & 1){
+			base++;
+			bitmap >>= 1;
+		}
+		ack[1] = (uint8_t)base;
+		ack[2] = (uint8_t)(base >> 8);
+		memcpy(&ack[3], &bitmap, 4);
+		Test_Request(BULKACK, ack, sizeof ack, -1);
+	}
+	CHECK(fragSize > 0 && fragSize < 200);
+	CHECK(total == (sizeof region + fragSize - 1) / fragSize);
+	CHECK(base == total);
+	CHECK(!comm.bulk.isActive);
+	CHECK(!memcmp(copy, region, sizeof region));
+}
+
+/**
+ * @brief Responde el mismo payload, como cualquier comando que contesta una consulta.
+ */
+static void Test_Echo(s_commData *c, const s_payload *payload){
+	comm_sendCMD(c, USERNUMBER, (uint8_t *)payload->data, (uint8_t)payload->length);
+}
+
+/**
+ * @brief 64 solicitudes etiquetadas en curso: la PC mantiene tantas como le concedió
+ * PIPELINE y cada respuesta llega en orden con la etiqueta y el payload de su solicitud.
+ *
+ * El puerto se vacía de a ratos, así algunas solicitudes esperan en Rx a que haya lugar para
+ * su respuesta.
+ */
+static void Test_Pipeline(void){
+	uint8_t credit = 0, want = 64, payload[4];
+	uint32_t sent = 0, received = 0, pos = 0, n, loops = 0;
+	s_unerFrame f;
+
+	Comm_Init(&comm, Comm_Dispatch, NULL);
+	Comm_Register_Command(USERNUMBER, Test_Echo);
+	txLen = 0;
+
+	Test_Request(PIPELINE, &want, 1, 200);
+	Test_Drain();
+	n = Test_Next(pos, CHECK_XOR, &f);
+	CHECK(n && f.cmd == PIPELINE && f.tag == 200 && f.length == 3);
+	credit = f.payload[0];
+	CHECK(credit == COMM_MAX_INFLIGHT);
+	CHECK(comm_get_u16(&f.payload[1]) == COMM_RX_BUFFER_SIZE);
+	pos += n;
+	want = 4;
+	Test_Request(PIPELINE, &want, 1, 201);
+	Test_Drain();
+	n = Test_Next(pos, CHECK_XOR, &f);
+	CHECK(n && f.tag == 201 && f.payload[0] == 4);				// Se concede lo pedido si es menor
+	pos += n;
+
+	while(received < 64 && loops++ < 10000){
+		while(sent < 64 && sent - received < credit){
+			uint8_t frame[32];
+			uint32_t size;
+
+			memcpy(payload, &sent, 4);
+			payload[3] = (uint8_t)~sent;
+			size = Uner_Encode(frame, USERNUMBER, payload, 4, (int)(sent * 3 % 256), CHECK_XOR);
+			if(RingBuffer_Free(&comm.Rx) < size)
+				break;
+			RingBuffer_Push(&comm.Rx, frame, size);
+			sent++;
+		}
+		decodeProtocol(&comm);
+		if(loops % 3 == 0)
+			Test_Drain();
+		while(pos < txLen && (n = Test_Next(pos, CHECK_XOR, &f)) != 0){
+			uint32_t value = 0;
+
+			pos += n;
+			CHECK(f.cmd == USERNUMBER && f.isTagged && f.length == 4);
+			memcpy(&value, f.payload, 3);
+			CHECK(f.tag == received * 3 % 256);					// Emparejada por etiqueta
+			CHECK(value == received && f.payload[3] == (uint8_t)~received);
+			received++;
+		}
+	}
+	CHECK(received == 64);
+	CHECK(pos == txLen);
+	Comm_Register_Command(USERNUMBER, NULL);
+}
+
+/**
+ * @brief Adelanta los índices de Rx para que la próxima trama dé la vuelta al buffer.
+ */
+static void Test_Wrap_Rx(s_commData *c, uint32_t at){
+	static const uint8_t filler[COMM_RX_BUFFER_SIZE];
+
+	RingBuffer_Push(&c->Rx, filler, at);
+	RingBuffer_Consume(&c->Rx, at);
+}
+
+static uint8_t nestedOk, nestedCalls;
+
+/**
+ * @brief Handler que, con el payload de un enlace en la mano, decodifica el otro, como si el
+ * otro enlace se atendiera desde su interrupción.
+ */
+static void Test_Nested(s_commData *c, const s_payload *payload){
+	uint8_t data[120], frame[COMM_RX_BUFFER_SIZE];
+	uint32_t size;
+
+	nestedCalls++;
+	for(uint32_t i = 0; i < payload->length; i++)
+		nestedOk &= payload->data[i] == (uint8_t)(i * 5 + (c == &comm ? 1 : 2));
+	if(c != &comm)
+		return;
+
+	for(uint32_t i = 0; i < sizeof data; i++)
+		data[i] = (uint8_t)(i * 5 + 2);
+	size = Uner_Encode(frame, USERTEXT, data, sizeof data, -1, other.checkMode);
+	Test_Wrap_Rx(&other, COMM_RX_BUFFER_SIZE - 40);
+	CHECK(RingBuffer_Push(&other.Rx, frame, size) == size);
+	decodeProtocol(&other);
+
+	// El payload de este enlace no lo pisó el del otro
+	for(uint32_t i = 0; i < payload->length; i++)
+		nestedOk &= payload->data[i] == (uint8_t)(i * 5 + 1);
+}
+
+/**
+ * @brief Dos enlaces con tramas que dan la vuelta a Rx, decodificando uno dentro del otro:
+ * cada uno arma la copia lineal del payload en su propia instancia.
+ */
+static void Test_Reentrant(void){
+	uint8_t data[100];
+
+	Comm_Init(&comm, Comm_Dispatch, NULL);
+	Comm_Init(&other, Comm_Dispatch, NULL);
+	Comm_Register_Command(USERTEXT, Test_Nested);
+	for(uint32_t i = 0; i < sizeof data; i++)
+		data[i] = (uint8_t)(i * 5 + 1);
+	nestedOk = TRUE;
+	nestedCalls = 0;
+
+	Test_Wrap_Rx(&comm, COMM_RX_BUFFER_SIZE - 30);
+	Test_Request(USERTEXT, data, sizeof data, -1);
+	CHECK(nestedCalls == 2);
+	CHECK(nestedOk);
+	CHECK(RingBuffer_Count(&comm.Rx) == 0 && RingBuffer_Count(&other.Rx) == 0);
+	Comm_Register_Command(USERTEXT, NULL);
+}
+
+/**
+ * @brief Puerto como el USB CDC: saca los bytes de Tx antes de saber si el endpoint los
+ * acepta y, si los rechaza, los retiene para reintentar en el próximo llamado.
+ */
+static uint8_t portBuffer[64], portRefuse;
+static uint16_t portPending;
+
+static void Port_Start_Tx(s_commData *c){
+	uint16_t len = portPending;
+
+	if(!len)
+		len = (uint16_t)Comm_Tx_Read(c, portBuffer, sizeof portBuffer);
+	if(!len)
+		return;
+	if(portRefuse){
+		portPending = len;
+		return;
+	}
+	memcpy(&txOut[txLen], portBuffer, len);
+	txLen += len;
+	portPending = 0;
+}
+
+static uint8_t Port_Tx_Pending(void){
+	return portPending != 0;
+}
+
+/**
+ * @brief Con el endpoint ocupado la última respuesta queda retenida en el puerto; sale en
+ * el próximo Comm_Task() aunque no se encole otra trama.
+ */
+static void Test_Refused(void){
+	static const uint8_t data[4] = {9, 8, 7, 6};
+	s_unerFrame f;
+	uint32_t n;
+
+	Comm_Init(&comm, Comm_Dispatch, Port_Start_Tx);
+	Comm_Set_Tx_Pending(&comm, Port_Tx_Pending);
+	Comm_Register_Command(USERNUMBER, Test_Echo);
+	txLen = 0;
+	portPending = 0;
+
+	portRefuse = TRUE;
+	Test_Request(USERNUMBER, data, sizeof data, 33);
+	Comm_Task(&comm);
+	CHECK(Comm_Tx_Count(&comm) == 0 && portPending && txLen == 0);
+
+	portRefuse = FALSE;
+	Comm_Task(&comm);
+	n = Test_Next(0, CHECK_XOR, &f);
+	CHECK(n == txLen && f.cmd == USERNUMBER && f.tag == 33 && !memcmp(f.payload, data, 4));
+	CHECK(!portPending);
+	Comm_Register_Command(USERNUMBER, NULL);
+}
+
+int main(void){
+	Test_Padding(CHECK_XOR);
+	Test_Padding(CHECK_CRC16);
+	Test_Padding(CHECK_CRC32C);
+	Test_Bulk();
+	Test_Pipeline();
+	Test_Reentrant();
+	Test_Refused();
+	return Test_Summary("protocol_test");
+}
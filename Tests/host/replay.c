@@ -0,0 +1,204 @@
+/**
+ * @file replay.c
+ * @brief Reproduce un registro de cuadros crudos del MPU6050 por la misma cadena del firmware.
+ *
+ * Cada cuadro de 14 bytes entra como si lo hubiera traído el DMA: MPU6050_I2C_DMA_Cplt(),
+ * MPU6050_MAF(), Kalman_Update() y AHRS_Update(), igual que IMU_Update_Angles() en main.c.
+ * Verifica que MPU6050_Get_Frame() reconstruya el cuadro de entrada, compara la salida
+ * contra un archivo dorado y mide el costo por muestra.
+ *
+ * Uso: replay <cuadros.bin> [-g dorado.csv] [-o salida.csv] [-b repeticiones]
+ *
+ * Las columnas enteras (aceleración, giro, ángulo del Kalman en Q16) deben coincidir
+ * exactamente; el cuaternión del AHRS, que es float, admite REPLAY_Q_TOL.
+ */
+
+#include "I2C/MPU6050/mpu6050.h"
+#include "Estimators/kalman.h"
+#include "Estimators/ahrs.h"
+#include "test.h"
+#include <stdlib.h>
+#include <math.h>
+
+#define REPLAY_Q_TOL		1e-4
+
+typedef struct{
+	int16_t acc[3];
+	int16_t gyro[3];
+	int32_t pitch;			///< Salida del Kalman, Q16 grados
+	float q[4];				///< Cuaternión del AHRS
+}s_sample;
+
+static s_MPU mpu;
+static s_kalman pitchFilter;
+static s_ahrs attitude;
+
+static e_system I2C_Write(uint16_t dev, uint8_t reg, uint8_t size, uint8_t *data, uint16_t len, uint32_t timeout){
+	(void)dev; (void)reg; (void)size; (void)data; (void)len; (void)timeout;
+	return SYS_OK;
+}
+
+static e_system I2C_Read(uint16_t dev, uint8_t reg, uint8_t size, uint8_t *data, uint16_t len, uint32_t timeout){
+	(void)dev; (void)size; (void)timeout;
+	memset(data, 0, len);
+	if(reg == WHO_AM_I_MPU6050)
+		data[0] = WHO_AM_I_DEFAULT_VALUE;
+	return SYS_OK;
+}
+
+/**
+ * @brief Pasa todos los cuadros por la cadena del firmware.
+ *
+ * @param out Muestras resultantes, o NULL al medir.
+ * @return Cantidad de muestras producidas.
+ */
+static size_t Replay_Run(const uint8_t *frames, size_t count, s_sample *out){
+	int16_t offsets[NUM_AXIS] = {0};
+	uint8_t frame[MPU_FIFO_FRAME];
+	size_t samples = 0;
+
+	MPU6050_Set_I2C_Communication(I2C_Write, I2C_Read);
+	MPU6050_Init(&mpu);
+	MPU6050_Set_Offsets(&mpu, offsets);
+	Kalman_Init(&pitchFilter, mpu.Config.samplePeriod);
+	AHRS_Init(&attitude, mpu.Config.samplePeriod);
+	AHRS_Set_Scale(&attitude, mpu.Config.gyroScale * (3.14159265f / 180.0f / 16777216.0f), mpu.Config.accOneG);
+
+	for(size_t i = 0; i < count; i++){
+		memcpy(mpu.bit_data, &frames[i * MPU_FIFO_FRAME], MPU_FIFO_FRAME);
+		MPU6050_I2C_DMA_Cplt(&mpu);
+		while(MPU6050_MAF(&mpu)){
+			int16_t gyro[3] = {mpu.MAF.rawData[3] - mpu.Gyro.offset.x,
+							   mpu.MAF.rawData[4] - mpu.Gyro.offset.y,
+							   mpu.MAF.rawData[5] - mpu.Gyro.offset.z};
+			int16_t acc[3] = {mpu.Acc.x, mpu.Acc.y, mpu.Acc.z};
+			int32_t pitch = Kalman_Update(&pitchFilter,
+										  Kalman_Acc_Pitch(acc[0], acc[1], acc[2]),
+										  Kalman_Gyro_Rate(gyro[0], mpu.Config.gyroScale));
+
+			AHRS_Update(&attitude, gyro, acc);
+			if(out != NULL){
+				MPU6050_Get_Frame(&mpu, frame);
+				CHECK(memcmp(frame, &frames[i * MPU_FIFO_FRAME], MPU_FIFO_FRAME) == 0);
+				memcpy(out[samples].acc, acc, sizeof acc);
+				out[samples].gyro[0] = mpu.Gyro.x;
+				out[samples].gyro[1] = mpu.Gyro.y;
+				out[samples].gyro[2] = mpu.Gyro.z;
+				out[samples].pitch = pitch;
+				memcpy(out[samples].q, attitude.q, sizeof attitude.q);
+			}
+			samples++;
+		}
+	}
+	return samples;
+}
+
+static void Replay_Write(FILE *f, const s_sample *s, size_t count){
+	for(size_t i = 0; i < count; i++, s++)
+		fprintf(f, "%zu,%d,%d,%d,%d,%d,%d,%ld,%.7f,%.7f,%.7f,%.7f\n", i,
+				s->acc[0], s->acc[1], s->acc[2], s->gyro[0], s->gyro[1], s->gyro[2],
+				(long)s->pitch, s->q[0], s->q[1], s->q[2], s->q[3]);
+}
+
+static void Replay_Compare(FILE *f, const s_sample *s, size_t count){
+	size_t i, index, lines = 0;
+	int v[6];
+	long pitch;
+	double q[4];
+
+	for(i = 0; i < count; i++, s++){
+		if(fscanf(f, "%zu,%d,%d,%d,%d,%d,%d,%ld,%lf,%lf,%lf,%lf\n", &index,
+				  &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &pitch, &q[0], &q[1], &q[2], &q[3]) != 12)
+			break;
+		lines++;
+		CHECK(index == i);
+		for(int j = 0; j < 3; j++){
+			CHECK(v[j] == s->acc[j]);
+			CHECK(v[3 + j] == s->gyro[j]);
+		}
+		CHECK(pitch == s->pitch);
+		for(int j = 0; j < 4; j++)
+			CHECK_NEAR(q[j], s->q[j], REPLAY_Q_TOL);
+		if(testFails){
+			printf("primera diferencia en la muestra %zu\n", i);
+			return;
+		}
+	}
+	CHECK(lines == count);
+}
+
+int main(int argc, char **argv){
+	const char *golden = NULL, *output = NULL;
+	unsigned reps = 0;
+	uint8_t *frames;
+	s_sample *samples;
+	size_t count, produced;
+	long size;
+	FILE *f;
+
+	if(argc < 2){
+		fprintf(stderr, "uso: %s <cuadros.bin> [-g dorado.csv] [-o salida.csv] [-b repeticiones]\n", argv[0]);
+		return 2;
+	}
+	for(int i = 2; i + 1 < argc; i += 2){
+		if(!strcmp(argv[i], "-g"))
+			golden = argv[i + 1];
+		else if(!strcmp(argv[i], "-o"))
+			output = argv[i + 1];
+		else if(!strcmp(argv[i], "-b"))
+			reps = (unsigned)strtoul(argv[i + 1], NULL, 0);
+	}
+
+	f = fopen(argv[1], "rb");
+	if(f == NULL){
+		perror(argv[1]);
+		return 1;
+	}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	rewind(f);
+	count = (size_t)size / MPU_FIFO_FRAME;
+	frames = malloc(count * MPU_FIFO_FRAME);
+	samples = calloc(count, sizeof *samples);
+	if(frames == NULL || samples == NULL || fread(frames, MPU_FIFO_FRAME, count, f) != count){
+		fprintf(stderr, "%s: no se pudo leer\n", argv[1]);
+		return 1;
+	}
+	fclose(f);
+
+	produced = Replay_Run(frames, count, samples);
+	CHECK(produced == count);
+
+	if(output != NULL){
+		f = fopen(output, "w");
+		if(f == NULL){
+			perror(output);
+			return 1;
+		}
+		Replay_Write(f, samples, produced);
+		fclose(f);
+	}
+
+	if(golden != NULL){
+		f = fopen(golden, "r");
+		if(f == NULL){
+			perror(golden);
+			return 1;
+		}
+		Replay_Compare(f, samples, produced);
+		fclose(f);
+	}
+
+	if(reps){
+		uint64_t start = Test_Now_Ns();
+
+		for(unsigned r = 0; r < reps; r++)
+			Replay_Run(frames, count, NULL);
+		printf("replay: %zu cuadros x %u, %.1f ns/muestra (Cplt + MAF + Kalman + AHRS)\n",
+			   count, reps, (double)(Test_Now_Ns() - start) / ((double)reps * count));
+	}
+
+	free(frames);
+	free(samples);
+	return Test_Summary("replay");
+}
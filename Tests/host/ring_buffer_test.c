@@ -0,0 +1,170 @@
+/**
+ * @file ring_buffer_test.c
+ * @brief Pruebas de ring_buffer.c en la PC: casos límite, estrés SPSC con dos hilos y medición.
+ *
+ * En la prueba de estrés un hilo productor escribe una secuencia conocida alternando
+ * RingBuffer_Push(), RingBuffer_PushByte() y RingBuffer_WriteSpan(), y un hilo consumidor la
+ * verifica alternando RingBuffer_Pop() y RingBuffer_ReadSpan(). Con un buffer chico los
+ * índices dan la vuelta millones de veces; cualquier falta de orden entre datos e índices se
+ * ve como un byte fuera de secuencia.
+ *
+ * Uso: ring_buffer_test [-b]		con -b además mide el caudal entre dos hilos.
+ */
+
+#include "RingBuffer/ring_buffer.h"
+#include "test.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+
+#define STRESS_BYTES		(64u * 1024 * 1024)
+#define BENCH_BYTES			(128u * 1024 * 1024)
+
+typedef struct{
+	s_ring ring;
+	uint32_t total;
+	uint32_t chunk;
+	uint32_t errors;
+}s_stress;
+
+/** @brief Byte número i de la secuencia; 251 es primo para que no coincida con el tamaño. */
+static inline uint8_t Seq(uint32_t i){
+	return (uint8_t)(i % 251);
+}
+
+static void Test_Edges(void){
+	uint8_t storage[16], data[32], out[32];
+	uint8_t *span;
+	s_ring ring;
+
+	for(uint8_t i = 0; i < sizeof data; i++)
+		data[i] = i;
+	RingBuffer_Init(&ring, storage, sizeof storage);
+	CHECK(RingBuffer_Count(&ring) == 0 && RingBuffer_Free(&ring) == 16);
+
+	// Se llena por completo sin confundir lleno con vacío
+	CHECK(RingBuffer_Push(&ring, data, 32) == 16);
+	CHECK(RingBuffer_Count(&ring) == 16 && RingBuffer_Free(&ring) == 0);
+	CHECK(RingBuffer_PushByte(&ring, 0) == 0);
+	CHECK(RingBuffer_WriteSpan(&ring, &span) == 0);
+
+	// Lectura y escritura que dan la vuelta
+	CHECK(RingBuffer_Pop(&ring, out, 10) == 10 && !memcmp(out, data, 10));
+	CHECK(RingBuffer_Push(&ring, &data[16], 8) == 8);
+	CHECK(RingBuffer_ReadSpan(&ring, &span) == 6 && span == &storage[10]);
+	CHECK(RingBuffer_Pop(&ring, out, 32) == 14);
+	CHECK(!memcmp(out, &data[10], 14));
+	CHECK(RingBuffer_Count(&ring) == 0);
+
+	// Los índices libres cruzan el desborde de 32 bits sin perder la cuenta
+	ring.write = ring.read = UINT32_MAX - 3;
+	CHECK(RingBuffer_Push(&ring, data, 12) == 12 && RingBuffer_Count(&ring) == 12);
+	CHECK(RingBuffer_Pop(&ring, out, 12) == 12 && !memcmp(out, data, 12));
+	CHECK(RingBuffer_Count(&ring) == 0 && RingBuffer_Free(&ring) == 16);
+}
+
+static void *Stress_Producer(void *arg){
+	s_stress *st = arg;
+	uint8_t chunk[256];
+	uint32_t sent = 0, n, k = 0, last;
+	uint8_t *span;
+
+	while(sent < st->total){
+		last = sent;
+		n = st->chunk ? st->chunk : 1 + (k * 7) % 37;
+		if(n > st->total - sent)
+			n = st->total - sent;
+		switch(st->chunk ? 0 : k++ % 3){
+		case 0:
+			for(uint32_t i = 0; i < n; i++)
+				chunk[i] = Seq(sent + i);
+			sent += RingBuffer_Push(&st->ring, chunk, n);
+			break;
+		case 1:
+			sent += RingBuffer_PushByte(&st->ring, Seq(sent));
+			break;
+		default:
+			n = RingBuffer_WriteSpan(&st->ring, &span) < n ? RingBuffer_WriteSpan(&st->ring, &span) : n;
+			for(uint32_t i = 0; i < n; i++)
+				span[i] = Seq(sent + i);
+			RingBuffer_CommitWrite(&st->ring, n);
+			sent += n;
+			break;
+		}
+		if(sent == last)
+			sched_yield();								// Lleno: con un solo núcleo el consumidor tiene que correr
+	}
+	return NULL;
+}
+
+static void *Stress_Consumer(void *arg){
+	s_stress *st = arg;
+	uint8_t chunk[256];
+	uint32_t received = 0, n, k = 0;
+	uint8_t *span;
+
+	while(received < st->total){
+		if(st->chunk || k++ & 1){
+			n = RingBuffer_Pop(&st->ring, chunk, st->chunk ? st->chunk : 1 + (k * 5) % 41);
+			if(!st->chunk){
+				for(uint32_t i = 0; i < n; i++)
+					st->errors += chunk[i] != Seq(received + i);
+			}
+		}else{
+			n = RingBuffer_ReadSpan(&st->ring, &span);
+			for(uint32_t i = 0; i < n; i++)
+				st->errors += span[i] != Seq(received + i);
+			RingBuffer_Consume(&st->ring, n);
+		}
+		received += n;
+		if(!n)
+			sched_yield();
+	}
+	return NULL;
+}
+
+/**
+ * @brief Corre productor y consumidor en dos hilos.
+ *
+ * @param chunk Bytes por operación; cero alterna las operaciones y verifica la secuencia.
+ * @return Nanosegundos que tardó la transferencia.
+ */
+static uint64_t Stress_Run(s_stress *st, uint8_t *storage, uint32_t size, uint32_t total, uint32_t chunk){
+	pthread_t producer, consumer;
+	uint64_t start;
+
+	RingBuffer_Init(&st->ring, storage, size);
+	st->total = total;
+	st->chunk = chunk;
+	st->errors = 0;
+	start = Test_Now_Ns();
+	pthread_create(&consumer, NULL, Stress_Consumer, st);
+	pthread_create(&producer, NULL, Stress_Producer, st);
+	pthread_join(producer, NULL);
+	pthread_join(consumer, NULL);
+	return Test_Now_Ns() - start;
+}
+
+int main(int argc, char **argv){
+	static uint8_t storage[4096];
+	static s_stress st;
+	static const uint32_t chunks[] = {1, 16, 64, 256};
+
+	Test_Edges();
+
+	Stress_Run(&st, storage, 64, STRESS_BYTES, 0);
+	CHECK(st.errors == 0);
+	CHECK(RingBuffer_Count(&st.ring) == 0);
+	Stress_Run(&st, storage, 1024, STRESS_BYTES, 0);
+	CHECK(st.errors == 0);
+
+	if(argc > 1 && !strcmp(argv[1], "-b")){
+		for(uint32_t i = 0; i < sizeof chunks / sizeof chunks[0]; i++){
+			uint32_t total = chunks[i] == 1 ? BENCH_BYTES / 16 : BENCH_BYTES;
+			uint64_t ns = Stress_Run(&st, storage, sizeof storage, total, chunks[i]);
+
+			printf("ring_buffer: bloques de %3u bytes, %7.1f MB/s entre dos hilos\n", chunks[i], total * 1e3 / ns);
+		}
+	}
+	return Test_Summary("ring_buffer_test");
+}
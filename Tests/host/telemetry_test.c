@@ -0,0 +1,223 @@
+/**
+ * @file telemetry_test.c
+ * @brief Pruebas de telemetry.c en la PC: ida y vuelta con el decodificador, pérdidas,
+ * relación de compresión y costo de Telemetry_Push().
+ *
+ * El canal IMU toma aceleración y giro del registro data/imu_sweep.bin; el canal ADC es una
+ * señal sintética de 9 sensores de 12 bits, como los de la línea, que varían lento con ruido.
+ * Los canales se configuran igual que en main.c.
+ *
+ * Uso: telemetry_test <cuadros.bin> [-b]
+ */
+
+#include "Telemetry/telemetry.h"
+#include "I2C/MPU6050/mpu6050.h"
+#include "uner.h"
+#include "tlm_decoder.h"
+#include "test.h"
+#include <stdlib.h>
+#include <math.h>
+
+#define TEST_ADC			0
+#define TEST_IMU			1
+#define TEST_ADC_SENSORS	9
+#define TEST_ADC_SAMPLES	16000
+
+typedef struct{
+	const uint8_t *samples;		///< Muestras a enviar, de a sampleSize bytes
+	uint32_t count;
+	uint8_t sampleSize;
+	uint8_t channel;
+}s_stream;
+
+static s_commData comm;
+static uint8_t tx[1 << 22];
+static uint32_t txLen;
+
+static void Test_Drain(void){
+	txLen += Comm_Tx_Read(&comm, &tx[txLen], sizeof tx - txLen);
+}
+
+/**
+ * @brief Envía el flujo por el canal y devuelve los bytes de trama que generó.
+ *
+ * @param drainEvery Se vacía la cola Tx cada tantas muestras; con poco drenaje se pierden tramas.
+ */
+static uint32_t Test_Send(const s_stream *s, uint8_t flags, uint32_t drainEvery){
+	Comm_Init(&comm, NULL, NULL);
+	txLen = 0;
+	Telemetry_Subscribe(&comm, 1U << s->channel, 1, flags);
+	for(uint32_t i = 0; i < s->count; i++){
+		Telemetry_Push(s->channel, &s->samples[i * s->sampleSize]);
+		if(i % drainEvery == drainEvery - 1)
+			Test_Drain();
+	}
+	Test_Drain();
+	Telemetry_Subscribe(NULL, 0, 1, 0);
+	return txLen;
+}
+
+/**
+ * @brief Decodifica lo enviado y lo compara con el flujo original.
+ *
+ * @param dropSeq Trama que se descarta como si se hubiera perdido en el enlace; negativo ninguna.
+ * @return Muestras recuperadas.
+ */
+static uint32_t Test_Receive(const s_stream *s, int dropSeq, s_tlmDecoder *d){
+	static uint8_t out[TLM_MAX_SAMPLES_SIZE * 2];
+	uint32_t pos = 0, n, index = 0, recovered = 0;
+	s_unerFrame f;
+	int count;
+
+	memset(d, 0, sizeof *d);
+	while(pos < txLen){
+		n = Uner_Decode(&tx[pos], txLen - pos, CHECK_XOR, &f);
+		CHECK(n != 0);
+		if(!n)
+			return recovered;
+		pos += n;
+		if(f.cmd != TELEMETRY)
+			continue;
+		CHECK((f.payload[0] & 0x0F) == s->channel);
+		if(dropSeq >= 0 && comm_get_u16(&f.payload[1]) == dropSeq){
+			index += f.payload[3];
+			continue;
+		}
+		// Las muestras de tramas que la cola no aceptó no llegan nunca: se salta en index
+		if(d->hasSeq && comm_get_u16(&f.payload[1]) != d->seq)
+			index = (uint32_t)comm_get_u16(&f.payload[1]) * f.payload[3];
+		count = Tlm_Decode(d, f.payload, f.length, s->sampleSize, out);
+		CHECK(count >= 0);
+		if(count > 0){
+			CHECK(index + count <= s->count);
+			CHECK(!memcmp(out, &s->samples[index * s->sampleSize], (size_t)count * s->sampleSize));
+			recovered += count;
+		}
+		index += f.payload[3];
+	}
+	return recovered;
+}
+
+/**
+ * @brief Descarta todo lo publicado en la cola Tx sin copiarlo, para medir sólo Telemetry_Push().
+ */
+static void Test_Discard(void){
+	uint32_t length;
+
+	while(Comm_Tx_Next(&comm, &length) != NULL)
+		Comm_Tx_Consume(&comm, length);
+}
+
+static void Test_Roundtrip(const s_stream *s, const char *name, uint8_t isBench){
+	s_tlmDecoder d;
+	uint32_t rawBytes, deltaBytes, timedBytes, recovered;
+	uint64_t start;
+
+	// Sin compresión y con compresión todo se recupera exacto
+	rawBytes = Test_Send(s, 0, 1);
+	CHECK(Test_Receive(s, -1, &d) == s->count);
+	CHECK(d.lost == 0);
+	deltaBytes = Test_Send(s, TLM_FLAG_DELTA, 1);
+	CHECK(Test_Receive(s, -1, &d) == s->count);
+	CHECK(d.lost == 0 && d.skipped == 0);
+	timedBytes = Test_Send(s, TLM_FLAG_DELTA | TLM_FLAG_TIME, 1);
+	CHECK(Test_Receive(s, -1, &d) == s->count);
+
+	// Una trama perdida en el enlace: se descartan las comprimidas hasta la próxima clave
+	Test_Send(s, TLM_FLAG_DELTA, 1);
+	recovered = Test_Receive(s, 5, &d);
+	CHECK(d.lost == 1 && d.skipped == TLM_KEYFRAME_PERIOD - 6);
+	CHECK(recovered == s->count - (TLM_KEYFRAME_PERIOD - 5) * 8);
+
+	// Cola llena: el firmware pierde tramas, fuerza una clave y el decodificador se
+	// resincroniza sin descartar ninguna de las que llegan
+	Test_Send(s, TLM_FLAG_DELTA, 500);
+	recovered = Test_Receive(s, -1, &d);
+	CHECK(d.lost > 0 && d.skipped == 0);
+	CHECK(d.seq <= s->count / 8);
+	CHECK(recovered + (d.lost + s->count / 8 - d.seq) * 8 == s->count);	// Incluye las perdidas al final
+
+	if(!isBench)
+		return;
+
+	printf("%-4s %5u muestras de %2u bytes: crudo %7u B, delta %7u B (%.2f:1), delta+tiempo %7u B\n",
+		   name, s->count, s->sampleSize, rawBytes, deltaBytes, (double)rawBytes / deltaBytes, timedBytes);
+
+	for(uint8_t flags = 0; flags <= TLM_FLAG_DELTA; flags++){
+		Comm_Init(&comm, NULL, NULL);
+		Telemetry_Subscribe(&comm, 1U << s->channel, 1, flags);
+		start = Test_Now_Ns();
+		for(uint32_t r = 0; r < 20; r++){
+			for(uint32_t i = 0; i < s->count; i++){
+				Telemetry_Push(s->channel, &s->samples[i * s->sampleSize]);
+				if(!(i & 7))
+					Test_Discard();
+			}
+		}
+		printf("     Telemetry_Push %s: %.1f ns/muestra, trama incluida\n", flags ? "delta" : "crudo",
+			   (double)(Test_Now_Ns() - start) / (20.0 * s->count));
+	}
+	Telemetry_Subscribe(NULL, 0, 1, 0);
+}
+
+int main(int argc, char **argv){
+	s_stream imu = {.channel = TEST_IMU, .sampleSize = 12};
+	s_stream adc = {.channel = TEST_ADC, .sampleSize = TEST_ADC_SENSORS * 2, .count = TEST_ADC_SAMPLES};
+	uint8_t isBench = argc > 2 && !strcmp(argv[2], "-b");
+	uint8_t *frames, *samples;
+	uint16_t *value;
+	uint32_t seed = 7;
+	long size;
+	FILE *f;
+
+	if(argc < 2){
+		fprintf(stderr, "uso: %s <cuadros.bin> [-b]\n", argv[0]);
+		return 2;
+	}
+	f = fopen(argv[1], "rb");
+	if(f == NULL){
+		perror(argv[1]);
+		return 1;
+	}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	rewind(f);
+	imu.count = (uint32_t)(size / MPU_FIFO_FRAME);
+	frames = malloc((size_t)size);
+	if(frames == NULL || fread(frames, MPU_FIFO_FRAME, imu.count, f) != imu.count)
+		return 1;
+	fclose(f);
+
+	// Acc y gyro del cuadro big endian, sin la temperatura, como int16 little-endian
+	samples = malloc((size_t)imu.count * imu.sampleSize);
+	for(uint32_t i = 0; i < imu.count; i++){
+		for(uint8_t w = 0, src = 0; w < 6; w++, src++){
+			if(src == 3)
+				src++;
+			samples[i * 12 + 2 * w] = frames[i * MPU_FIFO_FRAME + 2 * src + 1];
+			samples[i * 12 + 2 * w + 1] = frames[i * MPU_FIFO_FRAME + 2 * src];
+		}
+	}
+	imu.samples = samples;
+
+	value = malloc((size_t)adc.count * adc.sampleSize);
+	for(uint32_t i = 0; i < adc.count; i++){
+		for(uint8_t k = 0; k < TEST_ADC_SENSORS; k++){
+			double line = exp(-pow((k - 4.0 - 3.0 * sin(i * 2e-4)) / 1.5, 2));
+
+			seed = seed * 1664525u + 1013904223u;
+			value[i * TEST_ADC_SENSORS + k] = (uint16_t)(400 + 3000 * line + (seed >> 28));
+		}
+	}
+	adc.samples = (const uint8_t *)value;
+
+	Telemetry_Add_Channel(TEST_ADC, adc.sampleSize, 8);
+	Telemetry_Add_Channel(TEST_IMU, imu.sampleSize, 8);
+	Test_Roundtrip(&imu, "IMU", isBench);
+	Test_Roundtrip(&adc, "ADC", isBench);
+
+	free(frames);
+	free(samples);
+	free(value);
+	return Test_Summary("telemetry_test");
+}
@@ -0,0 +1,67 @@
+/**
+ * @file test.h
+ * @brief Utilidades comunes de las pruebas en la PC.
+ *
+ * Cada prueba es un ejecutable que compila los fuentes del firmware sin modificar. Las
+ * verificaciones fallidas se informan con archivo y línea y al final Test_Summary() devuelve
+ * el código de salida, así `make test` se detiene en la primera prueba que falla.
+ */
+
+#ifndef TESTS_HOST_TEST_H_
+#define TESTS_HOST_TEST_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+static unsigned testChecks, testFails;
+
+/** @brief Verifica una condición y la informa si falla, sin abortar la prueba. */
+#define CHECK(cond)	do{																	\
+		testChecks++;																		\
+		if(!(cond)){																		\
+			testFails++;																	\
+			printf("%s:%d: falla: %s\n", __FILE__, __LINE__, #cond);						\
+		}																					\
+	}while(0)
+
+/** @brief Verifica que dos valores estén a menos de tol, mostrando ambos si falla. */
+#define CHECK_NEAR(a, b, tol)	do{															\
+		double _a = (a), _b = (b);															\
+		testChecks++;																		\
+		if(!(_a - _b <= (tol) && _b - _a <= (tol))){										\
+			testFails++;																	\
+			printf("%s:%d: falla: %s = %g, %s = %g\n", __FILE__, __LINE__, #a, _a, #b, _b);\
+		}																					\
+	}while(0)
+
+/** @brief Tiempo monotónico en nanosegundos, para las mediciones. */
+static inline uint64_t Test_Now_Ns(void){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/** @brief Contador de ciclos del procesador de la PC, 0 donde no hay uno disponible. */
+static inline uint64_t Test_Cycles(void){
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	return 0;
+#endif
+}
+
+/** @brief Evita que el compilador descarte un resultado que sólo se mide. */
+static inline void Test_Keep(const void *p){
+	__asm__ volatile("" : : "r"(p) : "memory");
+}
+
+/** @brief Informa el resultado y devuelve el código de salida del ejecutable. */
+static inline int Test_Summary(const char *name){
+	printf("%s: %u verificaciones, %u fallas\n", name, testChecks, testFails);
+	return testFails ? 1 : 0;
+}
+
+#endif /* TESTS_HOST_TEST_H_ */
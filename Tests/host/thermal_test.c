@@ -0,0 +1,218 @@
+/**
+ * @file thermal_test.c
+ * @brief Pruebas de la compensación del sesgo del giróscopo por temperatura de mpu6050.c.
+ *
+ * Un MPU6050 simulado se calienta de 25 a 45 grados en los primeros 15 minutos, como al
+ * encender los motores en un día templado, y después se enfría hacia 30. El sesgo de cada eje
+ * del giróscopo sigue una recta con la temperatura, con pendientes del orden de las de la hoja
+ * de datos, y el robot se mueve 10 segundos de cada minuto.
+ *
+ * Las muestras entran por el camino de la lectura directa: bit_data, MPU6050_I2C_DMA_Cplt()
+ * y MPU6050_MAF(), sin modificar. Se corre la misma historia con la compensación apagada
+ * (offsets fijos de la calibración en segundo plano del arranque) y prendida, y se compara el
+ * offset aplicado en cada muestra contra el sesgo verdadero a la temperatura del momento.
+ */
+
+#include "I2C/MPU6050/mpu6050.h"
+#include "test.h"
+#include <math.h>
+
+#define TEST_RATE_HZ		1000
+#define TEST_SECONDS		1800
+#define TEST_LEARN_S		120			///< Desde acá se mide el sesgo residual
+#define TEST_T_START		25.0
+#define TEST_T_HOT			45.0
+#define TEST_T_COOL			30.0
+#define TEST_T_TURN_S		900			///< Empieza a enfriarse
+#define TEST_LSB_DPS		131.0		///< LSB del giróscopo por grado/s a ±250 grados/s
+
+/** @brief Sesgo a TEST_T_START y su variación por grado, LSB de ±250 grados/s. */
+static const double biasAt25[3] = {-42.0, 27.0, 15.0};
+static const double biasPerDeg[3] = {5.5, -3.8, 2.4};
+
+/** @brief Sesgo residual de una corrida, LSB. */
+typedef struct{
+	double sumSq[3];
+	double worst[3];
+	uint32_t count;
+}s_residual;
+
+static s_MPU mpu;
+static uint32_t lost;				///< Muestras que el driver no publicó
+static uint32_t lcg = 4242;
+
+static uint32_t Test_Rand(void){
+	lcg = lcg * 1664525u + 1013904223u;
+	return lcg >> 8;
+}
+
+/** @brief Ruido de media cero y desvío sigma, suma de uniformes. */
+static double Test_Noise(double sigma){
+	double sum = 0;
+
+	for(uint8_t i = 0; i < 4; i++)
+		sum += (Test_Rand() & 0xFFFF) / 65536.0 - 0.5;
+	return sum * sigma * 1.732;
+}
+
+static int16_t Test_Clamp(double v){
+	long r = lround(v);
+
+	return (int16_t)(r > INT16_MAX ? INT16_MAX : r < INT16_MIN ? INT16_MIN : r);
+}
+
+static double Test_Temperature(double t){
+	double hot = TEST_T_HOT - (TEST_T_HOT - TEST_T_START) * exp(-t / 240.0);
+
+	if(t < TEST_T_TURN_S)
+		return hot;
+	hot = TEST_T_HOT - (TEST_T_HOT - TEST_T_START) * exp(-TEST_T_TURN_S / 240.0);
+	return TEST_T_COOL + (hot - TEST_T_COOL) * exp(-(t - TEST_T_TURN_S) / 300.0);
+}
+
+static double Test_Bias(uint8_t axis, double celsius){
+	return biasAt25[axis] + biasPerDeg[axis] * (celsius - TEST_T_START);
+}
+
+static e_system Sim_Write(uint16_t dev, uint8_t reg, uint8_t size, uint8_t *data, uint16_t len, uint32_t timeout){
+	(void)dev; (void)reg; (void)size; (void)data; (void)len; (void)timeout;
+	return SYS_OK;
+}
+
+static e_system Sim_Read(uint16_t dev, uint8_t reg, uint8_t size, uint8_t *data, uint16_t len, uint32_t timeout){
+	(void)dev; (void)size; (void)timeout;
+	memset(data, 0, len);
+	if(reg == WHO_AM_I_MPU6050)
+		data[0] = WHO_AM_I_DEFAULT_VALUE;
+	return SYS_OK;
+}
+
+/** @brief Entrega una muestra al driver como la lectura directa por DMA. */
+static void Test_Sample(const int16_t word[MPU_FRAME_WORDS]){
+	for(uint8_t i = 0; i < MPU_FRAME_WORDS; i++){
+		mpu.bit_data[2 * i] = (uint8_t)((uint16_t)word[i] >> 8);
+		mpu.bit_data[2 * i + 1] = (uint8_t)word[i];
+	}
+	if(MPU6050_I2C_DMA_Cplt(&mpu) != TRUE || MPU6050_MAF(&mpu) != TRUE)
+		lost++;
+}
+
+/** @brief Muestra del sensor en el instante t; quieto salvo 10 s de cada minuto. */
+static void Test_Step(double t, double celsius){
+	uint8_t isMoving = t >= 30 && fmod(t, 60.0) >= 40.0;
+	double rate = isMoving ? 60.0 * sin(t * 2.1) : 0.0;
+	int16_t word[MPU_FRAME_WORDS];
+
+	word[0] = Test_Clamp((isMoving ? 3000 * sin(t * 1.3) : 0) + Test_Noise(12));
+	word[1] = Test_Clamp(Test_Noise(12));
+	word[2] = Test_Clamp(16384 + Test_Noise(12));
+	word[3] = Test_Clamp((celsius - 36.53) * 340.0 + Test_Noise(1.5));
+	for(uint8_t axis = 0; axis < 3; axis++)
+		word[4 + axis] = Test_Clamp(Test_Bias(axis, celsius) + rate * TEST_LSB_DPS * (axis == 2 ? 1 : 0.3) + Test_Noise(4));
+	Test_Sample(word);
+}
+
+static void Test_Init(uint8_t isThermal){
+	MPU6050_Set_I2C_Communication(Sim_Write, Sim_Read);
+	MPU6050_Set_I2C_DMA(NULL, NULL);
+	CHECK(MPU6050_Init(&mpu) == SYS_OK);
+	MPU6050_Thermal_Reset(&mpu, isThermal);
+	MPU6050_Calibrate_Start(&mpu);
+	lcg = 4242;
+}
+
+/**
+ * @brief Corre toda la historia de temperatura y mide el offset aplicado contra el sesgo verdadero.
+ */
+static void Test_Run(uint8_t isThermal, s_residual *res){
+	memset(res, 0, sizeof *res);
+	Test_Init(isThermal);
+
+	for(uint32_t n = 0; n < TEST_SECONDS * TEST_RATE_HZ; n++){
+		double t = (double)n / TEST_RATE_HZ, celsius = Test_Temperature(t);
+		const int16_t *offset = &mpu.Gyro.offset.x;
+
+		Test_Step(t, celsius);
+		if(t < TEST_LEARN_S)
+			continue;
+		for(uint8_t axis = 0; axis < 3; axis++){
+			double err = offset[axis] - Test_Bias(axis, celsius);
+
+			res->sumSq[axis] += err * err;
+			if(fabs(err) > res->worst[axis])
+				res->worst[axis] = fabs(err);
+		}
+		res->count++;
+	}
+	CHECK(MPU6050_Is_Calibrated(&mpu));
+}
+
+/**
+ * @brief Sesgo residual con y sin compensación, y la pendiente aprendida.
+ */
+static void Test_Drift(void){
+	s_residual fixed, comp;
+
+	Test_Run(FALSE, &fixed);
+	CHECK(!mpu.Thermal.isValid);
+	Test_Run(TRUE, &comp);
+	CHECK(mpu.Thermal.isValid && mpu.Thermal.hasSlope);
+	// Las ventanas con movimiento no entran en la recta
+	CHECK(mpu.Calib.rejected > 0);
+
+	for(uint8_t axis = 0; axis < 3; axis++){
+		double rmsFixed = sqrt(fixed.sumSq[axis] / fixed.count), rmsComp = sqrt(comp.sumSq[axis] / comp.count);
+		double slope = mpu.Thermal.slope[axis] / 65536.0 * 340.0;
+
+		// Pendiente en LSB de giróscopo por grado, contra la verdadera
+		CHECK_NEAR(slope, biasPerDeg[axis], 0.1 * fabs(biasPerDeg[axis]));
+		// Sin compensación el sesgo se va con los 20 grados; con la recta queda cerca del ruido
+		CHECK(rmsFixed > 50 * rmsComp);
+		CHECK(rmsComp < 1.0);
+		CHECK(comp.worst[axis] < 2.0);
+		printf("thermal: eje %u, sesgo residual %.2f LSB eficaces (peor %.1f) sin compensar, "
+			   "%.2f (peor %.1f) compensado; pendiente %.2f LSB/grado, verdadera %.2f\n",
+			   axis, rmsFixed, fixed.worst[axis], rmsComp, comp.worst[axis], slope, biasPerDeg[axis]);
+	}
+}
+
+/**
+ * @brief A temperatura constante no hay pendiente: la recta es el sesgo medio de las ventanas quietas.
+ */
+static void Test_Constant(void){
+	const double celsius = 33.0;
+	const int16_t *offset = &mpu.Gyro.offset.x;
+
+	// Termina quieto: la ventana en curso al hacer el reset no tiene movimiento
+	Test_Init(TRUE);
+	for(uint32_t n = 0; n < 95 * TEST_RATE_HZ; n++)
+		Test_Step((double)n / TEST_RATE_HZ, celsius);
+	CHECK(mpu.Thermal.isValid && !mpu.Thermal.hasSlope);
+	for(uint8_t axis = 0; axis < 3; axis++){
+		CHECK(mpu.Thermal.slope[axis] == 0);
+		CHECK_NEAR(offset[axis], Test_Bias(axis, celsius), 1.0);
+	}
+
+	// Reset: vuelve a los offsets fijos hasta juntar MPU_THERMAL_MIN_POINTS ventanas quietas
+	MPU6050_Thermal_Reset(&mpu, TRUE);
+	CHECK(!mpu.Thermal.isValid && mpu.Thermal.points == 0);
+	for(uint32_t n = 0; n < (MPU_THERMAL_MIN_POINTS - 1) * MPU_CALIB_WINDOW; n++)
+		Test_Step(10.0, celsius);
+	CHECK(!mpu.Thermal.isValid);
+	for(uint32_t n = 0; n < MPU_CALIB_WINDOW; n++)
+		Test_Step(10.0, celsius);
+	CHECK(mpu.Thermal.isValid);
+
+	// Apagada no suma ventanas
+	MPU6050_Thermal_Reset(&mpu, FALSE);
+	for(uint32_t n = 0; n < 4 * MPU_THERMAL_MIN_POINTS * MPU_CALIB_WINDOW; n++)
+		Test_Step(10.0, celsius);
+	CHECK(!mpu.Thermal.isValid && mpu.Thermal.points == 0);
+}
+
+int main(void){
+	Test_Drift();
+	Test_Constant();
+	CHECK(lost == 0);
+	return Test_Summary("thermal_test");
+}
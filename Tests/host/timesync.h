@@ -0,0 +1,159 @@
+/**
+ * @file timesync.h
+ * @brief Sincronización del reloj de la PC con el del robot mediante TIMESYNC.
+ *
+ * Sigue el intercambio de Comm_Attach_Clock(): la PC envía hostTime (8 bytes, su reloj en
+ * microsegundos en t1) y el rtt del intercambio anterior; el robot responde hostTime | t2 | t3
+ * y la PC anota t4 al recibirla. Cada intercambio da, al estilo NTP,
+ * offset = ((t2 - t1) + (t3 - t4)) / 2 y rtt = (t4 - t1) - (t3 - t2), con el offset verdadero a
+ * menos de rtt / 2 del calculado.
+ *
+ * El reloj del robot es de 32 bits y da la vuelta cada 71 minutos, así que el offset se lleva
+ * módulo 2^32. Sobre una ventana de intercambios se descartan los de rtt largo (demorados en
+ * la cola del puerto o del sistema operativo, con el error más grande) y con los restantes se
+ * ajusta por cuadrados mínimos una recta offset = offset0 + drift * (t - base) que sigue la
+ * diferencia de frecuencia entre los cristales.
+ */
+
+#ifndef TESTS_HOST_TIMESYNC_H_
+#define TESTS_HOST_TIMESYNC_H_
+
+#include "Protocol_Handler/protocol_handler.h"
+#include <string.h>
+#include <math.h>
+
+/** @brief Intercambios que se guardan para el ajuste. */
+#define TIMESYNC_WINDOW			32
+/** @brief Se usan en el ajuste los intercambios con rtt hasta tantas veces el mínimo de la ventana. */
+#define TIMESYNC_RTT_FACTOR		2
+
+/** @brief Resultado de un intercambio. */
+typedef struct{
+	uint64_t host;			///< Punto medio del intercambio en el reloj de la PC, (t1 + t4) / 2
+	uint32_t offset;		///< Reloj del robot menos reloj de la PC, módulo 2^32
+	uint32_t rtt;			///< Ida y vuelta sin la atención en el robot, microsegundos
+}s_syncSample;
+
+/** @brief Estado de la sincronización de un enlace. */
+typedef struct{
+	s_syncSample sample[TIMESYNC_WINDOW];	///< Últimos intercambios, circular
+	uint32_t count;							///< Intercambios recibidos en total
+	uint32_t lastRtt;						///< rtt del último intercambio, se informa en el próximo
+	uint64_t base;							///< Instante de la PC al que se refiere offset
+	uint32_t offset;						///< Offset ajustado en base, módulo 2^32
+	double drift;							///< Variación del offset por microsegundo de la PC
+	uint32_t minRtt;						///< Menor rtt de la ventana
+	uint8_t used;							///< Intercambios que entraron en el último ajuste
+}s_timeSync;
+
+/** @brief Deja la sincronización sin intercambios. */
+static inline void TimeSync_Init(s_timeSync *ts){
+	memset(ts, 0, sizeof *ts);
+}
+
+/**
+ * @brief Arma el payload de una solicitud TIMESYNC.
+ *
+ * @param t1 Reloj de la PC al enviar, microsegundos.
+ * @param payload Al menos 12 bytes.
+ * @return Bytes del payload; sin un intercambio previo no se informa rtt.
+ */
+static inline uint16_t TimeSync_Request(const s_timeSync *ts, uint64_t t1, uint8_t *payload){
+	memcpy(payload, &t1, 8);
+	if(!ts->count)
+		return 8;
+	for(uint8_t i = 0; i < 4; i++)
+		payload[8 + i] = (uint8_t)(ts->lastRtt >> (8 * i));
+	return 12;
+}
+
+/**
+ * @brief Ajusta la recta de offset con los intercambios de rtt corto de la ventana.
+ */
+static inline void TimeSync_Fit(s_timeSync *ts){
+	uint32_t n = ts->count < TIMESYNC_WINDOW ? ts->count : TIMESYNC_WINDOW;
+	const s_syncSample *ref = &ts->sample[0];
+	double sx = 0, sy = 0, sxx = 0, sxy = 0, x, y, den;
+	uint8_t used = 0;
+
+	for(uint32_t i = 0; i < n; i++){
+		if(ts->sample[i].rtt < ref->rtt)
+			ref = &ts->sample[i];
+	}
+	ts->minRtt = ref->rtt;
+	ts->base = ref->host;
+	for(uint32_t i = 0; i < n; i++){
+		const s_syncSample *s = &ts->sample[i];
+
+		if(s->rtt > (uint64_t)ref->rtt * TIMESYNC_RTT_FACTOR)
+			continue;
+		x = (double)(int64_t)(s->host - ref->host);
+		y = (int32_t)(s->offset - ref->offset);
+		sx += x;
+		sy += y;
+		sxx += x * x;
+		sxy += x * y;
+		used++;
+	}
+	ts->used = used;
+	den = used * sxx - sx * sx;
+	// Con un solo punto, o todos en el mismo instante, se conserva la pendiente anterior
+	if(used >= 2 && den > 0)
+		ts->drift = (used * sxy - sx * sy) / den;
+	ts->offset = ref->offset + (uint32_t)(int32_t)lround((sy - ts->drift * sx) / used);
+}
+
+/**
+ * @brief Procesa la respuesta TIMESYNC y rehace el ajuste.
+ *
+ * @param payload Payload de la respuesta: hostTime | t2 | t3.
+ * @param t4 Reloj de la PC al recibir, microsegundos.
+ * @return 0 si se agregó el intercambio, -1 si la respuesta está mal formada.
+ */
+static inline int TimeSync_Reply(s_timeSync *ts, const uint8_t *payload, uint16_t len, uint64_t t4){
+	s_syncSample *s = &ts->sample[ts->count % TIMESYNC_WINDOW];
+	uint64_t t1;
+	uint32_t t2, t3, up;
+
+	if(len != 16)
+		return -1;
+	memcpy(&t1, payload, 8);
+	t2 = comm_get_u32(&payload[8]);
+	t3 = comm_get_u32(&payload[12]);
+	if(t4 < t1)
+		return -1;
+
+	// Todo módulo 2^32: la ida da t2 - t1 = offset + subida, la vuelta t3 - t4 = offset - bajada
+	up = t2 - (uint32_t)t1;
+	s->rtt = (uint32_t)(t4 - t1) - (t3 - t2);
+	s->offset = up + (uint32_t)((int32_t)((t3 - (uint32_t)t4) - up) / 2);
+	s->host = t1 + (t4 - t1) / 2;
+	ts->lastRtt = s->rtt;
+	ts->count++;
+	TimeSync_Fit(ts);
+	return 0;
+}
+
+/**
+ * @brief Reloj del robot que corresponde a un instante de la PC.
+ */
+static inline uint32_t TimeSync_To_Robot(const s_timeSync *ts, uint64_t host){
+	double dt = (double)(int64_t)(host - ts->base);
+
+	return (uint32_t)host + ts->offset + (uint32_t)(int32_t)lround(ts->drift * dt);
+}
+
+/**
+ * @brief Instante de la PC que corresponde a una marca del robot, por ejemplo de TELEMETRY.
+ *
+ * @param robot Marca del robot, microsegundos.
+ * @param near Instante de la PC cercano a la marca (a menos de 35 minutos), para deshacer la
+ * vuelta del contador de 32 bits; por ejemplo el de recepción de la trama.
+ */
+static inline uint64_t TimeSync_To_Host(const s_timeSync *ts, uint32_t robot, uint64_t near){
+	int32_t ahead = (int32_t)(robot - TimeSync_To_Robot(ts, near));
+
+	return near + (int64_t)llround(ahead / (1.0 + ts->drift));
+}
+
+#endif /* TESTS_HOST_TIMESYNC_H_ */
@@ -0,0 +1,163 @@
+/**
+ * @file timesync_test.c
+ * @brief Pruebas de la sincronización de relojes de timesync.h contra el TIMESYNC del firmware.
+ *
+ * Se simula un enlace con demoras de ida y de vuelta independientes, con ruido y colas
+ * ocasionales de varios milisegundos, y un robot cuyo reloj de 32 bits corre 40 ppm más
+ * rápido que el de la PC y da la vuelta durante la prueba. Cada intercambio pasa por
+ * decodeProtocol() y Comm_Cmd_TimeSync() sin modificar; el reloj del robot se entrega con
+ * Comm_Attach_Clock() y avanza en cada lectura, como el tiempo de atención del handler.
+ */
+
+#include "Protocol_Handler/protocol_handler.h"
+#include "uner.h"
+#include "timesync.h"
+#include "test.h"
+#include <stdlib.h>
+
+#define TEST_EXCHANGES		400
+#define TEST_PERIOD			50000		///< Microsegundos entre intercambios
+#define TEST_DRIFT			40e-6		///< Diferencia de frecuencia del robot
+#define TEST_HOST_START		1760000000000000ULL
+#define TEST_ROBOT_START	0xFFF00000U	///< Da la vuelta a los ~1.05 s
+
+static s_commData comm;
+static uint8_t txOut[1024];
+static uint32_t txLen;
+static uint64_t hostNow;
+static uint32_t lcg = 12345;
+
+static uint32_t Test_Rand(void){
+	lcg = lcg * 1664525u + 1013904223u;
+	return lcg >> 8;
+}
+
+/** @brief Reloj verdadero del robot en un instante de la PC. */
+static uint32_t Test_Robot(uint64_t host){
+	double dt = (double)(host - TEST_HOST_START);
+
+	return TEST_ROBOT_START + (uint32_t)(uint64_t)llround(dt * (1.0 + TEST_DRIFT));
+}
+
+/** @brief Reloj que ve el firmware; cada lectura consume 3 us de atención. */
+static uint32_t Test_Micros(void){
+	uint32_t now = Test_Robot(hostNow);
+
+	hostNow += 3;
+	return now;
+}
+
+/** @brief Demora de un sentido: base, ruido y de vez en cuando una cola larga. */
+static uint32_t Test_Delay(void){
+	uint32_t d = 250 + Test_Rand() % 200;
+
+	if(Test_Rand() % 8 == 0)
+		d += Test_Rand() % 6000;
+	return d;
+}
+
+/** @brief Error del reloj ajustado contra el verdadero en un instante de la PC, microsegundos. */
+static int32_t Test_Error(const s_timeSync *ts, uint64_t host){
+	return (int32_t)(TimeSync_To_Robot(ts, host) - Test_Robot(host));
+}
+
+/**
+ * @brief Un intercambio completo por el firmware.
+ *
+ * @return Error del offset del intercambio contra el verdadero en su punto medio.
+ */
+static int32_t Test_Exchange(s_timeSync *ts){
+	uint8_t payload[12], frame[64];
+	uint64_t t1 = hostNow;
+	uint32_t size, n, prev = ts->count;
+	const s_syncSample *s = &ts->sample[prev % TIMESYNC_WINDOW];
+	s_unerFrame f;
+
+	size = Uner_Encode(frame, TIMESYNC, payload, TimeSync_Request(ts, t1, payload), -1, comm.checkMode);
+	hostNow += Test_Delay();
+	CHECK(RingBuffer_Push(&comm.Rx, frame, size) == size);
+	decodeProtocol(&comm);
+	txLen = Comm_Tx_Read(&comm, txOut, sizeof txOut);
+	hostNow += Test_Delay();
+
+	n = Uner_Decode(txOut, txLen, comm.checkMode, &f);
+	CHECK(n == txLen && f.cmd == TIMESYNC && f.length == 16);
+	CHECK(!memcmp(f.payload, &t1, 8));
+	CHECK(TimeSync_Reply(ts, f.payload, f.length, hostNow) == 0);
+	CHECK(ts->count == prev + 1);
+	return (int32_t)(s->offset - (Test_Robot(s->host) - (uint32_t)s->host));
+}
+
+/**
+ * @brief El histograma del robot cuenta los rtt que informó la PC.
+ */
+static void Test_Latency(uint32_t expected){
+	uint8_t frame[64], clear = 1;
+	uint32_t size, total = 0;
+	s_unerFrame f;
+
+	size = Uner_Encode(frame, LATENCY, &clear, 1, -1, comm.checkMode);
+	CHECK(RingBuffer_Push(&comm.Rx, frame, size) == size);
+	decodeProtocol(&comm);
+	txLen = Comm_Tx_Read(&comm, txOut, sizeof txOut);
+	CHECK(Uner_Decode(txOut, txLen, comm.checkMode, &f) && f.cmd == LATENCY);
+	CHECK(f.length == COMM_RTT_BINS * 4);
+	for(uint8_t bin = 0; bin < COMM_RTT_BINS; bin++)
+		total += comm_get_u32(&f.payload[bin * 4]);
+	CHECK(total == expected);
+}
+
+int main(void){
+	s_timeSync ts;
+	uint64_t sampleErr = 0, fitErr = 0, host;
+	int32_t err, worst = 0;
+	uint32_t fitCount = 0;
+
+	Comm_Init(&comm, Comm_Dispatch, NULL);
+	Comm_Attach_Clock(&Test_Micros);
+	TimeSync_Init(&ts);
+	hostNow = TEST_HOST_START;
+
+	// Respuestas mal formadas
+	CHECK(TimeSync_Reply(&ts, txOut, 12, hostNow) == -1);
+	CHECK(ts.count == 0);
+
+	for(uint32_t i = 0; i < TEST_EXCHANGES; i++){
+		const s_syncSample *s;
+
+		err = Test_Exchange(&ts);
+		s = &ts.sample[i % TIMESYNC_WINDOW];
+		// Cota NTP del intercambio; el drift durante unos ms suma menos de 1 us
+		CHECK(abs(err) <= (int32_t)(s->rtt / 2 + 2));
+		sampleErr += abs(err);
+
+		// Con la ventana llena, el ajuste predice el reloj del robot hasta el próximo intercambio
+		if(i >= TIMESYNC_WINDOW){
+			for(host = hostNow; host < hostNow + TEST_PERIOD; host += TEST_PERIOD / 5){
+				err = Test_Error(&ts, host);
+				fitErr += abs(err);
+				if(abs(err) > worst)
+					worst = abs(err);
+				fitCount++;
+			}
+		}
+		hostNow += TEST_PERIOD;
+	}
+
+	// El contador del robot dio la vuelta durante la prueba
+	CHECK(Test_Robot(hostNow) < TEST_ROBOT_START);
+	CHECK_NEAR(ts.drift, TEST_DRIFT, 3e-6);
+	CHECK(worst <= 100);
+	CHECK(fitErr / fitCount * 4 < sampleErr / TEST_EXCHANGES);
+
+	// Ida y vuelta entre los dos relojes, incluso del otro lado de la vuelta del contador
+	for(host = hostNow - 3000000; host < hostNow + 3000000; host += 99991)
+		CHECK_NEAR((double)(int64_t)(TimeSync_To_Host(&ts, TimeSync_To_Robot(&ts, host), host + 1000000) - host), 0, 1);
+
+	// La primera solicitud no lleva rtt
+	Test_Latency(TEST_EXCHANGES - 1);
+
+	printf("timesync: error por intercambio %.1f us, ajustado %.1f us (peor %d us), drift %.2f ppm\n",
+		   (double)sampleErr / TEST_EXCHANGES, (double)fitErr / fitCount, (int)worst, ts.drift * 1e6);
+	return Test_Summary("timesync_test");
+}
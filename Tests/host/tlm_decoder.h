@@ -0,0 +1,102 @@
+/**
+ * @file tlm_decoder.h
+ * @brief Decodificador de tramas TELEMETRY del lado de la PC.
+ *
+ * Sigue el formato de telemetry.h: channel | seq (u16) | count | [first | last] | muestras.
+ * En modo comprimido cada palabra int16 llega como delta zigzag + varint contra la misma
+ * palabra de la muestra anterior del canal; una trama clave parte de cero. Si falta una
+ * trama (salto en seq) se pierde la referencia y se descartan las tramas comprimidas hasta
+ * la próxima clave.
+ */
+
+#ifndef TESTS_HOST_TLM_DECODER_H_
+#define TESTS_HOST_TLM_DECODER_H_
+
+#include "Telemetry/telemetry.h"
+#include <string.h>
+
+/** @brief Estado de decodificación de un canal. */
+typedef struct{
+	int16_t last[TLM_MAX_DELTA_SAMPLE / 2];		///< Última muestra decodificada
+	uint16_t seq;								///< seq esperado de la próxima trama
+	uint8_t hasSeq;								///< Ya llegó al menos una trama
+	uint8_t isSynced;							///< last vale como referencia
+	uint32_t lost;								///< Tramas perdidas según seq
+	uint32_t skipped;							///< Tramas comprimidas descartadas por falta de referencia
+	uint32_t first;								///< Instante de la primera muestra de la última trama
+	uint32_t lastTime;							///< Instante de la última muestra de la última trama
+}s_tlmDecoder;
+
+/**
+ * @brief Decodifica el payload de una trama TELEMETRY del canal.
+ *
+ * @param d Estado del canal.
+ * @param payload Payload de la trama.
+ * @param len Bytes del payload.
+ * @param sampleSize Bytes de cada muestra del canal.
+ * @param out Muestras decodificadas, count * sampleSize bytes little-endian.
+ * @return Muestras decodificadas, 0 si se descartó por falta de referencia, -1 si la trama está mal formada.
+ */
+static inline int Tlm_Decode(s_tlmDecoder *d, const uint8_t *payload, uint16_t len, uint8_t sampleSize, uint8_t *out){
+	uint8_t id, count;
+	uint16_t seq, pos = TLM_HEADER_SIZE;
+
+	if(len < TLM_HEADER_SIZE)
+		return -1;
+	id = payload[0];
+	seq = (uint16_t)(payload[1] | (payload[2] << 8));
+	count = payload[3];
+	if(id & TLM_CHANNEL_TIME){
+		if(len < TLM_HEADER_SIZE + TLM_TIME_SIZE)
+			return -1;
+		d->first = comm_get_u32(&payload[pos]);
+		d->lastTime = comm_get_u32(&payload[pos + 4]);
+		pos += TLM_TIME_SIZE;
+	}
+
+	if(d->hasSeq && seq != d->seq){
+		d->lost += (uint16_t)(seq - d->seq);
+		d->isSynced = 0;
+	}
+	d->hasSeq = 1;
+	d->seq = seq + 1;
+
+	if(!(id & TLM_CHANNEL_DELTA)){
+		if(len - pos != count * sampleSize)
+			return -1;
+		memcpy(out, &payload[pos], len - pos);
+		return count;
+	}
+
+	if(id & TLM_CHANNEL_KEY){
+		memset(d->last, 0, sizeof d->last);
+		d->isSynced = 1;
+	}
+	if(!d->isSynced){
+		d->skipped++;
+		return 0;
+	}
+
+	for(uint16_t s = 0; s < count; s++){
+		for(uint8_t w = 0; w < sampleSize / 2; w++){
+			uint32_t zigzag = 0;
+			uint8_t shift = 0, byte;
+			uint16_t delta;
+
+			do{
+				if(pos >= len || shift > 14)
+					return -1;
+				byte = payload[pos++];
+				zigzag |= (uint32_t)(byte & 0x7F) << shift;
+				shift += 7;
+			}while(byte & 0x80);
+			delta = (uint16_t)((zigzag >> 1) ^ (0U - (zigzag & 1)));
+			d->last[w] = (int16_t)(d->last[w] + delta);
+			*out++ = (uint8_t)d->last[w];
+			*out++ = (uint8_t)((uint16_t)d->last[w] >> 8);
+		}
+	}
+	return pos == len ? count : -1;
+}
+
+#endif /* TESTS_HOST_TLM_DECODER_H_ */
@@ -0,0 +1,106 @@
+/**
+ * @file uner.h
+ * @brief Armado y lectura de tramas UNER del lado de la PC, para las pruebas.
+ *
+ * Trama: 'U' 'N' 'E' 'R' | nBytes | ':' o ';' | [tag] | cmd | payload | checksum.
+ * nBytes cuenta desde la etiqueta hasta el checksum inclusive; en cero indica trama
+ * extendida con el largo en los dos bytes siguientes. El XOR cubre desde la 'U' hasta el
+ * último byte del payload y los CRC se guardan con el byte menos significativo primero.
+ */
+
+#ifndef TESTS_HOST_UNER_H_
+#define TESTS_HOST_UNER_H_
+
+#include "Protocol_Handler/protocol_handler.h"
+#include "CRC/crc.h"
+#include <string.h>
+
+/** @brief Trama leída de un flujo de bytes. */
+typedef struct{
+	uint8_t cmd;
+	uint8_t tag;
+	uint8_t isTagged;
+	const uint8_t *payload;
+	uint16_t length;
+}s_unerFrame;
+
+static inline uint8_t Uner_Check_Size(uint8_t mode){
+	return mode == CHECK_CRC16 ? 2 : mode == CHECK_CRC32C ? 4 : 1;
+}
+
+static inline uint32_t Uner_Check(const uint8_t *data, uint32_t len, uint8_t mode){
+	uint8_t x = 0;
+
+	if(mode == CHECK_CRC16)
+		return CRC16_Update(CRC16_INIT, data, len);
+	if(mode == CHECK_CRC32C)
+		return CRC32C_Update(CRC32C_INIT, data, len);
+	while(len--)
+		x ^= *data++;
+	return x;
+}
+
+/**
+ * @brief Arma una trama en out.
+ *
+ * @param tag Etiqueta, o negativo para una trama sin etiqueta.
+ * @return Largo total de la trama.
+ */
+static inline uint32_t Uner_Encode(uint8_t *out, uint8_t cmd, const uint8_t *payload, uint16_t len, int tag, uint8_t mode){
+	uint32_t body = (tag >= 0) + 1 + len + Uner_Check_Size(mode);
+	uint32_t i = 0, check;
+
+	memcpy(out, "UNER", 4);
+	i = 4;
+	if(body <= 255){
+		out[i++] = (uint8_t)body;
+	}else{
+		out[i++] = 0;
+	}
+	out[i++] = tag >= 0 ? FRAME_TOKEN_TAGGED : FRAME_TOKEN;
+	if(body > 255){
+		out[i++] = (uint8_t)body;
+		out[i++] = (uint8_t)(body >> 8);
+	}
+	if(tag >= 0)
+		out[i++] = (uint8_t)tag;
+	out[i++] = cmd;
+	memcpy(&out[i], payload, len);
+	i += len;
+	check = Uner_Check(out, i, mode);
+	for(uint8_t k = 0; k < Uner_Check_Size(mode); k++)
+		out[i++] = (uint8_t)(check >> (8 * k));
+	return i;
+}
+
+/**
+ * @brief Lee la trama que empieza en data.
+ *
+ * @return Largo de la trama, o cero si no hay una trama válida completa al principio.
+ */
+static inline uint32_t Uner_Decode(const uint8_t *data, uint32_t len, uint8_t mode, s_unerFrame *frame){
+	uint32_t prefix = FRAME_PREFIX, body, check = 0;
+	uint8_t checkSize = Uner_Check_Size(mode);
+
+	if(len < FRAME_MIN_SIZE || memcmp(data, "UNER", 4) || (data[5] != FRAME_TOKEN && data[5] != FRAME_TOKEN_TAGGED))
+		return 0;
+	body = data[4];
+	if(!body){
+		body = data[6] | (data[7] << 8);
+		prefix = FRAME_EXT_PREFIX;
+	}
+	frame->isTagged = data[5] == FRAME_TOKEN_TAGGED;
+	if(prefix + body > len || body < 1U + frame->isTagged + checkSize)
+		return 0;
+	for(uint8_t k = 0; k < checkSize; k++)
+		check |= (uint32_t)data[prefix + body - checkSize + k] << (8 * k);
+	if(check != Uner_Check(data, prefix + body - checkSize, mode))
+		return 0;
+	frame->tag = frame->isTagged ? data[prefix] : 0;
+	frame->cmd = data[prefix + frame->isTagged];
+	frame->payload = &data[prefix + frame->isTagged + 1];
+	frame->length = (uint16_t)(body - frame->isTagged - 1 - checkSize);
+	return prefix + body;
+}
+
+#endif /* TESTS_HOST_UNER_H_ */
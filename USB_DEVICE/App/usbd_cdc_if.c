@@ -94,7 +94,11 @@ uint8_t UserRxBufferFS[APP_RX_DATA_SIZE];
 uint8_t UserTxBufferFS[APP_TX_DATA_SIZE];
 
 /* USER CODE BEGIN PRIVATE_VARIABLES */
-static void (*dataOnRx)(uint8_t* buf, uint32_t len) = NULL;
+static uint8_t (*dataOnRx)(uint8_t* buf, uint32_t len) = NULL;
+static volatile uint8_t rxPaused = 0;
+static uint16_t (*dataOnTx)(uint8_t* buf, uint16_t size) = NULL;
+static volatile uint8_t txBusy = 0;		// Hay una transferencia IN en curso desde UserTxBufferFS
+static uint16_t txPending = 0;				// Bytes ya copiados a UserTxBufferFS que el endpoint no aceptó
 
 USBD_CDC_LineCodingTypeDef LineCoding = {
 		.bitrate 	= 115200,
@@ -135,6 +139,7 @@ static int8_t CDC_Receive_FS(uint8_t* pbuf, uint32_t *Len);
 static int8_t CDC_TransmitCplt_FS(uint8_t *pbuf, uint32_t *Len, uint8_t epnum);
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_DECLARATION */
+static uint8_t CDC_Chain_Tx(void);
 
 /* USER CODE END PRIVATE_FUNCTIONS_DECLARATION */
 
@@ -162,6 +167,7 @@ static int8_t CDC_Init_FS(void)
   /* Set Application Buffers */
   USBD_CDC_SetTxBuffer(&hUsbDeviceFS, UserTxBufferFS, 0);
   USBD_CDC_SetRxBuffer(&hUsbDeviceFS, UserRxBufferFS);
+  txBusy = 0;
   return (USBD_OK);
   /* USER CODE END 3 */
 }
@@ -173,6 +179,7 @@ static int8_t CDC_Init_FS(void)
 static int8_t CDC_DeInit_FS(void)
 {
   /* USER CODE BEGIN 4 */
+  txBusy = 0;		// La transferencia en curso no va a completarse
   return (USBD_OK);
   /* USER CODE END 4 */
 }
@@ -277,10 +284,11 @@ static int8_t CDC_Control_FS(uint8_t cmd, uint8_t* pbuf, uint16_t length)
 static int8_t CDC_Receive_FS(uint8_t* Buf, uint32_t *Len)
 {
   /* USER CODE BEGIN 6 */
-	if(dataOnRx != NULL){
-		dataOnRx(Buf, *Len);
-	}
   USBD_CDC_SetRxBuffer(&hUsbDeviceFS, &Buf[0]);
+	if(dataOnRx != NULL && !dataOnRx(Buf, *Len)){
+		rxPaused = 1;		// El endpoint queda en NAK hasta CDC_Resume_Rx()
+		return (USBD_OK);
+	}
   USBD_CDC_ReceivePacket(&hUsbDeviceFS);
   return (USBD_OK);
   /* USER CODE END 6 */
@@ -330,14 +338,67 @@ static int8_t CDC_TransmitCplt_FS(uint8_t *Buf, uint32_t *Len, uint8_t epnum)
   UNUSED(Buf);
   UNUSED(Len);
   UNUSED(epnum);
+  // Se encadena la próxima transferencia sin esperar al lazo principal
+  if(!CDC_Chain_Tx())
+	  txBusy = 0;
   /* USER CODE END 13 */
   return result;
 }
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_IMPLEMENTATION */
-void CDC_Attach_Rx(void (*RxData)(uint8_t* buf, uint32_t len)){
+/**
+  * @brief Llena UserTxBufferFS con los datos pendientes y arranca la transferencia.
+  *        La biblioteca CDC agrega el ZLP cuando el largo es múltiplo de 64.
+  *        dataOnTx libera los bytes al copiarlos: si el endpoint rechaza la transferencia
+  *        el buffer queda lleno en txPending y se reintenta tal cual en el próximo llamado,
+  *        antes de pedir datos nuevos, así no se pierde ni se reordena nada. Comm_Task()
+  *        lo pide con CDC_Tx_Pending() aunque no haya tramas nuevas en cola.
+  * @retval 1 si se arrancó una transferencia, 0 si no había datos o no se pudo arrancar
+  */
+static uint8_t CDC_Chain_Tx(void){
+	uint16_t len = txPending;
+
+	if(!len)
+		len = dataOnTx(UserTxBufferFS, APP_TX_DATA_SIZE);
+	if(!len)
+		return 0;
+	USBD_CDC_SetTxBuffer(&hUsbDeviceFS, UserTxBufferFS, len);
+	if(USBD_CDC_TransmitPacket(&hUsbDeviceFS) != USBD_OK){
+		txPending = len;
+		return 0;
+	}
+	txPending = 0;
+	return 1;
+}
+
+void CDC_Attach_Tx(uint16_t (*TxData)(uint8_t* buf, uint16_t size)){
+	dataOnTx = TxData;
+}
+
+void CDC_Start_Tx(void){
+	if(dataOnTx == NULL || hUsbDeviceFS.dev_state != USBD_STATE_CONFIGURED)
+		return;
+	// Mientras haya una transferencia en curso el callback de fin encadena la siguiente
+	if(__atomic_exchange_n(&txBusy, 1, __ATOMIC_ACQ_REL))
+		return;
+	if(!CDC_Chain_Tx())
+		txBusy = 0;
+}
+
+uint8_t CDC_Tx_Pending(void){
+	return txPending != 0;
+}
+
+void CDC_Attach_Rx(uint8_t (*RxData)(uint8_t* buf, uint32_t len)){
 	dataOnRx = RxData;
 }
+
+void CDC_Resume_Rx(void){
+	if(rxPaused){
+		rxPaused = 0;
+		USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+	}
+}
 /* USER CODE END PRIVATE_FUNCTIONS_IMPLEMENTATION */
 
 /**
@@ -109,7 +109,36 @@ extern USBD_CDC_ItfTypeDef USBD_Interface_fops_FS;
 uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len);
 
 /* USER CODE BEGIN EXPORTED_FUNCTIONS */
-void CDC_Attach_Rx(void (*RxData)(uint8_t* buf, uint32_t len));
+/**
+  * @brief Asigna la función que recibe los datos del endpoint OUT.
+  *        Si devuelve 0 no se pide el próximo paquete y el host queda en espera
+  *        hasta que se llame a CDC_Resume_Rx().
+  */
+void CDC_Attach_Rx(uint8_t (*RxData)(uint8_t* buf, uint32_t len));
+
+/**
+  * @brief Vuelve a habilitar la recepción si quedó pausada por falta de lugar.
+  */
+void CDC_Resume_Rx(void);
+
+/**
+  * @brief Asigna la función que entrega los datos a transmitir por el endpoint IN.
+  *        Debe copiar en buf hasta size bytes y devolver la cantidad copiada. Se llama
+  *        desde CDC_Start_Tx() y desde la interrupción de fin de transferencia.
+  */
+void CDC_Attach_Tx(uint16_t (*TxData)(uint8_t* buf, uint16_t size));
+
+/**
+  * @brief Arranca la transmisión si no hay una transferencia en curso. Las siguientes
+  *        se encadenan desde el fin de transferencia mientras haya datos.
+  */
+void CDC_Start_Tx(void);
+
+/**
+  * @brief Indica si quedó un buffer que el endpoint rechazó y espera a CDC_Start_Tx().
+  * @retval 1 si hay bytes retenidos, 0 si no
+  */
+uint8_t CDC_Tx_Pending(void);
 /* USER CODE END EXPORTED_FUNCTIONS */
 
 /**